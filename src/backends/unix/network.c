@@ -24,6 +24,11 @@
  * =======================================================================
  */
 
+/* For recvmmsg() and sendmmsg() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+ #define _GNU_SOURCE
+#endif
+
 #include "../../common/header/common.h"
 
 #include <unistd.h>
@@ -47,9 +52,16 @@
 netadr_t net_local_adr;
 
 #define LOOPBACK 0x7f000001
-#define MAX_LOOPBACK 4
+#define MAX_LOOPBACK 16 /* power of two, holds a fragmented message */
 #define QUAKE2MCAST "ff12::666"
 
+/* Packets moved per recvmmsg() / sendmmsg() */
+#define NET_BATCH 32
+
+#if defined(__linux__)
+ #define NET_MMSG
+#endif
+
 typedef struct
 {
 	byte data[MAX_MSGLEN];
@@ -68,6 +80,33 @@ int ip6_sockets[2];
 int ipx_sockets[2];
 char *multicast_interface = NULL;
 
+/* Packets received but not yet handed out, one ring per socket */
+typedef struct
+{
+	byte data[NET_BATCH][MAX_MSGLEN];
+	struct sockaddr_storage from[NET_BATCH];
+	int length[NET_BATCH];
+	int count, next;
+} netrecv_t;
+
+typedef struct
+{
+	int socket;
+	int length;
+	socklen_t addrlen;
+	struct sockaddr_storage addr;
+	byte data[MAX_MSGLEN];
+} netsend_t;
+
+static netrecv_t *net_recv[2][3];
+
+static netsend_t *net_sendqueue;
+static int net_numqueued;
+static qboolean net_queueing;
+
+static unsigned net_recvcalls, net_recvpackets;
+static unsigned net_sendcalls, net_sendpackets;
+
 static int NET_Socket(char *net_interface, int port, netsrc_t type, int family);
 static const char *NET_ErrorString(void);
 
@@ -148,6 +187,7 @@ NetadrToSockadr(netadr_t *a, struct sockaddr_storage *s)
 		case NA_LOOPBACK:
 		case NA_IPX:
 		case NA_BROADCAST_IPX:
+		case NA_BOT:
 			break;
 	}
 }
@@ -184,9 +224,30 @@ SockadrToNetadr(struct sockaddr_storage *s, netadr_t *a)
 	}
 }
 
+static void
+NET_Stats_f(void)
+{
+	Com_Printf("received %u packets in %u calls (%.2f per call)\n",
+			net_recvpackets, net_recvcalls,
+			net_recvcalls ? (float)net_recvpackets / net_recvcalls : 0.0f);
+	Com_Printf("sent %u packets in %u calls (%.2f per call)\n",
+			net_sendpackets, net_sendcalls,
+			net_sendcalls ? (float)net_sendpackets / net_sendcalls : 0.0f);
+#ifndef NET_MMSG
+	Com_Printf("recvmmsg() and sendmmsg() aren't available on this platform.\n");
+#endif
+
+	if ((Cmd_Argc() > 1) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		net_recvcalls = net_recvpackets = 0;
+		net_sendcalls = net_sendpackets = 0;
+	}
+}
+
 void
 NET_Init()
 {
+	Cmd_AddCommand("net_stats", NET_Stats_f);
 }
 
 qboolean
@@ -202,6 +263,11 @@ NET_CompareAdr(netadr_t a, netadr_t b)
 		return true;
 	}
 
+	if (a.type == NA_BOT)
+	{
+		return a.port == b.port;
+	}
+
 	if (a.type == NA_IP)
 	{
 		if ((a.ip[0] == b.ip[0]) && (a.ip[1] == b.ip[1]) &&
@@ -233,7 +299,7 @@ NET_CompareBaseAdr(netadr_t a, netadr_t b)
 		return false;
 	}
 
-	if (a.type == NA_LOOPBACK)
+	if ((a.type == NA_LOOPBACK) || (a.type == NA_BOT))
 	{
 		return true;
 	}
@@ -287,6 +353,10 @@ NET_BaseAdrToString(netadr_t a)
 				a.ip[1], a.ip[2], a.ip[3]);
 			break;
 
+		case NA_BOT:
+			Com_sprintf(s, sizeof(s), "bot");
+			break;
+
 		case NA_BROADCAST:
 			Com_sprintf(s, sizeof(s), "255.255.255.255");
 			break;
@@ -512,15 +582,64 @@ NET_SendLoopPacket(netsrc_t sock, int length, void *data, netadr_t to)
 	loop->msgs[i].datalen = length;
 }
 
+/*
+ * Drains up to NET_BATCH packets from the socket into an
+ * empty ring. Returns the number received, or -1 on error.
+ */
+static int
+NET_RecvBatch(int net_socket, netrecv_t *q)
+{
+	int ret;
+#ifdef NET_MMSG
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iov[NET_BATCH];
+	int i;
+
+	memset(msgs, 0, sizeof(msgs));
+
+	for (i = 0; i < NET_BATCH; i++)
+	{
+		iov[i].iov_base = q->data[i];
+		iov[i].iov_len = MAX_MSGLEN;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &q->from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(q->from[i]);
+	}
+
+	ret = recvmmsg(net_socket, msgs, NET_BATCH, MSG_DONTWAIT, NULL);
+	net_recvcalls++;
+
+	for (i = 0; i < ret; i++)
+	{
+		q->length[i] = msgs[i].msg_len;
+	}
+#else
+	socklen_t fromlen;
+
+	fromlen = sizeof(q->from[0]);
+	ret = recvfrom(net_socket, q->data[0], MAX_MSGLEN,
+			0, (struct sockaddr *)&q->from[0], &fromlen);
+	net_recvcalls++;
+
+	if (ret != -1)
+	{
+		q->length[0] = ret;
+		ret = 1;
+	}
+#endif
+
+	return ret;
+}
+
 qboolean
 NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 {
 	int ret;
-	struct sockaddr_storage from;
-	socklen_t fromlen;
 	int net_socket;
 	int protocol;
 	int err;
+	netrecv_t *q;
 
 	if (NET_GetLoopPacket(sock, net_from, net_message))
 	{
@@ -547,37 +666,165 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 			continue;
 		}
 
-		fromlen = sizeof(from);
-		ret = recvfrom(net_socket, net_message->data, net_message->maxsize,
-				0, (struct sockaddr *)&from, &fromlen);
+		if (!net_recv[sock][protocol])
+		{
+			net_recv[sock][protocol] = Z_Malloc(sizeof(netrecv_t));
+		}
 
-		SockadrToNetadr(&from, net_from);
+		q = net_recv[sock][protocol];
 
-		if (ret == -1)
+		while (1)
 		{
-			err = errno;
+			if (q->next == q->count)
+			{
+				q->next = q->count = 0;
+
+				memset(&q->from[0], 0, sizeof(q->from[0]));
+				ret = NET_RecvBatch(net_socket, q);
+
+				if (ret == -1)
+				{
+					err = errno;
+
+					if ((err == EWOULDBLOCK) || (err == ECONNREFUSED))
+					{
+						break;
+					}
+
+					SockadrToNetadr(&q->from[0], net_from);
+					Com_Printf("%s: %s from %s\n", NET_ErrorString(),
+							__func__, NET_AdrToString(*net_from));
+					break;
+				}
+
+				if (!ret)
+				{
+					break;
+				}
+
+				q->count = ret;
+				net_recvpackets += ret;
+			}
 
-			if ((err == EWOULDBLOCK) || (err == ECONNREFUSED))
+			ret = q->next++;
+			SockadrToNetadr(&q->from[ret], net_from);
+
+			if (q->length[ret] >= net_message->maxsize)
 			{
+				Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
 				continue;
 			}
 
-			Com_Printf("%s: %s from %s\n", NET_ErrorString(),
-					__func__, NET_AdrToString(*net_from));
+			memcpy(net_message->data, q->data[ret], q->length[ret]);
+			net_message->cursize = q->length[ret];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+NET_SendError(struct sockaddr_storage *addr)
+{
+	netadr_t to;
+
+	memset(&to, 0, sizeof(to));
+	SockadrToNetadr(addr, &to);
+
+	Com_Printf("%s ERROR: %s to %s\n", NET_ErrorString(),
+			"NET_SendPacket", NET_AdrToString(to));
+}
+
+/*
+ * Sends everything queued since NET_QueuePackets(), one
+ * sendmmsg() per run of packets for the same socket.
+ */
+static void
+NET_SendQueue(void)
+{
+	netsend_t *p;
+#ifdef NET_MMSG
+	struct mmsghdr msgs[NET_BATCH];
+	struct iovec iov[NET_BATCH];
+	int first, count, ret;
+
+	first = 0;
+
+	while (first < net_numqueued)
+	{
+		memset(msgs, 0, sizeof(msgs));
+
+		for (count = 0; first + count < net_numqueued; count++)
+		{
+			p = &net_sendqueue[first + count];
+
+			if (p->socket != net_sendqueue[first].socket)
+			{
+				break;
+			}
+
+			iov[count].iov_base = p->data;
+			iov[count].iov_len = p->length;
+			msgs[count].msg_hdr.msg_iov = &iov[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			msgs[count].msg_hdr.msg_name = &p->addr;
+			msgs[count].msg_hdr.msg_namelen = p->addrlen;
+		}
+
+		ret = sendmmsg(net_sendqueue[first].socket, msgs, count, 0);
+		net_sendcalls++;
+
+		if (ret <= 0)
+		{
+			/* the first packet failed, report it and move on */
+			NET_SendError(&net_sendqueue[first].addr);
+			first++;
 			continue;
 		}
 
-		if (ret == net_message->maxsize)
+		net_sendpackets += ret;
+		first += ret;
+	}
+#else
+	int i;
+
+	for (i = 0; i < net_numqueued; i++)
+	{
+		p = &net_sendqueue[i];
+
+		net_sendcalls++;
+
+		if (sendto(p->socket, p->data, p->length, 0,
+				(struct sockaddr *)&p->addr, p->addrlen) == -1)
 		{
-			Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+			NET_SendError(&p->addr);
 			continue;
 		}
 
-		net_message->cursize = ret;
-		return true;
+		net_sendpackets++;
 	}
+#endif
 
-	return false;
+	net_numqueued = 0;
+}
+
+/*
+ * Holds back packets sent to the network until
+ * NET_FlushPackets(), so they go out in batches.
+ * Loopback packets are still delivered at once.
+ */
+void
+NET_QueuePackets(void)
+{
+	net_queueing = true;
+}
+
+void
+NET_FlushPackets(void)
+{
+	net_queueing = false;
+	NET_SendQueue();
 }
 
 void
@@ -595,6 +842,9 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 			return;
 			break;
 
+		case NA_BOT:
+			return;
+
 		case NA_BROADCAST:
 		case NA_IP:
 			net_socket = ip_sockets[sock];
@@ -720,6 +970,28 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 		}
 	}
 
+	if (net_queueing && (length <= MAX_MSGLEN))
+	{
+		netsend_t *p;
+
+		if (!net_sendqueue)
+		{
+			net_sendqueue = Z_Malloc(NET_BATCH * sizeof(netsend_t));
+		}
+		else if (net_numqueued == NET_BATCH)
+		{
+			NET_SendQueue();
+		}
+
+		p = &net_sendqueue[net_numqueued++];
+		p->socket = net_socket;
+		p->length = length;
+		p->addrlen = addr_size;
+		p->addr = addr;
+		memcpy(p->data, data, length);
+		return;
+	}
+
 	ret = sendto(net_socket,
 			data,
 			length,
@@ -727,11 +999,16 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 			(struct sockaddr *)&addr,
 			addr_size);
 
+	net_sendcalls++;
+
 	if (ret == -1)
 	{
 		Com_Printf("%s ERROR: %s to %s\n", NET_ErrorString(),
 				__func__, NET_AdrToString(to));
+		return;
 	}
+
+	net_sendpackets++;
 }
 
 static void
@@ -775,11 +1052,22 @@ NET_Config(qboolean multiplayer)
 {
 	if (!multiplayer)
 	{
-		int i;
+		int i, j;
+
+		/* nothing may be left for the sockets we close */
+		NET_SendQueue();
 
 		/* shut down any existing sockets */
 		for (i = 0; i < 2; i++)
 		{
+			for (j = 0; j < 3; j++)
+			{
+				if (net_recv[i][j])
+				{
+					net_recv[i][j]->count = net_recv[i][j]->next = 0;
+				}
+			}
+
 			if (ip_sockets[i])
 			{
 				close(ip_sockets[i]);
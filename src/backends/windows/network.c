@@ -32,7 +32,7 @@
 #include <wsipx.h>
 #include "../../common/header/common.h"
 
-#define MAX_LOOPBACK 4
+#define MAX_LOOPBACK 16 /* power of two, holds a fragmented message */
 #define QUAKE2MCAST "ff12::666"
 
 typedef struct
@@ -144,8 +144,9 @@ NetadrToSockadr(netadr_t *a, struct sockaddr_storage *s)
 		case NA_LOOPBACK:
 		case NA_IPX:
 		case NA_BROADCAST_IPX:
+		case NA_BOT:
 			/* no handling of NA_LOOPBACK,
-			   NA_IPX, NA_BROADCAST_IPX */
+			   NA_IPX, NA_BROADCAST_IPX, NA_BOT */
 			break;
 	}
 }
@@ -196,6 +197,11 @@ NET_CompareAdr(netadr_t a, netadr_t b)
 		return true;
 	}
 
+	if (a.type == NA_BOT)
+	{
+		return a.port == b.port;
+	}
+
 	if (a.type == NA_IP)
 	{
 		if ((a.ip[0] == b.ip[0]) && (a.ip[1] == b.ip[1]) &&
@@ -238,7 +244,7 @@ NET_CompareBaseAdr(netadr_t a, netadr_t b)
 		return false;
 	}
 
-	if (a.type == NA_LOOPBACK)
+	if ((a.type == NA_LOOPBACK) || (a.type == NA_BOT))
 	{
 		return true;
 	}
@@ -291,6 +297,9 @@ NET_BaseAdrToString(netadr_t a)
 			Com_sprintf(s, sizeof(s), "%i.%i.%i.%i",
 				a.ip[0], a.ip[1], a.ip[2], a.ip[3]);
 			break;
+		case NA_BOT:
+			Com_sprintf(s, sizeof(s), "bot");
+			break;
 		case NA_BROADCAST:
 			Com_sprintf(s, sizeof(s), "255.255.255.255");
 			break;
@@ -638,6 +647,8 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 			NET_SendLoopPacket(sock, length, data, to);
 			return;
 			break;
+		case NA_BOT:
+			return;
 		case NA_BROADCAST:
 		case NA_IP:
 			net_socket = ip_sockets[sock];
@@ -1213,6 +1224,20 @@ NET_Config(qboolean multiplayer)
 	}
 }
 
+/*
+ * Winsock has no batched send, packets
+ * always go out from NET_SendPacket().
+ */
+void
+NET_QueuePackets(void)
+{
+}
+
+void
+NET_FlushPackets(void)
+{
+}
+
 /*
  * sleeps msec or until
  * net socket is ready
@@ -49,8 +49,6 @@ static vec3_t avelocities[NUMVERTEXNORMALS];
 extern struct model_s *cl_mod_smoke;
 extern struct model_s *cl_mod_flash;
 
-extern cparticle_t *active_particles, *free_particles;
-
 /* Per-weapon muzzle flash configuration */
 typedef struct muzzle_flash_config_s {
 	qboolean enabled;
@@ -1035,24 +1033,17 @@ CL_AddMuzzleFlash2(void)
 void
 CL_TeleporterParticles(entity_state_t *ent)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 8; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 8;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xdb;
 
@@ -1076,24 +1067,17 @@ CL_TeleporterParticles(entity_state_t *ent)
 void
 CL_LogoutEffect(vec3_t org, int type)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 500; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 500;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 
 		if (type == MZ_LOGIN)
@@ -1131,24 +1115,17 @@ CL_LogoutEffect(vec3_t org, int type)
 void
 CL_ItemRespawnParticles(vec3_t org)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 64; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 64;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xd4 + (randk() & 3);
 		p->org[0] = org[0] + crandk() * 8;
@@ -1171,24 +1148,17 @@ CL_ItemRespawnParticles(vec3_t org)
 void
 CL_ExplosionParticles(vec3_t org)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 256; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 256;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xe0 + (randk() & 7);
 
@@ -1218,18 +1188,10 @@ CL_SmokeParticles(vec3_t org, int count)
 
 	time = (float)cl.time;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		/* Grey smoke colors (palette indices for grey tones) */
 		p->color = 0x0 + (randk() & 7);  /* dark grey range */
@@ -1255,7 +1217,7 @@ CL_SmokeParticles(vec3_t org, int count)
 void
 CL_BigTeleportParticles(vec3_t org)
 {
-	int i;
+	int i, count;
 	cparticle_t *p;
 	float time;
 
@@ -1263,18 +1225,11 @@ CL_BigTeleportParticles(vec3_t org)
 	float angle, dist;
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
 
-	for (i = 0; i < 4096; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 4096;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = colortable[randk() & 3];
 
@@ -1313,18 +1268,10 @@ CL_BlasterParticles(vec3_t org, vec3_t dir)
 
 	count = 40;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xe0 + (randk() & 7);
 		d = randk() & 15;
@@ -1367,15 +1314,12 @@ CL_BlasterTrail(vec3_t start, vec3_t end)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -1419,15 +1363,12 @@ CL_QuadTrail(vec3_t start, vec3_t end)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -1471,15 +1412,12 @@ CL_FlagTrail(vec3_t start, vec3_t end, int color)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -1541,18 +1479,15 @@ CL_DiminishingTrail(vec3_t start, vec3_t end, centity_t *old, int flags)
 	{
 		len -= dec;
 
-		if (!free_particles)
-		{
-			return;
-		}
-
 		/* drop less particles as it flies */
 		if ((randk() & 1023) < old->trailcount)
 		{
-			p = free_particles;
-			free_particles = p->next;
-			p->next = active_particles;
-			active_particles = p;
+			p = CL_AllocParticle();
+
+			if (!p)
+			{
+				return;
+			}
 			VectorClear(p->accel);
 
 			p->time = time;
@@ -1659,17 +1594,14 @@ CL_RocketTrail(vec3_t start, vec3_t end, centity_t *old)
 	{
 		len -= dec;
 
-		if (!free_particles)
-		{
-			return;
-		}
-
 		if ((randk() & 7) == 0)
 		{
-			p = free_particles;
-			free_particles = p->next;
-			p->next = active_particles;
-			active_particles = p;
+			p = CL_AllocParticle();
+
+			if (!p)
+			{
+				return;
+			}
 
 			VectorClear(p->accel);
 			p->time = time;
@@ -1701,7 +1633,7 @@ CL_RailTrail(vec3_t start, vec3_t end)
 	cparticle_t *p;
 	float dec;
 	vec3_t right, up;
-	int i;
+	int i, count;
 	float d, c, s;
 	vec3_t dir;
 	byte clr = 0x74;
@@ -1715,18 +1647,11 @@ CL_RailTrail(vec3_t start, vec3_t end)
 
 	MakeNormalVectors(vec, right, up);
 
-	for (i = 0; i < len; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = len;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		VectorClear(p->accel);
 
@@ -1758,16 +1683,13 @@ CL_RailTrail(vec3_t start, vec3_t end)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		VectorClear(p->accel);
 
@@ -1811,15 +1733,12 @@ CL_IonripperTrail(vec3_t start, vec3_t ent)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -1873,16 +1792,13 @@ CL_BubbleTrail(vec3_t start, vec3_t end)
 
 	for (i = 0; i < len; i += 32)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		VectorClear(p->accel);
 		p->time = time;
 
@@ -1946,16 +1862,13 @@ CL_FlyParticles(vec3_t origin, int count)
 		forward[1] = cp * sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 
 		dist = (float)sin(ltime + i) * 64;
@@ -2055,16 +1968,13 @@ CL_BfgParticles(entity_t *ent)
 		forward[1] = cp * sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 
 		dist = (float)sin(ltime + i) * 64;
@@ -2114,15 +2024,12 @@ CL_TrapParticles(entity_t *ent)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2159,16 +2066,13 @@ CL_TrapParticles(entity_t *ent)
 			{
 				for (k = -2; k <= 4; k += 4)
 				{
-					if (!free_particles)
+					p = CL_AllocParticle();
+
+					if (!p)
 					{
 						return;
 					}
 
-					p = free_particles;
-					free_particles = p->next;
-					p->next = active_particles;
-					active_particles = p;
-
 					p->time = time;
 					p->color = 0xe0 + (randk() & 3);
 					p->alpha = 1.0;
@@ -2197,24 +2101,17 @@ CL_TrapParticles(entity_t *ent)
 void
 CL_BFGExplosionParticles(vec3_t org)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 256; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 256;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xd0 + (randk() & 7);
 
@@ -2249,16 +2146,13 @@ CL_TeleportParticles(vec3_t org)
 		{
 			for (k = -16; k <= 32; k += 4)
 			{
-				if (!free_particles)
+				p = CL_AllocParticle();
+
+				if (!p)
 				{
 					return;
 				}
 
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
 				p->time = time;
 				p->color = 7 + (randk() & 7);
 				p->alpha = 1.0;
@@ -2389,16 +2283,13 @@ CL_DebugTrail(vec3_t start, vec3_t end)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = (float)cl.time;
 		VectorClear(p->accel);
 		VectorClear(p->vel);
@@ -2432,15 +2323,12 @@ CL_SmokeTrail(vec3_t start, vec3_t end, int colorStart,
 	{
 		len -= spacing;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2483,17 +2371,14 @@ CL_ForceWall(vec3_t start, vec3_t end, int color8)
 	{
 		len -= 4;
 
-		if (!free_particles)
-		{
-			return;
-		}
-
 		if (frandk() > 0.3)
 		{
-			p = free_particles;
-			free_particles = p->next;
-			p->next = active_particles;
-			active_particles = p;
+			p = CL_AllocParticle();
+
+			if (!p)
+			{
+				return;
+			}
 			VectorClear(p->accel);
 
 			p->time = time;
@@ -2541,16 +2426,13 @@ CL_BubbleTrail2(vec3_t start, vec3_t end, int dist)
 
 	for (i = 0; i < len; i += dist)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		VectorClear(p->accel);
 		p->time = time;
 
@@ -2621,16 +2503,13 @@ CL_Heatbeam(vec3_t start, vec3_t forward)
 
 		for (rot = 0; rot < M_PI * 2; rot += rstep)
 		{
-			if (!free_particles)
+			p = CL_AllocParticle();
+
+			if (!p)
 			{
 				return;
 			}
 
-			p = free_particles;
-			free_particles = p->next;
-			p->next = active_particles;
-			active_particles = p;
-
 			p->time = time;
 			VectorClear(p->accel);
 			variance = 0.5;
@@ -2679,18 +2558,10 @@ CL_ParticleSteamEffect(vec3_t org, vec3_t dir, int color,
 	time = (float)cl.time;
 	MakeNormalVectors(dir, r, u);
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color + (randk() & 7);
 
@@ -2716,7 +2587,7 @@ CL_ParticleSteamEffect(vec3_t org, vec3_t dir, int color,
 void
 CL_ParticleSteamEffect2(cl_sustain_t *self)
 {
-	int i, j;
+	int i, j, count;
 	cparticle_t *p;
 	float d;
 	vec3_t r, u;
@@ -2725,18 +2596,11 @@ CL_ParticleSteamEffect2(cl_sustain_t *self)
 	VectorCopy(self->dir, dir);
 	MakeNormalVectors(dir, r, u);
 
-	for (i = 0; i < self->count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = self->count;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = cl.time;
 		p->color = self->color + (randk() & 7);
 
@@ -2790,15 +2654,12 @@ CL_TrackerTrail(vec3_t start, vec3_t end, int particleColor)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2825,23 +2686,17 @@ void
 CL_Tracker_Shell(vec3_t origin)
 {
 	vec3_t dir;
-	int i;
+	int i, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 300; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
+	count = 300;
+	p = CL_AllocParticles(&count);
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	for (i = 0; i < count; i++, p++)
+	{
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2862,23 +2717,17 @@ void
 CL_MonsterPlasma_Shell(vec3_t origin)
 {
 	vec3_t dir;
-	int i;
+	int i, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 40; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
+	count = 40;
+	p = CL_AllocParticles(&count);
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	for (i = 0; i < count; i++, p++)
+	{
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2899,7 +2748,7 @@ void
 CL_Widowbeamout(cl_sustain_t *self)
 {
 	vec3_t dir;
-	int i;
+	int i, count;
 	cparticle_t *p;
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
 	float ratio;
@@ -2908,17 +2757,11 @@ CL_Widowbeamout(cl_sustain_t *self)
 	ratio = 1.0f - (((float)self->endtime - (float)cl.time) / 2100.0f);
 	time = (float)cl.time;
 
-	for (i = 0; i < 300; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
+	count = 300;
+	p = CL_AllocParticles(&count);
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	for (i = 0; i < count; i++, p++)
+	{
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2939,7 +2782,7 @@ void
 CL_Nukeblast(cl_sustain_t *self)
 {
 	vec3_t dir;
-	int i;
+	int i, count;
 	cparticle_t *p;
 	static int colortable[4] = {110, 112, 114, 116};
 	float ratio;
@@ -2948,17 +2791,11 @@ CL_Nukeblast(cl_sustain_t *self)
 	ratio = 1.0f - (((float)self->endtime - (float)cl.time) / 1000.0f);
 	time = (float)cl.time;
 
-	for (i = 0; i < 700; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
+	count = 700;
+	p = CL_AllocParticles(&count);
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	for (i = 0; i < count; i++, p++)
+	{
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -2979,25 +2816,18 @@ void
 CL_WidowSplash(vec3_t org)
 {
 	static int colortable[4] = {2 * 8, 13 * 8, 21 * 8, 18 * 8};
-	int i;
+	int i, count;
 	cparticle_t *p;
 	vec3_t dir;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 256; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 256;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = colortable[randk() & 3];
 		dir[0] = crandk();
@@ -3018,23 +2848,17 @@ void
 CL_Tracker_Explode(vec3_t origin)
 {
 	vec3_t dir, backdir;
-	int i;
+	int i, count;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 300; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
+	count = 300;
+	p = CL_AllocParticles(&count);
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	for (i = 0; i < count; i++, p++)
+	{
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -3077,15 +2901,12 @@ CL_TagTrail(vec3_t start, vec3_t end, int color)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -3108,25 +2929,18 @@ CL_TagTrail(vec3_t start, vec3_t end, int color)
 void
 CL_ColorExplosionParticles(vec3_t org, int color, int run)
 {
-	int i;
+	int i, count;
 	int j;
 	cparticle_t *p;
 	float time;
 
 	time = (float)cl.time;
 
-	for (i = 0; i < 128; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 128;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color + (randk() % run);
 
@@ -3161,18 +2975,10 @@ CL_ParticleSmokeEffect(vec3_t org, vec3_t dir, int color,
 
 	MakeNormalVectors(dir, r, u);
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color + (randk() & 7);
 
@@ -3210,18 +3016,10 @@ CL_BlasterParticles2(vec3_t org, vec3_t dir, unsigned int color)
 
 	count = 40;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color + (randk() & 7);
 		d = (float)(randk() & 15);
@@ -3267,15 +3065,12 @@ CL_BlasterTrail2(vec3_t start, vec3_t end)
 	{
 		len -= dec;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
 		VectorClear(p->accel);
 
 		p->time = time;
@@ -3301,7 +3096,7 @@ CL_BlasterTrail2(vec3_t start, vec3_t end)
 void
 CL_FlameEffect(vec3_t org)
 {
-	int i;
+	int i, count;
 	cparticle_t *p;
 	float time;
 	cdlight_t *dl;
@@ -3320,18 +3115,11 @@ CL_FlameEffect(vec3_t org)
 	dl->color[2] = 0.1f;
 
 	/* Smoke particles - slow rising, gray */
-	for (i = 0; i < 3; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 3;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0x00 + (randk() & 3);
 
@@ -3352,18 +3140,11 @@ CL_FlameEffect(vec3_t org)
 	}
 
 	/* Ember particles - bright orange/yellow */
-	for (i = 0; i < 5; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 5;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xe0 + (randk() & 7);
 
@@ -3384,18 +3165,11 @@ CL_FlameEffect(vec3_t org)
 	}
 
 	/* Core flame particles - bright yellow/white */
-	for (i = 0; i < 2; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	count = 2;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = 0xd0 + (randk() & 7);
 
@@ -3440,16 +3214,13 @@ CL_FlameTrail(vec3_t start, vec3_t end)
 	{
 		len -= 8;
 
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		p->color = 0xe0 + (randk() & 7);
 
@@ -43,6 +43,7 @@ cvar_t *rcon_address;
 cvar_t *cl_noskins;
 cvar_t *cl_footsteps;
 cvar_t *cl_timeout;
+cvar_t *cl_packedproto;
 cvar_t *cl_predict;
 cvar_t *cl_showfps;
 cvar_t *cl_showspeed;
@@ -257,7 +258,7 @@ CL_Record_f(void)
 
 	/* send the serverdata */
 	MSG_WriteByte(&buf, svc_serverdata);
-	MSG_WriteLong(&buf, PROTOCOL_VERSION);
+	MSG_WriteLong(&buf, cls.serverProtocol); /* frames are saved as they came in */
 	MSG_WriteLong(&buf, 0x10000 + cl.servercount);
 	MSG_WriteByte(&buf, 1);  /* demos are always attract loops */
 	MSG_WriteString(&buf, cl.gamedir);
@@ -592,6 +593,7 @@ CL_InitLocal(void)
 	cl_showmiss = Cvar_Get("cl_showmiss", "0", 0);
 	cl_showclamp = Cvar_Get("showclamp", "0", 0);
 	cl_timeout = Cvar_Get("cl_timeout", "120", 0);
+	cl_packedproto = Cvar_Get("cl_packedproto", "0", CVAR_ARCHIVE);
 	cl_paused = Cvar_Get("paused", "0", 0);
 	cl_loadpaused = Cvar_Get("cl_loadpaused", "1", CVAR_ARCHIVE);
 	cl_audiopaused = Cvar_Get("cl_audiopaused", "1", CVAR_ARCHIVE);
@@ -669,6 +671,8 @@ CL_InitLocal(void)
 	Cmd_AddCommand("download", CL_Download_f);
 
 	Cmd_AddCommand("currentmap", CL_CurrentMap_f);
+	Cmd_AddCommand("cl_particle_bench", CL_ParticleBench_f);
+	Cmd_AddCommand("cl_tentstats", CL_TEntStats_f);
 
 	/* forward to server commands
 	 * the only thing this does is allow command completion
@@ -133,8 +133,12 @@ CL_SendConnectPacket(void)
 
 	userinfo_modified = false;
 
-	Netchan_OutOfBandPrint(NS_CLIENT, adr, "connect %i %i %i \"%s\"\n",
-			PROTOCOL_VERSION, port, cls.challenge, Cvar_Userinfo());
+	/* ask for bit packed snapshots, servers that don't
+	   know them refuse the connection. The last argument
+	   is the longest fragmented message we take. */
+	Netchan_OutOfBandPrint(NS_CLIENT, adr, "connect %i %i %i \"%s\" %i\n",
+			cl_packedproto->value ? PROTOCOL_PACKED : PROTOCOL_VERSION,
+			port, cls.challenge, Cvar_Userinfo(), MAX_FRAGMENTED_MSGLEN);
 }
 
 /*
@@ -622,6 +626,11 @@ CL_ConnectionlessPacket(void)
 				Com_Printf("HTTP downloading supported by server but not the client.\n");
 #endif
 			}
+			else if (!strncmp(p, "fragments=", 10))
+			{
+				Netchan_EnableFragments(&cls.netchan, (int)strtol(p + 10,
+							(char **)NULL, 10));
+			}
 		}
 
 		/* Put client into pause mode when connecting to a local server.
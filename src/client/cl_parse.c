@@ -86,29 +86,11 @@ CL_RegisterSounds(void)
 static int
 CL_ParseEntityBits(unsigned *bits)
 {
-	unsigned b, total;
+	unsigned total;
 	int i;
 	int number;
 
-	total = MSG_ReadByte(&net_message);
-
-	if (total & U_MOREBITS1)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 8;
-	}
-
-	if (total & U_MOREBITS2)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 16;
-	}
-
-	if (total & U_MOREBITS3)
-	{
-		b = MSG_ReadByte(&net_message);
-		total |= b << 24;
-	}
+	number = MSG_ReadEntityBits(&net_message, &total);
 
 	/* count the bits for net profiling */
 	for (i = 0; i < 32; i++)
@@ -119,16 +101,6 @@ CL_ParseEntityBits(unsigned *bits)
 		}
 	}
 
-	if (total & U_NUMBER16)
-	{
-		number = MSG_ReadShort(&net_message);
-	}
-
-	else
-	{
-		number = MSG_ReadByte(&net_message);
-	}
-
 	*bits = total;
 
 	return number;
@@ -140,156 +112,24 @@ CL_ParseEntityBits(unsigned *bits)
 static void
 CL_ParseDelta(const entity_state_t *from, entity_state_t *to, int number, int bits)
 {
-	static const entity_state_t es_nullstate = {0};
 	entity_state_t dummy;
 
-	if (!from)
-	{
-		from = &es_nullstate;
-	}
-
 	if (!to)
 	{
 		to = &dummy;
 	}
 
-	/* set everything to the state we are delta'ing from */
-	*to = *from;
-
-	VectorCopy(from->origin, to->old_origin);
-	to->number = number;
-
-	if (bits & U_MODEL)
-	{
-		to->modelindex = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL2)
-	{
-		to->modelindex2 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL3)
-	{
-		to->modelindex3 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_MODEL4)
-	{
-		to->modelindex4 = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_FRAME8)
-	{
-		to->frame = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_FRAME16)
-	{
-		to->frame = MSG_ReadShort(&net_message);
-	}
-
-	/* used for laser colors */
-	if ((bits & U_SKIN8) && (bits & U_SKIN16))
-	{
-		to->skinnum = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_SKIN8)
-	{
-		to->skinnum = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_SKIN16)
-	{
-		to->skinnum = MSG_ReadShort(&net_message);
-	}
-
-	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
-	{
-		to->effects = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_EFFECTS8)
-	{
-		to->effects = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_EFFECTS16)
-	{
-		to->effects = MSG_ReadShort(&net_message);
-	}
-
-	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
-	{
-		to->renderfx = MSG_ReadLong(&net_message);
-	}
-	else if (bits & U_RENDERFX8)
-	{
-		to->renderfx = MSG_ReadByte(&net_message);
-	}
-	else if (bits & U_RENDERFX16)
-	{
-		to->renderfx = MSG_ReadShort(&net_message);
-	}
-
-	if (bits & U_ORIGIN1)
-	{
-		to->origin[0] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ORIGIN2)
-	{
-		to->origin[1] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ORIGIN3)
-	{
-		to->origin[2] = MSG_ReadCoord(&net_message);
-	}
-
-	if (bits & U_ANGLE1)
-	{
-		to->angles[0] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_ANGLE2)
-	{
-		to->angles[1] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_ANGLE3)
-	{
-		to->angles[2] = MSG_ReadAngle(&net_message);
-	}
-
-	if (bits & U_OLDORIGIN)
-	{
-		MSG_ReadPos(&net_message, to->old_origin);
-	}
-
-	if (bits & U_SOUND)
-	{
-		to->sound = MSG_ReadByte(&net_message);
-	}
-
-	if (bits & U_EVENT)
-	{
-		to->event = MSG_ReadByte(&net_message);
-	}
-	else
-	{
-		to->event = 0;
-	}
-
-	if (bits & U_SOLID)
-	{
-		to->solid = MSG_ReadShort(&net_message);
-	}
+	MSG_ReadDeltaEntity(&net_message, from, to, number, bits);
 }
 
 /*
  * Parses deltas from the given base and adds the resulting entity to
- * the current frame
+ * the current frame. packed is the bit stream of a PROTOCOL_PACKED
+ * packetentities, bits are ignored then.
  */
 static void
-CL_DeltaEntity(frame_t *frame, int newnum, const entity_state_t *old, int bits)
+CL_DeltaEntity(frame_t *frame, int newnum, const entity_state_t *old, int bits,
+		msgbits_t *packed)
 {
 	centity_t dummy, *ent;
 	entity_state_t *state;
@@ -305,7 +145,14 @@ CL_DeltaEntity(frame_t *frame, int newnum, const entity_state_t *old, int bits)
 	cl.parse_entities++;
 	frame->num_entities++;
 
-	CL_ParseDelta(old, state, newnum, bits);
+	if (packed)
+	{
+		MSG_ReadPackedEntity(packed, old, state, newnum);
+	}
+	else
+	{
+		CL_ParseDelta(old, state, newnum, bits);
+	}
 
 	/* some data changes will force no lerping */
 	if ((state->modelindex != ent->current.modelindex) ||
@@ -365,10 +212,20 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 	centity_t *ent;
 	entity_state_t *oldstate = NULL;
 	int oldindex, oldnum;
+	msgbits_t mb, *packed;
+	qboolean remove;
 
 	newframe->parse_entities = cl.parse_entities;
 	newframe->num_entities = 0;
 
+	packed = NULL;
+
+	if (cls.serverProtocol == PROTOCOL_PACKED)
+	{
+		MSG_BeginBits(&mb, &net_message);
+		packed = &mb;
+	}
+
 	/* delta from the entities present in oldframe */
 	oldindex = 0;
 
@@ -394,7 +251,15 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 
 	while (1)
 	{
-		newnum = CL_ParseEntityBits(&bits);
+		if (packed)
+		{
+			newnum = MSG_ReadPackedNumber(packed, &remove);
+			bits = remove ? U_REMOVE : 0;
+		}
+		else
+		{
+			newnum = CL_ParseEntityBits(&bits);
+		}
 
 		if (newnum > MAX_CL_ENTNUM)
 		{
@@ -422,7 +287,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 				Com_Printf("   unchanged: %i\n", oldnum);
 			}
 
-			CL_DeltaEntity(newframe, oldnum, oldstate, 0);
+			CL_DeltaEntity(newframe, oldnum, oldstate, 0, NULL);
 
 			oldindex++;
 
@@ -477,7 +342,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 				Com_Printf("   delta: %i\n", newnum);
 			}
 
-			CL_DeltaEntity(newframe, newnum, oldstate, bits);
+			CL_DeltaEntity(newframe, newnum, oldstate, bits, packed);
 
 			oldindex++;
 
@@ -508,7 +373,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 
 			CL_DeltaEntity(newframe, newnum,
 					ent ? &ent->baseline : NULL,
-					bits);
+					bits, packed);
 
 			continue;
 		}
@@ -523,7 +388,7 @@ CL_ParsePacketEntities(frame_t *oldframe, frame_t *newframe)
 			Com_Printf("   unchanged: %i\n", oldnum);
 		}
 
-		CL_DeltaEntity(newframe, oldnum, oldstate, 0);
+		CL_DeltaEntity(newframe, oldnum, oldstate, 0, NULL);
 
 		oldindex++;
 
@@ -560,6 +425,18 @@ CL_ParsePlayerstate(frame_t *oldframe, frame_t *newframe)
 		memset(state, 0, sizeof(*state));
 	}
 
+	if (cls.serverProtocol == PROTOCOL_PACKED)
+	{
+		MSG_ReadPackedPlayerstate(&net_message, state);
+
+		if (cl.attractloop)
+		{
+			state->pmove.pm_type = PM_FREEZE; /* demo playback */
+		}
+
+		return;
+	}
+
 	flags = MSG_ReadShort(&net_message);
 
 	/* parse the pmove_state_t */
@@ -905,7 +782,7 @@ CL_ParseServerData(void)
 	if (Com_ServerState() && (PROTOCOL_VERSION == 34))
 	{
 	}
-	else if (i != PROTOCOL_VERSION)
+	else if ((i != PROTOCOL_VERSION) && (i != PROTOCOL_PACKED))
 	{
 		Com_Error(ERR_DROP, "Server returned version %i, not %i",
 				i, PROTOCOL_VERSION);
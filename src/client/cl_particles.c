@@ -19,34 +19,310 @@
  *
  * =======================================================================
  *
- * This file implements all generic particle stuff
+ * This file implements all generic particle stuff. Live particles are
+ * kept as a structure of arrays, updated 4 at a time and compacted by
+ * moving the last one into the hole of a faded one. Effects fill in
+ * cparticle_ts, they're moved into the arrays by the next update.
  *
  * =======================================================================
  */
 
 #include "header/client.h"
 
-cparticle_t *active_particles, *free_particles;
-cparticle_t particles[MAX_PARTICLES];
-int cl_numparticles = MAX_PARTICLES;
+#if defined(__SSE2__) || defined(_M_X64)
+ #include <emmintrin.h>
+ #define PARTICLES_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define PARTICLES_NEON
+#endif
+
+typedef struct
+{
+	float *org[3];
+	float *vel[3];
+	float *accel[3];
+	float *time;
+	float *alpha;
+	float *alphavel;
+	int *color;
+
+	/* written by the update */
+	float *pos[3];
+	float *curalpha;
+
+	int num;
+	int max;
+	void *mem;
+} particlestore_t;
+
+#define PARTICLE_ARRAYS 17
+
+static particlestore_t store;
+
+/* what the effects spawned since the last update */
+static cparticle_t spawned[MAX_PARTICLES];
+static int numspawned;
+
+/*
+ * One allocation for all arrays, aligned and padded
+ * to a multiple of 4 for the vector loads.
+ */
+static void
+CL_InitParticleStore(particlestore_t *ps, int max)
+{
+	float *f;
+	int i;
+
+	max = (max + 3) & ~3;
+
+	ps->mem = Z_Malloc(PARTICLE_ARRAYS * max * sizeof(float) + 15);
+	f = (float *)(((size_t)ps->mem + 15) & ~(size_t)15);
+
+	for (i = 0; i < 3; i++)
+	{
+		ps->org[i] = f + i * max;
+		ps->vel[i] = f + (3 + i) * max;
+		ps->accel[i] = f + (6 + i) * max;
+		ps->pos[i] = f + (9 + i) * max;
+	}
+
+	ps->time = f + 12 * max;
+	ps->alpha = f + 13 * max;
+	ps->alphavel = f + 14 * max;
+	ps->curalpha = f + 15 * max;
+
+	ps->color = (int *)(f + 16 * max);
+
+	ps->num = 0;
+	ps->max = max;
+}
+
+static void
+CL_FreeParticleStore(particlestore_t *ps)
+{
+	Z_Free(ps->mem);
+	memset(ps, 0, sizeof(*ps));
+}
+
+static void
+CL_StoreParticle(particlestore_t *ps, const cparticle_t *p)
+{
+	int i, n;
+
+	n = ps->num++;
+
+	for (i = 0; i < 3; i++)
+	{
+		ps->org[i][n] = p->org[i];
+		ps->vel[i][n] = p->vel[i];
+		ps->accel[i][n] = p->accel[i];
+	}
+
+	ps->time[n] = p->time;
+	ps->alpha[n] = p->alpha;
+	ps->alphavel[n] = p->alphavel;
+	ps->color[n] = (int)p->color;
+}
+
+/*
+ * Positions and alphas of all particles at the given time. Instant
+ * particles don't move and keep their alpha. A particle has faded
+ * out when its alpha isn't positive anymore.
+ */
+static void
+CL_UpdateParticlesScalar(particlestore_t *ps, float now)
+{
+	float t, t2, a;
+	int i, j;
+
+	for (i = 0; i < ps->num; i++)
+	{
+		if (ps->alphavel[i] != INSTANT_PARTICLE)
+		{
+			t = (now - ps->time[i]) * 0.001f;
+		}
+		else
+		{
+			t = 0.0f;
+		}
+
+		a = ps->alpha[i] + t * ps->alphavel[i];
+		ps->curalpha[i] = (a > 1.0f) ? 1.0f : a;
+
+		t2 = t * t;
+
+		for (j = 0; j < 3; j++)
+		{
+			ps->pos[j][i] = ps->org[j][i] + ps->vel[j][i] * t +
+				ps->accel[j][i] * t2;
+		}
+	}
+}
+
+static void
+CL_UpdateParticles(particlestore_t *ps, float now)
+{
+#if defined(PARTICLES_SSE2)
+	__m128 vnow, vms, vinstant, vone;
+	__m128 t, t2, av, a, instant;
+	int i, j;
+
+	vnow = _mm_set1_ps(now);
+	vms = _mm_set1_ps(0.001f);
+	vinstant = _mm_set1_ps(INSTANT_PARTICLE);
+	vone = _mm_set1_ps(1.0f);
+
+	/* the arrays are padded, so the last
+	   block may go past num */
+	for (i = 0; i < ps->num; i += 4)
+	{
+		av = _mm_load_ps(ps->alphavel + i);
+		instant = _mm_cmpeq_ps(av, vinstant);
+
+		t = _mm_mul_ps(_mm_sub_ps(vnow, _mm_load_ps(ps->time + i)), vms);
+		t = _mm_andnot_ps(instant, t);
+		t2 = _mm_mul_ps(t, t);
+
+		a = _mm_add_ps(_mm_load_ps(ps->alpha + i), _mm_mul_ps(t, av));
+		_mm_store_ps(ps->curalpha + i, _mm_min_ps(a, vone));
+
+		for (j = 0; j < 3; j++)
+		{
+			_mm_store_ps(ps->pos[j] + i, _mm_add_ps(
+				_mm_add_ps(_mm_load_ps(ps->org[j] + i),
+					_mm_mul_ps(_mm_load_ps(ps->vel[j] + i), t)),
+				_mm_mul_ps(_mm_load_ps(ps->accel[j] + i), t2)));
+		}
+	}
+#elif defined(PARTICLES_NEON)
+	float32x4_t vnow, vms, vinstant, vone;
+	float32x4_t t, t2, av, a, p;
+	uint32x4_t instant;
+	int i, j;
+
+	vnow = vdupq_n_f32(now);
+	vms = vdupq_n_f32(0.001f);
+	vinstant = vdupq_n_f32(INSTANT_PARTICLE);
+	vone = vdupq_n_f32(1.0f);
+
+	for (i = 0; i < ps->num; i += 4)
+	{
+		av = vld1q_f32(ps->alphavel + i);
+		instant = vceqq_f32(av, vinstant);
+
+		t = vmulq_f32(vsubq_f32(vnow, vld1q_f32(ps->time + i)), vms);
+		t = vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(t),
+					instant));
+		t2 = vmulq_f32(t, t);
+
+		a = vmlaq_f32(vld1q_f32(ps->alpha + i), t, av);
+		vst1q_f32(ps->curalpha + i, vminq_f32(a, vone));
+
+		for (j = 0; j < 3; j++)
+		{
+			p = vmlaq_f32(vld1q_f32(ps->org[j] + i),
+					vld1q_f32(ps->vel[j] + i), t);
+			p = vmlaq_f32(p, vld1q_f32(ps->accel[j] + i), t2);
+			vst1q_f32(ps->pos[j] + i, p);
+		}
+	}
+#else
+	CL_UpdateParticlesScalar(ps, now);
+#endif
+}
+
+/*
+ * Drops the particles that faded out. Instant
+ * particles are gone after they were drawn once.
+ */
+static void
+CL_CompactParticles(particlestore_t *ps)
+{
+	int i, j, last;
+
+	for (i = 0; i < ps->num; )
+	{
+		if (ps->curalpha[i] <= 0)
+		{
+			last = --ps->num;
+
+			for (j = 0; j < 3; j++)
+			{
+				ps->org[j][i] = ps->org[j][last];
+				ps->vel[j][i] = ps->vel[j][last];
+				ps->accel[j][i] = ps->accel[j][last];
+				ps->pos[j][i] = ps->pos[j][last];
+			}
+
+			ps->time[i] = ps->time[last];
+			ps->alpha[i] = ps->alpha[last];
+			ps->alphavel[i] = ps->alphavel[last];
+			ps->color[i] = ps->color[last];
+			ps->curalpha[i] = ps->curalpha[last];
+
+			/* check the moved one */
+			continue;
+		}
+
+		if (ps->alphavel[i] == INSTANT_PARTICLE)
+		{
+			ps->alphavel[i] = 0.0f;
+			ps->alpha[i] = 0.0f;
+		}
+
+		i++;
+	}
+}
 
 void
 CL_ClearParticles(void)
 {
-	if (cl_numparticles == 0)
-		return;
-		
-	int i;
+	if (!store.mem)
+	{
+		CL_InitParticleStore(&store, MAX_PARTICLES);
+	}
 
-	free_particles = &particles[0];
-	active_particles = NULL;
+	store.num = 0;
+	numspawned = 0;
+}
 
-	for (i = 0; i < cl_numparticles; i++)
+/*
+ * Returns room for up to count new particles, count is
+ * lowered to what's free. The caller must fill in all of
+ * them. NULL if there's no room at all.
+ */
+cparticle_t *
+CL_AllocParticles(int *count)
+{
+	int free;
+	cparticle_t *p;
+
+	free = MAX_PARTICLES - store.num - numspawned;
+
+	if (*count > free)
 	{
-		particles[i].next = &particles[i + 1];
+		*count = free;
 	}
 
-	particles[cl_numparticles - 1].next = NULL;
+	if (*count <= 0)
+	{
+		*count = 0;
+		return NULL;
+	}
+
+	p = &spawned[numspawned];
+	numspawned += *count;
+
+	return p;
+}
+
+cparticle_t *
+CL_AllocParticle(void)
+{
+	int count = 1;
+
+	return CL_AllocParticles(&count);
 }
 
 void
@@ -56,18 +332,10 @@ CL_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
 	cparticle_t *p;
 	float d;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = cl.time;
 		p->color = color + (randk() & 7);
 		d = randk() & 31;
@@ -96,18 +364,10 @@ CL_ParticleEffect2(vec3_t org, vec3_t dir, int color, int count)
 
 	time = (float)cl.time;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color + (randk() & 7);
 
@@ -137,18 +397,10 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 
 	time = (float)cl.time;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 		p->color = color;
 
@@ -171,74 +423,35 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 void
 CL_AddParticles(void)
 {
-	cparticle_t *p, *next;
-	float alpha;
-	float time, time2;
-	vec3_t org;
-	int color;
-	cparticle_t *active, *tail;
+	particle_t *r;
+	int i, count;
 
-	active = NULL;
-	tail = NULL;
-
-	for (p = active_particles; p; p = next)
+	if (!store.mem)
 	{
-		next = p->next;
-
-		if (p->alphavel != INSTANT_PARTICLE)
-		{
-			time = (cl.time - p->time) * 0.001;
-			alpha = p->alpha + time * p->alphavel;
-
-			if (alpha <= 0)
-			{
-				/* faded out */
-				p->next = free_particles;
-				free_particles = p;
-				continue;
-			}
-		}
-		else
-		{
-			time = 0.0f;
-			alpha = p->alpha;
-		}
-
-		p->next = NULL;
-
-		if (!tail)
-		{
-			active = tail = p;
-		}
-
-		else
-		{
-			tail->next = p;
-			tail = p;
-		}
+		CL_ClearParticles();
+	}
 
-		if (alpha > 1.0f)
-		{
-			alpha = 1;
-		}
+	for (i = 0; i < numspawned; i++)
+	{
+		CL_StoreParticle(&store, &spawned[i]);
+	}
 
-		color = p->color;
-		time2 = time * time;
+	numspawned = 0;
 
-		org[0] = p->org[0] + p->vel[0] * time + p->accel[0] * time2;
-		org[1] = p->org[1] + p->vel[1] * time + p->accel[1] * time2;
-		org[2] = p->org[2] + p->vel[2] * time + p->accel[2] * time2;
+	CL_UpdateParticles(&store, (float)cl.time);
+	CL_CompactParticles(&store);
 
-		V_AddParticle(org, color, alpha);
+	count = store.num;
+	r = V_AllocParticles(&count);
 
-		if (p->alphavel == INSTANT_PARTICLE)
-		{
-			p->alphavel = 0.0;
-			p->alpha = 0.0;
-		}
+	for (i = 0; i < count; i++, r++)
+	{
+		r->origin[0] = store.pos[0][i];
+		r->origin[1] = store.pos[1][i];
+		r->origin[2] = store.pos[2][i];
+		r->color = store.color[i];
+		r->alpha = store.curalpha[i];
 	}
-
-	active_particles = active;
 }
 
 void
@@ -252,18 +465,10 @@ CL_GenericParticleEffect(vec3_t org, vec3_t dir, int color,
 
 	time = (float)cl.time;
 
-	for (i = 0; i < count; i++)
-	{
-		if (!free_particles)
-		{
-			return;
-		}
-
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
+	p = CL_AllocParticles(&count);
 
+	for (i = 0; i < count; i++, p++)
+	{
 		p->time = time;
 
 		if (numcolors > 1)
@@ -292,3 +497,85 @@ CL_GenericParticleEffect(vec3_t org, vec3_t dir, int color,
 	}
 }
 
+
+/*
+ * cl_particle_bench [count]
+ *
+ * Spawns count particles (100000 by default) into a store of their
+ * own and times the update of all of them, vectorized and scalar.
+ * Nothing fades out, so the compaction only walks the arrays.
+ */
+void
+CL_ParticleBench_f(void)
+{
+	particlestore_t ps;
+	cparticle_t p;
+	long long start, simd, scalar, compact;
+	int count, frames;
+	int i, j;
+	float now;
+
+	count = 100000;
+
+	if (Cmd_Argc() > 1)
+	{
+		count = (int)strtol(Cmd_Argv(1), (char **)NULL, 10);
+	}
+
+	if (count <= 0)
+	{
+		Com_Printf("Usage: cl_particle_bench [count]\n");
+		return;
+	}
+
+	CL_InitParticleStore(&ps, count);
+
+	for (i = 0; i < count; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			p.org[j] = crandk() * 1024;
+			p.vel[j] = crandk() * 200;
+		}
+
+		p.accel[0] = p.accel[1] = 0;
+		p.accel[2] = -PARTICLE_GRAVITY;
+		p.time = 0;
+		p.alpha = 1.0f;
+		p.alphavel = -0.001f * (1 + frandk());
+		p.color = 0xe0 + (randk() & 7);
+
+		CL_StoreParticle(&ps, &p);
+	}
+
+	frames = 100;
+	simd = scalar = compact = 0;
+
+	for (i = 0; i < frames; i++)
+	{
+		now = i * 16.0f;
+
+		start = Sys_Microseconds();
+		CL_UpdateParticles(&ps, now);
+		simd += Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		CL_CompactParticles(&ps);
+		compact += Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		CL_UpdateParticlesScalar(&ps, now);
+		scalar += Sys_Microseconds() - start;
+	}
+
+	Com_Printf("%i particles, %i frames\n", count, frames);
+#if defined(PARTICLES_SSE2)
+	Com_Printf("update (SSE2): %lli us/frame\n", simd / frames);
+#elif defined(PARTICLES_NEON)
+	Com_Printf("update (NEON): %lli us/frame\n", simd / frames);
+#endif
+	Com_Printf("update (scalar): %lli us/frame\n", scalar / frames);
+	Com_Printf("compaction: %lli us/frame\n", compact / frames);
+
+	CL_FreeParticleStore(&ps);
+}
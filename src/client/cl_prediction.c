@@ -77,33 +77,111 @@ CL_CheckPredictionError(void)
 	}
 }
 
-void
-CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs,
-		vec3_t end, trace_t *tr)
+/*
+ * The solid entities of cl.frame, with their bounds worked out
+ * once per server frame instead of for every trace. The ones near
+ * the predicted move come first, so the traces of the move only
+ * have to look at those.
+ */
+typedef struct
+{
+	entity_state_t *ent;
+	int headnode;           /* bmodels, -1 for boxes */
+	vec3_t mins, maxs;      /* boxes */
+	vec3_t absmin, absmax;
+} clipent_t;
+
+static clipent_t clip_ents[MAX_EDICTS];
+static int clip_numents;
+static int clip_numnear;
+static vec3_t clip_nearmins, clip_nearmaxs;
+static int clip_serverframe = -1;
+static int clip_servercount;
+static qboolean clip_outside;   /* a trace left the near bounds */
+
+/*
+ * The pmove state after each command that was sent. A render frame
+ * only runs the commands that came after the newest one and the one
+ * that's still being built. A new server frame keeps them if its
+ * state matches the one predicted for the acknowledged command and
+ * nothing near the move changed, otherwise they're run again.
+ */
+typedef struct
+{
+	int number;
+	int solid;
+	int modelindex;
+	vec3_t origin, angles;
+} clipstate_t;
+
+static struct
+{
+	pmove_state_t states[CMD_BACKUP];
+	vec3_t viewangles[CMD_BACKUP];
+	int base;       /* the acknowledged command they start after */
+	int newest;     /* the last command with a state, base if none */
+	int serverframe;
+	int servercount;
+
+	/* what the near entities looked like when they were run */
+	clipstate_t near[MAX_EDICTS];
+	int numnear;
+} predict;
+
+/*
+ * How far the player may get before the next
+ * server frame: the unacknowledged commands,
+ * 100ms more and an allowance for falling.
+ */
+static float
+CL_PredictionReach(void)
+{
+	const short *velocity;
+	int ack, msec;
+	float speed, time;
+
+	msec = 100;
+
+	for (ack = cls.netchan.incoming_acknowledged + 1;
+		 ack <= cls.netchan.outgoing_sequence; ack++)
+	{
+		msec += cl.cmds[ack & (CMD_BACKUP - 1)].msec;
+	}
+
+	velocity = cl.frame.playerstate.pmove.velocity;
+	speed = (abs(velocity[0]) + abs(velocity[1]) + abs(velocity[2])) *
+		0.125f;
+	time = msec * 0.001f;
+
+	return 64 + (speed + 400 + 800 * time) * time;
+}
+
+static void
+CL_BuildClipList(void)
 {
-	int i, x, zd, zu;
-	trace_t trace;
-	int headnode;
-	float *angles;
 	entity_state_t *ent;
-	int num;
+	clipent_t *ce, swap;
 	cmodel_t *cmodel;
-	vec3_t bmins, bmaxs;
+	vec3_t origin;
+	float reach, v, radius;
+	int i, j, num, x, zd, zu;
+
+	clip_serverframe = cl.frame.serverframe;
+	clip_servercount = cl.servercount;
+	clip_numents = 0;
 
 	for (i = 0; i < cl.frame.num_entities; i++)
 	{
 		num = (cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1);
 		ent = &cl_parse_entities[num];
 
-		if (!ent->solid)
+		if (!ent->solid || (ent->number == cl.playernum + 1))
 		{
 			continue;
 		}
 
-		if (ent->number == cl.playernum + 1)
-		{
-			continue;
-		}
+		ce = &clip_ents[clip_numents];
+		ce->ent = ent;
 
 		if (ent->solid == 31)
 		{
@@ -115,8 +193,31 @@ CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs,
 				continue;
 			}
 
-			headnode = cmodel->headnode;
-			angles = ent->angles;
+			ce->headnode = cmodel->headnode;
+
+			if (ent->angles[0] || ent->angles[1] || ent->angles[2])
+			{
+				radius = 0;
+
+				for (j = 0; j < 3; j++)
+				{
+					v = Q_max(fabsf(cmodel->mins[j]), fabsf(cmodel->maxs[j]));
+					radius += v * v;
+				}
+
+				radius = sqrtf(radius);
+
+				for (j = 0; j < 3; j++)
+				{
+					ce->absmin[j] = ent->origin[j] - radius;
+					ce->absmax[j] = ent->origin[j] + radius;
+				}
+			}
+			else
+			{
+				VectorAdd(ent->origin, cmodel->mins, ce->absmin);
+				VectorAdd(ent->origin, cmodel->maxs, ce->absmax);
+			}
 		}
 		else
 		{
@@ -125,12 +226,117 @@ CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs,
 			zd = 8 * ((ent->solid >> 5) & 31);
 			zu = 8 * ((ent->solid >> 10) & 63) - 32;
 
-			bmins[0] = bmins[1] = -(float)x;
-			bmaxs[0] = bmaxs[1] = (float)x;
-			bmins[2] = -(float)zd;
-			bmaxs[2] = (float)zu;
+			ce->mins[0] = ce->mins[1] = -(float)x;
+			ce->maxs[0] = ce->maxs[1] = (float)x;
+			ce->mins[2] = -(float)zd;
+			ce->maxs[2] = (float)zu;
+
+			ce->headnode = -1;
+			VectorAdd(ent->origin, ce->mins, ce->absmin);
+			VectorAdd(ent->origin, ce->maxs, ce->absmax);
+		}
+
+		clip_numents++;
+	}
+
+	/* move the ones near the player to the front */
+	reach = CL_PredictionReach();
+
+	for (j = 0; j < 3; j++)
+	{
+		origin[j] = cl.frame.playerstate.pmove.origin[j] * 0.125f;
+		clip_nearmins[j] = origin[j] - reach;
+		clip_nearmaxs[j] = origin[j] + reach;
+	}
+
+	clip_numnear = 0;
+
+	for (i = 0; i < clip_numents; i++)
+	{
+		ce = &clip_ents[i];
+
+		for (j = 0; j < 3; j++)
+		{
+			if ((ce->absmin[j] > clip_nearmaxs[j]) ||
+				(ce->absmax[j] < clip_nearmins[j]))
+			{
+				break;
+			}
+		}
+
+		if (j == 3)
+		{
+			swap = clip_ents[clip_numnear];
+			clip_ents[clip_numnear++] = *ce;
+			*ce = swap;
+		}
+	}
+}
+
+/*
+ * The clip list must be built from the
+ * frame that's being traced against.
+ */
+static void
+CL_CheckClipList(void)
+{
+	if ((clip_serverframe != cl.frame.serverframe) ||
+		(clip_servercount != cl.servercount))
+	{
+		CL_BuildClipList();
+	}
+}
+
+void
+CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, trace_t *tr)
+{
+	trace_t trace;
+	int headnode;
+	float *angles;
+	clipent_t *ce;
+	vec3_t tmins, tmaxs;
+	int i, count;
+
+	CL_CheckClipList();
+
+	for (i = 0; i < 3; i++)
+	{
+		tmins[i] = Q_min(start[i], end[i]) + mins[i] - 1;
+		tmaxs[i] = Q_max(start[i], end[i]) + maxs[i] + 1;
+	}
+
+	count = clip_numnear;
 
-			headnode = CM_HeadnodeForBox(bmins, bmaxs);
+	for (i = 0; i < 3; i++)
+	{
+		if ((tmins[i] < clip_nearmins[i]) || (tmaxs[i] > clip_nearmaxs[i]))
+		{
+			count = clip_numents;
+			clip_outside = true;
+			break;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		ce = &clip_ents[i];
+
+		if ((ce->absmin[0] > tmaxs[0]) || (ce->absmax[0] < tmins[0]) ||
+			(ce->absmin[1] > tmaxs[1]) || (ce->absmax[1] < tmins[1]) ||
+			(ce->absmin[2] > tmaxs[2]) || (ce->absmax[2] < tmins[2]))
+		{
+			continue;
+		}
+
+		if (ce->headnode >= 0)
+		{
+			headnode = ce->headnode;
+			angles = ce->ent->angles;
+		}
+		else
+		{
+			headnode = CM_HeadnodeForBox(ce->mins, ce->maxs);
 			angles = vec3_origin; /* boxes don't rotate */
 		}
 
@@ -141,12 +347,12 @@ CL_ClipMoveToEntities(vec3_t start, vec3_t mins, vec3_t maxs,
 
 		trace = CM_TransformedBoxTrace(start, end,
 				mins, maxs, headnode, MASK_PLAYERSOLID,
-				ent->origin, angles);
+				ce->ent->origin, angles);
 
 		if (trace.allsolid || trace.startsolid ||
 			(trace.fraction < tr->fraction))
 		{
-			trace.ent = (struct edict_s *)ent;
+			trace.ent = (struct edict_s *)ce->ent;
 
 			if (tr->startsolid)
 			{
@@ -184,37 +390,123 @@ int
 CL_PMpointcontents(vec3_t point)
 {
 	int i;
-	entity_state_t *ent;
-	int num;
-	cmodel_t *cmodel;
+	clipent_t *ce;
 	int contents;
 
 	contents = CM_PointContents(point, 0);
 
-	for (i = 0; i < cl.frame.num_entities; i++)
+	CL_CheckClipList();
+
+	for (i = 0; i < clip_numents; i++)
 	{
-		num = (cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1);
-		ent = &cl_parse_entities[num];
+		ce = &clip_ents[i];
 
-		if (ent->solid != 31) /* special value for bmodel */
+		if (ce->headnode < 0) /* only bmodels */
 		{
 			continue;
 		}
 
-		cmodel = cl.model_clip[ent->modelindex];
-
-		if (!cmodel)
+		if ((point[0] < ce->absmin[0]) || (point[0] > ce->absmax[0]) ||
+			(point[1] < ce->absmin[1]) || (point[1] > ce->absmax[1]) ||
+			(point[2] < ce->absmin[2]) || (point[2] > ce->absmax[2]))
 		{
 			continue;
 		}
 
-		contents |= CM_TransformedPointContents(point, cmodel->headnode,
-				ent->origin, ent->angles);
+		contents |= CM_TransformedPointContents(point, ce->headnode,
+				ce->ent->origin, ce->ent->angles);
 	}
 
 	return contents;
 }
 
+static qboolean
+CL_SamePmoveState(const pmove_state_t *a, const pmove_state_t *b)
+{
+	return (a->pm_type == b->pm_type) &&
+		!memcmp(a->origin, b->origin, sizeof(a->origin)) &&
+		!memcmp(a->velocity, b->velocity, sizeof(a->velocity)) &&
+		(a->pm_flags == b->pm_flags) &&
+		(a->pm_time == b->pm_time) &&
+		(a->gravity == b->gravity) &&
+		!memcmp(a->delta_angles, b->delta_angles, sizeof(a->delta_angles));
+}
+
+/*
+ * Compares the entities near the move with the ones the
+ * checkpoints were run against and remembers the new ones.
+ */
+static qboolean
+CL_SameNearEntities(void)
+{
+	clipstate_t *cs;
+	entity_state_t *ent;
+	qboolean same;
+	int i;
+
+	same = (clip_numnear == predict.numnear);
+
+	for (i = 0; i < clip_numnear; i++)
+	{
+		ent = clip_ents[i].ent;
+		cs = &predict.near[i];
+
+		if (same && ((cs->number != ent->number) ||
+				(cs->solid != ent->solid) ||
+				(cs->modelindex != ent->modelindex) ||
+				!VectorCompare(cs->origin, ent->origin) ||
+				!VectorCompare(cs->angles, ent->angles)))
+		{
+			same = false;
+		}
+
+		cs->number = ent->number;
+		cs->solid = ent->solid;
+		cs->modelindex = ent->modelindex;
+		VectorCopy(ent->origin, cs->origin);
+		VectorCopy(ent->angles, cs->angles);
+	}
+
+	predict.numnear = clip_numnear;
+
+	return same;
+}
+
+/*
+ * Called for a new server frame, drops the
+ * checkpoints the frame doesn't agree with.
+ */
+static void
+CL_CheckPredictionStates(int ack)
+{
+	qboolean keep;
+
+	/* only if nothing was traced outside of
+	   the near entities since they were run */
+	keep = !clip_outside && (ack > predict.base) &&
+		(ack <= predict.newest) &&
+		(predict.newest - ack < CMD_BACKUP) &&
+		CL_SamePmoveState(&predict.states[ack & (CMD_BACKUP - 1)],
+				&cl.frame.playerstate.pmove);
+
+	CL_BuildClipList();
+
+	if (!CL_SameNearEntities())
+	{
+		keep = false;
+	}
+
+	clip_outside = false;
+	predict.base = ack;
+	predict.serverframe = cl.frame.serverframe;
+	predict.servercount = cl.servercount;
+
+	if (!keep)
+	{
+		predict.newest = ack;
+	}
+}
+
 /*
  * Sets cl.predicted_origin and cl.predicted_angles
  */
@@ -249,6 +541,9 @@ CL_PredictMovement(void)
 					cl.frame.playerstate.pmove.delta_angles[i]);
 		}
 
+		/* the checkpoints are stale once it's back */
+		predict.base = predict.newest = -1;
+
 		return;
 	}
 
@@ -266,30 +561,52 @@ CL_PredictMovement(void)
 		return;
 	}
 
+	if ((predict.serverframe != cl.frame.serverframe) ||
+		(predict.servercount != cl.servercount) || (predict.base != ack))
+	{
+		CL_CheckPredictionStates(ack);
+	}
+
 	/* copy current state to pmove */
 	memset (&pm, 0, sizeof(pm));
 	pm.trace = CL_PMTrace;
 	pm.pointcontents = CL_PMpointcontents;
 	pm_airaccelerate = atof(cl.configstrings[CS_AIRACCEL]);
-	pm.s = cl.frame.playerstate.pmove;
 
-	/* run frames */
-	while (++ack <= current)
+	if (predict.newest == ack)
+	{
+		pm.s = cl.frame.playerstate.pmove;
+	}
+	else
+	{
+		frame = predict.newest & (CMD_BACKUP - 1);
+		pm.s = predict.states[frame];
+		VectorCopy(predict.viewangles[frame], pm.viewangles);
+	}
+
+	/* run the commands sent since the newest checkpoint,
+	   and the one that's still being built */
+	for (ack = predict.newest + 1; ack <= current; ack++)
 	{
 		frame = ack & (CMD_BACKUP - 1);
 		cmd = &cl.cmds[frame];
 
 		// Ignore null entries
-		if (!cmd->msec)
+		if (cmd->msec)
 		{
-			continue;
-		}
+			pm.cmd = *cmd;
+			Pmove(&pm);
 
-		pm.cmd = *cmd;
-		Pmove(&pm);
+			/* save for debug checking */
+			VectorCopy(pm.s.origin, cl.predicted_origins[frame]);
+		}
 
-		/* save for debug checking */
-		VectorCopy(pm.s.origin, cl.predicted_origins[frame]);
+		if (ack < current)
+		{
+			predict.states[frame] = pm.s;
+			VectorCopy(pm.viewangles, predict.viewangles[frame]);
+			predict.newest = ack;
+		}
 	}
 
 	// step is used for movement prediction on stairs
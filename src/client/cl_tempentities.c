@@ -46,6 +46,7 @@ typedef enum
 
 typedef struct
 {
+	tentlink_t link;
 	exptype_t type;
 	entity_t ent;
 
@@ -59,14 +60,13 @@ typedef struct
 	vec3_t velocity;       /* velocity for muzzle flash tracking */
 } explosion_t;
 
-#define MAX_EXPLOSIONS 64
-#define MAX_BEAMS 64
-#define MAX_LASERS 64
-
-static explosion_t cl_explosions[MAX_EXPLOSIONS];
+#define MAX_EXPLOSIONS 1024
+#define MAX_BEAMS 512
+#define MAX_LASERS 512
 
 typedef struct
 {
+	tentlink_t link;
 	int entity;
 	int dest_entity;
 	struct model_s *model;
@@ -75,18 +75,44 @@ typedef struct
 	vec3_t start, end;
 } beam_t;
 
-static beam_t cl_beams[MAX_BEAMS];
-static beam_t cl_heatbeams[MAX_BEAMS];
-
 typedef struct
 {
+	tentlink_t link;
 	entity_t ent;
 	int endtime;
 } laser_t;
 
-static laser_t cl_lasers[MAX_LASERS];
-
-static cl_sustain_t cl_sustains[MAX_SUSTAINS];
+/*
+ * A pool of temp entities of one kind. The entries start with a
+ * tentlink_t and are allocated in blocks as more of them are needed,
+ * up to limit. Unused ones are in a free list, the ones in use in a
+ * list in the order they were allocated, so the oldest comes first.
+ */
+typedef struct
+{
+	const char *name;
+	int size;
+	int limit;
+
+	tentlink_t active;
+	tentlink_t *free;
+	int allocated;
+
+	/* since the last map change */
+	int num;
+	int peak;
+	int overflows;
+} tentpool_t;
+
+static tentpool_t cl_explosions = {"explosions", sizeof(explosion_t), MAX_EXPLOSIONS};
+static tentpool_t cl_beams = {"beams", sizeof(beam_t), MAX_BEAMS};
+static tentpool_t cl_heatbeams = {"heat beams", sizeof(beam_t), MAX_BEAMS};
+static tentpool_t cl_lasers = {"lasers", sizeof(laser_t), MAX_LASERS};
+static tentpool_t cl_sustains = {"sustains", sizeof(cl_sustain_t), MAX_SUSTAINS};
+
+static tentpool_t *cl_tentpools[] = {
+	&cl_explosions, &cl_beams, &cl_heatbeams, &cl_lasers, &cl_sustains
+};
 
 extern void CL_TeleportParticles(vec3_t org);
 void CL_BlasterParticles(vec3_t org, vec3_t dir);
@@ -140,33 +166,171 @@ static struct model_s *cl_mod_smoke_sprite;
 static struct model_s *cl_mod_muzzle_flash_sprite;
 
 /*
- * Utility functions
+ * Puts all entries back into the free list.
  */
-static beam_t *
-CL_Beams_NextFree(const beam_t *list)
+static void
+CL_TEntPoolClear(tentpool_t *pool)
 {
-	const beam_t *b;
+	tentlink_t *l, *next;
 
-	for (b = list; b < &list[MAX_BEAMS]; b++)
+	if (pool->active.next)
 	{
-		if (!b->model || (b->endtime < cl.time))
-			return (beam_t *)b;
+		for (l = pool->active.next; l != &pool->active; l = next)
+		{
+			next = l->next;
+			l->next = pool->free;
+			pool->free = l;
+		}
 	}
 
-	return NULL;
+	pool->active.prev = pool->active.next = &pool->active;
+	pool->num = 0;
+}
+
+static qboolean
+CL_TEntPoolGrow(tentpool_t *pool)
+{
+	byte *entries;
+	int count, i;
+
+	/* double it, starting at 16 */
+	count = pool->allocated ? pool->allocated : 16;
+
+	if (count > pool->limit - pool->allocated)
+	{
+		count = pool->limit - pool->allocated;
+	}
+
+	if (count <= 0)
+	{
+		return false;
+	}
+
+	/* kept until the client shuts down */
+	entries = Z_Malloc(count * pool->size);
+
+	for (i = count - 1; i >= 0; i--)
+	{
+		tentlink_t *l = (tentlink_t *)(entries + i * pool->size);
+
+		l->next = pool->free;
+		pool->free = l;
+	}
+
+	pool->allocated += count;
+
+	return true;
 }
 
+/*
+ * Returns a cleared entry at the end of the active
+ * list, or NULL if the pool is at its limit.
+ */
+static void *
+CL_TEntPoolAlloc(tentpool_t *pool)
+{
+	tentlink_t *l;
+
+	if (!pool->active.next)
+	{
+		CL_TEntPoolClear(pool);
+	}
+
+	if (!pool->free && !CL_TEntPoolGrow(pool))
+	{
+		pool->overflows++;
+		return NULL;
+	}
+
+	l = pool->free;
+	pool->free = l->next;
+
+	memset(l, 0, pool->size);
+
+	l->prev = pool->active.prev;
+	l->next = &pool->active;
+	l->prev->next = l;
+	pool->active.prev = l;
+
+	if (++pool->num > pool->peak)
+	{
+		pool->peak = pool->num;
+	}
+
+	return l;
+}
+
+static void
+CL_TEntPoolFree(tentpool_t *pool, void *entry)
+{
+	tentlink_t *l = entry;
+
+	l->prev->next = l->next;
+	l->next->prev = l->prev;
+
+	l->next = pool->free;
+	pool->free = l;
+
+	pool->num--;
+}
+
+/*
+ * Reuses the oldest entry when the pool is full.
+ */
+static void *
+CL_TEntPoolAllocOldest(tentpool_t *pool)
+{
+	void *entry;
+
+	entry = CL_TEntPoolAlloc(pool);
+
+	if (!entry && (pool->active.next != &pool->active))
+	{
+		CL_TEntPoolFree(pool, pool->active.next);
+		entry = CL_TEntPoolAlloc(pool);
+	}
+
+	return entry;
+}
+
+/*
+ * cl_tentstats
+ */
+void
+CL_TEntStats_f(void)
+{
+	tentpool_t *pool;
+	int i;
+
+	Com_Printf("%-12s %6s %6s %9s %6s %9s\n", "pool", "live", "peak",
+			"allocated", "limit", "overflows");
+
+	for (i = 0; i < sizeof(cl_tentpools) / sizeof(cl_tentpools[0]); i++)
+	{
+		pool = cl_tentpools[i];
+
+		Com_Printf("%-12s %6i %6i %9i %6i %9i\n", pool->name, pool->num,
+				pool->peak, pool->allocated, pool->limit, pool->overflows);
+	}
+}
+
+/*
+ * Utility functions
+ */
 static beam_t *
-CL_Beams_SameEnt(const beam_t *list, int src, int dest)
+CL_Beams_SameEnt(tentpool_t *pool, int src, int dest)
 {
-	const beam_t *b;
+	tentlink_t *l;
+	beam_t *b;
 
-	for (b = list; b < &list[MAX_BEAMS]; b++)
+	for (l = pool->active.next; l != &pool->active; l = l->next)
 	{
+		b = (beam_t *)l;
+
 		if ((src < 0 || b->entity == src) &&
 			(dest < 0 || b->dest_entity == dest))
 		{
-			return (beam_t *)b;
+			return b;
 		}
 	}
 
@@ -198,53 +362,10 @@ CL_Beams_Set(beam_t *b,
 	b->endtime = cl.time + tm;
 }
 
-static cl_sustain_t *
-CL_NextFreeSustain(void)
-{
-	cl_sustain_t *s;
-
-	for (s = cl_sustains; s < &cl_sustains[MAX_SUSTAINS]; s++)
-	{
-		if (s->id == 0)
-		{
-			return s;
-		}
-	}
-
-	return NULL;
-}
-
 static explosion_t *
 CL_AllocExplosion(void)
 {
-	int i;
-	float time;
-	int index;
-
-	for (i = 0; i < MAX_EXPLOSIONS; i++)
-	{
-		if (cl_explosions[i].type == ex_free)
-		{
-			memset(&cl_explosions[i], 0, sizeof(cl_explosions[i]));
-			return &cl_explosions[i];
-		}
-	}
-
-	/* find the oldest explosion */
-	time = (float)cl.time;
-	index = 0;
-
-	for (i = 0; i < MAX_EXPLOSIONS; i++)
-	{
-		if (cl_explosions[i].start < time)
-		{
-			time = cl_explosions[i].start;
-			index = i;
-		}
-	}
-
-	memset(&cl_explosions[index], 0, sizeof(cl_explosions[index]));
-	return &cl_explosions[index];
+	return CL_TEntPoolAllocOldest(&cl_explosions);
 }
 
 /*
@@ -371,12 +492,17 @@ CL_ClearTEntModelVars(void)
 void
 CL_ClearTEnts(void)
 {
-	memset(cl_beams, 0, sizeof(cl_beams));
-	memset(cl_explosions, 0, sizeof(cl_explosions));
-	memset(cl_lasers, 0, sizeof(cl_lasers));
+	tentpool_t *pool;
+	int i;
 
-	memset(cl_heatbeams, 0, sizeof(cl_heatbeams));
-	memset(cl_sustains, 0, sizeof(cl_sustains));
+	/* the stats are per map */
+	for (i = 0; i < sizeof(cl_tentpools) / sizeof(cl_tentpools[0]); i++)
+	{
+		pool = cl_tentpools[i];
+
+		CL_TEntPoolClear(pool);
+		pool->peak = pool->overflows = 0;
+	}
 
 	CL_ClearTEntModelVars();
 	CL_ClearTEntSoundVars();
@@ -385,10 +511,10 @@ CL_ClearTEnts(void)
 void
 CL_ClearTEntModels(void)
 {
-	memset(cl_explosions, 0, sizeof(cl_explosions));
+	CL_TEntPoolClear(&cl_explosions);
 
-	memset(cl_beams, 0, sizeof(cl_beams));
-	memset(cl_heatbeams, 0, sizeof(cl_heatbeams));
+	CL_TEntPoolClear(&cl_beams);
+	CL_TEntPoolClear(&cl_heatbeams);
 
 	CL_ClearTEntModelVars();
 }
@@ -540,11 +666,11 @@ CL_ParseBeam(struct model_s *model, qboolean with_offset)
 	}
 
 	/* override any beam with the same entity */
-	b = CL_Beams_SameEnt(cl_beams, ent, -1);
+	b = CL_Beams_SameEnt(&cl_beams, ent, -1);
 
 	if (!b)
 	{
-		b = CL_Beams_NextFree(cl_beams);
+		b = CL_TEntPoolAlloc(&cl_beams);
 
 		if (!b)
 		{
@@ -558,7 +684,7 @@ CL_ParseBeam(struct model_s *model, qboolean with_offset)
 }
 
 /*
- * adds to the cl_playerbeam array instead of the cl_beams array
+ * adds to the cl_heatbeams pool instead of the cl_beams pool
  */
 static void
 CL_ParseHeatBeam(qboolean is_monster)
@@ -588,11 +714,11 @@ CL_ParseHeatBeam(qboolean is_monster)
 	/* Override any beam with the same entity
 	   For player beams, we only want one per
 	   player (entity) so... */
-	b = CL_Beams_SameEnt(cl_heatbeams, ent, -1);
+	b = CL_Beams_SameEnt(&cl_heatbeams, ent, -1);
 
 	if (!b)
 	{
-		b = CL_Beams_NextFree(cl_heatbeams);
+		b = CL_TEntPoolAlloc(&cl_heatbeams);
 
 		if (!b)
 		{
@@ -641,11 +767,11 @@ CL_ParseLightning(struct model_s *model)
 
 	/* override any beam with the same
 	   source AND destination entities */
-	b = CL_Beams_SameEnt(cl_beams, srcEnt, destEnt);
+	b = CL_Beams_SameEnt(&cl_beams, srcEnt, destEnt);
 
 	if (!b)
 	{
-		b = CL_Beams_NextFree(cl_beams);
+		b = CL_TEntPoolAlloc(&cl_beams);
 
 		if (!b)
 		{
@@ -666,36 +792,37 @@ CL_ParseLaser(int colors)
 	vec3_t start;
 	vec3_t end;
 	laser_t *l;
-	int i;
+	float alpha;
 
 	MSG_ReadPos(&net_message, start);
 	MSG_ReadPos(&net_message, end);
 
-	for (i = 0, l = cl_lasers; i < MAX_LASERS; i++, l++)
+	l = CL_TEntPoolAlloc(&cl_lasers);
+
+	if (!l)
 	{
-		if (l->endtime < cl.time)
-		{
-			float alpha = cl_laseralpha->value;
-			if (alpha < 0.0f)
-			{
-				alpha = 0.0f;
-			}
-			else if (alpha > 1.0f)
-			{
-				alpha = 1.0f;
-			}
+		return;
+	}
 
-			l->ent.flags = RF_TRANSLUCENT | RF_BEAM;
-			VectorCopy(start, l->ent.origin);
-			VectorCopy(end, l->ent.oldorigin);
-			l->ent.alpha = alpha;
-			l->ent.skinnum = (colors >> ((randk() % 4) * 8)) & 0xff;
-			l->ent.model = NULL;
-			l->ent.frame = 4;
-			l->endtime = cl.time + 100;
-			return;
-		}
+	alpha = cl_laseralpha->value;
+
+	if (alpha < 0.0f)
+	{
+		alpha = 0.0f;
+	}
+	else if (alpha > 1.0f)
+	{
+		alpha = 1.0f;
 	}
+
+	l->ent.flags = RF_TRANSLUCENT | RF_BEAM;
+	VectorCopy(start, l->ent.origin);
+	VectorCopy(end, l->ent.oldorigin);
+	l->ent.alpha = alpha;
+	l->ent.skinnum = (colors >> ((randk() % 4) * 8)) & 0xff;
+	l->ent.model = NULL;
+	l->ent.frame = 4;
+	l->endtime = cl.time + 100;
 }
 
 static void
@@ -726,7 +853,7 @@ CL_ParseSteam(void)
 		return;
 	}
 
-	s = CL_NextFreeSustain();
+	s = CL_TEntPoolAlloc(&cl_sustains);
 
 	if (!s)
 	{
@@ -754,7 +881,7 @@ CL_ParseWidow(void)
 
 	id = MSG_ReadShort(&net_message);
 
-	s = CL_NextFreeSustain();
+	s = CL_TEntPoolAlloc(&cl_sustains);
 
 	if (!s)
 	{
@@ -774,7 +901,7 @@ CL_ParseNuke(void)
 {
 	cl_sustain_t *s, dummy;
 
-	s = CL_NextFreeSustain();
+	s = CL_TEntPoolAlloc(&cl_sustains);
 
 	if (!s)
 	{
@@ -1546,7 +1673,8 @@ CalculatePitchYaw(const vec3_t dir, float *pitch, float *yaw)
 static void
 CL_AddBeams(void)
 {
-	const beam_t *b;
+	tentlink_t *l, *next;
+	beam_t *b;
 	vec3_t dist, org;
 	float d;
 	entity_t ent;
@@ -1554,10 +1682,14 @@ CL_AddBeams(void)
 	float len, steps;
 	float model_length;
 
-	for (b = cl_beams; b < &cl_beams[MAX_BEAMS]; b++)
+	for (l = cl_beams.active.next; l != &cl_beams.active; l = next)
 	{
-		if (!b->model || (b->endtime < cl.time))
+		next = l->next;
+		b = (beam_t *)l;
+
+		if (b->endtime < cl.time)
 		{
+			CL_TEntPoolFree(&cl_beams, b);
 			continue;
 		}
 
@@ -1706,7 +1838,8 @@ AdjustToWeapon(const vec3_t ofs, float hand_mul, vec3_t out)
 static void
 CL_AddHeatBeams(void)
 {
-	const beam_t *b;
+	tentlink_t *l, *next;
+	beam_t *b;
 	vec3_t dist, org;
 	float d;
 	entity_t ent;
@@ -1719,10 +1852,14 @@ CL_AddHeatBeams(void)
 
 	hand_mul = HandMul();
 
-	for (b = cl_heatbeams; b < &cl_heatbeams[MAX_BEAMS]; b++)
+	for (l = cl_heatbeams.active.next; l != &cl_heatbeams.active; l = next)
 	{
-		if (!b->model || (b->endtime < cl.time))
+		next = l->next;
+		b = (beam_t *)l;
+
+		if (b->endtime < cl.time)
 		{
+			CL_TEntPoolFree(&cl_heatbeams, b);
 			continue;
 		}
 
@@ -1819,20 +1956,18 @@ CL_AddHeatBeams(void)
 static void
 CL_AddExplosions(void)
 {
+	tentlink_t *l, *next;
 	entity_t *ent;
-	int i;
 	explosion_t *ex;
 	float frac;
 	int f;
 
 	memset(&ent, 0, sizeof(ent));
 
-	for (i = 0, ex = cl_explosions; i < MAX_EXPLOSIONS; i++, ex++)
+	for (l = cl_explosions.active.next; l != &cl_explosions.active; l = next)
 	{
-		if (ex->type == ex_free)
-		{
-			continue;
-		}
+		next = l->next;
+		ex = (explosion_t *)l;
 
 		frac = (cl.time - ex->start) / 100.0;
 		f = (int)floor(frac);
@@ -2026,6 +2161,7 @@ CL_AddExplosions(void)
 
 		if (ex->type == ex_free)
 		{
+			CL_TEntPoolFree(&cl_explosions, ex);
 			continue;
 		}
 
@@ -2053,14 +2189,21 @@ CL_AddExplosions(void)
 static void
 CL_AddLasers(void)
 {
-	laser_t *l;
-	int i;
+	tentlink_t *l, *next;
+	laser_t *laser;
 
-	for (i = 0, l = cl_lasers; i < MAX_LASERS; i++, l++)
+	for (l = cl_lasers.active.next; l != &cl_lasers.active; l = next)
 	{
-		if (l->endtime >= cl.time)
+		next = l->next;
+		laser = (laser_t *)l;
+
+		if (laser->endtime >= cl.time)
+		{
+			V_AddEntity(&laser->ent);
+		}
+		else
 		{
-			V_AddEntity(&l->ent);
+			CL_TEntPoolFree(&cl_lasers, laser);
 		}
 	}
 }
@@ -2068,21 +2211,21 @@ CL_AddLasers(void)
 void
 CL_ProcessSustain()
 {
+	tentlink_t *l, *next;
 	cl_sustain_t *s;
-	int i;
 
-	for (i = 0, s = cl_sustains; i < MAX_SUSTAINS; i++, s++)
+	for (l = cl_sustains.active.next; l != &cl_sustains.active; l = next)
 	{
-		if (s->id)
+		next = l->next;
+		s = (cl_sustain_t *)l;
+
+		if ((s->endtime >= cl.time) && (cl.time >= s->nextthink))
 		{
-			if ((s->endtime >= cl.time) && (cl.time >= s->nextthink))
-			{
-				s->think(s);
-			}
-			else if (s->endtime < cl.time)
-			{
-				s->id = 0;
-			}
+			s->think(s);
+		}
+		else if (s->endtime < cl.time)
+		{
+			CL_TEntPoolFree(&cl_sustains, s);
 		}
 	}
 }
@@ -98,6 +98,26 @@ V_AddParticle(vec3_t org, unsigned int color, float alpha)
 	p->alpha = alpha;
 }
 
+/*
+ * Room for up to count particles, count is
+ * lowered to what's left for this frame.
+ */
+particle_t *
+V_AllocParticles(int *count)
+{
+	particle_t *p;
+
+	if (*count > MAX_PARTICLES - r_numparticles)
+	{
+		*count = MAX_PARTICLES - r_numparticles;
+	}
+
+	p = &r_particles[r_numparticles];
+	r_numparticles += *count;
+
+	return p;
+}
+
 void
 V_AddLight(vec3_t org, float intensity, float r, float g, float b)
 {
@@ -35,7 +35,7 @@
    it can be un-deltad from the original */
 #define	MAX_PARSE_ENTITIES	1024
 
-#define MAX_SUSTAINS		32
+#define MAX_SUSTAINS		256
 #define	PARTICLE_GRAVITY 40
 #define INSTANT_PARTICLE -10000.0
 
@@ -290,6 +290,7 @@ extern	cvar_t	*cl_pitchspeed;
 extern	cvar_t	*cl_run;
 extern	cvar_t	*cl_anglespeedkey;
 extern	cvar_t	*cl_shownet;
+extern	cvar_t	*cl_packedproto;
 extern	cvar_t	*cl_showmiss;
 extern	cvar_t	*cl_showclamp;
 extern	cvar_t	*lookstrafe;
@@ -352,8 +353,15 @@ qboolean	CL_CheckOrDownloadFile (const char *filename);
 
 void CL_AddNetgraph (void);
 
+/* temp entities are kept in lists of the ones in use */
+typedef struct tentlink_s
+{
+	struct tentlink_s	*prev, *next;
+} tentlink_t;
+
 typedef struct cl_sustain
 {
+	tentlink_t	link;	/* must be first */
 	int			id;
 	int			type;
 	int			endtime;
@@ -378,9 +386,6 @@ void CL_ParticleEffect3 (vec3_t org, vec3_t dir, int color, int count);
 
 typedef struct particle_s
 {
-
-	struct particle_s	*next;
-
 	float		time;
 
 	vec3_t		org;
@@ -395,6 +400,7 @@ typedef struct particle_s
 void CL_ClearEffects (void);
 void CL_ClearTEnts (void);
 void CL_ClearTEntModels (void);
+void CL_TEntStats_f (void);
 void CL_BlasterTrail (vec3_t start, vec3_t end);
 void CL_QuadTrail (vec3_t start, vec3_t end);	// unused
 void CL_RailTrail (vec3_t start, vec3_t end);
@@ -508,6 +514,7 @@ void V_Init (void);
 void V_RenderView( float stereo_separation );
 void V_AddEntity (entity_t *ent);
 void V_AddParticle (vec3_t org, unsigned int color, float alpha);
+particle_t *V_AllocParticles (int *count);
 void V_AddLight (vec3_t org, float intensity, float r, float g, float b);
 void V_AddLightStyle (int style, float r, float g, float b);
 
@@ -529,6 +536,9 @@ void CL_DiminishingTrail (vec3_t start, vec3_t end, centity_t *old, int flags);
 void CL_FlyEffect (centity_t *ent, vec3_t origin);
 void CL_BfgParticles (entity_t *ent);
 void CL_AddParticles (void);
+cparticle_t *CL_AllocParticles (int *count);
+cparticle_t *CL_AllocParticle (void);
+void CL_ParticleBench_f (void);
 void CL_EntityEvent (entity_state_t *ent);
 void CL_TrapParticles (entity_t *ent);
 void CL_FlameEffect (vec3_t org);
@@ -64,6 +64,7 @@ int gl3_visframecount; /* bumped when going to a new PVS */
 int gl3_framecount; /* used for dlight push checking */
 
 int c_brush_polys, c_alias_polys;
+int c_brush_draws; /* draw calls for brush polys */
 
 static float v_blend[4]; /* final blending color */
 
@@ -125,6 +126,7 @@ cvar_t *gl_lightmap;
 cvar_t *gl_shadows;
 cvar_t *gl3_debugcontext;
 cvar_t *gl3_usebigvbo;
+cvar_t *gl3_usepersistentvbo;
 cvar_t *r_fixsurfsky;
 cvar_t *r_palettedtexture;
 cvar_t *r_validation;
@@ -225,6 +227,9 @@ GL3_Register(void)
 	// -1: auto (let yq2 choose to enable/disable this based on detected driver)
 	gl3_usebigvbo = ri.Cvar_Get("gl3_usebigvbo", "-1", CVAR_ARCHIVE);
 
+	// 1: stream 3D vertices through a persistently mapped buffer if GL_ARB_buffer_storage is supported
+	gl3_usepersistentvbo = ri.Cvar_Get("gl3_usepersistentvbo", "1", CVAR_ARCHIVE);
+
 	r_norefresh = ri.Cvar_Get("r_norefresh", "0", 0);
 	r_drawentities = ri.Cvar_Get("r_drawentities", "1", 0);
 	r_drawworld = ri.Cvar_Get("r_drawworld", "1", 0);
@@ -635,6 +640,24 @@ GL3_Init(void)
 #endif
 	}
 
+	gl3config.usePersistentVBO = false;
+	if(gl3config.buffer_storage)
+	{
+		if(gl3_usepersistentvbo->value != 0.0f)
+		{
+			Com_Printf(" - Persistent Mapped Buffers: Supported and enabled\n");
+			gl3config.usePersistentVBO = true;
+		}
+		else
+		{
+			Com_Printf(" - Persistent Mapped Buffers: Supported (but disabled with gl3_usepersistentvbo = 0)\n");
+		}
+	}
+	else
+	{
+		Com_Printf(" - Persistent Mapped Buffers: Not Supported\n");
+	}
+
 	// generate texture handles for all possible lightmaps
 	glGenTextures(MAX_LIGHTMAPS*MAX_LIGHTMAPS_PER_SURFACE, gl3state.lightmap_textureIDs[0]);
 
@@ -704,16 +727,69 @@ GL3_Shutdown(void)
 	GL3_ShutdownContext();
 }
 
+#ifndef YQ2_GL3_GLES
+/*
+ * Returns the offset of numBytes free bytes in the persistently mapped vbo3D.
+ * The buffer is used as a ring of GL3_VBO3D_SEGMENTS segments. Leaving a
+ * segment puts a fence behind the draws that use it, entering one waits for
+ * the GPU to be done with the draws that used it the last time around.
+ */
+static int
+GetPersistentVBOSpace(int numBytes)
+{
+	int segSize = gl3state.vbo3Dsize / GL3_VBO3D_SEGMENTS;
+	int curOffset = gl3state.vbo3DcurOffset;
+	int seg = curOffset / segSize;
+
+	if(curOffset + numBytes > (seg + 1) * segSize)
+	{
+		gl3state.vbo3Dfences[seg] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		seg = (seg + 1) % GL3_VBO3D_SEGMENTS;
+
+		if(gl3state.vbo3Dfences[seg] != NULL)
+		{
+			GLenum res;
+			do {
+				res = glClientWaitSync(gl3state.vbo3Dfences[seg], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			} while(res == GL_TIMEOUT_EXPIRED);
+
+			glDeleteSync(gl3state.vbo3Dfences[seg]);
+			gl3state.vbo3Dfences[seg] = NULL;
+		}
+
+		curOffset = seg * segSize;
+	}
+
+	gl3state.vbo3DcurOffset = curOffset + numBytes;
+
+	return curOffset;
+}
+#endif
+
 // assumes gl3state.v[ab]o3D are bound
-// buffers and draws gl3_3D_vtx_t vertices
-// drawMode is something like GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN or whatever
-void
-GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode)
+// puts gl3_3D_vtx_t vertices into vbo3D and returns the index of the first one,
+// all of them must fit into a quarter of the buffer
+int
+GL3_Upload3D(const gl3_3D_vtx_t* verts, int numVerts)
 {
+	int neededSize = numVerts*sizeof(gl3_3D_vtx_t);
+
+#ifndef YQ2_GL3_GLES
+	if(gl3config.usePersistentVBO)
+	{
+		// no mapping and unmapping, the fences make sure that the GPU isn't using this part anymore
+		int curOffset = GetPersistentVBOSpace(neededSize);
+		memcpy(gl3state.vbo3Dmapped + curOffset, verts, neededSize);
+
+		return curOffset/sizeof(gl3_3D_vtx_t);
+	}
+#endif
+
 	if(!gl3config.useBigVBO)
 	{
-		glBufferData( GL_ARRAY_BUFFER, sizeof(gl3_3D_vtx_t)*numVerts, verts, GL_STREAM_DRAW );
-		glDrawArrays( drawMode, 0, numVerts );
+		glBufferData( GL_ARRAY_BUFFER, neededSize, verts, GL_STREAM_DRAW );
+		return 0;
 	}
 	else // gl3config.useBigVBO == true
 	{
@@ -738,23 +814,11 @@ GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode)
 		 * this workaround (with glMapBufferRange()), the framerate dropped
 		 * significantly - that's why both methods are available and
 		 * selectable at runtime.
+		 *
+		 * World surfaces are uploaded in batches now (see gl3_surf.c), so
+		 * this happens a lot less often than before.
 		 */
-#if 0
-		// I /think/ doing it with glBufferSubData() didn't really help
-		const int bufSize = gl3state.vbo3Dsize;
-		int neededSize = numVerts*sizeof(gl3_3D_vtx_t);
 		int curOffset = gl3state.vbo3DcurOffset;
-		if(curOffset + neededSize > gl3state.vbo3Dsize)
-			curOffset = 0;
-		int curIdx = curOffset / sizeof(gl3_3D_vtx_t);
-
-		gl3state.vbo3DcurOffset = curOffset + neededSize;
-
-		glBufferSubData( GL_ARRAY_BUFFER, curOffset, neededSize, verts );
-		glDrawArrays( drawMode, curIdx, numVerts );
-#else
-		int curOffset = gl3state.vbo3DcurOffset;
-		int neededSize = numVerts*sizeof(gl3_3D_vtx_t);
 		if(curOffset+neededSize > gl3state.vbo3Dsize)
 		{
 			// buffer is full, need to start again from the beginning
@@ -771,13 +835,23 @@ GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode)
 		memcpy(data, verts, neededSize);
 		glUnmapBuffer(GL_ARRAY_BUFFER);
 
-		glDrawArrays(drawMode, curOffset/sizeof(gl3_3D_vtx_t), numVerts);
-
 		gl3state.vbo3DcurOffset = curOffset + neededSize; // TODO: padding or sth needed?
-#endif
+
+		return curOffset/sizeof(gl3_3D_vtx_t);
 	}
 }
 
+// assumes gl3state.v[ab]o3D are bound
+// buffers and draws gl3_3D_vtx_t vertices
+// drawMode is something like GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN or whatever
+void
+GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode)
+{
+	int first = GL3_Upload3D(verts, numVerts);
+
+	glDrawArrays(drawMode, first, numVerts);
+}
+
 static void
 GL3_DrawBeam(entity_t *e)
 {
@@ -1666,6 +1740,7 @@ GL3_RenderView(refdef_t *fd)
 	if (r_speeds->value)
 	{
 		c_brush_polys = 0;
+		c_brush_draws = 0;
 		c_alias_polys = 0;
 	}
 
@@ -1700,9 +1775,9 @@ GL3_RenderView(refdef_t *fd)
 
 	if (r_speeds->value)
 	{
-		Com_Printf("%4i wpoly %4i epoly %i tex %i lmaps\n",
-				c_brush_polys, c_alias_polys, c_visible_textures,
-				c_visible_lightmaps);
+		Com_Printf("%4i wpoly %4i wdraws %4i epoly %i tex %i lmaps\n",
+				c_brush_polys, c_brush_draws, c_alias_polys,
+				c_visible_textures, c_visible_lightmaps);
 	}
 
 #if 0 // TODO: stereo stuff
@@ -348,6 +348,7 @@ Mod_LoadFaces(gl3model_t *loadmodel, byte *mod_base, lump_t *l)
 		out->numedges = LittleShort(in->numedges);
 		out->flags = 0;
 		out->polys = NULL;
+		out->worldVert = -1;
 
 		planenum = LittleShort(in->planenum);
 		side = LittleShort(in->side);
@@ -763,6 +764,8 @@ GL3_BeginRegistration(const char *model)
 
 	gl3_worldmodel = Mod_ForName(fullname, NULL, true);
 
+	GL3_SurfBuildWorldVBO(gl3_worldmodel);
+
 	gl3_viewcluster = -1;
 }
 
@@ -117,7 +117,8 @@ DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei le
  */
 void GL3_EndFrame(void)
 {
-	if(gl3config.useBigVBO)
+	// (the persistently mapped one is synced with fences instead)
+	if(gl3config.useBigVBO && !gl3config.usePersistentVBO)
 	{
 		// I think this is a good point to orphan the VBO and get a fresh one
 		GL3_BindVAO(gl3state.vao3D);
@@ -416,8 +417,10 @@ int GL3_InitContext(void* win)
 
 #ifdef YQ2_GL3_GLES
 	gl3config.debug_output = GLAD_GL_KHR_debug != 0;
+	gl3config.buffer_storage = false;
 #else // Desktop GL
 	gl3config.debug_output = GLAD_GL_ARB_debug_output != 0;
+	gl3config.buffer_storage = GLAD_GL_ARB_buffer_storage != 0;
 #endif
 	gl3config.anisotropic = GLAD_GL_EXT_texture_filter_anisotropic != 0;
 
@@ -42,6 +42,48 @@ gl3lightmapstate_t gl3_lms;
 extern gl3image_t gl3textures[MAX_GL3TEXTURES];
 extern int numgl3textures;
 
+// assumes gl3state.vbo3D is bound
+static qboolean
+InitPersistentVBO(void)
+{
+#ifndef YQ2_GL3_GLES
+	// 4 segments of 2MB, each starting at a vertex
+	int segSize = (2*1024*1024 / sizeof(gl3_3D_vtx_t)) * sizeof(gl3_3D_vtx_t);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	gl3state.vbo3Dsize = segSize * GL3_VBO3D_SEGMENTS;
+	gl3state.vbo3DcurOffset = 0;
+	memset(gl3state.vbo3Dfences, 0, sizeof(gl3state.vbo3Dfences));
+
+	glBufferStorage(GL_ARRAY_BUFFER, gl3state.vbo3Dsize, NULL, flags);
+	gl3state.vbo3Dmapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, gl3state.vbo3Dsize, flags);
+
+	return gl3state.vbo3Dmapped != NULL;
+#else
+	return false;
+#endif
+}
+
+// attributes of gl3_3D_vtx_t for the bound VAO and VBO
+static void
+Setup3DVertexAttribs(void)
+{
+	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), 0);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, texCoord));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_LMTEXCOORD);
+	qglVertexAttribPointer(GL3_ATTRIB_LMTEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, lmTexCoord));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_NORMAL);
+	qglVertexAttribPointer(GL3_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, normal));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_LIGHTFLAGS);
+	qglVertexAttribIPointer(GL3_ATTRIB_LIGHTFLAGS, 1, GL_UNSIGNED_INT, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, lightFlags));
+}
+
 void GL3_SurfInit(void)
 {
 	// init the VAO and VBO for the standard vertexdata: 10 floats and 1 uint
@@ -53,27 +95,36 @@ void GL3_SurfInit(void)
 	glGenBuffers(1, &gl3state.vbo3D);
 	GL3_BindVBO(gl3state.vbo3D);
 
-	if(gl3config.useBigVBO)
+	if(gl3config.usePersistentVBO && !InitPersistentVBO())
+	{
+		Com_Printf("Couldn't map the 3D VBO persistently, falling back to the normal one\n");
+		gl3config.usePersistentVBO = false;
+
+		// the storage of the old one is immutable
+		glDeleteBuffers(1, &gl3state.vbo3D);
+		gl3state.currentVBO = 0;
+		glGenBuffers(1, &gl3state.vbo3D);
+		GL3_BindVBO(gl3state.vbo3D);
+	}
+
+	if(gl3config.useBigVBO && !gl3config.usePersistentVBO)
 	{
 		gl3state.vbo3Dsize = 5*1024*1024; // a 5MB buffer seems to work well?
 		gl3state.vbo3DcurOffset = 0;
 		glBufferData(GL_ARRAY_BUFFER, gl3state.vbo3Dsize, NULL, GL_STREAM_DRAW); // allocate/reserve that data
 	}
 
-	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
-	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), 0);
+	Setup3DVertexAttribs();
 
-	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
-	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, texCoord));
+	// the same for the world vertices, they're uploaded by GL3_SurfBuildWorldVBO()
 
-	glEnableVertexAttribArray(GL3_ATTRIB_LMTEXCOORD);
-	qglVertexAttribPointer(GL3_ATTRIB_LMTEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, lmTexCoord));
+	glGenVertexArrays(1, &gl3state.vaoWorld);
+	GL3_BindVAO(gl3state.vaoWorld);
 
-	glEnableVertexAttribArray(GL3_ATTRIB_NORMAL);
-	qglVertexAttribPointer(GL3_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, normal));
+	glGenBuffers(1, &gl3state.vboWorld);
+	GL3_BindVBO(gl3state.vboWorld);
 
-	glEnableVertexAttribArray(GL3_ATTRIB_LIGHTFLAGS);
-	qglVertexAttribIPointer(GL3_ATTRIB_LIGHTFLAGS, 1, GL_UNSIGNED_INT, sizeof(gl3_3D_vtx_t), offsetof(gl3_3D_vtx_t, lightFlags));
+	Setup3DVertexAttribs();
 
 
 
@@ -119,11 +170,36 @@ void GL3_SurfInit(void)
 
 void GL3_SurfShutdown(void)
 {
+#ifndef YQ2_GL3_GLES
+	int i;
+
+	if(gl3state.vbo3Dmapped != NULL)
+	{
+		GL3_BindVBO(gl3state.vbo3D);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		gl3state.vbo3Dmapped = NULL;
+	}
+
+	for(i=0; i<GL3_VBO3D_SEGMENTS; ++i)
+	{
+		if(gl3state.vbo3Dfences[i] != NULL)
+		{
+			glDeleteSync(gl3state.vbo3Dfences[i]);
+			gl3state.vbo3Dfences[i] = NULL;
+		}
+	}
+#endif
+
 	glDeleteBuffers(1, &gl3state.vbo3D);
 	gl3state.vbo3D = 0;
 	glDeleteVertexArrays(1, &gl3state.vao3D);
 	gl3state.vao3D = 0;
 
+	glDeleteBuffers(1, &gl3state.vboWorld);
+	gl3state.vboWorld = 0;
+	glDeleteVertexArrays(1, &gl3state.vaoWorld);
+	gl3state.vaoWorld = 0;
+
 	glDeleteBuffers(1, &gl3state.eboAlias);
 	gl3state.eboAlias = 0;
 	glDeleteBuffers(1, &gl3state.vboAlias);
@@ -132,6 +208,93 @@ void GL3_SurfShutdown(void)
 	gl3state.vaoAlias = 0;
 }
 
+/*
+ * Puts the vertices of all world surfaces that can be batched
+ * into vboWorld, so they don't have to be uploaded every frame.
+ * Scrolling, warped, sky and translucent surfaces aren't in it,
+ * neither are the inline models.
+ */
+void
+GL3_SurfBuildWorldVBO(gl3model_t *mod)
+{
+	int i, first, last, numVerts;
+	msurface_t *surf;
+	gl3_3D_vtx_t *verts;
+
+	if (mod->numsubmodels < 1)
+	{
+		return;
+	}
+
+	first = mod->submodels[0].firstmodelsurface;
+	last = first + mod->submodels[0].nummodelsurfaces;
+
+	if (first < 0 || last > mod->numsurfaces)
+	{
+		return;
+	}
+
+	numVerts = 0;
+
+	for (i = first, surf = mod->surfaces + first; i < last; i++, surf++)
+	{
+		surf->worldVert = -1;
+
+		if (!surf->polys || (surf->texinfo->flags &
+		     (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP | SURF_FLOWING)))
+		{
+			continue;
+		}
+
+		surf->worldVert = numVerts;
+		numVerts += surf->polys->numverts;
+	}
+
+	GL3_BindVAO(gl3state.vaoWorld);
+	GL3_BindVBO(gl3state.vboWorld);
+
+	if (numVerts == 0)
+	{
+		glBufferData(GL_ARRAY_BUFFER, 0, NULL, GL_STATIC_DRAW);
+		return;
+	}
+
+	verts = malloc(numVerts * sizeof(gl3_3D_vtx_t));
+
+	if (!verts)
+	{
+		Com_Printf("%s: couldn't allocate %d vertices, not using a world VBO\n", __func__, numVerts);
+
+		for (i = first; i < last; i++)
+		{
+			mod->surfaces[i].worldVert = -1;
+		}
+
+		return;
+	}
+
+	for (i = first, surf = mod->surfaces + first; i < last; i++, surf++)
+	{
+		if (surf->worldVert >= 0)
+		{
+			// no dynamic lights, surfaces that have some are streamed instead
+			memcpy(verts + surf->worldVert, surf->polys->vertices, surf->polys->numverts * sizeof(gl3_3D_vtx_t));
+
+			for (int j = 0; j < surf->polys->numverts; ++j)
+			{
+				verts[surf->worldVert + j].lightFlags = 0;
+			}
+		}
+	}
+
+	glBufferData(GL_ARRAY_BUFFER, numVerts * sizeof(gl3_3D_vtx_t), verts, GL_STATIC_DRAW);
+
+	free(verts);
+
+	R_Printf(PRINT_DEVELOPER, "World VBO: %d vertices, %d KB\n", numVerts,
+	         (int)(numVerts * sizeof(gl3_3D_vtx_t) / 1024));
+}
+
 static void
 SetLightFlags(msurface_t *surf)
 {
@@ -175,14 +338,11 @@ GL3_DrawGLPoly(msurface_t *fa)
 	GL3_BufferAndDraw3D(p->vertices, p->numverts, GL_TRIANGLE_FAN);
 }
 
-void
-GL3_DrawGLFlowingPoly(msurface_t *fa)
+static void
+UpdateFlowingScroll(void)
 {
-	glpoly_t *p;
 	float scroll;
 
-	p = fa->polys;
-
 	scroll = -64.0f * ((r_newrefdef.time / 40.0f) - (int)(r_newrefdef.time / 40.0f));
 
 	if (scroll == 0.0f)
@@ -195,6 +355,16 @@ GL3_DrawGLFlowingPoly(msurface_t *fa)
 		gl3state.uni3DData.scroll = scroll;
 		GL3_UpdateUBO3D();
 	}
+}
+
+void
+GL3_DrawGLFlowingPoly(msurface_t *fa)
+{
+	glpoly_t *p;
+
+	p = fa->polys;
+
+	UpdateFlowingScroll();
 
 	GL3_BindVAO(gl3state.vao3D);
 	GL3_BindVBO(gl3state.vbo3D);
@@ -288,6 +458,137 @@ UpdateLMscales(const hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE], gl3ShaderInfo
 	}
 }
 
+/*
+ * Opaque world and brush model polys with the same texture, lightmap,
+ * shader and lightstyles are collected here and drawn together with
+ * one upload and one glMultiDrawArrays() call. Polys that are in the
+ * world VBO and have no dynamic lights aren't uploaded at all, just
+ * their vertex ranges in it are collected.
+ */
+enum { MAX_BATCH_VERTS = 4096, MAX_BATCH_POLYS = 1024 };
+
+static struct
+{
+	GLuint texnum;
+	int lightmap;
+	gl3ShaderInfo_t* si;
+	hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE];
+
+	int numVerts;
+	int numPolys;
+	GLint firsts[MAX_BATCH_POLYS];
+	GLsizei counts[MAX_BATCH_POLYS];
+	gl3_3D_vtx_t verts[MAX_BATCH_VERTS];
+
+	int numWorldPolys;
+	GLint worldFirsts[MAX_BATCH_POLYS];
+	GLsizei worldCounts[MAX_BATCH_POLYS];
+} polyBatch;
+
+static void
+DrawBatchRanges(const GLint* firsts, const GLsizei* counts, int numPolys)
+{
+#ifdef YQ2_GL3_GLES
+	// no glMultiDrawArrays() in GLES3
+	for(int i=0; i<numPolys; ++i)
+	{
+		glDrawArrays(GL_TRIANGLE_FAN, firsts[i], counts[i]);
+	}
+	c_brush_draws += numPolys;
+#else
+	glMultiDrawArrays(GL_TRIANGLE_FAN, firsts, counts, numPolys);
+	c_brush_draws++;
+#endif
+}
+
+// must be called before any state the batched polys use is changed
+static void
+FlushPolyBatch(void)
+{
+	int i, first;
+
+	if(polyBatch.numWorldPolys > 0)
+	{
+		GL3_BindVAO(gl3state.vaoWorld);
+		DrawBatchRanges(polyBatch.worldFirsts, polyBatch.worldCounts, polyBatch.numWorldPolys);
+		polyBatch.numWorldPolys = 0;
+	}
+
+	if(polyBatch.numPolys == 0)
+	{
+		return;
+	}
+
+	GL3_BindVAO(gl3state.vao3D);
+	GL3_BindVBO(gl3state.vbo3D);
+
+	first = GL3_Upload3D(polyBatch.verts, polyBatch.numVerts);
+
+	for(i=0; i<polyBatch.numPolys; ++i)
+	{
+		polyBatch.firsts[i] += first;
+	}
+
+	DrawBatchRanges(polyBatch.firsts, polyBatch.counts, polyBatch.numPolys);
+
+	polyBatch.numVerts = 0;
+	polyBatch.numPolys = 0;
+}
+
+static void
+BatchLightmappedPoly(msurface_t *surf, gl3image_t *image, gl3ShaderInfo_t* si,
+                     const hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE])
+{
+	glpoly_t *p = surf->polys;
+
+	// SetLightFlags() didn't put any lights on it, so the world VBO has the right vertices
+	qboolean inWorldVBO = surf->worldVert >= 0 && surf->dlightframe != gl3_framecount;
+
+	if(polyBatch.numPolys + polyBatch.numWorldPolys > 0
+	   && (   polyBatch.texnum != image->texnum
+	       || polyBatch.lightmap != surf->lightmaptexturenum
+	       || polyBatch.si != si
+	       || memcmp(polyBatch.lmScales, lmScales, sizeof(polyBatch.lmScales)) != 0
+	       || (inWorldVBO && polyBatch.numWorldPolys == MAX_BATCH_POLYS)
+	       || (!inWorldVBO && (polyBatch.numPolys == MAX_BATCH_POLYS
+	                           || polyBatch.numVerts + p->numverts > MAX_BATCH_VERTS))))
+	{
+		FlushPolyBatch();
+	}
+
+	if(polyBatch.numPolys + polyBatch.numWorldPolys == 0)
+	{
+		polyBatch.texnum = image->texnum;
+		polyBatch.lightmap = surf->lightmaptexturenum;
+		polyBatch.si = si;
+		memcpy(polyBatch.lmScales, lmScales, sizeof(polyBatch.lmScales));
+
+		GL3_Bind(image->texnum);
+		GL3_BindLightmap(surf->lightmaptexturenum);
+		GL3_UseProgram(si->shaderProgram);
+		UpdateLMscales(lmScales, si);
+
+		if(si == &gl3state.si3DlmFlow)
+		{
+			UpdateFlowingScroll();
+		}
+	}
+
+	if(inWorldVBO)
+	{
+		polyBatch.worldFirsts[polyBatch.numWorldPolys] = surf->worldVert;
+		polyBatch.worldCounts[polyBatch.numWorldPolys] = p->numverts;
+		polyBatch.numWorldPolys++;
+		return;
+	}
+
+	memcpy(polyBatch.verts + polyBatch.numVerts, p->vertices, p->numverts*sizeof(gl3_3D_vtx_t));
+	polyBatch.firsts[polyBatch.numPolys] = polyBatch.numVerts;
+	polyBatch.counts[polyBatch.numPolys] = p->numverts;
+	polyBatch.numVerts += p->numverts;
+	polyBatch.numPolys++;
+}
+
 static void
 RenderBrushPoly(entity_t *currententity, msurface_t *fa)
 {
@@ -300,22 +601,18 @@ RenderBrushPoly(entity_t *currententity, msurface_t *fa)
 
 	if (fa->flags & SURF_DRAWTURB)
 	{
+		FlushPolyBatch();
+
 		GL3_Bind(image->texnum);
 
 		GL3_EmitWaterPolys(fa);
 
 		return;
 	}
-	else
-	{
-		GL3_Bind(image->texnum);
-	}
 
 	hmm_vec4 lmScales[MAX_LIGHTMAPS_PER_SURFACE] = {0};
 	lmScales[0] = HMM_Vec4(1.0f, 1.0f, 1.0f, 1.0f);
 
-	GL3_BindLightmap(fa->lightmaptexturenum);
-
 	// Any dynamic lights on this surface?
 	for (map = 0; map < MAX_LIGHTMAPS_PER_SURFACE && fa->styles[map] != 255; map++)
 	{
@@ -327,15 +624,11 @@ RenderBrushPoly(entity_t *currententity, msurface_t *fa)
 
 	if (fa->texinfo->flags & SURF_FLOWING)
 	{
-		GL3_UseProgram(gl3state.si3DlmFlow.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3DlmFlow);
-		GL3_DrawGLFlowingPoly(fa);
+		BatchLightmappedPoly(fa, image, &gl3state.si3DlmFlow, lmScales);
 	}
 	else
 	{
-		GL3_UseProgram(gl3state.si3Dlm.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3Dlm);
-		GL3_DrawGLPoly(fa);
+		BatchLightmappedPoly(fa, image, &gl3state.si3Dlm, lmScales);
 	}
 
 	// Note: lightmap chains are gone, lightmaps are rendered together with normal texture in one pass
@@ -403,9 +696,10 @@ GL3_DrawAlphaSurfaces(void)
 static void
 DrawTextureChains(entity_t *currententity)
 {
-	int i;
+	int i, lm;
 	msurface_t *s;
 	gl3image_t *image;
+	msurface_t *lightmapChains[MAX_LIGHTMAPS];
 
 	c_visible_textures = 0;
 
@@ -425,15 +719,39 @@ DrawTextureChains(entity_t *currententity)
 
 		c_visible_textures++;
 
+		// sort by lightmap so the polys can be batched,
+		// water has no lightmap and is drawn right away
+		memset(lightmapChains, 0, sizeof(lightmapChains));
+
 		for ( ; s; s = s->texturechain)
 		{
-			SetLightFlags(s);
-			RenderBrushPoly(currententity, s);
+			lm = s->lightmaptexturenum;
+
+			if ((s->flags & SURF_DRAWTURB) || lm < 0 || lm >= MAX_LIGHTMAPS)
+			{
+				SetLightFlags(s);
+				RenderBrushPoly(currententity, s);
+				continue;
+			}
+
+			s->lightmapchain = lightmapChains[lm];
+			lightmapChains[lm] = s;
+		}
+
+		for (lm = 0; lm < MAX_LIGHTMAPS; lm++)
+		{
+			for (s = lightmapChains[lm]; s; s = s->lightmapchain)
+			{
+				SetLightFlags(s);
+				RenderBrushPoly(currententity, s);
+			}
 		}
 
 		image->texturechain = NULL;
 	}
 
+	FlushPolyBatch();
+
 	// TODO: maybe one loop for normal faces and one for SURF_DRAWTURB ???
 }
 
@@ -460,20 +778,13 @@ RenderLightmappedPoly(entity_t *currententity, msurface_t *surf)
 
 	c_brush_polys++;
 
-	GL3_Bind(image->texnum);
-	GL3_BindLightmap(surf->lightmaptexturenum);
-
 	if (surf->texinfo->flags & SURF_FLOWING)
 	{
-		GL3_UseProgram(gl3state.si3DlmFlow.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3DlmFlow);
-		GL3_DrawGLFlowingPoly(surf);
+		BatchLightmappedPoly(surf, image, &gl3state.si3DlmFlow, lmScales);
 	}
 	else
 	{
-		GL3_UseProgram(gl3state.si3Dlm.shaderProgram);
-		UpdateLMscales(lmScales, &gl3state.si3Dlm);
-		GL3_DrawGLPoly(surf);
+		BatchLightmappedPoly(surf, image, &gl3state.si3Dlm, lmScales);
 	}
 }
 
@@ -536,6 +847,8 @@ DrawInlineBModel(entity_t *currententity, gl3model_t *currentmodel)
 		}
 	}
 
+	FlushPolyBatch();
+
 	if (currententity->flags & RF_TRANSLUCENT)
 	{
 		glDisable(GL_BLEND);
@@ -118,9 +118,11 @@ typedef struct
 
 	qboolean anisotropic; // is GL_EXT_texture_filter_anisotropic supported?
 	qboolean debug_output; // is GL_ARB_debug_output supported?
+	qboolean buffer_storage; // is GL_ARB_buffer_storage supported?
 	qboolean stencil; // Do we have a stencil buffer?
 
 	qboolean useBigVBO; // workaround for AMDs windows driver for fewer calls to glBufferData()
+	qboolean usePersistentVBO; // vbo3D is a persistently mapped ring buffer, see GL3_Upload3D()
 
 	// ----
 
@@ -195,6 +197,8 @@ enum {
 	MAX_LIGHTMAPS_PER_SURFACE = MAXLIGHTMAPS // 4
 };
 
+enum { GL3_VBO3D_SEGMENTS = 4 };
+
 typedef struct
 {
 	// TODO: what of this do we need?
@@ -252,10 +256,19 @@ typedef struct
 
 	GLuint vao3D, vbo3D; // for brushes etc, using 10 floats and one uint as vertex input (x,y,z, s,t, lms,lmt, normX,normY,normZ ; lightFlags)
 
-	// the next two are for gl3config.useBigVBO == true
+	// the next two are for gl3config.useBigVBO or gl3config.usePersistentVBO == true
 	int vbo3Dsize;
 	int vbo3DcurOffset;
 
+	// for gl3config.usePersistentVBO == true: vbo3D is split into
+	// GL3_VBO3D_SEGMENTS parts, each with a fence for when the GPU is done with it
+	byte* vbo3Dmapped;
+	GLsync vbo3Dfences[GL3_VBO3D_SEGMENTS];
+
+	// static vertices of the world surfaces that are drawn with a lightmap and
+	// don't scroll, uploaded once per map by GL3_SurfBuildWorldVBO(), same layout as vbo3D
+	GLuint vaoWorld, vboWorld;
+
 	GLuint vaoAlias, vboAlias, eboAlias; // for models, using 9 floats as (x,y,z, s,t, r,g,b,a)
 	GLuint vaoParticle, vboParticle; // for particles, using 9 floats (x,y,z, size,distance, r,g,b,a)
 
@@ -282,6 +295,7 @@ extern int gl3_framecount; /* used for dlight push checking */
 extern int gl3_viewcluster, gl3_viewcluster2, gl3_oldviewcluster, gl3_oldviewcluster2;
 
 extern int c_brush_polys, c_alias_polys;
+extern int c_brush_draws;
 
 extern qboolean IsHighDPIaware;
 
@@ -378,6 +392,7 @@ GL3_BindEBO(GLuint ebo)
 	}
 }
 
+extern int GL3_Upload3D(const gl3_3D_vtx_t* verts, int numVerts);
 extern void GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum drawMode);
 
 extern void GL3_RotateForEntity(entity_t *e);
@@ -480,6 +495,7 @@ extern void GL3_AddSkySurface(msurface_t *fa);
 // gl3_surf.c
 extern void GL3_SurfInit(void);
 extern void GL3_SurfShutdown(void);
+extern void GL3_SurfBuildWorldVBO(gl3model_t *mod);
 extern void GL3_DrawGLPoly(msurface_t *fa);
 extern void GL3_DrawGLFlowingPoly(msurface_t *fa);
 extern void GL3_DrawTriangleOutlines(void);
@@ -554,5 +570,6 @@ extern cvar_t *r_palettedtexture;
 extern cvar_t *r_validation;
 
 extern cvar_t *gl3_debugcontext;
+extern cvar_t *gl3_usepersistentvbo;
 
 #endif /* SRC_CLIENT_REFRESH_GL3_HEADER_LOCAL_H_ */
@@ -72,8 +72,9 @@ typedef struct msurface_s
 	int dlight_s, dlight_t;         /* gl lightmap coordinates for dynamic lightmaps */
 
 	glpoly_t *polys;                /* multiple if warped */
+	int worldVert;                  /* first vertex in gl3state.vboWorld, -1 if not in there */
 	struct  msurface_s *texturechain;
-	// struct  msurface_s *lightmapchain; not used/needed anymore
+	struct  msurface_s *lightmapchain; /* sorts a texture chain by lightmap */
 
 	mtexinfo_t *texinfo;
 
@@ -32,10 +32,12 @@
 
 #define MAX_ALIAS_NAME 32
 #define ALIAS_LOOP_COUNT 16
+#define CMD_HASH_SIZE 256 /* power of two */
 
 typedef struct cmd_function_s
 {
 	struct cmd_function_s *next;
+	struct cmd_function_s *hashnext;
 	const char *name;
 	xcommand_t function;
 } cmd_function_t;
@@ -45,10 +47,18 @@ static cmd_function_t *cmd_functions; /* possible commands to execute */
 typedef struct cmdalias_s
 {
 	struct cmdalias_s *next;
+	struct cmdalias_s *hashnext;
 	char name[MAX_ALIAS_NAME];
 	char *value;
 } cmdalias_t;
 
+/* The lists above stay sorted (commands) and newest first (aliases)
+   for listing and completion, lookups go through these. The hash
+   ignores case and each chain keeps the order of its list, so a
+   case insensitive lookup finds the same entry as a list walk. */
+static cmd_function_t *cmd_hash[CMD_HASH_SIZE];
+static cmdalias_t *alias_hash[CMD_HASH_SIZE];
+
 char retval[256];
 int alias_count; /* for detecting runaway loops */
 cmdalias_t *cmd_alias;
@@ -58,6 +68,60 @@ static char *cmd_argv[MAX_STRING_TOKENS];
 static char *cmd_null_string = "";
 static char cmd_args[MAX_STRING_CHARS];
 sizebuf_t cmd_text;
+
+/*
+ * Case insensitive FNV-1a, shared with the cvar code
+ */
+unsigned
+Cmd_HashName(const char *name)
+{
+	unsigned hash = 2166136261u;
+
+	for ( ; *name; name++)
+	{
+		hash ^= (unsigned char)tolower((unsigned char)*name);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static cmd_function_t *
+Cmd_FindCommand(const char *cmd_name, qboolean nocase)
+{
+	cmd_function_t *cmd;
+
+	cmd = cmd_hash[Cmd_HashName(cmd_name) & (CMD_HASH_SIZE - 1)];
+
+	for ( ; cmd; cmd = cmd->hashnext)
+	{
+		if (nocase ? !Q_strcasecmp(cmd_name, cmd->name) :
+				!strcmp(cmd_name, cmd->name))
+		{
+			return cmd;
+		}
+	}
+
+	return NULL;
+}
+
+static cmdalias_t *
+Cmd_FindAlias(const char *name, qboolean nocase)
+{
+	cmdalias_t *a;
+
+	a = alias_hash[Cmd_HashName(name) & (CMD_HASH_SIZE - 1)];
+
+	for ( ; a; a = a->hashnext)
+	{
+		if (nocase ? !Q_strcasecmp(name, a->name) : !strcmp(name, a->name))
+		{
+			return a;
+		}
+	}
+
+	return NULL;
+}
 byte cmd_text_buf[32768];
 char defer_text_buf[32768];
 
@@ -396,6 +460,81 @@ Cmd_Exec_f(void)
 	FS_FreeFile(f);
 }
 
+/*
+ * execbench <filename> [count]
+ *
+ * Times count execs of a config, which mostly measures the
+ * command, alias and cvar lookups. Works on the command line
+ * as well, e.g. +execbench yq2.cfg 100
+ */
+static void
+Cmd_ExecBench_f(void)
+{
+	char name[MAX_QPATH];
+	char *f, *f2, *saved;
+	long long start, total;
+	int len, savedsize;
+	int count, lines, i;
+
+	if ((Cmd_Argc() < 2) || (Cmd_Argc() > 3))
+	{
+		Com_Printf("execbench <filename> [count]\n");
+		return;
+	}
+
+	/* the execs below overwrite Cmd_Argv() */
+	Q_strlcpy(name, Cmd_Argv(1), sizeof(name));
+	count = (Cmd_Argc() == 3) ? (int)strtol(Cmd_Argv(2), NULL, 10) : 10;
+	count = (count < 1) ? 1 : count;
+
+	len = FS_LoadFile(name, (void **)&f);
+
+	if (!f)
+	{
+		Com_Printf("couldn't exec %s\n", name);
+		return;
+	}
+
+	f2 = Z_Malloc(len + 2);
+	memcpy(f2, f, len);
+	f2[len] = '\n';
+	f2[len+1] = '\0';
+	FS_FreeFile(f);
+
+	for (i = 0, lines = 0; i < len; i++)
+	{
+		lines += (f2[i] == '\n');
+	}
+
+	/* keep whatever follows us in the buffer out of the timing */
+	savedsize = cmd_text.cursize;
+	saved = Z_Malloc(savedsize + 1);
+	memcpy(saved, cmd_text.data, savedsize);
+	SZ_Clear(&cmd_text);
+
+	total = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		start = Sys_Microseconds();
+
+		Cbuf_InsertText(f2);
+		Cbuf_Execute();
+
+		total += Sys_Microseconds() - start;
+	}
+
+	SZ_Clear(&cmd_text);
+	SZ_Write(&cmd_text, saved, savedsize);
+
+	Com_Printf("execbench: %i x %s (%i lines), %.3f ms per exec, %.3f us per line\n",
+			count, name, lines, total / 1000.0 / count,
+			lines ? (double)total / count / lines : 0.0);
+
+	Z_Free(saved);
+	Z_Free(f2);
+}
+
 /*
  * Inserts the current value of a variable as command text
  */
@@ -462,20 +601,23 @@ Cmd_Alias_f(void)
 	}
 
 	/* if the alias already exists, reuse it */
-	for (a = cmd_alias; a; a = a->next)
+	a = Cmd_FindAlias(s, false);
+
+	if (a)
 	{
-		if (!strcmp(s, a->name))
-		{
-			Z_Free(a->value);
-			break;
-		}
+		Z_Free(a->value);
 	}
-
-	if (!a)
+	else
 	{
+		cmdalias_t **chain;
+
 		a = Z_Malloc(sizeof(cmdalias_t));
 		a->next = cmd_alias;
 		cmd_alias = a;
+
+		chain = &alias_hash[Cmd_HashName(s) & (CMD_HASH_SIZE - 1)];
+		a->hashnext = *chain;
+		*chain = a;
 	}
 
 	strcpy(a->name, s);
@@ -717,13 +859,10 @@ Cmd_AddCommand(const char *cmd_name, xcommand_t function)
 	}
 
 	/* fail if the command already exists */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if (Cmd_FindCommand(cmd_name, false))
 	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Com_Printf("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = Z_Malloc(sizeof(cmd_function_t));
@@ -738,6 +877,15 @@ Cmd_AddCommand(const char *cmd_name, xcommand_t function)
 	}
 	cmd->next = *pos;
 	*pos = cmd;
+
+	/* and into its hash chain, in the same order */
+	pos = &cmd_hash[Cmd_HashName(cmd_name) & (CMD_HASH_SIZE - 1)];
+	while (*pos && strcmp((*pos)->name, cmd->name) < 0)
+	{
+		pos = &(*pos)->hashnext;
+	}
+	cmd->hashnext = *pos;
+	*pos = cmd;
 }
 
 void
@@ -760,6 +908,14 @@ Cmd_RemoveCommand(const char *cmd_name)
 		if (!strcmp(cmd_name, cmd->name))
 		{
 			*back = cmd->next;
+
+			back = &cmd_hash[Cmd_HashName(cmd_name) & (CMD_HASH_SIZE - 1)];
+			while (*back != cmd)
+			{
+				back = &(*back)->hashnext;
+			}
+			*back = cmd->hashnext;
+
 			Z_Free(cmd);
 			return;
 		}
@@ -771,17 +927,7 @@ Cmd_RemoveCommand(const char *cmd_name)
 qboolean
 Cmd_Exists(const char *cmd_name)
 {
-	cmd_function_t *cmd;
-
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
-	{
-		if (!strcmp(cmd_name, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	return Cmd_FindCommand(cmd_name, false) != NULL;
 }
 
 const char *
@@ -1038,25 +1184,12 @@ Cmd_CompleteMapCommand(const char *partial)
 qboolean
 Cmd_IsComplete(const char *command)
 {
-	cmd_function_t *cmd;
-	cmdalias_t *a;
 	cvar_t *cvar;
 
 	/* check for exact match */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if (Cmd_FindCommand(command, false) || Cmd_FindAlias(command, false))
 	{
-		if (!strcmp(command, cmd->name))
-		{
-			return true;
-		}
-	}
-
-	for (a = cmd_alias; a; a = a->next)
-	{
-		if (!strcmp(command, a->name))
-		{
-			return true;
-		}
+		return true;
 	}
 
 	for (cvar = cvar_vars; cvar; cvar = cvar->next)
@@ -1097,38 +1230,32 @@ Cmd_ExecuteString(char *text)
 	}
 
 	/* check functions */
-	for (cmd = cmd_functions; cmd; cmd = cmd->next)
+	if ((cmd = Cmd_FindCommand(cmd_argv[0], true)) != NULL)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], cmd->name))
+		if (!cmd->function)
 		{
-			if (!cmd->function)
-			{
-				/* forward to server command */
-				Cmd_ExecuteString(va("cmd %s", text));
-			}
-			else
-			{
-				cmd->function();
-			}
-
-			return;
+			/* forward to server command */
+			Cmd_ExecuteString(va("cmd %s", text));
 		}
+		else
+		{
+			cmd->function();
+		}
+
+		return;
 	}
 
 	/* check alias */
-	for (a = cmd_alias; a; a = a->next)
+	if ((a = Cmd_FindAlias(cmd_argv[0], true)) != NULL)
 	{
-		if (!Q_strcasecmp(cmd_argv[0], a->name))
+		if (++alias_count == ALIAS_LOOP_COUNT)
 		{
-			if (++alias_count == ALIAS_LOOP_COUNT)
-			{
-				Com_Printf("ALIAS_LOOP_COUNT\n");
-				return;
-			}
-
-			Cbuf_InsertText(a->value);
+			Com_Printf("ALIAS_LOOP_COUNT\n");
 			return;
 		}
+
+		Cbuf_InsertText(a->value);
+		return;
 	}
 
 	/* check cvars */
@@ -1165,6 +1292,7 @@ Cmd_Init(void)
 	/* register our commands */
 	Cmd_AddCommand("cmdlist", Cmd_List_f);
 	Cmd_AddCommand("exec", Cmd_Exec_f);
+	Cmd_AddCommand("execbench", Cmd_ExecBench_f);
 	Cmd_AddCommand("vstr", Cmd_Vstr_f);
 	Cmd_AddCommand("echo", Cmd_Echo_f);
 	Cmd_AddCommand("alias", Cmd_Alias_f);
@@ -1183,4 +1311,6 @@ Cmd_Shutdown(void)
 		Z_Free(cmd_alias);
 		cmd_alias = next;
 	}
+
+	memset(alias_hash, 0, sizeof(alias_hash));
 }
@@ -90,10 +90,6 @@ static int box_headnode;
 static int checkcount;
 static int emptyleaf, solidleaf;
 static int floodvalid;
-static float *leaf_mins, *leaf_maxs;
-static int leaf_count, leaf_maxcount;
-static int *leaf_list;
-static int leaf_topnode;
 static int numareaportals;
 static int numareas = 1;
 static int numbrushes;
@@ -254,12 +250,12 @@ CM_WriteAreaBits(byte *buffer, int area)
 }
 
 /*
- * Writes the portal state to a savegame file
+ * Appends the portal state to a savegame
  */
 void
-CM_WritePortalState(FILE *f)
+CM_WritePortalState(sizebuf_t *msg)
 {
-	fwrite(portalopen, sizeof(portalopen), 1, f);
+	SZ_Write(msg, portalopen, sizeof(portalopen));
 }
 
 /*
@@ -464,11 +460,21 @@ CM_PointLeafnum(vec3_t p)
 	return CM_PointLeafnum_r(p, 0);
 }
 
+/* state of a single CM_BoxLeafnums() query, kept off
+   the globals so the server can run it from workers */
+typedef struct
+{
+	const float *mins, *maxs;
+	int *list;
+	int count, maxcount;
+	int topnode;
+} leafquery_t;
+
 /*
  * Fills in a list of all the leafs touched
  */
 static void
-CM_BoxLeafnums_r(int nodenum)
+CM_BoxLeafnums_r(leafquery_t *q, int nodenum)
 {
 	while (1)
 	{
@@ -478,18 +484,18 @@ CM_BoxLeafnums_r(int nodenum)
 
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (q->count >= q->maxcount)
 			{
 				return;
 			}
 
-			leaf_list[leaf_count++] = -1 - nodenum;
+			q->list[q->count++] = -1 - nodenum;
 			return;
 		}
 
 		node = &map_nodes[nodenum];
 		plane = node->plane;
-		s = BOX_ON_PLANE_SIDE(leaf_mins, leaf_maxs, plane);
+		s = BOX_ON_PLANE_SIDE(q->mins, q->maxs, plane);
 
 		if (s == 1)
 		{
@@ -504,12 +510,12 @@ CM_BoxLeafnums_r(int nodenum)
 		else
 		{
 			/* go down both */
-			if (leaf_topnode == -1)
+			if (q->topnode == -1)
 			{
-				leaf_topnode = nodenum;
+				q->topnode = nodenum;
 			}
 
-			CM_BoxLeafnums_r(node->children[0]);
+			CM_BoxLeafnums_r(q, node->children[0]);
 			nodenum = node->children[1];
 		}
 	}
@@ -519,22 +525,24 @@ static int
 CM_BoxLeafnums_headnode(vec3_t mins, vec3_t maxs, int *list,
 		int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	leafquery_t q;
 
-	leaf_topnode = -1;
+	q.list = list;
+	q.count = 0;
+	q.maxcount = listsize;
+	q.mins = mins;
+	q.maxs = maxs;
 
-	CM_BoxLeafnums_r(headnode);
+	q.topnode = -1;
+
+	CM_BoxLeafnums_r(&q, headnode);
 
 	if (topnode)
 	{
-		*topnode = leaf_topnode;
+		*topnode = q.topnode;
 	}
 
-	return leaf_count;
+	return q.count;
 }
 
 int
@@ -1114,6 +1122,197 @@ CM_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_
 	return trace_trace;
 }
 
+/*
+ * Starts the shared part of a trace: fresh
+ * result and brush check counter, endpoints.
+ */
+static void
+CM_BeginBatchRay(const vec3_t start, const vec3_t end, const trace_t *trace)
+{
+	checkcount++;
+	trace_trace = *trace;
+	VectorCopy(start, trace_start);
+	VectorCopy(end, trace_end);
+}
+
+/*
+ * Walks the rays of a batch down the tree together. As all
+ * rays share the start point, at every node they are either
+ * on the side of the start point or cross the plane. Rays
+ * that cross are split off and finished one by one with
+ * CM_RecursiveHullCheck() from that node on, the rest move
+ * down as a group. Rays still together at a leaf lie entirely
+ * inside it.
+ */
+static void
+CM_RecursiveHullCheckBatch(int num, const vec3_t start, const vec3_t *ends,
+		trace_t *traces, int *rays, int numrays)
+{
+	cnode_t *node;
+	cplane_t *plane;
+	float t1, t2, offset;
+	int i, r, kept;
+
+	while (numrays)
+	{
+		if (num < 0)
+		{
+			for (i = 0; i < numrays; i++)
+			{
+				r = rays[i];
+
+				CM_BeginBatchRay(start, ends[r], &traces[r]);
+				CM_TraceToLeaf(-1 - num);
+				traces[r] = trace_trace;
+			}
+
+			return;
+		}
+
+		node = map_nodes + num;
+		plane = node->plane;
+
+		if (plane->type < 3)
+		{
+			t1 = start[plane->type] - plane->dist;
+			offset = trace_extents[plane->type];
+		}
+		else
+		{
+			t1 = DotProduct(plane->normal, start) - plane->dist;
+
+			if (trace_ispoint)
+			{
+				offset = 0;
+			}
+			else
+			{
+				offset = (float)fabs(trace_extents[0] * plane->normal[0]) +
+						 (float)fabs(trace_extents[1] * plane->normal[1]) +
+						 (float)fabs(trace_extents[2] * plane->normal[2]);
+			}
+		}
+
+		kept = 0;
+
+		for (i = 0; i < numrays; i++)
+		{
+			r = rays[i];
+
+			if (plane->type < 3)
+			{
+				t2 = ends[r][plane->type] - plane->dist;
+			}
+			else
+			{
+				t2 = DotProduct(plane->normal, ends[r]) - plane->dist;
+			}
+
+			if (((t1 >= offset) && (t2 >= offset)) ||
+				((t1 < -offset) && (t2 < -offset)))
+			{
+				rays[kept++] = r;
+				continue;
+			}
+
+			/* crosses the plane, finish this one alone */
+			CM_BeginBatchRay(start, ends[r], &traces[r]);
+			CM_RecursiveHullCheck(num, 0, 1, start, ends[r]);
+			traces[r] = trace_trace;
+		}
+
+		numrays = kept;
+		num = (t1 >= offset) ? node->children[0] : node->children[1];
+	}
+}
+
+/*
+ * Like CM_BoxTrace(), but for several sweeps of the same
+ * box from one start point, e.g. the pellets of a shotgun.
+ * The node walk is shared as long as the rays stay on the
+ * same side of the planes. Results are identical to calling
+ * CM_BoxTrace() for each end point.
+ */
+void
+CM_BoxTraceBatch(const vec3_t start, const vec3_t *ends, int count,
+		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask,
+		trace_t *traces)
+{
+	int rays[CM_MAX_TRACE_BATCH];
+	int i, j, numrays;
+
+	if (count > CM_MAX_TRACE_BATCH)
+	{
+		CM_BoxTraceBatch(start, ends + CM_MAX_TRACE_BATCH,
+				count - CM_MAX_TRACE_BATCH, mins, maxs, headnode,
+				brushmask, traces + CM_MAX_TRACE_BATCH);
+		count = CM_MAX_TRACE_BATCH;
+	}
+
+	numrays = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		/* position tests don't sweep, let CM_BoxTrace() do them */
+		if (!numnodes || VectorCompare(start, ends[i]))
+		{
+			traces[i] = CM_BoxTrace(start, ends[i], mins, maxs,
+					headnode, brushmask);
+			continue;
+		}
+
+#ifndef DEDICATED_ONLY
+		c_traces++; /* for statistics, may be zeroed */
+#endif
+
+		memset(&traces[i], 0, sizeof(traces[i]));
+		traces[i].fraction = 1;
+		traces[i].surface = &(nullsurface.c);
+		rays[numrays++] = i;
+	}
+
+	if (!numrays)
+	{
+		return;
+	}
+
+	trace_contents = brushmask;
+	VectorCopy(mins, trace_mins);
+	VectorCopy(maxs, trace_maxs);
+
+	if ((mins[0] == 0) && (mins[1] == 0) && (mins[2] == 0) &&
+		(maxs[0] == 0) && (maxs[1] == 0) && (maxs[2] == 0))
+	{
+		trace_ispoint = true;
+		VectorClear(trace_extents);
+	}
+	else
+	{
+		trace_ispoint = false;
+		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+	}
+
+	CM_RecursiveHullCheckBatch(headnode, start, ends, traces, rays, numrays);
+
+	for (i = 0; i < count; i++)
+	{
+		if (traces[i].fraction == 1)
+		{
+			VectorCopy(ends[i], traces[i].endpos);
+		}
+		else
+		{
+			for (j = 0; j < 3; j++)
+			{
+				traces[i].endpos[j] = start[j] + traces[i].fraction *
+										(ends[i][j] - start[j]);
+			}
+		}
+	}
+}
+
 /*
  * Handles offseting and rotation of the end points for moving and
  * rotating entities
@@ -1918,35 +2117,51 @@ CM_DecompressVis(byte *in, byte *out)
 	while (out_p - out < row);
 }
 
-byte *
-CM_ClusterPVS(int cluster)
+/*
+ * Decompresses the PVS of a cluster into out, which must
+ * hold (CM_NumClusters() + 7) >> 3 bytes. Unlike
+ * CM_ClusterPVS() this doesn't touch any shared state.
+ */
+void
+CM_CopyClusterPVS(int cluster, byte *out)
 {
 	if (cluster == -1)
 	{
-		memset(pvsrow, 0, (numclusters + 7) >> 3);
+		memset(out, 0, (numclusters + 7) >> 3);
 	}
 	else
 	{
 		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), pvsrow);
+				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), out);
 	}
-
-	return pvsrow;
 }
 
-byte *
-CM_ClusterPHS(int cluster)
+void
+CM_CopyClusterPHS(int cluster, byte *out)
 {
 	if (cluster == -1)
 	{
-		memset(phsrow, 0, (numclusters + 7) >> 3);
+		memset(out, 0, (numclusters + 7) >> 3);
 	}
-
 	else
 	{
 		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), phsrow);
+				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), out);
 	}
+}
+
+byte *
+CM_ClusterPVS(int cluster)
+{
+	CM_CopyClusterPVS(cluster, pvsrow);
+
+	return pvsrow;
+}
+
+byte *
+CM_ClusterPHS(int cluster)
+{
+	CM_CopyClusterPHS(cluster, phsrow);
 
 	return phsrow;
 }
@@ -116,24 +116,116 @@ Cvar_InfoValidate(const char *s)
 	return true;
 }
 
+/* Index into the cvars. cvar_vars stays sorted for
+   listing and archiving, lookups go through here. */
+static cvar_t **cvar_hash;
+static int cvar_hashsize; /* power of two */
+static int cvar_count;
+
+/* replacements[] by old name, slot holds index + 1 */
+static byte replacement_hash[128];
+static qboolean replacement_hashed;
+
+static const replacement_t *
+Cvar_FindReplacement(const char *var_name)
+{
+	unsigned i, j;
+
+	if (!replacement_hashed)
+	{
+		for (j = 0; j < ARRLEN(replacements); j++)
+		{
+			i = Cmd_HashName(replacements[j].old) & (sizeof(replacement_hash) - 1);
+
+			while (replacement_hash[i])
+			{
+				i = (i + 1) & (sizeof(replacement_hash) - 1);
+			}
+
+			replacement_hash[i] = j + 1;
+		}
+
+		replacement_hashed = true;
+	}
+
+	i = Cmd_HashName(var_name) & (sizeof(replacement_hash) - 1);
+
+	for ( ; replacement_hash[i]; i = (i + 1) & (sizeof(replacement_hash) - 1))
+	{
+		j = replacement_hash[i] - 1;
+
+		if (!strcmp(var_name, replacements[j].old))
+		{
+			return &replacements[j];
+		}
+	}
+
+	return NULL;
+}
+
+static void
+Cvar_HashInsert(cvar_t *var)
+{
+	unsigned i;
+
+	if ((cvar_count + 1) * 2 > cvar_hashsize)
+	{
+		cvar_t **old = cvar_hash;
+		int oldsize = cvar_hashsize;
+		int j;
+
+		cvar_hashsize = oldsize ? oldsize * 2 : 1024;
+		cvar_hash = Z_Malloc(cvar_hashsize * sizeof(cvar_t *));
+		cvar_count = 0;
+
+		for (j = 0; j < oldsize; j++)
+		{
+			if (old[j])
+			{
+				Cvar_HashInsert(old[j]);
+			}
+		}
+
+		if (old)
+		{
+			Z_Free(old);
+		}
+	}
+
+	i = Cmd_HashName(var->name) & (cvar_hashsize - 1);
+
+	while (cvar_hash[i])
+	{
+		i = (i + 1) & (cvar_hashsize - 1);
+	}
+
+	cvar_hash[i] = var;
+	cvar_count++;
+}
+
 static cvar_t *
 Cvar_FindVar(const char *var_name)
 {
+	const replacement_t *r;
 	cvar_t *var;
-	int i;
+	unsigned i;
 
 	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < ARRLEN(replacements); i++)
+	if ((r = Cvar_FindReplacement(var_name)) != NULL)
 	{
-		if (!strcmp(var_name, replacements[i].old))
-		{
-			Com_Printf("cvar %s is deprecated, use %s instead\n", replacements[i].old, replacements[i].new);
+		Com_Printf("cvar %s is deprecated, use %s instead\n", r->old, r->new);
 
-			var_name = replacements[i].new;
-		}
+		var_name = r->new;
 	}
 
-	for (var = cvar_vars; var; var = var->next)
+	if (!cvar_hashsize)
+	{
+		return NULL;
+	}
+
+	i = Cmd_HashName(var_name) & (cvar_hashsize - 1);
+
+	for ( ; (var = cvar_hash[i]) != NULL; i = (i + 1) & (cvar_hashsize - 1))
 	{
 		if (!strcmp(var_name, var->name))
 		{
@@ -284,6 +376,8 @@ Cvar_Get(const char *var_name, const char *var_value, int flags)
 	var->next = *pos;
 	*pos = var;
 
+	Cvar_HashInsert(var);
+
 	var->flags = flags;
 
 	return var;
@@ -527,8 +621,9 @@ Cvar_Command(void)
 static void
 Cvar_Set_f(void)
 {
+	const replacement_t *r;
 	char *firstarg;
-	int c, i;
+	int c;
 
 	c = Cmd_Argc();
 
@@ -541,12 +636,9 @@ Cvar_Set_f(void)
 	firstarg = Cmd_Argv(1);
 
 	/* An ugly hack to rewrite changed CVARs */
-	for (i = 0; i < ARRLEN(replacements); i++)
+	if ((r = Cvar_FindReplacement(firstarg)) != NULL)
 	{
-		if (!strcmp(firstarg, replacements[i].old))
-		{
-			firstarg = replacements[i].new;
-		}
+		firstarg = r->new;
 	}
 
 	if (c == 4)
@@ -894,6 +986,16 @@ Cvar_Fini(void)
 		var = c;
 	}
 
+	cvar_vars = NULL;
+
+	if (cvar_hash)
+	{
+		Z_Free(cvar_hash);
+		cvar_hash = NULL;
+		cvar_hashsize = 0;
+		cvar_count = 0;
+	}
+
 	Cmd_RemoveCommand("cvarlist");
 	Cmd_RemoveCommand("dec");
 	Cmd_RemoveCommand("inc");
@@ -813,6 +813,7 @@ Qcommon_Frame(int usec)
 void
 Qcommon_Shutdown(void)
 {
+	Workers_Shutdown();
 	FS_ShutdownFilesystem();
 	Cvar_Fini();
 
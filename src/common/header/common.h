@@ -89,6 +89,7 @@ typedef struct sizebuf_s
 {
 	qboolean allowoverflow;     /* if false, do a Com_Error */
 	qboolean overflowed;        /* set to true if the buffer size failed */
+	qboolean silent;            /* overflows aren't printed, for other threads */
 	byte *data;
 	int maxsize;
 	int cursize;
@@ -150,6 +151,32 @@ void MSG_ReadDir(sizebuf_t *sb, vec3_t vector);
 
 void MSG_ReadData(sizebuf_t *sb, void *buffer, int size);
 
+int MSG_ReadEntityBits(sizebuf_t *sb, unsigned *bits);
+void MSG_ReadDeltaEntity(sizebuf_t *sb, const struct entity_state_s *from,
+		struct entity_state_s *to, int number, unsigned bits);
+
+/* bit stream over a sizebuf_t, for PROTOCOL_PACKED */
+typedef struct
+{
+	sizebuf_t *msg;
+	unsigned long long bits;    /* not yet written or not yet read */
+	int count;                  /* valid bits in bits */
+	int entnum;                 /* last record of a packetentities list */
+} msgbits_t;
+
+void MSG_BeginBits(msgbits_t *mb, sizebuf_t *msg);
+void MSG_FlushBits(msgbits_t *mb);
+void MSG_WritePackedEntity(msgbits_t *mb, const struct entity_state_s *from,
+		const struct entity_state_s *to, qboolean force, qboolean newentity);
+void MSG_WritePackedRemove(msgbits_t *mb, int number);
+void MSG_WritePackedEnd(msgbits_t *mb);
+int MSG_ReadPackedNumber(msgbits_t *mb, qboolean *remove);
+void MSG_ReadPackedEntity(msgbits_t *mb, const struct entity_state_s *from,
+		struct entity_state_s *to, int number);
+void MSG_WritePackedPlayerstate(sizebuf_t *sb, const player_state_t *from,
+		const player_state_t *to, int pflags);
+void MSG_ReadPackedPlayerstate(sizebuf_t *sb, player_state_t *state);
+
 /* ================================================================== */
 
 extern qboolean bigendien;
@@ -181,6 +208,7 @@ void Info_Print(char *s);
 /* PROTOCOL */
 
 #define PROTOCOL_VERSION 34
+#define PROTOCOL_PACKED 1034 /* opt-in bit packed snapshots, R1Q2 and Q2PRO use 35 and 36 */
 
 /* ========================================= */
 
@@ -405,6 +433,10 @@ qboolean Cmd_Exists(const char *cmd_name);
 
 /* used by the cvar code to check for cvar / command name overlap */
 
+unsigned Cmd_HashName(const char *name);
+
+/* case insensitive string hash, used for the command and cvar lookups */
+
 const char *Cmd_CompleteCommand(const char *partial);
 
 const char *Cmd_CompleteMapCommand(const char *partial);
@@ -521,6 +553,7 @@ extern qboolean userinfo_modified;
 
 #define PORT_ANY -1
 #define MAX_MSGLEN 1400             /* max length of a message */
+#define MAX_FRAGMENTED_MSGLEN 0x4000 /* sent in MAX_MSGLEN sized fragments */
 #define PACKET_HEADER 10            /* two ints and a short */
 
 typedef enum
@@ -531,7 +564,8 @@ typedef enum
 	NA_IPX,
 	NA_BROADCAST_IPX,
 	NA_IP6,
-	NA_MULTICAST6
+	NA_MULTICAST6,
+	NA_BOT              /* load test clients, nothing is sent to them */
 } netadrtype_t;
 
 typedef enum {NS_CLIENT, NS_SERVER} netsrc_t;
@@ -554,6 +588,8 @@ void NET_Config(qboolean multiplayer);
 qboolean NET_GetPacket(netsrc_t sock, netadr_t *net_from,
 		sizebuf_t *net_message);
 void NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to);
+void NET_QueuePackets(void);
+void NET_FlushPackets(void);
 
 qboolean NET_CompareAdr(netadr_t a, netadr_t b);
 qboolean NET_CompareBaseAdr(netadr_t a, netadr_t b);
@@ -592,21 +628,31 @@ typedef struct
 	int reliable_sequence;                  /* single bit */
 	int last_reliable_sequence;             /* sequence number of last send */
 
+	/* longest message Netchan_Transmit() sends, more
+	   than MAX_MSGLEN if both sides handle fragments */
+	int maxmsglen;
+
 	/* reliable staging and holding areas */
 	sizebuf_t message;          /* writing buffer to send to server */
-	byte message_buf[MAX_MSGLEN - 16];          /* leave space for header */
+	byte message_buf[MAX_FRAGMENTED_MSGLEN - 16];   /* leave space for header */
 
 	/* message is copied to this buffer when it is first transfered */
 	int reliable_length;
-	byte reliable_buf[MAX_MSGLEN - 16];         /* unacked reliable message */
+	byte reliable_buf[MAX_FRAGMENTED_MSGLEN - 16];  /* unacked reliable message */
+
+	/* fragmented message being reassembled */
+	int fragment_sequence;
+	int fragment_length;
+	byte fragment_buf[MAX_FRAGMENTED_MSGLEN];
 } netchan_t;
 
 extern netadr_t net_from;
 extern sizebuf_t net_message;
-extern byte net_message_buffer[MAX_MSGLEN];
+extern byte net_message_buffer[MAX_FRAGMENTED_MSGLEN];
 
 void Netchan_Init(void);
 void Netchan_Setup(netsrc_t sock, netchan_t *chan, netadr_t adr, int qport);
+void Netchan_EnableFragments(netchan_t *chan, int maxmsglen);
 
 qboolean Netchan_NeedReliable(netchan_t *chan);
 void Netchan_Transmit(netchan_t *chan, int length, byte *data);
@@ -641,8 +687,16 @@ trace_t CM_TransformedBoxTrace(const vec3_t start, const vec3_t end,
 		const vec3_t mins, const vec3_t maxs, int headnode,
 		int brushmask, const vec3_t origin, const vec3_t angles);
 
+/* sweeps one box from start to each of the ends */
+#define CM_MAX_TRACE_BATCH 64
+void CM_BoxTraceBatch(const vec3_t start, const vec3_t *ends, int count,
+		const vec3_t mins, const vec3_t maxs, int headnode, int brushmask,
+		trace_t *traces);
+
 byte *CM_ClusterPVS(int cluster);
 byte *CM_ClusterPHS(int cluster);
+void CM_CopyClusterPVS(int cluster, byte *out);
+void CM_CopyClusterPHS(int cluster, byte *out);
 
 int CM_PointLeafnum(vec3_t p);
 
@@ -661,7 +715,7 @@ qboolean CM_AreasConnected(int area1, int area2);
 int CM_WriteAreaBits(byte *buffer, int area);
 qboolean CM_HeadnodeVisible(int headnode, byte *visbits);
 
-void CM_WritePortalState(FILE *f);
+void CM_WritePortalState(sizebuf_t *msg);
 
 /* PLAYER MOVEMENT CODE */
 
@@ -814,6 +868,14 @@ void *Z_Realloc(void *ptr, int size);
 void *Z_TagRealloc(void *ptr, int size, int tag);
 void Z_FreeTags(int tag);
 
+/* workers.c */
+typedef void (*workerfunc_t)(void *data, int index);
+
+void Workers_Init(int count);
+void Workers_Shutdown(void);
+int Workers_Count(void);
+void Workers_Run(workerfunc_t func, void *data, int count);
+
 void Qcommon_Init(int argc, char **argv);
 void Qcommon_ExecConfigs(qboolean addEarlyCmds);
 const char* Qcommon_GetInitialGame(void);
@@ -30,6 +30,10 @@ typedef enum {
 #define JSON_MAX_STRING 256
 #define JSON_MAX_CHILDREN 64
 #define JSON_MAX_KEY 64
+#define JSON_MAX_DEPTH 64
+
+/* Objects with at least this many members get a hashed member index */
+#define JSON_HASH_MIN_MEMBERS 8
 
 typedef struct json_value_s json_value_t;
 
@@ -47,19 +51,34 @@ struct json_value_s {
 	char key[JSON_MAX_KEY];          /* Key name (for object members) */
 	json_value_t *children;          /* Array of children */
 	int child_count;
-	int child_capacity;
+
+	/* Objects only: open addressed member index (child + 1, 0 = empty) */
+	unsigned short *member_index;
+	int member_mask;
 };
 
 /* ============================================================================
  * PARSER STATE
  * ============================================================================ */
 
+typedef struct json_chunk_s json_chunk_t;
+
 typedef struct {
 	const char *text;
 	int pos;
 	int len;
 	char error[256];
 	qboolean has_error;
+
+	/* Every node of a tree lives in a chain of arena chunks */
+	json_chunk_t *chunks;
+	json_chunk_t *current;
+
+	/* Members of the containers still being parsed, innermost last */
+	json_value_t *stack;
+	int stack_count;
+	int stack_size;
+	int depth;
 } json_parser_t;
 
 /* ============================================================================
@@ -69,7 +88,7 @@ typedef struct {
 /* Parse JSON text into a value tree. Returns NULL on error. */
 json_value_t *JSON_Parse(const char *text, char *error_out, int error_size);
 
-/* Free a parsed JSON value tree */
+/* Free a parsed JSON value tree. Only valid for the root JSON_Parse() returned */
 void JSON_Free(json_value_t *val);
 
 /* Access helpers */
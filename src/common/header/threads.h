@@ -0,0 +1,76 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Thin wrappers around the mutexes, condition variables and threads
+ * of the platform. Include before anything else, windows.h must see
+ * _WIN32_WINNT first.
+ *
+ * =======================================================================
+ */
+
+#ifndef CO_THREADS_H
+#define CO_THREADS_H
+
+#ifdef _WIN32
+ #if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+  #undef _WIN32_WINNT
+  #define _WIN32_WINNT 0x0600 /* condition variables */
+ #endif
+ #include <windows.h>
+#else
+ #include <pthread.h>
+#endif
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION qmutex_t;
+typedef CONDITION_VARIABLE qcond_t;
+typedef HANDLE qthread_t;
+
+#define THREAD_FUNC(name) static DWORD WINAPI name(LPVOID arg)
+#define THREAD_RETURN return 0
+
+#define Mutex_Init(m) InitializeCriticalSection(m)
+#define Mutex_Lock(m) EnterCriticalSection(m)
+#define Mutex_Unlock(m) LeaveCriticalSection(m)
+#define Cond_Init(c) InitializeConditionVariable(c)
+#define Cond_Wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define Cond_Signal(c) WakeConditionVariable(c)
+#define Cond_Broadcast(c) WakeAllConditionVariable(c)
+#define Thread_Spawn(t, func) ((*(t) = CreateThread(NULL, 0, func, NULL, 0, NULL)) != NULL)
+#define Thread_Join(t) (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+typedef pthread_mutex_t qmutex_t;
+typedef pthread_cond_t qcond_t;
+typedef pthread_t qthread_t;
+
+#define THREAD_FUNC(name) static void *name(void *arg)
+#define THREAD_RETURN return NULL
+
+#define Mutex_Init(m) pthread_mutex_init(m, NULL)
+#define Mutex_Lock(m) pthread_mutex_lock(m)
+#define Mutex_Unlock(m) pthread_mutex_unlock(m)
+#define Cond_Init(c) pthread_cond_init(c, NULL)
+#define Cond_Wait(c, m) pthread_cond_wait(c, m)
+#define Cond_Signal(c) pthread_cond_signal(c)
+#define Cond_Broadcast(c) pthread_cond_broadcast(c)
+#define Thread_Spawn(t, func) (pthread_create(t, NULL, func, NULL) == 0)
+#define Thread_Join(t) pthread_join(t, NULL)
+#endif
+
+#endif
@@ -1247,3 +1247,1024 @@ MSG_ReadData(sizebuf_t *msg_read, void *data, int len)
 	}
 }
 
+
+/*
+ * Reads the header of a packetentities record.
+ * Returns the entity number and the U_* bits.
+ */
+int
+MSG_ReadEntityBits(sizebuf_t *msg_read, unsigned *bits)
+{
+	unsigned b, total;
+	int number;
+
+	total = MSG_ReadByte(msg_read);
+
+	if (total & U_MOREBITS1)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 8;
+	}
+
+	if (total & U_MOREBITS2)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 16;
+	}
+
+	if (total & U_MOREBITS3)
+	{
+		b = MSG_ReadByte(msg_read);
+		total |= b << 24;
+	}
+
+	if (total & U_NUMBER16)
+	{
+		number = MSG_ReadShort(msg_read);
+	}
+	else
+	{
+		number = MSG_ReadByte(msg_read);
+	}
+
+	*bits = total;
+
+	return number;
+}
+
+/*
+ * Reads what MSG_WriteDeltaEntity() wrote.
+ * Can go from either a baseline or a previous packet_entity
+ */
+void
+MSG_ReadDeltaEntity(sizebuf_t *msg_read, const entity_state_t *from,
+		entity_state_t *to, int number, unsigned bits)
+{
+	if (!from)
+	{
+		from = &es_nullstate;
+	}
+
+	/* set everything to the state we are delta'ing from */
+	*to = *from;
+
+	VectorCopy(from->origin, to->old_origin);
+	to->number = number;
+
+	if (bits & U_MODEL)
+	{
+		to->modelindex = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL2)
+	{
+		to->modelindex2 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL3)
+	{
+		to->modelindex3 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_MODEL4)
+	{
+		to->modelindex4 = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_FRAME8)
+	{
+		to->frame = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_FRAME16)
+	{
+		to->frame = MSG_ReadShort(msg_read);
+	}
+
+	/* used for laser colors */
+	if ((bits & U_SKIN8) && (bits & U_SKIN16))
+	{
+		to->skinnum = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_SKIN8)
+	{
+		to->skinnum = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_SKIN16)
+	{
+		to->skinnum = MSG_ReadShort(msg_read);
+	}
+
+	if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
+	{
+		to->effects = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_EFFECTS8)
+	{
+		to->effects = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_EFFECTS16)
+	{
+		to->effects = MSG_ReadShort(msg_read);
+	}
+
+	if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
+	{
+		to->renderfx = MSG_ReadLong(msg_read);
+	}
+	else if (bits & U_RENDERFX8)
+	{
+		to->renderfx = MSG_ReadByte(msg_read);
+	}
+	else if (bits & U_RENDERFX16)
+	{
+		to->renderfx = MSG_ReadShort(msg_read);
+	}
+
+	if (bits & U_ORIGIN1)
+	{
+		to->origin[0] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ORIGIN2)
+	{
+		to->origin[1] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ORIGIN3)
+	{
+		to->origin[2] = MSG_ReadCoord(msg_read);
+	}
+
+	if (bits & U_ANGLE1)
+	{
+		to->angles[0] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_ANGLE2)
+	{
+		to->angles[1] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_ANGLE3)
+	{
+		to->angles[2] = MSG_ReadAngle(msg_read);
+	}
+
+	if (bits & U_OLDORIGIN)
+	{
+		MSG_ReadPos(msg_read, to->old_origin);
+	}
+
+	if (bits & U_SOUND)
+	{
+		to->sound = MSG_ReadByte(msg_read);
+	}
+
+	if (bits & U_EVENT)
+	{
+		to->event = MSG_ReadByte(msg_read);
+	}
+	else
+	{
+		to->event = 0;
+	}
+
+	if (bits & U_SOLID)
+	{
+		to->solid = MSG_ReadShort(msg_read);
+	}
+}
+
+/* ================================================================== */
+
+/*
+ * Bit packed snapshots, used with clients that connected with
+ * PROTOCOL_PACKED. The playerinfo and packetentities payloads are
+ * bit streams (low bit first, padded to a whole byte at the end)
+ * instead of byte aligned fields:
+ *
+ *  - a packetentities record is the entity number as an increment
+ *    over the previous record (0 ends the list), a remove bit and,
+ *    unless removed, 7 presence bits for the fields that change every
+ *    frame, a bit telling if the 11 presence bits of the other fields
+ *    follow, and then the present fields.
+ *  - coordinates go as the difference of the 1/8 unit values the old
+ *    protocol sends, to the state the client deltas from.
+ *  - counters and flags use a variable length code: 2 to 4 prefix
+ *    bits select 4, 8, 12, 16 or 32 value bits. Signed values are
+ *    zigzag mapped first, so small changes either way are short.
+ *
+ * Every field decodes to the value the old protocol would give the
+ * client, so nothing past the parser needs to know which one is used.
+ */
+
+/* presence bits of a packed entity record */
+#define PE_ORIGIN1 (1 << 0)
+#define PE_ORIGIN2 (1 << 1)
+#define PE_ORIGIN3 (1 << 2)
+#define PE_ANGLE1 (1 << 3)
+#define PE_ANGLE2 (1 << 4)
+#define PE_ANGLE3 (1 << 5)
+#define PE_FRAME (1 << 6)
+#define PE_COMMONBITS 7
+
+#define PE_MODEL (1 << 7)
+#define PE_MODEL2 (1 << 8)
+#define PE_MODEL3 (1 << 9)
+#define PE_MODEL4 (1 << 10)
+#define PE_SKIN (1 << 11)
+#define PE_EFFECTS (1 << 12)
+#define PE_RENDERFX (1 << 13)
+#define PE_OLDORIGIN (1 << 14)
+#define PE_SOUND (1 << 15)
+#define PE_EVENT (1 << 16)
+#define PE_SOLID (1 << 17)
+#define PE_RAREBITS 11
+
+#define PS_NUMBITS 15 /* PS_M_TYPE to PS_RDFLAGS */
+
+static const int varbits[] = {4, 8, 12, 16, 32};
+
+void
+MSG_BeginBits(msgbits_t *mb, sizebuf_t *msg)
+{
+	memset(mb, 0, sizeof(*mb));
+	mb->msg = msg;
+}
+
+static void
+MSG_WriteBits(msgbits_t *mb, unsigned value, int count)
+{
+	mb->bits |= (value & ((1ull << count) - 1)) << mb->count;
+	mb->count += count;
+
+	while (mb->count >= 8)
+	{
+		MSG_WriteByte(mb->msg, (int)(mb->bits & 255));
+		mb->bits >>= 8;
+		mb->count -= 8;
+	}
+}
+
+/*
+ * Writes out the last partial byte. Call once at the
+ * end of a stream, the reader skips the padding on its own.
+ */
+void
+MSG_FlushBits(msgbits_t *mb)
+{
+	if (mb->count)
+	{
+		MSG_WriteByte(mb->msg, (int)(mb->bits & 255));
+	}
+
+	mb->bits = 0;
+	mb->count = 0;
+}
+
+static unsigned
+MSG_ReadBits(msgbits_t *mb, int count)
+{
+	unsigned value;
+
+	/* only fetch what's needed, so the stream ends on the padding byte */
+	while (mb->count < count)
+	{
+		mb->bits |= (unsigned long long)(MSG_ReadByte(mb->msg) & 255) << mb->count;
+		mb->count += 8;
+	}
+
+	value = (unsigned)(mb->bits & ((1ull << count) - 1));
+	mb->bits >>= count;
+	mb->count -= count;
+
+	return value;
+}
+
+static void
+MSG_WriteVarBits(msgbits_t *mb, unsigned value)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		if (value < (1u << varbits[i]))
+		{
+			break;
+		}
+	}
+
+	/* i one bits, and a zero unless it's the last class */
+	MSG_WriteBits(mb, (i < 4) ? (1u << i) - 1 : 15, (i < 4) ? i + 1 : 4);
+	MSG_WriteBits(mb, value, varbits[i]);
+}
+
+static unsigned
+MSG_ReadVarBits(msgbits_t *mb)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		if (!MSG_ReadBits(mb, 1))
+		{
+			break;
+		}
+	}
+
+	return MSG_ReadBits(mb, varbits[i]);
+}
+
+static void
+MSG_WriteSignedBits(msgbits_t *mb, int value)
+{
+	MSG_WriteVarBits(mb, (value < 0) ? ~((unsigned)value << 1) :
+			(unsigned)value << 1);
+}
+
+static int
+MSG_ReadSignedBits(msgbits_t *mb)
+{
+	unsigned value = MSG_ReadVarBits(mb);
+
+	return (value & 1) ? (int)~(value >> 1) : (int)(value >> 1);
+}
+
+/*
+ * The coordinate as MSG_WriteCoord() sends it
+ */
+static int
+PackedCoord(float f)
+{
+	return (short)(int)(f * 8);
+}
+
+static int
+PackedEntityBits(int bits)
+{
+	int packed = 0;
+
+	if (bits & U_ORIGIN1)
+	{
+		packed |= PE_ORIGIN1;
+	}
+
+	if (bits & U_ORIGIN2)
+	{
+		packed |= PE_ORIGIN2;
+	}
+
+	if (bits & U_ORIGIN3)
+	{
+		packed |= PE_ORIGIN3;
+	}
+
+	if (bits & U_ANGLE1)
+	{
+		packed |= PE_ANGLE1;
+	}
+
+	if (bits & U_ANGLE2)
+	{
+		packed |= PE_ANGLE2;
+	}
+
+	if (bits & U_ANGLE3)
+	{
+		packed |= PE_ANGLE3;
+	}
+
+	if (bits & (U_FRAME8 | U_FRAME16))
+	{
+		packed |= PE_FRAME;
+	}
+
+	if (bits & U_MODEL)
+	{
+		packed |= PE_MODEL;
+	}
+
+	if (bits & U_MODEL2)
+	{
+		packed |= PE_MODEL2;
+	}
+
+	if (bits & U_MODEL3)
+	{
+		packed |= PE_MODEL3;
+	}
+
+	if (bits & U_MODEL4)
+	{
+		packed |= PE_MODEL4;
+	}
+
+	if (bits & (U_SKIN8 | U_SKIN16))
+	{
+		packed |= PE_SKIN;
+	}
+
+	if (bits & (U_EFFECTS8 | U_EFFECTS16))
+	{
+		packed |= PE_EFFECTS;
+	}
+
+	if (bits & (U_RENDERFX8 | U_RENDERFX16))
+	{
+		packed |= PE_RENDERFX;
+	}
+
+	if (bits & U_OLDORIGIN)
+	{
+		packed |= PE_OLDORIGIN;
+	}
+
+	if (bits & U_SOUND)
+	{
+		packed |= PE_SOUND;
+	}
+
+	if (bits & U_EVENT)
+	{
+		packed |= PE_EVENT;
+	}
+
+	if (bits & U_SOLID)
+	{
+		packed |= PE_SOLID;
+	}
+
+	return packed;
+}
+
+static void
+MSG_WritePackedNumber(msgbits_t *mb, int number, qboolean remove)
+{
+	MSG_WriteVarBits(mb, number - mb->entnum);
+	MSG_WriteBits(mb, remove, 1);
+
+	mb->entnum = number;
+}
+
+/*
+ * The PROTOCOL_PACKED version of MSG_WriteDeltaEntity().
+ * Records must be written in increasing entity order.
+ */
+void
+MSG_WritePackedEntity(msgbits_t *mb, const entity_state_t *from,
+		const entity_state_t *to, qboolean force, qboolean newentity)
+{
+	int bits, i;
+
+	if (!from)
+	{
+		from = &es_nullstate;
+	}
+
+	if (!to)
+	{
+		to = &es_nullstate;
+	}
+
+	/* same limit as the old protocol */
+	if (to->number > SHRT_MAX)
+	{
+		return;
+	}
+
+	bits = PackedEntityBits(DeltaEntityBits(from, to, newentity));
+
+	if (!bits && !force)
+	{
+		return;
+	}
+
+	MSG_WritePackedNumber(mb, to->number, false);
+
+	MSG_WriteBits(mb, bits, PE_COMMONBITS);
+
+	if (bits >> PE_COMMONBITS)
+	{
+		MSG_WriteBits(mb, 1, 1);
+		MSG_WriteBits(mb, bits >> PE_COMMONBITS, PE_RAREBITS);
+	}
+	else
+	{
+		MSG_WriteBits(mb, 0, 1);
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (PE_ORIGIN1 << i))
+		{
+			MSG_WriteSignedBits(mb, PackedCoord(to->origin[i]) -
+					PackedCoord(from->origin[i]));
+		}
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (PE_ANGLE1 << i))
+		{
+			MSG_WriteBits(mb, (int)(to->angles[i] * 256 / 360) & 255, 8);
+		}
+	}
+
+	if (bits & PE_FRAME)
+	{
+		MSG_WriteSignedBits(mb, to->frame - from->frame);
+	}
+
+	if (bits & PE_MODEL)
+	{
+		MSG_WriteBits(mb, to->modelindex, 8);
+	}
+
+	if (bits & PE_MODEL2)
+	{
+		MSG_WriteBits(mb, to->modelindex2, 8);
+	}
+
+	if (bits & PE_MODEL3)
+	{
+		MSG_WriteBits(mb, to->modelindex3, 8);
+	}
+
+	if (bits & PE_MODEL4)
+	{
+		MSG_WriteBits(mb, to->modelindex4, 8);
+	}
+
+	if (bits & PE_SKIN)
+	{
+		MSG_WriteVarBits(mb, to->skinnum);
+	}
+
+	if (bits & PE_EFFECTS)
+	{
+		MSG_WriteVarBits(mb, to->effects);
+	}
+
+	if (bits & PE_RENDERFX)
+	{
+		MSG_WriteVarBits(mb, to->renderfx);
+	}
+
+	if (bits & PE_OLDORIGIN)
+	{
+		/* usually close to where the entity is now */
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteSignedBits(mb, PackedCoord(to->old_origin[i]) -
+					PackedCoord(to->origin[i]));
+		}
+	}
+
+	if (bits & PE_SOUND)
+	{
+		MSG_WriteBits(mb, to->sound, 8);
+	}
+
+	if (bits & PE_EVENT)
+	{
+		MSG_WriteBits(mb, to->event, 8);
+	}
+
+	if (bits & PE_SOLID)
+	{
+		MSG_WriteBits(mb, to->solid, 16);
+	}
+}
+
+/*
+ * Tells the client that an entity of the old
+ * frame isn't in the new one.
+ */
+void
+MSG_WritePackedRemove(msgbits_t *mb, int number)
+{
+	MSG_WritePackedNumber(mb, number, true);
+}
+
+/*
+ * Ends a packetentities list.
+ */
+void
+MSG_WritePackedEnd(msgbits_t *mb)
+{
+	MSG_WriteVarBits(mb, 0);
+	MSG_FlushBits(mb);
+}
+
+/*
+ * Returns the entity number of the next record,
+ * or 0 at the end of the list.
+ */
+int
+MSG_ReadPackedNumber(msgbits_t *mb, qboolean *remove)
+{
+	unsigned delta;
+
+	delta = MSG_ReadVarBits(mb);
+
+	if (!delta)
+	{
+		*remove = false;
+		return 0;
+	}
+
+	mb->entnum += delta;
+	*remove = MSG_ReadBits(mb, 1);
+
+	return mb->entnum;
+}
+
+/*
+ * Reads what MSG_WritePackedEntity() wrote, after
+ * MSG_ReadPackedNumber() returned number.
+ */
+void
+MSG_ReadPackedEntity(msgbits_t *mb, const entity_state_t *from,
+		entity_state_t *to, int number)
+{
+	int bits, i;
+
+	if (!from)
+	{
+		from = &es_nullstate;
+	}
+
+	*to = *from;
+
+	VectorCopy(from->origin, to->old_origin);
+	to->number = number;
+
+	bits = MSG_ReadBits(mb, PE_COMMONBITS);
+
+	if (MSG_ReadBits(mb, 1))
+	{
+		bits |= MSG_ReadBits(mb, PE_RAREBITS) << PE_COMMONBITS;
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (PE_ORIGIN1 << i))
+		{
+			to->origin[i] = (short)(PackedCoord(from->origin[i]) +
+					MSG_ReadSignedBits(mb)) * 0.125f;
+		}
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (PE_ANGLE1 << i))
+		{
+			to->angles[i] = (signed char)MSG_ReadBits(mb, 8) * 1.40625f;
+		}
+	}
+
+	if (bits & PE_FRAME)
+	{
+		to->frame = from->frame + MSG_ReadSignedBits(mb);
+	}
+
+	if (bits & PE_MODEL)
+	{
+		to->modelindex = MSG_ReadBits(mb, 8);
+	}
+
+	if (bits & PE_MODEL2)
+	{
+		to->modelindex2 = MSG_ReadBits(mb, 8);
+	}
+
+	if (bits & PE_MODEL3)
+	{
+		to->modelindex3 = MSG_ReadBits(mb, 8);
+	}
+
+	if (bits & PE_MODEL4)
+	{
+		to->modelindex4 = MSG_ReadBits(mb, 8);
+	}
+
+	if (bits & PE_SKIN)
+	{
+		to->skinnum = MSG_ReadVarBits(mb);
+	}
+
+	if (bits & PE_EFFECTS)
+	{
+		to->effects = MSG_ReadVarBits(mb);
+	}
+
+	if (bits & PE_RENDERFX)
+	{
+		to->renderfx = MSG_ReadVarBits(mb);
+	}
+
+	if (bits & PE_OLDORIGIN)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			to->old_origin[i] = (short)(PackedCoord(to->origin[i]) +
+					MSG_ReadSignedBits(mb)) * 0.125f;
+		}
+	}
+
+	if (bits & PE_SOUND)
+	{
+		to->sound = MSG_ReadBits(mb, 8);
+	}
+
+	if (bits & PE_EVENT)
+	{
+		to->event = MSG_ReadBits(mb, 8);
+	}
+	else
+	{
+		to->event = 0;
+	}
+
+	if (bits & PE_SOLID)
+	{
+		to->solid = (short)MSG_ReadBits(mb, 16);
+	}
+}
+
+/*
+ * The PROTOCOL_PACKED playerinfo payload. pflags are the PS_*
+ * bits the server picked, the stats go as changes to from.
+ */
+void
+MSG_WritePackedPlayerstate(sizebuf_t *msg, const player_state_t *from,
+		const player_state_t *to, int pflags)
+{
+	msgbits_t mb;
+	unsigned statbits;
+	int i;
+
+	MSG_BeginBits(&mb, msg);
+	MSG_WriteBits(&mb, pflags, PS_NUMBITS);
+
+	if (pflags & PS_M_TYPE)
+	{
+		MSG_WriteBits(&mb, to->pmove.pm_type, 8);
+	}
+
+	if (pflags & PS_M_ORIGIN)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteSignedBits(&mb, to->pmove.origin[i] - from->pmove.origin[i]);
+		}
+	}
+
+	if (pflags & PS_M_VELOCITY)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteSignedBits(&mb, to->pmove.velocity[i] - from->pmove.velocity[i]);
+		}
+	}
+
+	if (pflags & PS_M_TIME)
+	{
+		MSG_WriteBits(&mb, to->pmove.pm_time, 8);
+	}
+
+	if (pflags & PS_M_FLAGS)
+	{
+		MSG_WriteBits(&mb, to->pmove.pm_flags, 8);
+	}
+
+	if (pflags & PS_M_GRAVITY)
+	{
+		MSG_WriteSignedBits(&mb, to->pmove.gravity - from->pmove.gravity);
+	}
+
+	if (pflags & PS_M_DELTA_ANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteSignedBits(&mb, to->pmove.delta_angles[i] -
+					from->pmove.delta_angles[i]);
+		}
+	}
+
+	if (pflags & PS_VIEWOFFSET)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteBits(&mb, (int)(to->viewoffset[i] * 4), 8);
+		}
+	}
+
+	if (pflags & PS_VIEWANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteBits(&mb, ANGLE2SHORT(to->viewangles[i]), 16);
+		}
+	}
+
+	if (pflags & PS_KICKANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteBits(&mb, (int)(to->kick_angles[i] * 4), 8);
+		}
+	}
+
+	if (pflags & PS_WEAPONINDEX)
+	{
+		MSG_WriteBits(&mb, to->gunindex, 8);
+	}
+
+	if (pflags & PS_WEAPONFRAME)
+	{
+		MSG_WriteBits(&mb, to->gunframe, 8);
+
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteBits(&mb, (int)(to->gunoffset[i] * 4), 8);
+		}
+
+		for (i = 0; i < 3; i++)
+		{
+			MSG_WriteBits(&mb, (int)(to->gunangles[i] * 4), 8);
+		}
+	}
+
+	if (pflags & PS_BLEND)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			MSG_WriteBits(&mb, (int)(to->blend[i] * 255), 8);
+		}
+	}
+
+	if (pflags & PS_FOV)
+	{
+		MSG_WriteBits(&mb, (int)to->fov, 8);
+	}
+
+	if (pflags & PS_RDFLAGS)
+	{
+		MSG_WriteBits(&mb, to->rdflags, 8);
+	}
+
+	statbits = 0;
+
+	for (i = 0; i < MAX_STATS; i++)
+	{
+		if (to->stats[i] != from->stats[i])
+		{
+			statbits |= 1u << i;
+		}
+	}
+
+	MSG_WriteVarBits(&mb, statbits);
+
+	for (i = 0; i < MAX_STATS; i++)
+	{
+		if (statbits & (1u << i))
+		{
+			MSG_WriteSignedBits(&mb, to->stats[i] - from->stats[i]);
+		}
+	}
+
+	MSG_FlushBits(&mb);
+}
+
+/*
+ * Reads what MSG_WritePackedPlayerstate() wrote.
+ * state must hold the player_state_t it deltas from.
+ */
+void
+MSG_ReadPackedPlayerstate(sizebuf_t *msg, player_state_t *state)
+{
+	msgbits_t mb;
+	unsigned statbits;
+	int pflags, i;
+
+	MSG_BeginBits(&mb, msg);
+	pflags = MSG_ReadBits(&mb, PS_NUMBITS);
+
+	if (pflags & PS_M_TYPE)
+	{
+		state->pmove.pm_type = MSG_ReadBits(&mb, 8);
+	}
+
+	if (pflags & PS_M_ORIGIN)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->pmove.origin[i] += MSG_ReadSignedBits(&mb);
+		}
+	}
+
+	if (pflags & PS_M_VELOCITY)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->pmove.velocity[i] += MSG_ReadSignedBits(&mb);
+		}
+	}
+
+	if (pflags & PS_M_TIME)
+	{
+		state->pmove.pm_time = MSG_ReadBits(&mb, 8);
+	}
+
+	if (pflags & PS_M_FLAGS)
+	{
+		state->pmove.pm_flags = MSG_ReadBits(&mb, 8);
+	}
+
+	if (pflags & PS_M_GRAVITY)
+	{
+		state->pmove.gravity += MSG_ReadSignedBits(&mb);
+	}
+
+	if (pflags & PS_M_DELTA_ANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->pmove.delta_angles[i] += MSG_ReadSignedBits(&mb);
+		}
+	}
+
+	if (pflags & PS_VIEWOFFSET)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->viewoffset[i] = (signed char)MSG_ReadBits(&mb, 8) * 0.25f;
+		}
+	}
+
+	if (pflags & PS_VIEWANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->viewangles[i] = SHORT2ANGLE((short)MSG_ReadBits(&mb, 16));
+		}
+	}
+
+	if (pflags & PS_KICKANGLES)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			state->kick_angles[i] = (signed char)MSG_ReadBits(&mb, 8) * 0.25f;
+		}
+	}
+
+	if (pflags & PS_WEAPONINDEX)
+	{
+		state->gunindex = MSG_ReadBits(&mb, 8);
+	}
+
+	if (pflags & PS_WEAPONFRAME)
+	{
+		state->gunframe = MSG_ReadBits(&mb, 8);
+
+		for (i = 0; i < 3; i++)
+		{
+			state->gunoffset[i] = (signed char)MSG_ReadBits(&mb, 8) * 0.25f;
+		}
+
+		for (i = 0; i < 3; i++)
+		{
+			state->gunangles[i] = (signed char)MSG_ReadBits(&mb, 8) * 0.25f;
+		}
+	}
+
+	if (pflags & PS_BLEND)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			state->blend[i] = MSG_ReadBits(&mb, 8) / 255.0f;
+		}
+	}
+
+	if (pflags & PS_FOV)
+	{
+		state->fov = (float)MSG_ReadBits(&mb, 8);
+	}
+
+	if (pflags & PS_RDFLAGS)
+	{
+		state->rdflags = MSG_ReadBits(&mb, 8);
+	}
+
+	statbits = MSG_ReadVarBits(&mb);
+
+	for (i = 0; i < MAX_STATS; i++)
+	{
+		if (statbits & (1u << i))
+		{
+			state->stats[i] += MSG_ReadSignedBits(&mb);
+		}
+	}
+}
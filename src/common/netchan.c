@@ -81,15 +81,28 @@
  * frame, such as during the connection stage while waiting for the
  * client to load, then a packet only needs to be delivered if there is
  * something in the unacknowledged reliable
+ *
+ * Messages longer than MAX_MSGLEN are only sent when both sides agreed
+ * on it while connecting (see Netchan_EnableFragments()). They go out
+ * as a burst of packets with bit 30 of the sequence set. Each of them
+ * repeats the header, followed by a short with the offset of its chunk
+ * (bit 15 set if more follow) and the chunk itself. The receiver puts
+ * the message back together and processes it as if it came in one
+ * packet. If a fragment is lost the whole message is, the reliable
+ * part is retransmitted as usual.
  */
 
+#define FRAGMENT_BIT (1U << 30)
+#define FRAGMENT_MORE 0x8000
+#define FRAGMENT_SIZE (MAX_MSGLEN - 16)
+
 cvar_t *showpackets;
 cvar_t *showdrop;
 cvar_t *qport;
 
 netadr_t net_from;
 sizebuf_t net_message;
-byte net_message_buffer[MAX_MSGLEN];
+byte net_message_buffer[MAX_FRAGMENTED_MSGLEN];
 
 void
 Netchan_Init(void)
@@ -172,11 +185,63 @@ Netchan_Setup(netsrc_t sock, netchan_t *chan, netadr_t adr, int qport)
 	chan->last_received = curtime;
 	chan->incoming_sequence = 0;
 	chan->outgoing_sequence = 1;
+	chan->maxmsglen = MAX_MSGLEN;
 
-	SZ_Init(&chan->message, chan->message_buf, sizeof(chan->message_buf));
+	SZ_Init(&chan->message, chan->message_buf, MAX_MSGLEN - 16);
 	chan->message.allowoverflow = true;
 }
 
+/*
+ * Lets the channel send messages of up to maxmsglen
+ * bytes. Only call it if the other side can put
+ * fragments back together.
+ */
+void
+Netchan_EnableFragments(netchan_t *chan, int maxmsglen)
+{
+	if (maxmsglen > MAX_FRAGMENTED_MSGLEN)
+	{
+		maxmsglen = MAX_FRAGMENTED_MSGLEN;
+	}
+
+	if (maxmsglen <= MAX_MSGLEN)
+	{
+		return;
+	}
+
+	chan->maxmsglen = maxmsglen;
+	chan->message.maxsize = maxmsglen - 16;
+}
+
+static void
+Netchan_TransmitFragments(netchan_t *chan, sizebuf_t *send, int headerlen)
+{
+	sizebuf_t frag;
+	byte frag_buf[MAX_MSGLEN];
+	int offset, chunk;
+
+	for (offset = headerlen; offset < send->cursize; offset += chunk)
+	{
+		chunk = send->cursize - offset;
+
+		if (chunk > FRAGMENT_SIZE)
+		{
+			chunk = FRAGMENT_SIZE;
+		}
+
+		SZ_Init(&frag, frag_buf, sizeof(frag_buf));
+		SZ_Write(&frag, send->data, headerlen);
+		frag.data[3] |= FRAGMENT_BIT >> 24;
+
+		MSG_WriteShort(&frag, (offset - headerlen) |
+				((offset + chunk < send->cursize) ? FRAGMENT_MORE : 0));
+		SZ_Write(&frag, send->data + offset, chunk);
+
+		NET_SendPacket(chan->sock, frag.cursize, frag.data,
+				chan->remote_address);
+	}
+}
+
 /*
  * Returns true if the last reliable message has acked
  */
@@ -224,9 +289,10 @@ void
 Netchan_Transmit(netchan_t *chan, int length, byte *data)
 {
 	sizebuf_t send;
-	byte send_buf[MAX_MSGLEN];
+	byte send_buf[MAX_FRAGMENTED_MSGLEN];
 	qboolean send_reliable;
-	unsigned w1, w2;
+	unsigned w1, w2, mask;
+	int headerlen;
 
 	/* check for message overflow */
 	if (chan->message.overflowed)
@@ -248,9 +314,12 @@ Netchan_Transmit(netchan_t *chan, int length, byte *data)
 	}
 
 	/* write the packet header */
-	SZ_Init(&send, send_buf, sizeof(send_buf));
+	SZ_Init(&send, send_buf, chan->maxmsglen);
 
-	w1 = (chan->outgoing_sequence & ~(1U << 31)) | (send_reliable << 31);
+	/* bit 30 marks fragments if the other side knows them */
+	mask = (chan->maxmsglen > MAX_MSGLEN) ? (FRAGMENT_BIT - 1) : ~(1U << 31);
+
+	w1 = (chan->outgoing_sequence & mask) | (send_reliable << 31);
 	w2 =
 		(chan->incoming_sequence &
 	~(1U << 31)) | (chan->incoming_reliable_sequence << 31);
@@ -267,6 +336,8 @@ Netchan_Transmit(netchan_t *chan, int length, byte *data)
 		MSG_WriteShort(&send, qport->value);
 	}
 
+	headerlen = send.cursize;
+
 	/* copy the reliable message to the packet first */
 	if (send_reliable)
 	{
@@ -285,7 +356,15 @@ Netchan_Transmit(netchan_t *chan, int length, byte *data)
 	}
 
 	/* send the datagram */
-	NET_SendPacket(chan->sock, send.cursize, send.data, chan->remote_address);
+	if (send.cursize > MAX_MSGLEN)
+	{
+		Netchan_TransmitFragments(chan, &send, headerlen);
+	}
+	else
+	{
+		NET_SendPacket(chan->sock, send.cursize, send.data,
+				chan->remote_address);
+	}
 
 	if (showpackets->value)
 	{
@@ -315,6 +394,8 @@ Netchan_Process(netchan_t *chan, sizebuf_t *msg)
 {
 	unsigned sequence, sequence_ack;
 	unsigned reliable_ack, reliable_message;
+	qboolean fragment;
+	int headerlen, offset, chunk;
 
 	/* get sequence numbers */
 	MSG_BeginReading(msg);
@@ -333,6 +414,14 @@ Netchan_Process(netchan_t *chan, sizebuf_t *msg)
 	sequence &= ~(1U << 31);
 	sequence_ack &= ~(1U << 31);
 
+	fragment = false;
+
+	if (chan->maxmsglen > MAX_MSGLEN)
+	{
+		fragment = (sequence & FRAGMENT_BIT) != 0;
+		sequence &= ~FRAGMENT_BIT;
+	}
+
 	if (showpackets->value)
 	{
 		if (reliable_message)
@@ -363,6 +452,52 @@ Netchan_Process(netchan_t *chan, sizebuf_t *msg)
 		return false;
 	}
 
+	if (fragment)
+	{
+		headerlen = msg->readcount;
+		offset = MSG_ReadShort(msg) & 0xffff;
+		chunk = msg->cursize - msg->readcount;
+
+		if (sequence != chan->fragment_sequence)
+		{
+			chan->fragment_sequence = sequence;
+			chan->fragment_length = 0;
+		}
+
+		/* a missing fragment loses the whole message */
+		if (((offset & ~FRAGMENT_MORE) != chan->fragment_length) ||
+			(chunk < 0) ||
+			(chan->fragment_length + chunk > chan->maxmsglen) ||
+			(headerlen + chan->fragment_length + chunk > msg->maxsize))
+		{
+			if (showdrop->value)
+			{
+				Com_Printf("%s:Dropped fragment of %i at %i\n",
+						NET_AdrToString(chan->remote_address),
+						sequence, offset & ~FRAGMENT_MORE);
+			}
+
+			chan->fragment_length = 0;
+			return false;
+		}
+
+		memcpy(chan->fragment_buf + chan->fragment_length,
+				msg->data + msg->readcount, chunk);
+		chan->fragment_length += chunk;
+
+		if (offset & FRAGMENT_MORE)
+		{
+			return false;
+		}
+
+		/* continue as if it came in one piece */
+		memcpy(msg->data + headerlen, chan->fragment_buf,
+				chan->fragment_length);
+		msg->cursize = headerlen + chan->fragment_length;
+		msg->readcount = headerlen;
+		chan->fragment_length = 0;
+	}
+
 	/* dropped packets don't keep the message from being used */
 	chan->dropped = sequence - (chan->incoming_sequence + 1);
 
@@ -13,51 +13,207 @@
 
 /* ============================================================================
  * MEMORY ALLOCATION
+ *
+ * A parsed tree is carved out of a chain of arena chunks. The root is the
+ * first allocation in the first chunk, so JSON_Free() can find the chain
+ * from the root alone and release the whole tree without walking it.
  * ============================================================================ */
 
-static json_value_t *
-json_alloc_value(void)
+#define JSON_ALIGN(x) (((x) + 15) & ~(size_t)15)
+#define JSON_MIN_CHUNK (16 * 1024)
+#define JSON_MIN_STACK 64
+
+struct json_chunk_s {
+	json_chunk_t *next;
+	size_t size;
+	size_t used;
+};
+
+static json_chunk_t *
+json_new_chunk(json_parser_t *p, size_t size)
 {
-	json_value_t *val = (json_value_t *)malloc(sizeof(json_value_t));
-	if (val)
+	json_chunk_t *chunk;
+
+	chunk = (json_chunk_t *)malloc(size);
+	if (!chunk)
+	{
+		return NULL;
+	}
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = JSON_ALIGN(sizeof(json_chunk_t));
+
+	if (p->current)
+	{
+		p->current->next = chunk;
+	}
+	else
 	{
-		memset(val, 0, sizeof(json_value_t));
+		p->chunks = chunk;
 	}
-	return val;
+
+	p->current = chunk;
+	return chunk;
 }
 
-static qboolean
-json_grow_children(json_value_t *val)
+static void
+json_free_chunks(json_chunk_t *chunk)
 {
-	int new_cap;
-	json_value_t *new_children;
+	json_chunk_t *next;
 
-	if (val->child_capacity == 0)
+	while (chunk)
 	{
-		new_cap = 8;
+		next = chunk->next;
+		free(chunk);
+		chunk = next;
 	}
-	else
+}
+
+static void *
+json_alloc(json_parser_t *p, size_t size)
+{
+	json_chunk_t *chunk = p->current;
+	size_t needed;
+	void *mem;
+
+	size = JSON_ALIGN(size);
+
+	if (chunk->used + size > chunk->size)
 	{
-		new_cap = val->child_capacity * 2;
+		/* Each new chunk doubles the last one, so a tree needs few of them */
+		needed = JSON_ALIGN(sizeof(json_chunk_t)) + size;
+
+		chunk = json_new_chunk(p, (chunk->size * 2 > needed) ? chunk->size * 2 : needed);
+		if (!chunk)
+		{
+			return NULL;
+		}
 	}
 
-	if (new_cap > JSON_MAX_CHILDREN)
+	mem = (byte *)chunk + chunk->used;
+	chunk->used += size;
+	return mem;
+}
+
+/* Pushes a finished member of the innermost open container */
+static qboolean
+json_push(json_parser_t *p, const json_value_t *val)
+{
+	json_value_t *stack;
+	int size;
+
+	if (p->stack_count == p->stack_size)
 	{
-		new_cap = JSON_MAX_CHILDREN;
-		if (val->child_count >= new_cap)
+		size = p->stack_size ? p->stack_size * 2 : JSON_MIN_STACK;
+
+		stack = (json_value_t *)realloc(p->stack, size * sizeof(json_value_t));
+		if (!stack)
 		{
 			return false;
 		}
+
+		p->stack = stack;
+		p->stack_size = size;
+	}
+
+	p->stack[p->stack_count++] = *val;
+	return true;
+}
+
+static unsigned
+json_hash_key(const char *key, int len)
+{
+	unsigned hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Indexes the members of a large object. When a key
+ * is repeated the first member keeps it, just like a
+ * linear search would.
+ */
+static qboolean
+json_index_members(json_parser_t *p, json_value_t *obj)
+{
+	json_value_t *child;
+	unsigned slot;
+	int size, i;
+
+	for (size = 16; size < obj->child_count * 2; size *= 2)
+	{
 	}
 
-	new_children = (json_value_t *)realloc(val->children, new_cap * sizeof(json_value_t));
-	if (!new_children)
+	obj->member_index = (unsigned short *)json_alloc(p, size * sizeof(unsigned short));
+	if (!obj->member_index)
 	{
 		return false;
 	}
 
-	val->children = new_children;
-	val->child_capacity = new_cap;
+	memset(obj->member_index, 0, size * sizeof(unsigned short));
+	obj->member_mask = size - 1;
+
+	for (i = 0; i < obj->child_count; i++)
+	{
+		child = &obj->children[i];
+		slot = json_hash_key(child->key, strlen(child->key)) & obj->member_mask;
+
+		while (obj->member_index[slot])
+		{
+			if (strcmp(obj->children[obj->member_index[slot] - 1].key, child->key) == 0)
+			{
+				break;
+			}
+
+			slot = (slot + 1) & obj->member_mask;
+		}
+
+		if (!obj->member_index[slot])
+		{
+			obj->member_index[slot] = (unsigned short)(i + 1);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Moves the members pushed since 'base' into the
+ * arena and hands them to the container.
+ */
+static qboolean
+json_pop_children(json_parser_t *p, json_value_t *val, int base)
+{
+	int count = p->stack_count - base;
+
+	p->stack_count = base;
+
+	if (!count)
+	{
+		return true;
+	}
+
+	val->children = (json_value_t *)json_alloc(p, count * sizeof(json_value_t));
+	if (!val->children)
+	{
+		return false;
+	}
+
+	memcpy(val->children, &p->stack[base], count * sizeof(json_value_t));
+	val->child_count = count;
+
+	if (val->type == JSON_OBJECT && count >= JSON_HASH_MIN_MEMBERS)
+	{
+		return json_index_members(p, val);
+	}
+
 	return true;
 }
 
@@ -130,9 +286,13 @@ json_expect(json_parser_t *p, char expected)
 
 /* ============================================================================
  * VALUE PARSING
+ *
+ * Values are parsed into a caller supplied node. Containers push their
+ * members onto the parser stack and move them into the arena in one piece
+ * once they're closed, so every children array is allocated exactly once.
  * ============================================================================ */
 
-static json_value_t *json_parse_value(json_parser_t *p);
+static qboolean json_parse_value(json_parser_t *p, json_value_t *val);
 
 static qboolean
 json_parse_string_into(json_parser_t *p, char *buf, int buf_size)
@@ -189,30 +349,9 @@ json_parse_string_into(json_parser_t *p, char *buf, int buf_size)
 	return false;
 }
 
-static json_value_t *
-json_parse_string(json_parser_t *p)
-{
-	json_value_t *val = json_alloc_value();
-	if (!val)
-	{
-		json_error(p, "Out of memory");
-		return NULL;
-	}
-
-	val->type = JSON_STRING;
-	if (!json_parse_string_into(p, val->string_val, JSON_MAX_STRING))
-	{
-		free(val);
-		return NULL;
-	}
-
-	return val;
-}
-
-static json_value_t *
-json_parse_number(json_parser_t *p)
+static qboolean
+json_parse_number(json_parser_t *p, json_value_t *val)
 {
-	json_value_t *val;
 	char buf[64];
 	int i = 0;
 	char c;
@@ -237,114 +376,83 @@ json_parse_number(json_parser_t *p)
 	if (i == 0)
 	{
 		json_error(p, "Invalid number");
-		return NULL;
-	}
-
-	val = json_alloc_value();
-	if (!val)
-	{
-		json_error(p, "Out of memory");
-		return NULL;
+		return false;
 	}
 
 	val->type = JSON_NUMBER;
 	val->number_val = atof(buf);
-	return val;
+	return true;
 }
 
-static json_value_t *
-json_parse_literal(json_parser_t *p)
+static qboolean
+json_parse_literal(json_parser_t *p, json_value_t *val)
 {
-	json_value_t *val;
-
 	json_skip_whitespace(p);
 
 	if (strncmp(&p->text[p->pos], "true", 4) == 0)
 	{
 		p->pos += 4;
-		val = json_alloc_value();
-		if (val)
-		{
-			val->type = JSON_BOOL;
-			val->bool_val = true;
-		}
-		return val;
+		val->type = JSON_BOOL;
+		val->bool_val = true;
+		return true;
 	}
 
 	if (strncmp(&p->text[p->pos], "false", 5) == 0)
 	{
 		p->pos += 5;
-		val = json_alloc_value();
-		if (val)
-		{
-			val->type = JSON_BOOL;
-			val->bool_val = false;
-		}
-		return val;
+		val->type = JSON_BOOL;
+		val->bool_val = false;
+		return true;
 	}
 
 	if (strncmp(&p->text[p->pos], "null", 4) == 0)
 	{
 		p->pos += 4;
-		val = json_alloc_value();
-		if (val)
-		{
-			val->type = JSON_NULL;
-		}
-		return val;
+		val->type = JSON_NULL;
+		return true;
 	}
 
 	json_error(p, "Invalid literal");
-	return NULL;
+	return false;
 }
 
-static json_value_t *
-json_parse_array(json_parser_t *p)
+static qboolean
+json_parse_array(json_parser_t *p, json_value_t *val)
 {
-	json_value_t *val;
-	json_value_t *child;
+	json_value_t child;
+	int base = p->stack_count;
 
 	if (!json_expect(p, '['))
 	{
-		return NULL;
+		return false;
 	}
 
-	val = json_alloc_value();
-	if (!val)
-	{
-		json_error(p, "Out of memory");
-		return NULL;
-	}
 	val->type = JSON_ARRAY;
 
 	if (json_peek(p) == ']')
 	{
 		json_consume(p);
-		return val;
+		return true;
 	}
 
 	while (!p->has_error)
 	{
-		child = json_parse_value(p);
-		if (!child)
+		if (!json_parse_value(p, &child))
 		{
-			JSON_Free(val);
-			return NULL;
+			return false;
 		}
 
-		if (val->child_count >= val->child_capacity)
+		if (p->stack_count - base >= JSON_MAX_CHILDREN)
 		{
-			if (!json_grow_children(val))
-			{
-				json_error(p, "Too many array elements");
-				JSON_Free(val);
-				return NULL;
-			}
+			json_error(p, "Too many array elements");
+			return false;
 		}
 
-		memcpy(&val->children[val->child_count], child, sizeof(json_value_t));
-		val->child_count++;
-		free(child);
+		if (!json_push(p, &child))
+		{
+			json_error(p, "Out of memory");
+			return false;
+		}
 
 		if (json_peek(p) == ',')
 		{
@@ -358,37 +466,36 @@ json_parse_array(json_parser_t *p)
 
 	if (!json_expect(p, ']'))
 	{
-		JSON_Free(val);
-		return NULL;
+		return false;
+	}
+
+	if (!json_pop_children(p, val, base))
+	{
+		json_error(p, "Out of memory");
+		return false;
 	}
 
-	return val;
+	return true;
 }
 
-static json_value_t *
-json_parse_object(json_parser_t *p)
+static qboolean
+json_parse_object(json_parser_t *p, json_value_t *val)
 {
-	json_value_t *val;
-	json_value_t *child;
+	json_value_t child;
 	char key[JSON_MAX_KEY];
+	int base = p->stack_count;
 
 	if (!json_expect(p, '{'))
 	{
-		return NULL;
+		return false;
 	}
 
-	val = json_alloc_value();
-	if (!val)
-	{
-		json_error(p, "Out of memory");
-		return NULL;
-	}
 	val->type = JSON_OBJECT;
 
 	if (json_peek(p) == '}')
 	{
 		json_consume(p);
-		return val;
+		return true;
 	}
 
 	while (!p->has_error)
@@ -396,41 +503,34 @@ json_parse_object(json_parser_t *p)
 		/* Parse key */
 		if (!json_parse_string_into(p, key, JSON_MAX_KEY))
 		{
-			JSON_Free(val);
-			return NULL;
+			return false;
 		}
 
 		if (!json_expect(p, ':'))
 		{
-			JSON_Free(val);
-			return NULL;
+			return false;
 		}
 
 		/* Parse value */
-		child = json_parse_value(p);
-		if (!child)
+		if (!json_parse_value(p, &child))
 		{
-			JSON_Free(val);
-			return NULL;
+			return false;
 		}
 
 		/* Store key in child */
-		Q_strlcpy(child->key, key, JSON_MAX_KEY);
+		Q_strlcpy(child.key, key, JSON_MAX_KEY);
 
-		if (val->child_count >= val->child_capacity)
+		if (p->stack_count - base >= JSON_MAX_CHILDREN)
 		{
-			if (!json_grow_children(val))
-			{
-				json_error(p, "Too many object members");
-				free(child);
-				JSON_Free(val);
-				return NULL;
-			}
+			json_error(p, "Too many object members");
+			return false;
 		}
 
-		memcpy(&val->children[val->child_count], child, sizeof(json_value_t));
-		val->child_count++;
-		free(child);
+		if (!json_push(p, &child))
+		{
+			json_error(p, "Out of memory");
+			return false;
+		}
 
 		if (json_peek(p) == ',')
 		{
@@ -444,33 +544,53 @@ json_parse_object(json_parser_t *p)
 
 	if (!json_expect(p, '}'))
 	{
-		JSON_Free(val);
-		return NULL;
+		return false;
 	}
 
-	return val;
+	if (!json_pop_children(p, val, base))
+	{
+		json_error(p, "Out of memory");
+		return false;
+	}
+
+	return true;
 }
 
-static json_value_t *
-json_parse_value(json_parser_t *p)
+static qboolean
+json_parse_value(json_parser_t *p, json_value_t *val)
 {
+	qboolean ok;
 	char c;
 
 	if (p->has_error)
 	{
-		return NULL;
+		return false;
 	}
 
+	memset(val, 0, sizeof(*val));
+
 	c = json_peek(p);
 
 	switch (c)
 	{
-		case '{': return json_parse_object(p);
-		case '[': return json_parse_array(p);
-		case '"': return json_parse_string(p);
+		case '{':
+		case '[':
+			if (p->depth >= JSON_MAX_DEPTH)
+			{
+				json_error(p, "Nested too deeply");
+				return false;
+			}
+
+			p->depth++;
+			ok = (c == '{') ? json_parse_object(p, val) : json_parse_array(p, val);
+			p->depth--;
+			return ok;
+		case '"':
+			val->type = JSON_STRING;
+			return json_parse_string_into(p, val->string_val, JSON_MAX_STRING);
 		case 't':
 		case 'f':
-		case 'n': return json_parse_literal(p);
+		case 'n': return json_parse_literal(p, val);
 		case '-':
 		case '0':
 		case '1':
@@ -481,10 +601,10 @@ json_parse_value(json_parser_t *p)
 		case '6':
 		case '7':
 		case '8':
-		case '9': return json_parse_number(p);
+		case '9': return json_parse_number(p, val);
 		default:
 			json_error(p, "Unexpected character");
-			return NULL;
+			return false;
 	}
 }
 
@@ -497,6 +617,7 @@ JSON_Parse(const char *text, char *error_out, int error_size)
 {
 	json_parser_t parser;
 	json_value_t *result;
+	size_t size;
 
 	if (!text)
 	{
@@ -511,48 +632,39 @@ JSON_Parse(const char *text, char *error_out, int error_size)
 	parser.text = text;
 	parser.len = strlen(text);
 
-	result = json_parse_value(&parser);
-
-	if (parser.has_error)
+	/* Roughly one node per 16 bytes of text, so most trees fit in one chunk */
+	size = JSON_ALIGN(sizeof(json_chunk_t)) + (parser.len / 16 + 16) * sizeof(json_value_t);
+	if (size < JSON_MIN_CHUNK)
 	{
-		if (error_out)
-		{
-			Q_strlcpy(error_out, parser.error, error_size);
-		}
-		if (result)
-		{
-			JSON_Free(result);
-		}
-		return NULL;
+		size = JSON_MIN_CHUNK;
 	}
 
-	return result;
-}
-
-/* Internal helper to free children without freeing the node itself */
-static void
-json_free_children(json_value_t *val)
-{
-	int i;
+	result = NULL;
 
-	if (!val || !val->children)
+	if (json_new_chunk(&parser, size))
 	{
-		return;
+		result = (json_value_t *)json_alloc(&parser, sizeof(json_value_t));
+		json_parse_value(&parser, result);
 	}
+	else
+	{
+		json_error(&parser, "Out of memory");
+	}
+
+	free(parser.stack);
 
-	/* Recursively free any nested children arrays */
-	for (i = 0; i < val->child_count; i++)
+	if (parser.has_error)
 	{
-		if (val->children[i].children)
+		if (error_out)
 		{
-			json_free_children(&val->children[i]);
+			Q_strlcpy(error_out, parser.error, error_size);
 		}
+
+		json_free_chunks(parser.chunks);
+		return NULL;
 	}
 
-	/* Free the children array itself */
-	free(val->children);
-	val->children = NULL;
-	val->child_count = 0;
+	return result;
 }
 
 void
@@ -563,34 +675,66 @@ JSON_Free(json_value_t *val)
 		return;
 	}
 
-	/* Free all nested children */
-	json_free_children(val);
-
-	/* Free the root node */
-	free(val);
+	/* The root sits right behind the header of the first chunk */
+	json_free_chunks((json_chunk_t *)((byte *)val - JSON_ALIGN(sizeof(json_chunk_t))));
 }
 
-json_value_t *
-JSON_GetMember(json_value_t *obj, const char *key)
+/* Looks up the first member whose key is the 'len' characters at 'key' */
+static json_value_t *
+json_find_member(json_value_t *obj, const char *key, int len)
 {
+	json_value_t *child;
+	unsigned slot;
 	int i;
 
-	if (!obj || obj->type != JSON_OBJECT || !key)
+	if (len >= JSON_MAX_KEY)
 	{
 		return NULL;
 	}
 
+	if (obj->member_index)
+	{
+		slot = json_hash_key(key, len) & obj->member_mask;
+
+		while (obj->member_index[slot])
+		{
+			child = &obj->children[obj->member_index[slot] - 1];
+
+			if (strncmp(child->key, key, len) == 0 && child->key[len] == '\0')
+			{
+				return child;
+			}
+
+			slot = (slot + 1) & obj->member_mask;
+		}
+
+		return NULL;
+	}
+
 	for (i = 0; i < obj->child_count; i++)
 	{
-		if (strcmp(obj->children[i].key, key) == 0)
+		child = &obj->children[i];
+
+		if (strncmp(child->key, key, len) == 0 && child->key[len] == '\0')
 		{
-			return &obj->children[i];
+			return child;
 		}
 	}
 
 	return NULL;
 }
 
+json_value_t *
+JSON_GetMember(json_value_t *obj, const char *key)
+{
+	if (!obj || obj->type != JSON_OBJECT || !key)
+	{
+		return NULL;
+	}
+
+	return json_find_member(obj, key, strlen(key));
+}
+
 json_value_t *
 JSON_GetIndex(json_value_t *arr, int index)
 {
@@ -660,7 +804,6 @@ JSON_GetString(json_value_t *val, const char *default_val)
 json_value_t *
 JSON_GetPath(json_value_t *root, const char *path)
 {
-	char segment[JSON_MAX_KEY];
 	const char *p = path;
 	const char *dot;
 	json_value_t *current = root;
@@ -671,39 +814,26 @@ JSON_GetPath(json_value_t *root, const char *path)
 		return NULL;
 	}
 
+	/* Segments are matched in place, without copying them out of the path */
 	while (*p && current)
 	{
 		dot = strchr(p, '.');
-		if (dot)
-		{
-			len = dot - p;
-			if (len >= JSON_MAX_KEY)
-			{
-				len = JSON_MAX_KEY - 1;
-			}
-			strncpy(segment, p, len);
-			segment[len] = '\0';
-			p = dot + 1;
-		}
-		else
-		{
-			Q_strlcpy(segment, p, JSON_MAX_KEY);
-			p += strlen(p);
-		}
+		len = dot ? (int)(dot - p) : (int)strlen(p);
 
 		if (current->type == JSON_OBJECT)
 		{
-			current = JSON_GetMember(current, segment);
+			current = json_find_member(current, p, len);
 		}
 		else if (current->type == JSON_ARRAY)
 		{
-			int idx = atoi(segment);
-			current = JSON_GetIndex(current, idx);
+			current = JSON_GetIndex(current, atoi(p));
 		}
 		else
 		{
 			return NULL;
 		}
+
+		p += dot ? len + 1 : len;
 	}
 
 	return current;
@@ -61,7 +61,11 @@ SZ_GetSpace(sizebuf_t *buf, int length)
 
 		SZ_Clear(buf);
 		buf->overflowed = true;
-		Com_Printf("SZ_GetSpace: overflow\n");
+
+		if (!buf->silent)
+		{
+			Com_Printf("SZ_GetSpace: overflow\n");
+		}
 	}
 
 	data = buf->data + buf->cursize;
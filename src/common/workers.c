@@ -0,0 +1,233 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * A small, fixed pool of worker threads. Work is handed out as a
+ * parallel for: Workers_Run() calls func(data, i) for every i in
+ * [0, count) and returns once all of them are done. The calling
+ * thread takes part in the work, so a pool of N workers runs N + 1
+ * items at a time. Only one Workers_Run() may be in flight, and the
+ * work functions must not call back into the pool.
+ *
+ * =======================================================================
+ */
+
+#include "header/threads.h"
+#include "header/common.h"
+
+#define MAX_WORKERS 16
+
+typedef struct
+{
+	workerfunc_t func;
+	void *data;
+	int count;
+	int next;               /* next index to hand out */
+	int done;               /* indices completed */
+	unsigned generation;    /* bumped for every Workers_Run() */
+} workerjob_t;
+
+static qmutex_t workers_lock;
+static qcond_t workers_wake;  /* new job or shutdown */
+static qcond_t workers_idle;  /* last index of a job finished */
+static qboolean workers_initialized;
+static qboolean workers_quit;
+
+static qthread_t workers[MAX_WORKERS];
+static int numworkers;
+static workerjob_t job;
+
+/*
+ * Runs indices of the current job until none are left.
+ * Must be called with workers_lock held.
+ */
+static void
+Workers_Drain(void)
+{
+	while (job.next < job.count)
+	{
+		int index = job.next++;
+
+		Mutex_Unlock(&workers_lock);
+		job.func(job.data, index);
+		Mutex_Lock(&workers_lock);
+
+		if (++job.done == job.count)
+		{
+			Cond_Signal(&workers_idle);
+		}
+	}
+}
+
+static void
+Workers_Loop(void)
+{
+	unsigned seen;
+
+	Mutex_Lock(&workers_lock);
+
+	seen = job.generation;
+
+	while (1)
+	{
+		while (!workers_quit && (job.generation == seen))
+		{
+			Cond_Wait(&workers_wake, &workers_lock);
+		}
+
+		if (workers_quit)
+		{
+			break;
+		}
+
+		seen = job.generation;
+		Workers_Drain();
+	}
+
+	Mutex_Unlock(&workers_lock);
+}
+
+THREAD_FUNC(Workers_Thread)
+{
+	Workers_Loop();
+	THREAD_RETURN;
+}
+
+/*
+ * (Re)starts the pool with the given number of
+ * threads. 0 shuts it down and makes Workers_Run()
+ * execute everything on the calling thread.
+ */
+void
+Workers_Init(int count)
+{
+	if (count < 0)
+	{
+		count = 0;
+	}
+	else if (count > MAX_WORKERS)
+	{
+		Com_Printf("Workers_Init: %i workers requested, using %i\n",
+				count, MAX_WORKERS);
+		count = MAX_WORKERS;
+	}
+
+	if (count == numworkers)
+	{
+		return;
+	}
+
+	Workers_Shutdown();
+
+	if (!workers_initialized)
+	{
+		Mutex_Init(&workers_lock);
+		Cond_Init(&workers_wake);
+		Cond_Init(&workers_idle);
+		workers_initialized = true;
+	}
+
+	while (numworkers < count)
+	{
+		if (!Thread_Spawn(&workers[numworkers], Workers_Thread))
+		{
+			Com_Printf("Workers_Init: couldn't create worker thread %i\n",
+					numworkers);
+			break;
+		}
+
+		numworkers++;
+	}
+
+	if (numworkers)
+	{
+		Com_Printf("Started %i worker thread%s.\n", numworkers,
+				(numworkers == 1) ? "" : "s");
+	}
+}
+
+void
+Workers_Shutdown(void)
+{
+	int i;
+
+	if (!numworkers)
+	{
+		return;
+	}
+
+	Mutex_Lock(&workers_lock);
+	workers_quit = true;
+	Cond_Broadcast(&workers_wake);
+	Mutex_Unlock(&workers_lock);
+
+	for (i = 0; i < numworkers; i++)
+	{
+		Thread_Join(workers[i]);
+	}
+
+	numworkers = 0;
+	workers_quit = false;
+}
+
+int
+Workers_Count(void)
+{
+	return numworkers;
+}
+
+void
+Workers_Run(workerfunc_t func, void *data, int count)
+{
+	int i;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (!numworkers || (count == 1))
+	{
+		for (i = 0; i < count; i++)
+		{
+			func(data, i);
+		}
+
+		return;
+	}
+
+	Mutex_Lock(&workers_lock);
+
+	job.func = func;
+	job.data = data;
+	job.count = count;
+	job.next = 0;
+	job.done = 0;
+	job.generation++;
+
+	Cond_Broadcast(&workers_wake);
+
+	Workers_Drain();
+
+	while (job.done < job.count)
+	{
+		Cond_Wait(&workers_idle, &workers_lock);
+	}
+
+	Mutex_Unlock(&workers_lock);
+}
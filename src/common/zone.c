@@ -19,7 +19,8 @@
  *
  * =======================================================================
  *
- * Zone malloc. It's just a normal malloc with tags.
+ * Zone malloc. Allocations are grouped by tag into arenas, so a
+ * whole tag can be thrown away at once.
  *
  * =======================================================================
  */
@@ -29,18 +30,149 @@
 #include <limits.h>
 
 #define Z_MAGIC 0x1d1d
+#define Z_MAGIC_FREE 0x1d1e
 
-static zhead_t z_chain;
+/*
+ * Every tag gets its own arena. Small blocks are carved out of
+ * Z_CHUNKSIZE slabs, one free list per size class, so they never
+ * go to libc. Blocks too large for the biggest class are malloc'ed
+ * one by one and kept in a list. Z_FreeTags() hands back the slabs
+ * and the large blocks of the arena without looking at the small
+ * blocks at all.
+ */
+#define Z_CHUNKSIZE (64 * 1024)
+#define Z_NUMCLASSES 14
+
+/* block sizes, header included */
+static const int z_classes[Z_NUMCLASSES] = {
+	32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072
+};
+
+typedef struct zchunk_s
+{
+	struct zchunk_s *next;
+	void *pad; /* keeps the blocks 16 byte aligned */
+} zchunk_t;
+
+typedef struct
+{
+	short tag;
+	zchunk_t *chunks;               /* slabs of this tag */
+	byte *bump, *bumpend;           /* untouched rest of the newest slab */
+	zhead_t *free[Z_NUMCLASSES];    /* freed small blocks, by class */
+	zhead_t large;                  /* blocks above the largest class */
+	int count, bytes;               /* blocks and bytes in use */
+	int numchunks;
+	int numlarge;
+} zarena_t;
+
+static zarena_t **z_arenas;
+static int z_numarenas;
+static zarena_t *z_lastarena;
 static int z_count, z_bytes;
 
-void
-Z_Init(void)
+static int
+Z_SizeClass(int size)
 {
-	memset(&z_chain, 0, sizeof(z_chain));
+	int i;
 
-	z_chain.prev = &z_chain;
-	z_chain.next = &z_chain;
+	for (i = 0; i < Z_NUMCLASSES; i++)
+	{
+		if (size <= z_classes[i])
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static zarena_t *
+Z_FindArena(int tag, qboolean create)
+{
+	zarena_t *arena;
+	int i;
+
+	if (z_lastarena && (z_lastarena->tag == tag))
+	{
+		return z_lastarena;
+	}
+
+	for (i = 0; i < z_numarenas; i++)
+	{
+		if (z_arenas[i]->tag == tag)
+		{
+			z_lastarena = z_arenas[i];
+			return z_lastarena;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
 
+	z_arenas = realloc(z_arenas, (z_numarenas + 1) * sizeof(zarena_t *));
+	YQ2_COM_CHECK_OOM(z_arenas, "realloc()", (z_numarenas + 1) * sizeof(zarena_t *))
+
+	arena = calloc(1, sizeof(zarena_t));
+	YQ2_COM_CHECK_OOM(arena, "calloc()", sizeof(zarena_t))
+
+	arena->tag = tag;
+	arena->large.prev = &arena->large;
+	arena->large.next = &arena->large;
+
+	z_arenas[z_numarenas++] = arena;
+	z_lastarena = arena;
+
+	return arena;
+}
+
+static zhead_t *
+Z_SlabAlloc(zarena_t *arena, int cls)
+{
+	zchunk_t *chunk;
+	zhead_t *z;
+	int blocksize;
+
+	if (arena->free[cls])
+	{
+		z = arena->free[cls];
+		arena->free[cls] = z->next;
+
+		return z;
+	}
+
+	blocksize = z_classes[cls];
+
+	if (arena->bumpend - arena->bump < blocksize)
+	{
+		chunk = malloc(Z_CHUNKSIZE);
+
+		if (!chunk)
+		{
+			Com_Error(ERR_FATAL, "%s: failed to allocate %i bytes",
+					__func__, Z_CHUNKSIZE);
+			return NULL;
+		}
+
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->numchunks++;
+
+		arena->bump = (byte *)(chunk + 1);
+		arena->bumpend = (byte *)chunk + Z_CHUNKSIZE;
+	}
+
+	z = (zhead_t *)arena->bump;
+	arena->bump += blocksize;
+
+	return z;
+}
+
+void
+Z_Init(void)
+{
 	z_count = 0;
 	z_bytes = 0;
 }
@@ -48,7 +180,9 @@ Z_Init(void)
 void
 Z_Free(void *ptr)
 {
+	zarena_t *arena;
 	zhead_t *z;
+	int cls;
 
 	z = ((zhead_t *)ptr) - 1;
 
@@ -58,41 +192,102 @@ Z_Free(void *ptr)
 		return;
 	}
 
-	z->prev->next = z->next;
-	z->next->prev = z->prev;
+	arena = Z_FindArena(z->tag, false);
+
+	if (!arena)
+	{
+		Com_Error(ERR_FATAL, "%s: no arena for tag %i", __func__, z->tag);
+		return;
+	}
 
 	z_count--;
 	z_bytes -= z->size;
+	arena->count--;
+	arena->bytes -= z->size;
+
+	z->magic = Z_MAGIC_FREE;
+
+	cls = Z_SizeClass(z->size);
+
+	if (cls < 0)
+	{
+		z->prev->next = z->next;
+		z->next->prev = z->prev;
+		arena->numlarge--;
 
-	free(z);
+		free(z);
+		return;
+	}
+
+	z->next = arena->free[cls];
+	arena->free[cls] = z;
 }
 
 void
 Z_Stats_f(void)
 {
+	const zarena_t *arena;
+	int i;
+
 	Com_Printf("%i bytes in %i blocks\n", z_bytes, z_count);
+
+	for (i = 0; i < z_numarenas; i++)
+	{
+		arena = z_arenas[i];
+
+		if (!arena->count && !arena->numchunks)
+		{
+			continue;
+		}
+
+		Com_Printf("  tag %5i: %9i bytes in %6i blocks, %4i slabs (%i KB), %i large\n",
+				arena->tag, arena->bytes, arena->count, arena->numchunks,
+				arena->numchunks * (Z_CHUNKSIZE / 1024), arena->numlarge);
+	}
 }
 
 void
 Z_FreeTags(int tag)
 {
+	zarena_t *arena;
+	zchunk_t *chunk, *nextchunk;
 	zhead_t *z, *next;
 
-	for (z = z_chain.next; z != &z_chain; z = next)
+	arena = Z_FindArena(tag, false);
+
+	if (!arena)
 	{
-		next = z->next;
+		return;
+	}
 
-		if (z->tag == tag)
-		{
-			Z_Free((void *)(z + 1));
-		}
+	for (chunk = arena->chunks; chunk; chunk = nextchunk)
+	{
+		nextchunk = chunk->next;
+		free(chunk);
 	}
+
+	for (z = arena->large.next; z != &arena->large; z = next)
+	{
+		next = z->next;
+		free(z);
+	}
+
+	z_count -= arena->count;
+	z_bytes -= arena->bytes;
+
+	memset(arena, 0, sizeof(*arena));
+
+	arena->tag = tag;
+	arena->large.prev = &arena->large;
+	arena->large.next = &arena->large;
 }
 
 void *
 Z_TagMalloc(int size, int tag)
 {
+	zarena_t *arena;
 	zhead_t *z;
+	int cls;
 
 	if ((size <= 0) || ((INT_MAX - size) < sizeof(zhead_t)))
 	{
@@ -101,27 +296,41 @@ Z_TagMalloc(int size, int tag)
 	}
 
 	size = size + sizeof(zhead_t);
-	z = malloc(size);
+	arena = Z_FindArena(tag, true);
+	cls = Z_SizeClass(size);
 
-	if (!z)
+	if (cls >= 0)
 	{
-		Com_Error(ERR_FATAL, "%s: failed to allocate %i bytes", __func__, size);
-		return NULL;
+		z = Z_SlabAlloc(arena, cls);
+	}
+	else
+	{
+		z = malloc(size);
+
+		if (!z)
+		{
+			Com_Error(ERR_FATAL, "%s: failed to allocate %i bytes", __func__, size);
+			return NULL;
+		}
+
+		z->next = arena->large.next;
+		z->prev = &arena->large;
+		arena->large.next->prev = z;
+		arena->large.next = z;
+		arena->numlarge++;
 	}
 
-	memset(z, 0, size);
+	memset(z + 1, 0, size - sizeof(zhead_t));
 
 	z_count++;
 	z_bytes += size;
+	arena->count++;
+	arena->bytes += size;
+
 	z->magic = Z_MAGIC;
 	z->tag = tag;
 	z->size = size;
 
-	z->next = z_chain.next;
-	z->prev = &z_chain;
-	z_chain.next->prev = z;
-	z_chain.next = z;
-
 	return (void *)(z + 1);
 }
 
@@ -134,7 +343,10 @@ Z_Malloc(int size)
 void *
 Z_TagRealloc(void *ptr, int size, int tag)
 {
+	zarena_t *arena;
 	zhead_t *z, *zr;
+	void *copy;
+	int oldcls, newcls;
 
 	if ((size <= 0) || ((INT_MAX - size) < sizeof(zhead_t)))
 	{
@@ -156,6 +368,36 @@ Z_TagRealloc(void *ptr, int size, int tag)
 	}
 
 	size = size + sizeof(zhead_t);
+	oldcls = Z_SizeClass(z->size);
+	newcls = Z_SizeClass(size);
+
+	if ((z->tag != tag) || (oldcls != newcls))
+	{
+		/* the block moves to another size class or arena */
+		copy = Z_TagMalloc(size - sizeof(zhead_t), tag);
+		memcpy(copy, ptr, ((size < z->size) ? size : z->size) - sizeof(zhead_t));
+		Z_Free(ptr);
+
+		return copy;
+	}
+
+	arena = Z_FindArena(tag, false);
+
+	if (oldcls >= 0)
+	{
+		/* still fits the slab block */
+		if (size > z->size)
+		{
+			memset((byte *)z + z->size, 0, size - z->size);
+		}
+
+		z_bytes += size - z->size;
+		arena->bytes += size - z->size;
+		z->size = size;
+
+		return z + 1;
+	}
+
 	zr = realloc(z, size);
 
 	if (!zr)
@@ -171,8 +413,9 @@ Z_TagRealloc(void *ptr, int size, int tag)
 
 	z_bytes -= zr->size;
 	z_bytes += size;
+	arena->bytes -= zr->size;
+	arena->bytes += size;
 
-	zr->tag = tag;
 	zr->size = size;
 	zr->prev->next = zr;
 	zr->next->prev = zr;
@@ -185,4 +428,3 @@ Z_Realloc(void *ptr, int size)
 {
 	return Z_TagRealloc(ptr, size, 0);
 }
-
@@ -0,0 +1,599 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Lag compensation for instant hit weapons. At the end of every frame
+ * the origins and bounding boxes of players and monsters are recorded
+ * into a short ring of frames. When a client fires, the hulls the shot
+ * may touch are moved back to where that client saw them, a ping ago,
+ * for the duration of the trace and put back right after it.
+ *
+ * =======================================================================
+ */
+
+#include "header/local.h"
+
+#define ANTILAG_FRAMES 16       /* power of two, 1.6 seconds */
+#define ANTILAG_MAX_REWIND 64   /* entities moved back for one trace */
+#define ANTILAG_TELEPORT 256    /* farther than that in a frame isn't a move */
+
+enum
+{
+	AL_ORIGIN_X, AL_ORIGIN_Y, AL_ORIGIN_Z,
+	AL_MINS_X, AL_MINS_Y, AL_MINS_Z,
+	AL_MAXS_X, AL_MAXS_Y, AL_MAXS_Z,
+	AL_NUMFIELDS
+};
+
+typedef struct
+{
+	int framenum;               /* 0 for none */
+	int count;
+	short *entnum;              /* ascending */
+	float *freetime;            /* of the edict, differs once the slot is reused */
+	float *field[AL_NUMFIELDS];
+} antilag_frame_t;
+
+typedef struct
+{
+	edict_t *ent;
+	vec3_t origin, mins, maxs;
+	int linkcount;
+} antilag_saved_t;
+
+static antilag_frame_t antilag_frames[ANTILAG_FRAMES];
+static int antilag_newest;
+
+static struct
+{
+	int traces;
+	int candidates;
+	int rewound;
+} antilag_stats;
+
+void
+G_AntilagInit(void)
+{
+	byte *buf;
+	int i, j;
+
+	for (i = 0; i < ANTILAG_FRAMES; i++)
+	{
+		buf = gi.TagMalloc(game.maxentities *
+				(sizeof(short) + (AL_NUMFIELDS + 1) * sizeof(float)), TAG_GAME);
+
+		for (j = 0; j < AL_NUMFIELDS; j++)
+		{
+			antilag_frames[i].field[j] = (float *)buf;
+			buf += game.maxentities * sizeof(float);
+		}
+
+		antilag_frames[i].freetime = (float *)buf;
+		buf += game.maxentities * sizeof(float);
+
+		antilag_frames[i].entnum = (short *)buf;
+	}
+
+	G_AntilagClear();
+}
+
+void
+G_AntilagClear(void)
+{
+	int i;
+
+	for (i = 0; i < ANTILAG_FRAMES; i++)
+	{
+		antilag_frames[i].framenum = 0;
+		antilag_frames[i].count = 0;
+	}
+
+	antilag_newest = 0;
+}
+
+static antilag_frame_t *
+antilag_frame(int framenum)
+{
+	antilag_frame_t *frame;
+
+	if ((framenum <= 0) || (framenum > antilag_newest) ||
+		(framenum <= antilag_newest - ANTILAG_FRAMES))
+	{
+		return NULL;
+	}
+
+	frame = &antilag_frames[framenum & (ANTILAG_FRAMES - 1)];
+
+	return (frame->framenum == framenum) ? frame : NULL;
+}
+
+/*
+ * Called at the end of every frame, when
+ * everything is where the clients will see it.
+ */
+void
+G_AntilagRecord(void)
+{
+	antilag_frame_t *frame;
+	edict_t *ent;
+	int i, n;
+
+	if (!antilag_frames[0].entnum)
+	{
+		return;
+	}
+
+	/* a hole in the history would rewind across it */
+	if (level.framenum != antilag_newest + 1)
+	{
+		G_AntilagClear();
+	}
+
+	frame = &antilag_frames[level.framenum & (ANTILAG_FRAMES - 1)];
+	n = 0;
+
+	for (i = 1; i < globals.num_edicts; i++)
+	{
+		ent = &g_edicts[i];
+
+		if (!ent->inuse || (ent->solid != SOLID_BBOX) || !ent->area.prev)
+		{
+			continue;
+		}
+
+		if (!ent->client && !(ent->svflags & (SVF_MONSTER | SVF_DEADMONSTER)))
+		{
+			continue;
+		}
+
+		frame->entnum[n] = i;
+		frame->freetime[n] = ent->freetime;
+		frame->field[AL_ORIGIN_X][n] = ent->s.origin[0];
+		frame->field[AL_ORIGIN_Y][n] = ent->s.origin[1];
+		frame->field[AL_ORIGIN_Z][n] = ent->s.origin[2];
+		frame->field[AL_MINS_X][n] = ent->mins[0];
+		frame->field[AL_MINS_Y][n] = ent->mins[1];
+		frame->field[AL_MINS_Z][n] = ent->mins[2];
+		frame->field[AL_MAXS_X][n] = ent->maxs[0];
+		frame->field[AL_MAXS_Y][n] = ent->maxs[1];
+		frame->field[AL_MAXS_Z][n] = ent->maxs[2];
+		n++;
+	}
+
+	frame->count = n;
+	frame->framenum = level.framenum;
+	antilag_newest = level.framenum;
+}
+
+/*
+ * Segment against box, the segment runs from
+ * start to start + delta.
+ */
+static qboolean
+antilag_clip(const vec3_t start, const vec3_t delta,
+		const vec3_t mins, const vec3_t maxs)
+{
+	float enter, leave, t0, t1, tmp;
+	int i;
+
+	enter = 0;
+	leave = 1;
+
+	for (i = 0; i < 3; i++)
+	{
+		if (delta[i] == 0)
+		{
+			if ((start[i] < mins[i]) || (start[i] > maxs[i]))
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		t0 = (mins[i] - start[i]) / delta[i];
+		t1 = (maxs[i] - start[i]) / delta[i];
+
+		if (t0 > t1)
+		{
+			tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+
+		enter = Q_max(enter, t0);
+		leave = Q_min(leave, t1);
+
+		if (enter > leave)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static qboolean
+antilag_clip_any(const vec3_t start, vec3_t *ends, int count,
+		const vec3_t mins, const vec3_t maxs)
+{
+	vec3_t delta;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		VectorSubtract(ends[i], start, delta);
+
+		if (antilag_clip(start, delta, mins, maxs))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * G_FreeEdict() stamps the slot with the time, so a row
+ * belongs to ent if that didn't change since.
+ */
+static qboolean
+antilag_same_entity(const antilag_frame_t *frame, int row, const edict_t *ent)
+{
+	if (frame->freetime[row] != ent->freetime)
+	{
+		return false;
+	}
+
+	/* what G_AntilagRecord() keeps */
+	return ent->client || (ent->svflags & (SVF_MONSTER | SVF_DEADMONSTER));
+}
+
+/*
+ * Moves the entities the shots can touch back by lagms and
+ * returns how many were moved. Only the ones whose hull, now
+ * or back then, is on one of the segments are considered.
+ */
+static int
+antilag_rewind(int lagms, const vec3_t start, vec3_t *ends, int count,
+		const edict_t *shooter, const edict_t *passent,
+		antilag_saved_t *saved)
+{
+	antilag_frame_t *older, *newer;
+	float target, frac;
+	vec3_t origin, mins, maxs, absmin, absmax, move;
+	edict_t *ent;
+	int framenum, i, j, k, numsaved;
+
+	if (!antilag_newest || (lagms <= 0))
+	{
+		return 0;
+	}
+
+	/* antilag_newest is what the clients got last */
+	target = antilag_newest - lagms / (FRAMETIME * 1000.0f);
+	framenum = (int)floor(target);
+	frac = target - framenum;
+
+	if (framenum >= antilag_newest)
+	{
+		return 0;
+	}
+
+	if (!antilag_frame(framenum))
+	{
+		/* as far back as we can */
+		for (framenum++; framenum < antilag_newest; framenum++)
+		{
+			if (antilag_frame(framenum))
+			{
+				break;
+			}
+		}
+
+		frac = 0;
+	}
+
+	older = antilag_frame(framenum);
+	newer = antilag_frame(framenum + 1);
+
+	if (!older || !newer)
+	{
+		return 0;
+	}
+
+	numsaved = 0;
+	k = 0;
+
+	for (i = 0; i < older->count; i++)
+	{
+		/* both lists are sorted, so the same entity in
+		   the newer frame is found by walking along */
+		while ((k < newer->count) && (newer->entnum[k] < older->entnum[i]))
+		{
+			k++;
+		}
+
+		ent = &g_edicts[older->entnum[i]];
+
+		if ((ent == shooter) || (ent == passent) || !ent->inuse ||
+			(ent->solid != SOLID_BBOX) || !ent->area.prev ||
+			!antilag_same_entity(older, i, ent))
+		{
+			continue;
+		}
+
+		for (j = 0; j < 3; j++)
+		{
+			origin[j] = older->field[AL_ORIGIN_X + j][i];
+			mins[j] = older->field[AL_MINS_X + j][i];
+			maxs[j] = older->field[AL_MAXS_X + j][i];
+		}
+
+		if ((k < newer->count) && (newer->entnum[k] == older->entnum[i]) &&
+			(newer->freetime[k] == older->freetime[i]) && (frac > 0))
+		{
+			for (j = 0; j < 3; j++)
+			{
+				move[j] = newer->field[AL_ORIGIN_X + j][k] - origin[j];
+			}
+
+			if (VectorLength(move) < ANTILAG_TELEPORT)
+			{
+				VectorMA(origin, frac, move, origin);
+			}
+			else if (frac >= 0.5f)
+			{
+				VectorAdd(origin, move, origin);
+			}
+
+			/* the box only changes size when crouching */
+			if (frac >= 0.5f)
+			{
+				for (j = 0; j < 3; j++)
+				{
+					mins[j] = newer->field[AL_MINS_X + j][k];
+					maxs[j] = newer->field[AL_MAXS_X + j][k];
+				}
+			}
+		}
+
+		VectorAdd(origin, mins, absmin);
+		VectorAdd(origin, maxs, absmax);
+
+		/* where it is now has to be cleared as well */
+		if (!antilag_clip_any(start, ends, count, absmin, absmax) &&
+			!antilag_clip_any(start, ends, count, ent->absmin, ent->absmax))
+		{
+			continue;
+		}
+
+		antilag_stats.candidates++;
+
+		if (numsaved == ANTILAG_MAX_REWIND)
+		{
+			continue;
+		}
+
+		saved[numsaved].ent = ent;
+		VectorCopy(ent->s.origin, saved[numsaved].origin);
+		VectorCopy(ent->mins, saved[numsaved].mins);
+		VectorCopy(ent->maxs, saved[numsaved].maxs);
+		saved[numsaved].linkcount = ent->linkcount;
+		numsaved++;
+
+		VectorCopy(origin, ent->s.origin);
+		VectorCopy(mins, ent->mins);
+		VectorCopy(maxs, ent->maxs);
+		gi.linkentity(ent);
+	}
+
+	antilag_stats.rewound += numsaved;
+
+	return numsaved;
+}
+
+static void
+antilag_restore(antilag_saved_t *saved, int numsaved)
+{
+	edict_t *ent;
+	int i;
+
+	for (i = numsaved - 1; i >= 0; i--)
+	{
+		ent = saved[i].ent;
+		VectorCopy(saved[i].origin, ent->s.origin);
+		VectorCopy(saved[i].mins, ent->mins);
+		VectorCopy(saved[i].maxs, ent->maxs);
+		gi.linkentity(ent);
+
+		/* nobody standing on it should notice */
+		ent->linkcount = saved[i].linkcount;
+	}
+}
+
+static int
+antilag_lag(const edict_t *shooter)
+{
+	if (!g_antilag->value || !shooter || !shooter->client ||
+		!antilag_frames[0].entnum)
+	{
+		return 0;
+	}
+
+	return Q_clamp(shooter->client->ping, 0, (int)g_antilag_maxms->value);
+}
+
+static void
+antilag_trace_batch(int lagms, const edict_t *shooter, vec3_t start,
+		vec3_t *ends, int count, edict_t *passent, int mask,
+		trace_t *results)
+{
+	antilag_saved_t saved[ANTILAG_MAX_REWIND];
+	int numsaved;
+
+	antilag_stats.traces += count;
+	numsaved = antilag_rewind(lagms, start, ends, count, shooter,
+			passent, saved);
+
+	if (count == 1)
+	{
+		results[0] = gi.trace(start, NULL, NULL, ends[0], passent, mask);
+	}
+	else
+	{
+		gi.trace_batch(start, NULL, NULL, ends, count, passent, mask, results);
+	}
+
+	antilag_restore(saved, numsaved);
+}
+
+/*
+ * gi.trace() for an instant hit shot of shooter.
+ */
+trace_t
+G_AntilagTrace(edict_t *shooter, vec3_t start, vec3_t end,
+		edict_t *passent, int mask)
+{
+	trace_t tr;
+	int lagms;
+
+	lagms = antilag_lag(shooter);
+
+	if (!lagms)
+	{
+		return gi.trace(start, NULL, NULL, end, passent, mask);
+	}
+
+	antilag_trace_batch(lagms, shooter, start, (vec3_t *)end, 1,
+			passent, mask, &tr);
+
+	return tr;
+}
+
+/*
+ * gi.trace_batch() for shots of shooter that
+ * leave the same muzzle at once.
+ */
+void
+G_AntilagTraceBatch(edict_t *shooter, vec3_t start, vec3_t *ends,
+		int count, edict_t *passent, int mask, trace_t *results)
+{
+	int lagms;
+
+	lagms = antilag_lag(shooter);
+
+	if (!lagms)
+	{
+		gi.trace_batch(start, NULL, NULL, ends, count, passent, mask, results);
+		return;
+	}
+
+	antilag_trace_batch(lagms, shooter, start, ends, count, passent,
+			mask, results);
+}
+
+/*
+ * sv bench_antilag [shots] [ms]
+ *
+ * Fires shots through the recorded entities, once
+ * straight and once rewound by ms.
+ */
+void
+Svcmd_BenchAntilag_f(void)
+{
+	static vec3_t starts[1024], ends[1024];
+	antilag_frame_t *frame;
+	trace_t tr;
+	vec3_t dir;
+	clock_t start;
+	double plain_ms, rewound_ms;
+	int count, lagms, i, j, n, hits_plain, hits_rewound;
+
+	count = (gi.argc() > 2) ? atoi(gi.argv(2)) : 500;
+	lagms = (gi.argc() > 3) ? atoi(gi.argv(3)) : 100;
+	count = Q_clamp(count, 1, (int)(sizeof(starts) / sizeof(starts[0])));
+	lagms = Q_clamp(lagms, 1, ANTILAG_FRAMES * 100 - 100);
+
+	frame = antilag_frame(antilag_newest);
+
+	if (!frame || !frame->count)
+	{
+		gi.cprintf(NULL, PRINT_HIGH, "Nothing recorded yet.\n");
+		return;
+	}
+
+	/* aim at someone, from a bit away */
+	for (i = 0; i < count; i++)
+	{
+		n = randk() % frame->count;
+
+		for (j = 0; j < 3; j++)
+		{
+			dir[j] = crandk();
+			ends[i][j] = frame->field[AL_ORIGIN_X + j][n];
+		}
+
+		dir[2] *= 0.25f;
+		VectorNormalize(dir);
+		VectorMA(ends[i], 512, dir, starts[i]);
+		VectorMA(ends[i], -512, dir, ends[i]);
+	}
+
+	hits_plain = 0;
+	start = clock();
+
+	for (i = 0; i < count; i++)
+	{
+		tr = gi.trace(starts[i], NULL, NULL, ends[i], NULL, MASK_SHOT);
+
+		if (tr.ent && (tr.ent != world))
+		{
+			hits_plain++;
+		}
+	}
+
+	plain_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	memset(&antilag_stats, 0, sizeof(antilag_stats));
+	hits_rewound = 0;
+	start = clock();
+
+	for (i = 0; i < count; i++)
+	{
+		antilag_trace_batch(lagms, NULL, starts[i], &ends[i], 1, NULL,
+				MASK_SHOT, &tr);
+
+		if (tr.ent && (tr.ent != world))
+		{
+			hits_rewound++;
+		}
+	}
+
+	rewound_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	gi.cprintf(NULL, PRINT_HIGH, "%i shots, %i ms back, %i recorded entities\n",
+			count, lagms, frame->count);
+	gi.cprintf(NULL, PRINT_HIGH, "plain:   %8.3f ms, %i hits\n",
+			plain_ms, hits_plain);
+	gi.cprintf(NULL, PRINT_HIGH, "rewound: %8.3f ms, %i hits\n",
+			rewound_ms, hits_rewound);
+	gi.cprintf(NULL, PRINT_HIGH, "%.2f candidates, %.2f rewound per shot\n",
+			(float)antilag_stats.candidates / count,
+			(float)antilag_stats.rewound / count);
+}
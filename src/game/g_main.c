@@ -83,6 +83,7 @@ cvar_t *flood_persecond;
 cvar_t *flood_waitdelay;
 
 cvar_t *sv_maplist;
+cvar_t *sv_profile;
 
 cvar_t *gib_on;
 
@@ -90,6 +91,8 @@ cvar_t *aimfix;
 cvar_t *g_machinegun_norecoil;
 cvar_t *g_quick_weap;
 cvar_t *g_swap_speed;
+cvar_t *g_antilag;
+cvar_t *g_antilag_maxms;
 
 static void G_RunFrame(void);
 
@@ -506,6 +509,9 @@ G_RunFrame(void)
 		G_RunEntity(ent);
 	}
 
+	/* pick up edicts renamed behind the G_Find index' back */
+	G_SyncFindIndex();
+
 	/* see if it is time to end a deathmatch */
 	CheckDMRules();
 
@@ -514,4 +520,7 @@ G_RunFrame(void)
 
 	/* build the playerstate_t structures for all players */
 	ClientEndServerFrames();
+
+	/* remember where everyone is for lag compensation */
+	G_AntilagRecord();
 }
@@ -601,7 +601,17 @@ monster_think(edict_t *self)
 		return;
 	}
 
-	M_MoveFrame(self);
+	/* per monster type, the AI runs from M_MoveFrame() */
+	if (sv_profile->value)
+	{
+		gi.profile_begin(self->classname);
+		M_MoveFrame(self);
+		gi.profile_end();
+	}
+	else
+	{
+		M_MoveFrame(self);
+	}
 
 	if (self->linkcount != self->monsterinfo.linkcount)
 	{
@@ -134,7 +134,16 @@ SV_RunThink(edict_t *ent)
 		return false;
 	}
 
-	ent->think(ent);
+	if (sv_profile->value)
+	{
+		gi.profile_begin(G_FunctionName(ent->think));
+		ent->think(ent);
+		gi.profile_end();
+	}
+	else
+	{
+		ent->think(ent);
+	}
 
 	return false;
 }
@@ -503,6 +503,8 @@ ED_ParseEdict(char *data, edict_t *ent)
 		memset(ent, 0, sizeof(*ent));
 	}
 
+	G_TouchEdict(ent);
+
 	return data;
 }
 
@@ -616,6 +618,9 @@ SpawnEntities(const char *mapname, char *entities, const char *spawnpoint)
 
 	memset(&level, 0, sizeof(level));
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
+	G_ClearFindIndex();
+	FirePuddle_ClearRegistry();
+	G_AntilagClear();
 
 	Q_strlcpy(level.mapname, mapname, sizeof(level.mapname));
 	Q_strlcpy(game.spawnpoint, spawnpoint, sizeof(game.spawnpoint));
@@ -709,6 +714,7 @@ SpawnEntities(const char *mapname, char *entities, const char *spawnpoint)
 
 	gi.dprintf("%i entities inhibited.\n", inhibit);
 
+	G_SyncFindIndex();
 	G_FindTeams();
 
 	PlayerTrail_Init();
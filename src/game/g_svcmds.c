@@ -357,6 +357,18 @@ ServerCommand(void)
 	{
 		PP_Cmd_WeaponProfile();
 	}
+	else if (Q_stricmp(cmd, "puddlestats") == 0)
+	{
+		Svcmd_PuddleStats_f();
+	}
+	else if (Q_stricmp(cmd, "bench_radius") == 0)
+	{
+		Svcmd_BenchRadius_f();
+	}
+	else if (Q_stricmp(cmd, "bench_antilag") == 0)
+	{
+		Svcmd_BenchAntilag_f();
+	}
 	else
 	{
 		gi.cprintf(NULL, PRINT_HIGH, "Unknown server command \"%s\"\n", cmd);
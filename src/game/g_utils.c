@@ -24,6 +24,9 @@
  * =======================================================================
  */
 
+#include <ctype.h>
+#include <time.h>
+
 #include "header/local.h"
 
 #define MAXCHOICES 8
@@ -38,6 +41,314 @@ G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward,
 				distance[2];
 }
 
+/*
+ * G_Find index. Edicts are bucketed by the interned value of the
+ * string fields G_Find is used with (classname and targetname), so
+ * a lookup only walks the edicts holding that value, in edict order.
+ * Most writes to these fields happen right after G_Spawn(), so every
+ * initialized edict is put on a touched list which is rechecked
+ * before each lookup. Writes nobody told us about are picked up by
+ * the sweep at the end of the frame in G_SyncFindIndex().
+ */
+
+#define FINDINDEX_FIELDS 2
+#define FINDINDEX_HASH 1024 /* must be a power of two */
+
+typedef struct findkey_s
+{
+	struct findkey_s *hashnext;
+	int field;
+	unsigned hash;
+	int head; /* lowest edict holding the value, -1 if none */
+	char value[1];
+} findkey_t;
+
+typedef struct
+{
+	findkey_t *key;
+	char *value; /* field contents at index time */
+	int prev;
+	int next;
+} findlink_t;
+
+static findkey_t *findkeys[FINDINDEX_HASH];
+static findlink_t *findlinks[FINDINDEX_FIELDS];
+static int *findtouched;
+static byte *findtouchedflag;
+static int numfindtouched;
+
+static int
+FindIndex_Field(int fieldofs)
+{
+	if (fieldofs == FOFS(classname))
+	{
+		return 0;
+	}
+	else if (fieldofs == FOFS(targetname))
+	{
+		return 1;
+	}
+
+	return -1;
+}
+
+static char *
+FindIndex_Value(edict_t *ent, int field)
+{
+	if (!ent->inuse)
+	{
+		return NULL;
+	}
+
+	return field ? ent->targetname : ent->classname;
+}
+
+static unsigned
+FindIndex_Hash(int field, const char *s)
+{
+	unsigned hash = field;
+
+	while (*s)
+	{
+		hash = hash * 31 + tolower((unsigned char)*s++);
+	}
+
+	return hash;
+}
+
+static findkey_t *
+FindIndex_Key(int field, const char *value, qboolean create)
+{
+	findkey_t *key;
+	unsigned hash;
+	size_t len;
+
+	hash = FindIndex_Hash(field, value);
+
+	for (key = findkeys[hash & (FINDINDEX_HASH - 1)]; key; key = key->hashnext)
+	{
+		if ((key->hash == hash) && (key->field == field) &&
+			!Q_stricmp(key->value, value))
+		{
+			return key;
+		}
+	}
+
+	if (!create)
+	{
+		return NULL;
+	}
+
+	len = strlen(value);
+	key = gi.TagMalloc(sizeof(*key) + len, TAG_LEVEL);
+	key->field = field;
+	key->hash = hash;
+	key->head = -1;
+	memcpy(key->value, value, len + 1);
+
+	key->hashnext = findkeys[hash & (FINDINDEX_HASH - 1)];
+	findkeys[hash & (FINDINDEX_HASH - 1)] = key;
+
+	return key;
+}
+
+static void
+FindIndex_Unlink(int field, int num)
+{
+	findlink_t *links = findlinks[field];
+	findlink_t *link = &links[num];
+
+	if (!link->key)
+	{
+		return;
+	}
+
+	if (link->prev >= 0)
+	{
+		links[link->prev].next = link->next;
+	}
+	else
+	{
+		link->key->head = link->next;
+	}
+
+	if (link->next >= 0)
+	{
+		links[link->next].prev = link->prev;
+	}
+
+	link->key = NULL;
+	link->prev = -1;
+	link->next = -1;
+}
+
+static void
+FindIndex_Link(int field, int num, char *value)
+{
+	findlink_t *links = findlinks[field];
+	findlink_t *link = &links[num];
+	findkey_t *key;
+	int prev, next;
+
+	key = FindIndex_Key(field, value, true);
+
+	/* keep the chain sorted, G_Find returns edicts in order */
+	prev = -1;
+
+	for (next = key->head; next >= 0 && next < num; next = links[next].next)
+	{
+		prev = next;
+	}
+
+	link->key = key;
+	link->prev = prev;
+	link->next = next;
+
+	if (prev >= 0)
+	{
+		links[prev].next = num;
+	}
+	else
+	{
+		key->head = num;
+	}
+
+	if (next >= 0)
+	{
+		links[next].prev = num;
+	}
+}
+
+static void
+FindIndex_Update(edict_t *ent)
+{
+	int field, num;
+	char *value;
+
+	num = ent - g_edicts;
+
+	for (field = 0; field < FINDINDEX_FIELDS; field++)
+	{
+		value = FindIndex_Value(ent, field);
+
+		if (findlinks[field][num].value == value)
+		{
+			continue;
+		}
+
+		FindIndex_Unlink(field, num);
+		findlinks[field][num].value = value;
+
+		if (value)
+		{
+			FindIndex_Link(field, num, value);
+		}
+	}
+}
+
+static void
+FindIndex_Flush(void)
+{
+	int i;
+
+	for (i = 0; i < numfindtouched; i++)
+	{
+		FindIndex_Update(&g_edicts[findtouched[i]]);
+	}
+}
+
+void
+G_InitFindIndex(void)
+{
+	int field;
+
+	for (field = 0; field < FINDINDEX_FIELDS; field++)
+	{
+		findlinks[field] = gi.TagMalloc(game.maxentities * sizeof(findlink_t), TAG_GAME);
+	}
+
+	findtouched = gi.TagMalloc(game.maxentities * sizeof(int), TAG_GAME);
+	findtouchedflag = gi.TagMalloc(game.maxentities, TAG_GAME);
+
+	G_ClearFindIndex();
+}
+
+/*
+ * Drops the whole index. The keys live in
+ * TAG_LEVEL, so this has to be called after
+ * the level memory was released.
+ */
+void
+G_ClearFindIndex(void)
+{
+	int field, i;
+
+	memset(findkeys, 0, sizeof(findkeys));
+
+	for (field = 0; field < FINDINDEX_FIELDS; field++)
+	{
+		for (i = 0; i < game.maxentities; i++)
+		{
+			findlinks[field][i].key = NULL;
+			findlinks[field][i].value = NULL;
+			findlinks[field][i].prev = -1;
+			findlinks[field][i].next = -1;
+		}
+	}
+
+	memset(findtouchedflag, 0, game.maxentities);
+	numfindtouched = 0;
+}
+
+/*
+ * Tells the index that the classname or
+ * targetname of an edict may have changed.
+ */
+void
+G_TouchEdict(edict_t *ent)
+{
+	int num;
+
+	if (!ent)
+	{
+		return;
+	}
+
+	num = ent - g_edicts;
+
+	if (findtouchedflag[num])
+	{
+		return;
+	}
+
+	findtouchedflag[num] = 1;
+	findtouched[numfindtouched++] = num;
+}
+
+/*
+ * Rechecks every edict against the index and
+ * forgets the touched list. Called once per
+ * frame and after the edicts were replaced
+ * wholesale (map spawn, savegame load).
+ */
+void
+G_SyncFindIndex(void)
+{
+	int i;
+
+	for (i = 0; i < globals.num_edicts; i++)
+	{
+		FindIndex_Update(&g_edicts[i]);
+	}
+
+	for (i = 0; i < numfindtouched; i++)
+	{
+		findtouchedflag[findtouched[i]] = 0;
+	}
+
+	numfindtouched = 0;
+}
+
 /*
  * Searches all active entities for the next
  * one that holds the matching string at fieldofs
@@ -50,37 +361,89 @@ G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward,
 edict_t *
 G_Find(edict_t *from, int fieldofs, const char *match)
 {
+	findlink_t *links;
+	findkey_t *key;
 	char *s;
+	int field, num;
 
 	if (!match)
 	{
 		return NULL;
 	}
 
-	if (!from)
+	field = FindIndex_Field(fieldofs);
+
+	if (field < 0)
 	{
-		from = g_edicts;
+		if (!from)
+		{
+			from = g_edicts;
+		}
+		else
+		{
+			from++;
+		}
+
+		for ( ; from < &g_edicts[globals.num_edicts]; from++)
+		{
+			if (!from->inuse)
+			{
+				continue;
+			}
+
+			s = *(char **)((byte *)from + fieldofs);
+
+			if (!s)
+			{
+				continue;
+			}
+
+			if (!Q_stricmp(s, match))
+			{
+				return from;
+			}
+		}
+
+		return NULL;
 	}
-	else
+
+	FindIndex_Flush();
+
+	key = FindIndex_Key(field, match, false);
+
+	if (!key)
 	{
-		from++;
+		return NULL;
 	}
 
-	for ( ; from < &g_edicts[globals.num_edicts]; from++)
+	links = findlinks[field];
+
+	if (from && (links[from - g_edicts].key == key))
 	{
-		if (!from->inuse)
+		num = links[from - g_edicts].next;
+	}
+	else
+	{
+		int start = from ? (from - g_edicts) + 1 : 0;
+
+		for (num = key->head; num >= 0 && num < start; num = links[num].next)
 		{
-			continue;
 		}
+	}
 
-		s = *(char **)((byte *)from + fieldofs);
+	/* entries are only dropped lazily, so double check them */
+	for ( ; num >= 0; num = links[num].next)
+	{
+		from = &g_edicts[num];
 
-		if (!s)
+		if (!from->inuse)
 		{
 			continue;
 		}
 
-		if (!Q_stricmp(s, match))
+		s = *(char **)((byte *)from + fieldofs);
+
+		if (s && !Q_stricmp(s, match))
 		{
 			return from;
 		}
@@ -93,12 +456,38 @@ G_Find(edict_t *from, int fieldofs, const char *match)
  * Returns entities that have origins
  * within a spherical area
  */
-edict_t *
-findradius(edict_t *from, vec3_t org, float rad)
+static qboolean
+findradius_test(edict_t *ent, vec3_t org, float rad)
 {
 	vec3_t eorg;
 	int j;
 
+	if (!ent->inuse)
+	{
+		return false;
+	}
+
+	if (ent->solid == SOLID_NOT)
+	{
+		return false;
+	}
+
+	for (j = 0; j < 3; j++)
+	{
+		eorg[j] = org[j] - (ent->s.origin[j] +
+				   (ent->mins[j] + ent->maxs[j]) * 0.5);
+	}
+
+	return VectorLength(eorg) <= rad;
+}
+
+/*
+ * The reference implementation, walks
+ * every edict. Kept for bench_radius.
+ */
+static edict_t *
+findradius_linear(edict_t *from, vec3_t org, float rad)
+{
 	if (!from)
 	{
 		from = g_edicts;
@@ -110,31 +499,236 @@ findradius(edict_t *from, vec3_t org, float rad)
 
 	for ( ; from < &g_edicts[globals.num_edicts]; from++)
 	{
-		if (!from->inuse)
+		if (findradius_test(from, org, rad))
 		{
-			continue;
+			return from;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * findradius() is an iterator, so the candidates
+ * of the last few queries are kept around. Each
+ * query asks the server's area tree for the
+ * solid and trigger edicts touching the bounding
+ * box of the sphere, which is exactly the set of
+ * non SOLID_NOT edicts findradius_linear() could
+ * return (plus the world, which is never linked).
+ * Several slots are needed because T_Damage() can
+ * set off another explosion in the middle of a
+ * T_RadiusDamage() loop.
+ */
+#define RADIUS_QUERIES 8
+
+typedef struct
+{
+	vec3_t org;
+	float rad;
+	int numcandidates;
+	int cursor;
+	edict_t *candidates[MAX_EDICTS];
+} radiusquery_t;
+
+static radiusquery_t radiusqueries[RADIUS_QUERIES];
+static int nextradiusquery;
+
+static int
+radiusquery_compare(const void *a, const void *b)
+{
+	return *(edict_t **)a - *(edict_t **)b;
+}
+
+static radiusquery_t *
+radiusquery_start(vec3_t org, float rad)
+{
+	radiusquery_t *q;
+	vec3_t mins, maxs;
+	int num;
+
+	q = &radiusqueries[nextradiusquery];
+	nextradiusquery = (nextradiusquery + 1) % RADIUS_QUERIES;
+
+	VectorCopy(org, q->org);
+	q->rad = rad;
+	q->cursor = 0;
+
+	mins[0] = org[0] - rad;
+	mins[1] = org[1] - rad;
+	mins[2] = org[2] - rad;
+	maxs[0] = org[0] + rad;
+	maxs[1] = org[1] + rad;
+	maxs[2] = org[2] + rad;
+
+	q->candidates[0] = g_edicts;
+	num = 1;
+	num += gi.BoxEdicts(mins, maxs, q->candidates + num,
+			MAX_EDICTS - num, AREA_SOLID);
+	num += gi.BoxEdicts(mins, maxs, q->candidates + num,
+			MAX_EDICTS - num, AREA_TRIGGERS);
+
+	/* keep the edict order of the linear walk */
+	qsort(q->candidates, num, sizeof(q->candidates[0]), radiusquery_compare);
+	q->numcandidates = num;
+
+	return q;
+}
+
+static radiusquery_t *
+radiusquery_find(edict_t *from, vec3_t org, float rad)
+{
+	radiusquery_t *q;
+	int i;
+
+	for (i = 0; i < RADIUS_QUERIES; i++)
+	{
+		q = &radiusqueries[i];
+
+		if ((q->rad == rad) && VectorCompare(q->org, org) &&
+			(q->cursor > 0) && (q->cursor <= q->numcandidates) &&
+			(q->candidates[q->cursor - 1] == from))
+		{
+			return q;
+		}
+	}
+
+	return NULL;
+}
+
+edict_t *
+findradius(edict_t *from, vec3_t org, float rad)
+{
+	radiusquery_t *q;
+	edict_t *ent;
+
+	q = from ? radiusquery_find(from, org, rad) : NULL;
+
+	if (!q)
+	{
+		q = radiusquery_start(org, rad);
+
+		/* the iteration was evicted, resume behind from */
+		while ((q->cursor < q->numcandidates) &&
+			   from && (q->candidates[q->cursor] <= from))
+		{
+			q->cursor++;
 		}
+	}
 
-		if (from->solid == SOLID_NOT)
+	while (q->cursor < q->numcandidates)
+	{
+		ent = q->candidates[q->cursor++];
+
+		if (findradius_test(ent, org, rad))
 		{
-			continue;
+			return ent;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * sv bench_radius [explosions] [radius]
+ *
+ * Runs the findradius() sweep of T_RadiusDamage()
+ * for a burst of simultaneous explosions placed
+ * around the live entities, once with the linear
+ * walk and once with the area tree, and checks
+ * that both return the same edicts.
+ */
+void
+Svcmd_BenchRadius_f(void)
+{
+	static vec3_t origins[1024];
+	int count, i, j, n, found_linear, found_tree, mismatches;
+	float rad;
+	clock_t start;
+	double linear_ms, tree_ms;
+	edict_t *ent, *ref;
+
+	count = (gi.argc() > 2) ? atoi(gi.argv(2)) : 200;
+	rad = (gi.argc() > 3) ? (float)atof(gi.argv(3)) : 256;
+	count = Q_clamp(count, 1, (int)(sizeof(origins) / sizeof(origins[0])));
+
+	/* put the explosions where the action is */
+	for (i = 0; i < count; i++)
+	{
+		ent = NULL;
+
+		for (j = 0; j < 16; j++)
+		{
+			n = 1 + randk() % (globals.num_edicts > 1 ? globals.num_edicts - 1 : 1);
+
+			if (g_edicts[n].inuse && (g_edicts[n].solid != SOLID_NOT))
+			{
+				ent = &g_edicts[n];
+				break;
+			}
 		}
 
 		for (j = 0; j < 3; j++)
 		{
-			eorg[j] = org[j] - (from->s.origin[j] +
-					   (from->mins[j] + from->maxs[j]) * 0.5);
+			origins[i][j] = (ent ? ent->s.origin[j] : 0) + crandk() * 128;
 		}
+	}
+
+	found_linear = 0;
+	start = clock();
+
+	for (i = 0; i < count; i++)
+	{
+		ent = NULL;
 
-		if (VectorLength(eorg) > rad)
+		while ((ent = findradius_linear(ent, origins[i], rad)) != NULL)
 		{
-			continue;
+			found_linear++;
 		}
+	}
+
+	linear_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	found_tree = 0;
+	start = clock();
 
-		return from;
+	for (i = 0; i < count; i++)
+	{
+		ent = NULL;
+
+		while ((ent = findradius(ent, origins[i], rad)) != NULL)
+		{
+			found_tree++;
+		}
 	}
 
-	return NULL;
+	tree_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+	mismatches = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		ent = ref = NULL;
+
+		do
+		{
+			ent = findradius(ent, origins[i], rad);
+			ref = findradius_linear(ref, origins[i], rad);
+
+			if (ent != ref)
+			{
+				mismatches++;
+				break;
+			}
+		}
+		while (ent);
+	}
+
+	gi.cprintf(NULL, PRINT_HIGH, "%i explosions, radius %g, %i edicts\n",
+			count, rad, globals.num_edicts);
+	gi.cprintf(NULL, PRINT_HIGH, "linear: %8.3f ms, %i hits\n", linear_ms, found_linear);
+	gi.cprintf(NULL, PRINT_HIGH, "tree:   %8.3f ms, %i hits\n", tree_ms, found_tree);
+	gi.cprintf(NULL, PRINT_HIGH, "%i mismatching explosions\n", mismatches);
 }
 
 /*
@@ -507,6 +1101,8 @@ G_InitEdict(edict_t *e)
 	e->classname = "noclass";
 	e->gravity = 1.0;
 	e->s.number = e - g_edicts;
+
+	G_TouchEdict(e);
 }
 
 /*
@@ -607,6 +1203,8 @@ G_FreeEdict(edict_t *ed)
 	ed->classname = "freed";
 	ed->freetime = level.time;
 	ed->inuse = false;
+
+	FindIndex_Update(ed);
 }
 
 void
@@ -167,140 +167,142 @@ fire_hit(edict_t *self, vec3_t aim, int damage, int kick)
 }
 
 /*
- * This is an internal support routine
- * used for bullet/pellet based weapons.
+ * Picks the end point of a round
+ * fired along forward with the
+ * given spread.
  */
-void
-fire_lead(edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick,
-		int te_impact, int hspread, int vspread, int mod)
+static void
+fire_lead_end(vec3_t start, vec3_t forward, vec3_t right, vec3_t up,
+		int hspread, int vspread, vec3_t end)
 {
-	trace_t tr;
-	vec3_t dir;
-	vec3_t forward, right, up;
-	vec3_t end;
 	float r;
 	float u;
-	vec3_t water_start;
-	qboolean water = false;
-	int content_mask = MASK_SHOT | MASK_WATER;
 
-	if (!self)
+	r = crandom() * hspread;
+	u = crandom() * vspread;
+	VectorMA(start, 8192, forward, end);
+	VectorMA(end, r, right, end);
+	VectorMA(end, u, up, end);
+}
+
+/*
+ * Deals damage or sends the
+ * impact effect for a round
+ * that ended in tr.
+ */
+static void
+fire_lead_impact(edict_t *self, trace_t *tr, vec3_t aimdir, int damage,
+		int kick, int te_impact, int mod)
+{
+	/* send gun puff / flash */
+	if (!((tr->surface) && (tr->surface->flags & SURF_SKY)))
 	{
-		return;
+		if (tr->fraction < 1.0)
+		{
+			if (tr->ent->takedamage)
+			{
+				T_Damage(tr->ent, self, self, aimdir, tr->endpos, tr->plane.normal,
+						damage, kick, DAMAGE_BULLET, mod);
+			}
+			else
+			{
+				if (tr->surface && strncmp(tr->surface->name, "sky", 3) != 0)
+				{
+					gi.WriteByte(svc_temp_entity);
+					gi.WriteByte(te_impact);
+					gi.WritePosition(tr->endpos);
+					gi.WriteDir(tr->plane.normal);
+					gi.multicast(tr->endpos, MULTICAST_PVS);
+
+					if (self->client)
+					{
+						PlayerNoise(self, tr->endpos, PNOISE_IMPACT);
+					}
+				}
+			}
+		}
 	}
+}
 
-	tr = gi.trace(self->s.origin, NULL, NULL, start, self, MASK_SHOT);
+/*
+ * Finishes a round once the trace from start
+ * to end is known: water entry, damage and
+ * the bubble trail. water is set when start
+ * already is under water.
+ */
+static void
+fire_lead_finish(edict_t *self, vec3_t start, vec3_t end, trace_t tr,
+		qboolean water, vec3_t aimdir, int damage, int kick,
+		int te_impact, int hspread, int vspread, int mod)
+{
+	vec3_t dir;
+	vec3_t forward, right, up;
+	vec3_t water_start;
 
-	if (!(tr.fraction < 1.0))
+	if (water)
 	{
-		vectoangles(aimdir, dir);
-		AngleVectors(dir, forward, right, up);
-
-		r = crandom() * hspread;
-		u = crandom() * vspread;
-		VectorMA(start, 8192, forward, end);
-		VectorMA(end, r, right, end);
-		VectorMA(end, u, up, end);
+		VectorCopy(start, water_start);
+	}
 
-		if (gi.pointcontents(start) & MASK_WATER)
-		{
-			water = true;
-			VectorCopy(start, water_start);
-			content_mask &= ~MASK_WATER;
-		}
+	/* see if we hit water */
+	if (tr.contents & MASK_WATER)
+	{
+		int color;
 
-		tr = gi.trace(start, NULL, NULL, end, self, content_mask);
+		water = true;
+		VectorCopy(tr.endpos, water_start);
 
-		/* see if we hit water */
-		if (tr.contents & MASK_WATER)
+		if (!VectorCompare(start, tr.endpos))
 		{
-			int color;
-
-			water = true;
-			VectorCopy(tr.endpos, water_start);
-
-			if (!VectorCompare(start, tr.endpos))
+			if (tr.contents & CONTENTS_WATER)
 			{
-				if (tr.contents & CONTENTS_WATER)
+				if (strcmp(tr.surface->name, "*brwater") == 0)
 				{
-					if (strcmp(tr.surface->name, "*brwater") == 0)
-					{
-						color = SPLASH_BROWN_WATER;
-					}
-					else
-					{
-						color = SPLASH_BLUE_WATER;
-					}
-				}
-				else if (tr.contents & CONTENTS_SLIME)
-				{
-					color = SPLASH_SLIME;
-				}
-				else if (tr.contents & CONTENTS_LAVA)
-				{
-					color = SPLASH_LAVA;
+					color = SPLASH_BROWN_WATER;
 				}
 				else
 				{
-					color = SPLASH_UNKNOWN;
+					color = SPLASH_BLUE_WATER;
 				}
-
-				if (color != SPLASH_UNKNOWN)
-				{
-					gi.WriteByte(svc_temp_entity);
-					gi.WriteByte(TE_SPLASH);
-					gi.WriteByte(8);
-					gi.WritePosition(tr.endpos);
-					gi.WriteDir(tr.plane.normal);
-					gi.WriteByte(color);
-					gi.multicast(tr.endpos, MULTICAST_PVS);
-				}
-
-				/* change bullet's course when it enters water */
-				VectorSubtract(end, start, dir);
-				vectoangles(dir, dir);
-				AngleVectors(dir, forward, right, up);
-				r = crandom() * hspread * 2;
-				u = crandom() * vspread * 2;
-				VectorMA(water_start, 8192, forward, end);
-				VectorMA(end, r, right, end);
-				VectorMA(end, u, up, end);
 			}
-
-			/* re-trace ignoring water this time */
-			tr = gi.trace(water_start, NULL, NULL, end, self, MASK_SHOT);
-		}
-	}
-
-	/* send gun puff / flash */
-	if (!((tr.surface) && (tr.surface->flags & SURF_SKY)))
-	{
-		if (tr.fraction < 1.0)
-		{
-			if (tr.ent->takedamage)
+			else if (tr.contents & CONTENTS_SLIME)
 			{
-				T_Damage(tr.ent, self, self, aimdir, tr.endpos, tr.plane.normal,
-						damage, kick, DAMAGE_BULLET, mod);
+				color = SPLASH_SLIME;
+			}
+			else if (tr.contents & CONTENTS_LAVA)
+			{
+				color = SPLASH_LAVA;
 			}
 			else
 			{
-				if (tr.surface && strncmp(tr.surface->name, "sky", 3) != 0)
-				{
-					gi.WriteByte(svc_temp_entity);
-					gi.WriteByte(te_impact);
-					gi.WritePosition(tr.endpos);
-					gi.WriteDir(tr.plane.normal);
-					gi.multicast(tr.endpos, MULTICAST_PVS);
+				color = SPLASH_UNKNOWN;
+			}
 
-					if (self->client)
-					{
-						PlayerNoise(self, tr.endpos, PNOISE_IMPACT);
-					}
-				}
+			if (color != SPLASH_UNKNOWN)
+			{
+				gi.WriteByte(svc_temp_entity);
+				gi.WriteByte(TE_SPLASH);
+				gi.WriteByte(8);
+				gi.WritePosition(tr.endpos);
+				gi.WriteDir(tr.plane.normal);
+				gi.WriteByte(color);
+				gi.multicast(tr.endpos, MULTICAST_PVS);
 			}
+
+			/* change bullet's course when it enters water */
+			VectorSubtract(end, start, dir);
+			vectoangles(dir, dir);
+			AngleVectors(dir, forward, right, up);
+			fire_lead_end(water_start, forward, right, up,
+					hspread * 2, vspread * 2, end);
 		}
+
+		/* re-trace ignoring water this time */
+		tr = G_AntilagTrace(self, water_start, end, self, MASK_SHOT);
 	}
 
+	fire_lead_impact(self, &tr, aimdir, damage, kick, te_impact, mod);
+
 	/* if went through water, determine
 	   where the end and make a bubble trail */
 	if (water)
@@ -331,6 +333,51 @@ fire_lead(edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick,
 	}
 }
 
+/*
+ * This is an internal support routine
+ * used for bullet/pellet based weapons.
+ */
+void
+fire_lead(edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick,
+		int te_impact, int hspread, int vspread, int mod)
+{
+	trace_t tr;
+	vec3_t dir;
+	vec3_t forward, right, up;
+	vec3_t end;
+	qboolean water = false;
+	int content_mask = MASK_SHOT | MASK_WATER;
+
+	if (!self)
+	{
+		return;
+	}
+
+	tr = gi.trace(self->s.origin, NULL, NULL, start, self, MASK_SHOT);
+
+	if (tr.fraction < 1.0)
+	{
+		/* the muzzle is blocked */
+		fire_lead_impact(self, &tr, aimdir, damage, kick, te_impact, mod);
+		return;
+	}
+
+	vectoangles(aimdir, dir);
+	AngleVectors(dir, forward, right, up);
+	fire_lead_end(start, forward, right, up, hspread, vspread, end);
+
+	if (gi.pointcontents(start) & MASK_WATER)
+	{
+		water = true;
+		content_mask &= ~MASK_WATER;
+	}
+
+	tr = G_AntilagTrace(self, start, end, self, content_mask);
+
+	fire_lead_finish(self, start, end, tr, water, aimdir, damage, kick,
+			te_impact, hspread, vspread, mod);
+}
+
 /*
  * Fires a single round.  Used for machinegun and
  * chaingun.  Would be fine for pistols, rifles, etc....
@@ -387,7 +434,7 @@ fire_bullet_precise(edict_t *self, vec3_t start, vec3_t forward, vec3_t right,
 			content_mask &= ~MASK_WATER;
 		}
 
-		tr = gi.trace(start, NULL, NULL, end, self, content_mask);
+		tr = G_AntilagTrace(self, start, end, self, content_mask);
 
 		/* see if we hit water */
 		if (tr.contents & MASK_WATER)
@@ -443,7 +490,7 @@ fire_bullet_precise(edict_t *self, vec3_t start, vec3_t forward, vec3_t right,
 			}
 
 			/* re-trace ignoring water this time */
-			tr = gi.trace(water_start, NULL, NULL, end, self, MASK_SHOT);
+			tr = G_AntilagTrace(self, water_start, end, self, MASK_SHOT);
 		}
 	}
 
@@ -508,6 +555,8 @@ fire_bullet_precise(edict_t *self, vec3_t start, vec3_t forward, vec3_t right,
 	}
 }
 
+#define MAX_SHOTGUN_PELLETS 32
+
 /*
  * Shoots shotgun pellets. Used
  * by shotgun and super shotgun.
@@ -516,17 +565,78 @@ void
 fire_shotgun(edict_t *self, vec3_t start, vec3_t aimdir, int damage,
 		int kick, int hspread, int vspread, int count, int mod)
 {
-	int i;
+	trace_t tr;
+	trace_t traces[MAX_SHOTGUN_PELLETS];
+	vec3_t ends[MAX_SHOTGUN_PELLETS];
+	float freetimes[MAX_SHOTGUN_PELLETS];
+	vec3_t dir;
+	vec3_t forward, right, up;
+	qboolean water = false;
+	int content_mask = MASK_SHOT | MASK_WATER;
+	int i, num;
 
 	if (!self)
 	{
 		return;
 	}
 
-	for (i = 0; i < count; i++)
+	tr = gi.trace(self->s.origin, NULL, NULL, start, self, MASK_SHOT);
+
+	if (tr.fraction < 1.0)
 	{
-		fire_lead(self, start, aimdir, damage, kick, TE_SHOTGUN,
-				hspread, vspread, mod);
+		/* the muzzle is blocked, every pellet hits it */
+		for (i = 0; i < count; i++)
+		{
+			fire_lead_impact(self, &tr, aimdir, damage, kick, TE_SHOTGUN, mod);
+		}
+
+		return;
+	}
+
+	vectoangles(aimdir, dir);
+	AngleVectors(dir, forward, right, up);
+
+	if (gi.pointcontents(start) & MASK_WATER)
+	{
+		water = true;
+		content_mask &= ~MASK_WATER;
+	}
+
+	/* all pellets leave the same muzzle, so trace them
+	   as one batch. They're resolved in order afterwards */
+	while (count > 0)
+	{
+		num = Q_min(count, MAX_SHOTGUN_PELLETS);
+
+		for (i = 0; i < num; i++)
+		{
+			fire_lead_end(start, forward, right, up, hspread, vspread, ends[i]);
+		}
+
+		G_AntilagTraceBatch(self, start, ends, num, self, content_mask, traces);
+
+		for (i = 0; i < num; i++)
+		{
+			freetimes[i] = traces[i].ent ? traces[i].ent->freetime : 0;
+		}
+
+		for (i = 0; i < num; i++)
+		{
+			/* an earlier pellet may have destroyed what this one
+			   hit, G_FreeEdict() stamps the freetime if so */
+			if (traces[i].ent && (!traces[i].ent->inuse ||
+				(traces[i].ent->freetime != freetimes[i]) ||
+				(traces[i].ent->solid == SOLID_NOT)))
+			{
+				traces[i] = gi.trace(start, NULL, NULL, ends[i], self,
+						content_mask);
+			}
+
+			fire_lead_finish(self, start, ends[i], traces[i], water, aimdir,
+					damage, kick, TE_SHOTGUN, hspread, vspread, mod);
+		}
+
+		count -= num;
 	}
 }
 
@@ -1146,7 +1256,7 @@ fire_rail(edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick)
 
 	while (ignore)
 	{
-		tr = gi.trace(from, NULL, NULL, end, ignore, mask);
+		tr = G_AntilagTrace(self, from, end, ignore, mask);
 
 		if (tr.contents & (CONTENTS_SLIME | CONTENTS_LAVA))
 		{
@@ -1579,46 +1689,256 @@ Player_TickBurn(edict_t *ent)
 	}
 }
 
-/* Count active fire puddles owned by a player */
+/*
+ * Fire puddle registry. Every live puddle is linked into a hashed
+ * uniform grid (cell size == chain range, so a chain query only has
+ * to look at the 3x3x3 cells around the puddle) and into a small
+ * ring buffer owned by the player that spawned it. The ring keeps
+ * puddles in spawn order, so cap enforcement just evicts the head.
+ * Both structures are indexed by edict number, allocated once per
+ * game and reset when a new level is spawned.
+ */
+
+#define PUDDLE_GRID_BUCKETS 256 /* must be a power of two */
+
+typedef struct
+{
+	int bucket;	/* grid bucket, -1 if not registered */
+	int owner;	/* edict number of the owner ring */
+	int prev;	/* bucket chain, 0 terminates (world is never a puddle) */
+	int next;
+} puddle_link_t;
+
+typedef struct
+{
+	int head;	/* oldest puddle */
+	int count;
+	int ents[FIRE_PUDDLE_MAX_PER_PLAYER];
+} puddle_ring_t;
+
+typedef struct
+{
+	int framenum;	/* frame the current counters belong to */
+	int queries;
+	int visited;
+	int last_queries;
+	int last_visited;
+	int peak_visited;
+	int live;
+} puddle_stats_t;
+
+static puddle_link_t *puddle_links;
+static puddle_ring_t *puddle_rings;
+static int puddle_grid[PUDDLE_GRID_BUCKETS];
+static puddle_stats_t puddle_stats;
+
 static int
-count_player_puddles(edict_t *owner)
+puddle_cell(float v)
 {
-	edict_t *ent = NULL;
-	int count = 0;
+	return (int)floor(v / FIRE_PUDDLE_CHAIN_RANGE);
+}
 
-	while ((ent = G_Find(ent, FOFS(classname), "fire_puddle")) != NULL)
+static int
+puddle_bucket(int cx, int cy, int cz)
+{
+	unsigned h = (unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u ^
+		(unsigned)cz * 83492791u;
+
+	return h & (PUDDLE_GRID_BUCKETS - 1);
+}
+
+static void
+puddle_stats_frame(void)
+{
+	if (puddle_stats.framenum == level.framenum)
 	{
-		if (ent->owner == owner)
+		return;
+	}
+
+	puddle_stats.last_queries = puddle_stats.queries;
+	puddle_stats.last_visited = puddle_stats.visited;
+	puddle_stats.queries = 0;
+	puddle_stats.visited = 0;
+	puddle_stats.framenum = level.framenum;
+}
+
+void
+FirePuddle_InitRegistry(void)
+{
+	puddle_links = gi.TagMalloc(game.maxentities * sizeof(puddle_links[0]), TAG_GAME);
+	puddle_rings = gi.TagMalloc(game.maxentities * sizeof(puddle_rings[0]), TAG_GAME);
+
+	FirePuddle_ClearRegistry();
+}
+
+void
+FirePuddle_ClearRegistry(void)
+{
+	int i;
+
+	memset(puddle_rings, 0, game.maxentities * sizeof(puddle_rings[0]));
+	memset(puddle_grid, 0, sizeof(puddle_grid));
+	memset(&puddle_stats, 0, sizeof(puddle_stats));
+
+	for (i = 0; i < game.maxentities; i++)
+	{
+		puddle_links[i].bucket = -1;
+		puddle_links[i].owner = 0;
+		puddle_links[i].prev = 0;
+		puddle_links[i].next = 0;
+	}
+}
+
+static void
+puddle_ring_remove(puddle_ring_t *ring, int num)
+{
+	int i;
+
+	for (i = 0; i < ring->count; i++)
+	{
+		if (ring->ents[(ring->head + i) % FIRE_PUDDLE_MAX_PER_PLAYER] == num)
 		{
-			count++;
+			break;
 		}
 	}
 
-	return count;
+	if (i == ring->count)
+	{
+		return;
+	}
+
+	/* close the gap, at most FIRE_PUDDLE_MAX_PER_PLAYER - 1 moves */
+	for ( ; i < ring->count - 1; i++)
+	{
+		ring->ents[(ring->head + i) % FIRE_PUDDLE_MAX_PER_PLAYER] =
+			ring->ents[(ring->head + i + 1) % FIRE_PUDDLE_MAX_PER_PLAYER];
+	}
+
+	ring->count--;
+}
+
+static void
+puddle_ring_push(puddle_ring_t *ring, int num)
+{
+	ring->ents[(ring->head + ring->count) % FIRE_PUDDLE_MAX_PER_PLAYER] = num;
+	ring->count++;
+}
+
+static void
+register_puddle(edict_t *puddle)
+{
+	puddle_link_t *link;
+	int num, bucket;
+
+	num = puddle - g_edicts;
+	link = &puddle_links[num];
+	bucket = puddle_bucket(puddle_cell(puddle->s.origin[0]),
+			puddle_cell(puddle->s.origin[1]),
+			puddle_cell(puddle->s.origin[2]));
+
+	link->bucket = bucket;
+	link->owner = puddle->owner ? puddle->owner - g_edicts : 0;
+	link->prev = 0;
+	link->next = puddle_grid[bucket];
+
+	if (link->next)
+	{
+		puddle_links[link->next].prev = num;
+	}
+
+	puddle_grid[bucket] = num;
+
+	puddle_ring_push(&puddle_rings[link->owner], num);
+	puddle_stats.live++;
+}
+
+static void
+unregister_puddle(edict_t *puddle)
+{
+	puddle_link_t *link;
+	int num;
+
+	num = puddle - g_edicts;
+	link = &puddle_links[num];
+
+	if (link->bucket < 0)
+	{
+		return;
+	}
+
+	if (link->prev)
+	{
+		puddle_links[link->prev].next = link->next;
+	}
+	else
+	{
+		puddle_grid[link->bucket] = link->next;
+	}
+
+	if (link->next)
+	{
+		puddle_links[link->next].prev = link->prev;
+	}
+
+	puddle_ring_remove(&puddle_rings[link->owner], num);
+
+	link->bucket = -1;
+	link->prev = 0;
+	link->next = 0;
+	puddle_stats.live--;
+}
+
+/* Remove a puddle from the registry and free it */
+static void
+free_fire_puddle(edict_t *puddle)
+{
+	unregister_puddle(puddle);
+	G_FreeEdict(puddle);
+}
+
+/* Count active fire puddles owned by a player */
+static int
+count_player_puddles(edict_t *owner)
+{
+	return puddle_rings[owner ? owner - g_edicts : 0].count;
 }
 
 /* Find oldest puddle owned by player */
 static edict_t *
 find_oldest_puddle(edict_t *owner)
 {
-	edict_t *ent = NULL;
-	edict_t *oldest = NULL;
-	float oldest_time = level.time;
+	puddle_ring_t *ring = &puddle_rings[owner ? owner - g_edicts : 0];
 
-	while ((ent = G_Find(ent, FOFS(classname), "fire_puddle")) != NULL)
+	if (!ring->count)
 	{
-		if (ent->owner == owner)
-		{
-			float spawn_time = ent->timestamp - puddle_tier_lifetime[ent->count];
-			if (spawn_time < oldest_time)
-			{
-				oldest_time = spawn_time;
-				oldest = ent;
-			}
-		}
+		return NULL;
 	}
 
-	return oldest;
+	return &g_edicts[ring->ents[ring->head]];
+}
+
+/* Boosted puddles count as fresh again for cap eviction */
+static void
+refresh_puddle(edict_t *puddle)
+{
+	puddle_link_t *link = &puddle_links[puddle - g_edicts];
+	puddle_ring_t *ring = &puddle_rings[link->owner];
+
+	puddle_ring_remove(ring, puddle - g_edicts);
+	puddle_ring_push(ring, puddle - g_edicts);
+}
+
+/* Print the puddle registry query counters */
+void
+Svcmd_PuddleStats_f(void)
+{
+	puddle_stats_frame();
+
+	gi.cprintf(NULL, PRINT_HIGH, "fire puddles: %i live\n", puddle_stats.live);
+	gi.cprintf(NULL, PRINT_HIGH, "last frame:   %i chain queries, %i puddles visited\n",
+			puddle_stats.last_queries, puddle_stats.last_visited);
+	gi.cprintf(NULL, PRINT_HIGH, "peak:         %i puddles visited in one frame\n",
+			puddle_stats.peak_visited);
 }
 
 /* Determine surface type at position */
@@ -1645,49 +1965,125 @@ get_surface_type(vec3_t pos, csurface_t *surf)
 	return SURFACE_NORMAL;
 }
 
-static void FirePuddle_Think(edict_t *self);
+void FirePuddle_Think(edict_t *self);
 static void spawn_fire_puddle_at(edict_t *owner, vec3_t origin, int tier, int surface_type);
 
+/* Put the puddles of a loaded level back into the registry,
+   edict order is the closest to their age we still have */
+void
+FirePuddle_RelinkAll(void)
+{
+	edict_t *ent;
+	int i;
+
+	for (i = 1; i < globals.num_edicts; i++)
+	{
+		ent = &g_edicts[i];
+
+		if (!ent->inuse || (ent->think != FirePuddle_Think) ||
+			(puddle_links[i].bucket >= 0))
+		{
+			continue;
+		}
+
+		if (count_player_puddles(ent->owner) >= FIRE_PUDDLE_MAX_PER_PLAYER)
+		{
+			G_FreeEdict(ent);
+			continue;
+		}
+
+		register_puddle(ent);
+	}
+}
+
 /* Chain ignition - spread fire to nearby puddles */
 static void
 try_chain_ignition(edict_t *self)
 {
-	edict_t *ent = NULL;
+	edict_t *ent;
 	int chains_this_frame = 0;
-	
+	int cx, cy, cz, x, y, z, num;
+	int buckets[27];
+	int numbuckets = 0;
+	int i;
+
 	if (level.time < self->pain_debounce_time)
 	{
 		return;
 	}
 
-	while ((ent = G_Find(ent, FOFS(classname), "fire_puddle")) != NULL)
+	puddle_stats_frame();
+	puddle_stats.queries++;
+
+	cx = puddle_cell(self->s.origin[0]);
+	cy = puddle_cell(self->s.origin[1]);
+	cz = puddle_cell(self->s.origin[2]);
+
+	/* neighbouring cells may hash into the same bucket, visit it once */
+	for (x = cx - 1; x <= cx + 1; x++)
 	{
-		if (ent == self || !ent->inuse)
+		for (y = cy - 1; y <= cy + 1; y++)
 		{
-			continue;
-		}
+			for (z = cz - 1; z <= cz + 1; z++)
+			{
+				int bucket = puddle_bucket(x, y, z);
 
-		/* Check distance */
-		vec3_t diff;
-		VectorSubtract(ent->s.origin, self->s.origin, diff);
-		float dist = VectorLength(diff);
+				for (i = 0; i < numbuckets; i++)
+				{
+					if (buckets[i] == bucket)
+					{
+						break;
+					}
+				}
+
+				if (i == numbuckets)
+				{
+					buckets[numbuckets++] = bucket;
+				}
+			}
+		}
+	}
 
-		if (dist < FIRE_PUDDLE_CHAIN_RANGE)
+	for (i = 0; i < numbuckets && chains_this_frame < FIRE_PUDDLE_MAX_CHAINS; i++)
+	{
+		for (num = puddle_grid[buckets[i]]; num; num = puddle_links[num].next)
 		{
-			/* Boost the nearby puddle's tier if possible */
-			if (ent->count < PUDDLE_TIER_LARGE && chains_this_frame < FIRE_PUDDLE_MAX_CHAINS)
+			ent = &g_edicts[num];
+			puddle_stats.visited++;
+
+			if (ent == self || !ent->inuse)
+			{
+				continue;
+			}
+
+			/* Check distance */
+			vec3_t diff;
+			VectorSubtract(ent->s.origin, self->s.origin, diff);
+			float dist = VectorLength(diff);
+
+			if (dist < FIRE_PUDDLE_CHAIN_RANGE)
 			{
-				ent->count++;
-				ent->timestamp = level.time + puddle_tier_lifetime[ent->count];
-				chains_this_frame++;
+				/* Boost the nearby puddle's tier if possible */
+				if (ent->count < PUDDLE_TIER_LARGE && chains_this_frame < FIRE_PUDDLE_MAX_CHAINS)
+				{
+					ent->count++;
+					ent->timestamp = level.time + puddle_tier_lifetime[ent->count];
+					refresh_puddle(ent);
+					chains_this_frame++;
+				}
 			}
 		}
 	}
 
+	if (puddle_stats.visited > puddle_stats.peak_visited)
+	{
+		puddle_stats.peak_visited = puddle_stats.visited;
+	}
+
 	self->pain_debounce_time = level.time + FIRE_PUDDLE_CHAIN_DELAY;
 }
 
-static void
+void
 FirePuddle_Think(edict_t *self)
 {
 	edict_t *ent = NULL;
@@ -1701,7 +2097,7 @@ FirePuddle_Think(edict_t *self)
 
 	if (level.time >= self->timestamp)
 	{
-		G_FreeEdict(self);
+		free_fire_puddle(self);
 		return;
 	}
 
@@ -1848,7 +2244,7 @@ spawn_fire_puddle_at(edict_t *owner, vec3_t origin, int tier, int surface_type)
 		edict_t *oldest = find_oldest_puddle(owner);
 		if (oldest)
 		{
-			G_FreeEdict(oldest);
+			free_fire_puddle(oldest);
 		}
 	}
 
@@ -1909,6 +2305,7 @@ spawn_fire_puddle_at(edict_t *owner, vec3_t origin, int tier, int surface_type)
 	puddle->classname = "fire_puddle";
 
 	gi.linkentity(puddle);
+	register_puddle(puddle);
 }
 
 /* Add heat to a location, potentially igniting a fire puddle */
@@ -1952,7 +2349,7 @@ add_heat_at_location(edict_t *owner, vec3_t origin, csurface_t *surf)
 #define FLAME_GROWTH_TIME 0.5f
 #define FLAME_GROWTH_FRAMES 5
 
-static void
+void
 Flame_Think(edict_t *self)
 {
 	float age;
@@ -2009,7 +2406,7 @@ Flame_Think(edict_t *self)
 	self->nextthink = level.time + 0.1f;
 }
 
-static void
+void
 Flame_Touch(edict_t *self, edict_t *other, cplane_t *plane, csurface_t *surf)
 {
 	qboolean hit_world;
@@ -181,6 +181,26 @@ typedef struct
 	void (*AddCommandString)(char *text);
 
 	void (*DebugGraph)(float value, int color);
+
+	/* gi.trace() from one start point to each of the ends,
+	   e.g. for the pellets of a shotgun. Cheaper than count
+	   single traces, the results are the same. */
+	void (*trace_batch)(vec3_t start, vec3_t mins, vec3_t maxs,
+			vec3_t *ends, int count, edict_t *passent, int contentmask,
+			trace_t *results);
+
+	/* named, nestable zones for the server profiler (sv_profile).
+	   The name is copied, it doesn't need to stay around. */
+	void (*profile_begin)(const char *name);
+	void (*profile_end)(void);
+
+	/* savegame files, names as given to WriteGame() and friends.
+	   savefile_write copies the data and returns, the file is
+	   compressed and written in the background. savefile_load
+	   returns the length or -1, free the data with savefile_free. */
+	void (*savefile_write)(const char *name, const void *data, int len);
+	int (*savefile_load)(const char *name, void **data);
+	void (*savefile_free)(void *data);
 } game_import_t;
 
 /* functions exported by the game subsystem */
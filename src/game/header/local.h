@@ -557,11 +557,14 @@ extern cvar_t *flood_persecond;
 extern cvar_t *flood_waitdelay;
 
 extern cvar_t *sv_maplist;
+extern cvar_t *sv_profile;
 
 extern cvar_t *aimfix;
 extern cvar_t *g_machinegun_norecoil;
 extern cvar_t *g_quick_weap;
 extern cvar_t *g_swap_speed;
+extern cvar_t *g_antilag;
+extern cvar_t *g_antilag_maxms;
 
 #define world (&g_edicts[0])
 
@@ -643,7 +646,12 @@ qboolean KillBox(edict_t *ent);
 void G_ProjectSource(const vec3_t point, const vec3_t distance, const vec3_t forward,
 		const vec3_t right, vec3_t result);
 edict_t *G_Find(edict_t *from, int fieldofs, const char *match);
+void G_InitFindIndex(void);
+void G_ClearFindIndex(void);
+void G_TouchEdict(edict_t *ent);
+void G_SyncFindIndex(void);
 edict_t *findradius(edict_t *from, vec3_t org, float rad);
+void Svcmd_BenchRadius_f(void);
 edict_t *G_PickTarget(char *targetname);
 void G_UseTargets(edict_t *ent, edict_t *activator);
 void G_SetMovedir(vec3_t angles, vec3_t movedir);
@@ -774,6 +782,22 @@ void fire_flame(edict_t *self, vec3_t start, vec3_t dir, int damage, int speed);
 void Player_ApplyBurn(edict_t *target, edict_t *attacker, float duration);
 void Player_TickBurn(edict_t *ent);
 
+/* Fire puddle registry */
+void FirePuddle_InitRegistry(void);
+void FirePuddle_ClearRegistry(void);
+void FirePuddle_RelinkAll(void);
+void Svcmd_PuddleStats_f(void);
+
+/* g_antilag.c */
+void G_AntilagInit(void);
+void G_AntilagClear(void);
+void G_AntilagRecord(void);
+trace_t G_AntilagTrace(edict_t *shooter, vec3_t start, vec3_t end,
+		edict_t *passent, int mask);
+void G_AntilagTraceBatch(edict_t *shooter, vec3_t start, vec3_t *ends,
+		int count, edict_t *passent, int mask, trace_t *results);
+void Svcmd_BenchAntilag_f(void);
+
 /* g_ptrail.c */
 void PlayerTrail_Init(void);
 void PlayerTrail_Add(vec3_t spot);
@@ -840,6 +864,7 @@ void ReadLevel(const char *filename);
 void WriteLevel(const char *filename);
 void ReadGame(const char *filename);
 void WriteGame(const char *filename, qboolean autosave);
+const char *G_FunctionName(void *func);
 void SpawnEntities(const char *mapname, char *entities, const char *spawnpoint);
 
 /* g_spawn.c */
@@ -181,6 +181,76 @@ static field_t clientfields[] = {
 
 /* ========================================================= */
 
+/*
+ * The function and mmove lists sorted by
+ * address and by name, so every pointer
+ * in a savegame isn't a scan through the
+ * whole list.
+ */
+static functionList_t *functionsByAddress[ARRLEN(functionList) - 1];
+static functionList_t *functionsByName[ARRLEN(functionList) - 1];
+static mmoveList_t *mmovesByAddress[ARRLEN(mmoveList) - 1];
+static mmoveList_t *mmovesByName[ARRLEN(mmoveList) - 1];
+
+static int
+CompareFunctionAddress(const void *a, const void *b)
+{
+	size_t fa = (size_t)(*(functionList_t **)a)->funcPtr;
+	size_t fb = (size_t)(*(functionList_t **)b)->funcPtr;
+
+	return (fa > fb) - (fa < fb);
+}
+
+static int
+CompareFunctionName(const void *a, const void *b)
+{
+	return strcmp((*(functionList_t **)a)->funcStr,
+			(*(functionList_t **)b)->funcStr);
+}
+
+static int
+CompareMmoveAddress(const void *a, const void *b)
+{
+	size_t ma = (size_t)(*(mmoveList_t **)a)->mmovePtr;
+	size_t mb = (size_t)(*(mmoveList_t **)b)->mmovePtr;
+
+	return (ma > mb) - (ma < mb);
+}
+
+static int
+CompareMmoveName(const void *a, const void *b)
+{
+	return strcmp((*(mmoveList_t **)a)->mmoveStr,
+			(*(mmoveList_t **)b)->mmoveStr);
+}
+
+static void
+InitSaveTables(void)
+{
+	int i;
+
+	for (i = 0; i < ARRLEN(functionsByAddress); i++)
+	{
+		functionsByAddress[i] = functionsByName[i] = &functionList[i];
+	}
+
+	for (i = 0; i < ARRLEN(mmovesByAddress); i++)
+	{
+		mmovesByAddress[i] = mmovesByName[i] = &mmoveList[i];
+	}
+
+	qsort(functionsByAddress, ARRLEN(functionsByAddress),
+			sizeof(functionsByAddress[0]), CompareFunctionAddress);
+	qsort(functionsByName, ARRLEN(functionsByName),
+			sizeof(functionsByName[0]), CompareFunctionName);
+	qsort(mmovesByAddress, ARRLEN(mmovesByAddress),
+			sizeof(mmovesByAddress[0]), CompareMmoveAddress);
+	qsort(mmovesByName, ARRLEN(mmovesByName),
+			sizeof(mmovesByName[0]), CompareMmoveName);
+}
+
+/* ========================================================= */
+
 static void
 InitAllocations(void)
 {
@@ -272,18 +342,27 @@ InitGame(void)
 	/* dm map list */
 	sv_maplist = gi.cvar("sv_maplist", "", 0);
 
+	/* zones for the server profiler */
+	sv_profile = gi.cvar("sv_profile", "0", 0);
+
 	/* others */
 	aimfix = gi.cvar("aimfix", "0", CVAR_ARCHIVE);
 	g_machinegun_norecoil = gi.cvar("g_machinegun_norecoil", "0", CVAR_ARCHIVE);
 	g_quick_weap = gi.cvar("g_quick_weap", "1", CVAR_ARCHIVE);
 	g_swap_speed = gi.cvar("g_swap_speed", "1", CVAR_ARCHIVE);
+	g_antilag = gi.cvar("g_antilag", "0", CVAR_ARCHIVE);
+	g_antilag_maxms = gi.cvar("g_antilag_maxms", "200", CVAR_ARCHIVE);
 
 	memset(&game, 0, sizeof(game));
 
 	InitItems();
+	InitSaveTables();
 
 	/* initialize entities and clients arrays */
 	InitAllocations();
+	G_InitFindIndex();
+	FirePuddle_InitRegistry();
+	G_AntilagInit();
 
 	/* Plastic Platoon: Initialize weapon tuning system */
 	PP_Weapon_Init();
@@ -301,40 +380,50 @@ InitGame(void)
 static functionList_t *
 GetFunctionByAddress(byte *adr)
 {
-	int i;
+	functionList_t key, *keyp, **found;
 
-	for (i = 0; functionList[i].funcStr; i++)
-	{
-		if (functionList[i].funcPtr == adr)
-		{
-			return &functionList[i];
-		}
-	}
+	key.funcPtr = adr;
+	keyp = &key;
+
+	found = bsearch(&keyp, functionsByAddress, ARRLEN(functionsByAddress),
+			sizeof(functionsByAddress[0]), CompareFunctionAddress);
+
+	return found ? *found : NULL;
+}
+
+/*
+ * Name of a game function, used to
+ * label the think zones for the
+ * profiler.
+ */
+const char *
+G_FunctionName(void *func)
+{
+	functionList_t *f;
+
+	f = GetFunctionByAddress((byte *)func);
 
-	return NULL;
+	return f ? f->funcStr : "unknown";
 }
 
 /*
  * Helper function to get the
  * pointer to a function by
  * it's human readable name.
- * Called by WriteField1 and
- * WriteField2.
+ * Called by ReadField.
  */
 static byte *
 FindFunctionByName(char *name)
 {
-	int i;
+	functionList_t key, *keyp, **found;
 
-	for (i = 0; functionList[i].funcStr; i++)
-	{
-		if (!strcmp(name, functionList[i].funcStr))
-		{
-			return functionList[i].funcPtr;
-		}
-	}
+	key.funcStr = name;
+	keyp = &key;
 
-	return NULL;
+	found = bsearch(&keyp, functionsByName, ARRLEN(functionsByName),
+			sizeof(functionsByName[0]), CompareFunctionName);
+
+	return found ? (*found)->funcPtr : NULL;
 }
 
 /*
@@ -345,17 +434,15 @@ FindFunctionByName(char *name)
 static mmoveList_t *
 GetMmoveByAddress(mmove_t *adr)
 {
-	int i;
+	mmoveList_t key, *keyp, **found;
 
-	for (i = 0; mmoveList[i].mmoveStr; i++)
-	{
-		if (mmoveList[i].mmovePtr == adr)
-		{
-			return &mmoveList[i];
-		}
-	}
+	key.mmovePtr = adr;
+	keyp = &key;
+
+	found = bsearch(&keyp, mmovesByAddress, ARRLEN(mmovesByAddress),
+			sizeof(mmovesByAddress[0]), CompareMmoveAddress);
 
-	return NULL;
+	return found ? *found : NULL;
 }
 
 /*
@@ -366,19 +453,103 @@ GetMmoveByAddress(mmove_t *adr)
 static mmove_t *
 FindMmoveByName(char *name)
 {
-	int i;
+	mmoveList_t key, *keyp, **found;
+
+	key.mmoveStr = name;
+	keyp = &key;
+
+	found = bsearch(&keyp, mmovesByName, ARRLEN(mmovesByName),
+			sizeof(mmovesByName[0]), CompareMmoveName);
+
+	return found ? (*found)->mmovePtr : NULL;
+}
+
+/* ========================================================= */
+
+/*
+ * Savegame files are built in memory and
+ * handed to the server, which compresses
+ * and writes them in the background.
+ */
+static void
+SaveBuf_Begin(savebuf_t *buf)
+{
+	buf->size = 0x40000;
+	buf->data = gi.TagMalloc(buf->size, TAG_GAME);
+	buf->cursize = 0;
+	buf->readcount = 0;
+}
 
-	for (i = 0; mmoveList[i].mmoveStr; i++)
+static void
+SaveBuf_Write(savebuf_t *buf, const void *data, size_t len)
+{
+	byte *grown;
+
+	if (buf->cursize + len > buf->size)
 	{
-		if (!strcmp(name, mmoveList[i].mmoveStr))
+		while (buf->cursize + len > buf->size)
 		{
-			return mmoveList[i].mmovePtr;
+			buf->size *= 2;
 		}
+
+		grown = gi.TagMalloc(buf->size, TAG_GAME);
+		memcpy(grown, buf->data, buf->cursize);
+		gi.TagFree(buf->data);
+		buf->data = grown;
 	}
 
-	return NULL;
+	memcpy(buf->data + buf->cursize, data, len);
+	buf->cursize += len;
+}
+
+static void
+SaveBuf_Finish(savebuf_t *buf, const char *filename)
+{
+	gi.savefile_write(filename, buf->data, (int)buf->cursize);
+	gi.TagFree(buf->data);
+	buf->data = NULL;
 }
 
+static qboolean
+SaveBuf_Load(savebuf_t *buf, const char *filename)
+{
+	void *data;
+	int len;
+
+	len = gi.savefile_load(filename, &data);
+
+	if (len < 0)
+	{
+		return false;
+	}
+
+	buf->data = data;
+	buf->size = buf->cursize = len;
+	buf->readcount = 0;
+
+	return true;
+}
+
+static qboolean
+SaveBuf_Read(savebuf_t *buf, void *data, size_t len)
+{
+	if (len > buf->cursize - buf->readcount)
+	{
+		return false;
+	}
+
+	memcpy(data, buf->data + buf->readcount, len);
+	buf->readcount += len;
+
+	return true;
+}
+
+static void
+SaveBuf_Close(savebuf_t *buf)
+{
+	gi.savefile_free(buf->data);
+	buf->data = NULL;
+}
 
 /* ========================================================= */
 
@@ -389,7 +560,7 @@ FindMmoveByName(char *name)
  * below this block into files.
  */
 static void
-WriteField1(FILE *f, field_t *field, byte *base)
+WriteField1(savebuf_t *buf, field_t *field, byte *base)
 {
 	void *p;
 	size_t len;
@@ -516,7 +687,7 @@ WriteField1(FILE *f, field_t *field, byte *base)
 }
 
 static void
-WriteField2(FILE *f, field_t *field, byte *base)
+WriteField2(savebuf_t *buf, field_t *field, byte *base)
 {
 	size_t len;
 	void *p;
@@ -537,7 +708,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 			if (*(char **)p)
 			{
 				len = strlen(*(char **)p) + 1;
-				fwrite(*(char **)p, len, 1, f);
+				SaveBuf_Write(buf, *(char **)p, len);
 			}
 
 			break;
@@ -555,7 +726,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 				}
 
 				len = strlen(func->funcStr)+1;
-				fwrite (func->funcStr, len, 1, f);
+				SaveBuf_Write(buf, func->funcStr, len);
 			}
 
 			break;
@@ -572,7 +743,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 				}
 
 				len = strlen(mmove->mmoveStr)+1;
-				fwrite (mmove->mmoveStr, len, 1, f);
+				SaveBuf_Write(buf, mmove->mmoveStr, len);
 			}
 
 			break;
@@ -591,7 +762,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
  * below
  */
 static void
-ReadField(FILE *f, field_t *field, byte *base)
+ReadField(savebuf_t *buf, field_t *field, byte *base)
 {
 	void *p;
 	int len;
@@ -632,7 +803,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 					return;
 				}
 
-				if (fread(s, len, 1, f) != 1)
+				if (!SaveBuf_Read(buf, s, len))
 				{
 					gi.error("%s: can't read string field", __func__);
 					return;
@@ -698,7 +869,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 					return;
 				}
 
-				if (fread (funcStr, len, 1, f) != 1)
+				if (!SaveBuf_Read(buf, funcStr, len))
 				{
 					gi.error("%s: can't get function name", __func__);
 					return;
@@ -730,7 +901,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 					return;
 				}
 
-				if (fread(funcStr, len, 1, f) != 1)
+				if (!SaveBuf_Read(buf, funcStr, len))
 				{
 					gi.error("%s: can't get move name", __func__);
 					return;
@@ -757,7 +928,7 @@ ReadField(FILE *f, field_t *field, byte *base)
  * Write the client struct into a file.
  */
 static void
-WriteClient(FILE *f, gclient_t *client)
+WriteClient(savebuf_t *buf, gclient_t *client)
 {
 	field_t *field;
 	gclient_t temp;
@@ -768,16 +939,16 @@ WriteClient(FILE *f, gclient_t *client)
 	/* change the pointers to indexes */
 	for (field = clientfields; field->name; field++)
 	{
-		WriteField1(f, field, (byte *)&temp);
+		WriteField1(buf, field, (byte *)&temp);
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveBuf_Write(buf, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = clientfields; field->name; field++)
 	{
-		WriteField2(f, field, (byte *)client);
+		WriteField2(buf, field, (byte *)client);
 	}
 }
 
@@ -785,13 +956,13 @@ WriteClient(FILE *f, gclient_t *client)
  * Read the client struct from a file
  */
 static void
-ReadClient(FILE *f, gclient_t *client, short save_ver)
+ReadClient(savebuf_t *buf, gclient_t *client, short save_ver)
 {
 	field_t *field;
 
-	if (fread(client, sizeof(*client), 1, f) != 1)
+	if (!SaveBuf_Read(buf, client, sizeof(*client)))
 	{
-		fclose(f);
+		SaveBuf_Close(buf);
 		gi.error("%s: can't read client", __func__);
 		return;
 	}
@@ -800,7 +971,7 @@ ReadClient(FILE *f, gclient_t *client, short save_ver)
 	{
 		if (field->save_ver <= save_ver)
 		{
-			ReadField(f, field, (byte *)client);
+			ReadField(buf, field, (byte *)client);
 		}
 	}
 
@@ -826,7 +997,7 @@ void
 WriteGame(const char *filename, qboolean autosave)
 {
 	savegameHeader_t sv;
-	FILE *f;
+	savebuf_t buf;
 	int i;
 
 	if (!autosave)
@@ -834,13 +1005,7 @@ WriteGame(const char *filename, qboolean autosave)
 		SaveClientData();
 	}
 
-	f = Q_fopen(filename, "wb");
-
-	if (!f)
-	{
-		gi.error("%s: Couldn't open %s", __func__, filename);
-		return;
-	}
+	SaveBuf_Begin(&buf);
 
 	/* Savegame identification */
 	memset(&sv, 0, sizeof(sv));
@@ -850,18 +1015,18 @@ WriteGame(const char *filename, qboolean autosave)
 	Q_strlcpy(sv.os, YQ2OSTYPE, sizeof(sv.os) - 1);
 	Q_strlcpy(sv.arch, YQ2ARCH, sizeof(sv.arch) - 1);
 
-	fwrite(&sv, sizeof(sv), 1, f);
+	SaveBuf_Write(&buf, &sv, sizeof(sv));
 
 	game.autosaved = autosave;
-	fwrite(&game, sizeof(game), 1, f);
+	SaveBuf_Write(&buf, &game, sizeof(game));
 	game.autosaved = false;
 
 	for (i = 0; i < game.maxclients; i++)
 	{
-		WriteClient(f, &game.clients[i]);
+		WriteClient(&buf, &game.clients[i]);
 	}
 
-	fclose(f);
+	SaveBuf_Finish(&buf, filename);
 }
 
 /*
@@ -873,25 +1038,23 @@ void
 ReadGame(const char *filename)
 {
 	savegameHeader_t sv;
-	FILE *f;
+	savebuf_t buf;
 	int i;
 
 	short save_ver = 0;
 
 	gi.FreeTags(TAG_GAME);
 
-	f = Q_fopen(filename, "rb");
-
-	if (!f)
+	if (!SaveBuf_Load(&buf, filename))
 	{
 		gi.error("%s: Couldn't open %s", __func__, filename);
 		return;
 	}
 
 	/* Sanity checks */
-	if (fread(&sv, sizeof(sv), 1, f) != 1)
+	if (!SaveBuf_Read(&buf, &sv, sizeof(sv)))
 	{
-		fclose(f);
+		SaveBuf_Close(&buf);
 		gi.error("%s: can't read save file", __func__);
 		return;
 	}
@@ -918,7 +1081,7 @@ ReadGame(const char *filename)
 
 	if (save_ver == 0) // not found in mappings table
 	{
-		fclose(f);
+		SaveBuf_Close(&buf);
 		gi.error("Savegame from an incompatible version.\n");
 		return;
 	}
@@ -926,13 +1089,13 @@ ReadGame(const char *filename)
 	{
 		if (strcmp(sv.game, GAMEVERSION) != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another game.so.\n");
 			return;
 		}
 		else if (strcmp(sv.os, OSTYPE_1) != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another os.\n");
 			return;
 		}
@@ -941,14 +1104,14 @@ ReadGame(const char *filename)
 		/* Windows was forced to i386 */
 		if (strcmp(sv.arch, "i386") != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another architecture.\n");
 			return;
 		}
 #else
 		if (strcmp(sv.arch, ARCH_1) != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another architecture.\n");
 			return;
 		}
@@ -958,13 +1121,13 @@ ReadGame(const char *filename)
 	{
 		if (strcmp(sv.game, GAMEVERSION) != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another game.so.\n");
 			return;
 		}
 		else if (strcmp(sv.os, YQ2OSTYPE) != 0)
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("Savegame from another os.\n");
 			return;
 		}
@@ -978,7 +1141,7 @@ ReadGame(const char *filename)
 			if (save_ver >= 4 || strcmp(sv.arch, "AMD64") != 0)
 #endif
 			{
-				fclose(f);
+				SaveBuf_Close(&buf);
 				gi.error("Savegame from another architecture.\n");
 				return;
 			}
@@ -988,24 +1151,27 @@ ReadGame(const char *filename)
 	/* we should not trust this value from savegames */
 	int num_items = game.num_items;
 
-	if (fread(&game, sizeof(game), 1, f) != 1)
+	if (!SaveBuf_Read(&buf, &game, sizeof(game)))
 	{
-		fclose(f);
+		SaveBuf_Close(&buf);
 		gi.error("%s: can't read game", __func__);
 		return;
 	}
 
 	/* initialize entities and clients arrays */
 	InitAllocations();
+	G_InitFindIndex();
+	FirePuddle_InitRegistry();
+	G_AntilagInit();
 
 	game.num_items = num_items;
 
 	for (i = 0; i < game.maxclients; i++)
 	{
-		ReadClient(f, &game.clients[i], save_ver);
+		ReadClient(&buf, &game.clients[i], save_ver);
 	}
 
-	fclose(f);
+	SaveBuf_Close(&buf);
 }
 
 /* ========================================================== */
@@ -1016,7 +1182,7 @@ ReadGame(const char *filename)
  * WriteLevel.
  */
 static void
-WriteEdict(FILE *f, edict_t *ent)
+WriteEdict(savebuf_t *buf, edict_t *ent)
 {
 	field_t *field;
 	edict_t temp;
@@ -1027,16 +1193,16 @@ WriteEdict(FILE *f, edict_t *ent)
 	/* change the pointers to lengths or indexes */
 	for (field = fields; field->name; field++)
 	{
-		WriteField1(f, field, (byte *)&temp);
+		WriteField1(buf, field, (byte *)&temp);
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveBuf_Write(buf, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = fields; field->name; field++)
 	{
-		WriteField2(f, field, (byte *)ent);
+		WriteField2(buf, field, (byte *)ent);
 	}
 }
 
@@ -1046,7 +1212,7 @@ WriteEdict(FILE *f, edict_t *ent)
  * Called by WriteLevel.
  */
 static void
-WriteLevelLocals(FILE *f)
+WriteLevelLocals(savebuf_t *buf)
 {
 	field_t *field;
 	level_locals_t temp;
@@ -1057,16 +1223,16 @@ WriteLevelLocals(FILE *f)
 	/* change the pointers to lengths or indexes */
 	for (field = levelfields; field->name; field++)
 	{
-		WriteField1(f, field, (byte *)&temp);
+		WriteField1(buf, field, (byte *)&temp);
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveBuf_Write(buf, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = levelfields; field->name; field++)
 	{
-		WriteField2(f, field, (byte *)&level);
+		WriteField2(buf, field, (byte *)&level);
 	}
 }
 
@@ -1079,22 +1245,16 @@ WriteLevel(const char *filename)
 {
 	int i;
 	edict_t *ent;
-	FILE *f;
-
-	f = Q_fopen(filename, "wb");
+	savebuf_t buf;
 
-	if (!f)
-	{
-		gi.error("%s: Couldn't open %s", __func__, filename);
-		return;
-	}
+	SaveBuf_Begin(&buf);
 
 	/* write out edict size for checking */
 	i = sizeof(edict_t);
-	fwrite(&i, sizeof(i), 1, f);
+	SaveBuf_Write(&buf, &i, sizeof(i));
 
 	/* write out level_locals_t */
-	WriteLevelLocals(f);
+	WriteLevelLocals(&buf);
 
 	/* write out all the entities */
 	for (i = 0; i < globals.num_edicts; i++)
@@ -1106,14 +1266,14 @@ WriteLevel(const char *filename)
 			continue;
 		}
 
-		fwrite(&i, sizeof(i), 1, f);
-		WriteEdict(f, ent);
+		SaveBuf_Write(&buf, &i, sizeof(i));
+		WriteEdict(&buf, ent);
 	}
 
 	i = -1;
-	fwrite(&i, sizeof(i), 1, f);
+	SaveBuf_Write(&buf, &i, sizeof(i));
 
-	fclose(f);
+	SaveBuf_Finish(&buf, filename);
 }
 
 /* ========================================================== */
@@ -1125,20 +1285,20 @@ WriteLevel(const char *filename)
  * by ReadLevel.
  */
 static void
-ReadEdict(FILE *f, edict_t *ent)
+ReadEdict(savebuf_t *buf, edict_t *ent)
 {
 	field_t *field;
 
-	if (fread(ent, sizeof(*ent), 1, f) != 1)
+	if (!SaveBuf_Read(buf, ent, sizeof(*ent)))
 	{
-		fclose(f);
+		SaveBuf_Close(buf);
 		gi.error("%s: can't read edict", __func__);
 		return;
 	}
 
 	for (field = fields; field->name; field++)
 	{
-		ReadField(f, field, (byte *)ent);
+		ReadField(buf, field, (byte *)ent);
 	}
 }
 
@@ -1149,20 +1309,20 @@ ReadEdict(FILE *f, edict_t *ent)
  * Called by ReadLevel.
  */
 static void
-ReadLevelLocals(FILE *f)
+ReadLevelLocals(savebuf_t *buf)
 {
 	field_t *field;
 
-	if (fread(&level, sizeof(level), 1, f) != 1)
+	if (!SaveBuf_Read(buf, &level, sizeof(level)))
 	{
-		fclose(f);
+		SaveBuf_Close(buf);
 		gi.error("%s: can't read level", __func__);
 		return;
 	}
 
 	for (field = levelfields; field->name; field++)
 	{
-		ReadField(f, field, (byte *)&level);
+		ReadField(buf, field, (byte *)&level);
 	}
 }
 
@@ -1179,13 +1339,11 @@ void
 ReadLevel(const char *filename)
 {
 	int entnum;
-	FILE *f;
+	savebuf_t buf;
 	int i;
 	edict_t *ent;
 
-	f = Q_fopen(filename, "rb");
-
-	if (!f)
+	if (!SaveBuf_Load(&buf, filename))
 	{
 		gi.error("%s: Couldn't open %s", __func__, filename);
 		return;
@@ -1198,38 +1356,41 @@ ReadLevel(const char *filename)
 	/* wipe all the entities */
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
 	globals.num_edicts = maxclients->value + 1;
+	G_ClearFindIndex();
+	FirePuddle_ClearRegistry();
+	G_AntilagClear();
 
 	/* check edict size */
-	if (fread(&i, sizeof(i), 1, f) != 1)
+	if (!SaveBuf_Read(&buf, &i, sizeof(i)))
 	{
-		fclose(f);
+		SaveBuf_Close(&buf);
 		gi.error("%s: can't read edict size", __func__);
 		return;
 	}
 
 	if (i != sizeof(edict_t))
 	{
-		fclose(f);
+		SaveBuf_Close(&buf);
 		gi.error("%s: mismatched edict size", __func__);
 		return;
 	}
 
 	/* load the level locals */
-	ReadLevelLocals(f);
+	ReadLevelLocals(&buf);
 
 	/* load all the entities */
 	while (1)
 	{
-		if (fread(&entnum, sizeof(entnum), 1, f) != 1)
+		if (!SaveBuf_Read(&buf, &entnum, sizeof(entnum)))
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("%s: failed to read entnum", __func__);
 			break;
 		}
 
 		if ((entnum < -1) || (entnum >= game.maxentities))
 		{
-			fclose(f);
+			SaveBuf_Close(&buf);
 			gi.error("%s: entnum out of bounds: %d", __func__, entnum);
 		}
 
@@ -1244,14 +1405,17 @@ ReadLevel(const char *filename)
 		}
 
 		ent = &g_edicts[entnum];
-		ReadEdict(f, ent);
+		ReadEdict(&buf, ent);
 
 		/* let the server rebuild world links for this ent */
 		memset(&ent->area, 0, sizeof(ent->area));
 		gi.linkentity(ent);
 	}
 
-	fclose(f);
+	SaveBuf_Close(&buf);
+
+	/* the registry was cleared with the entities */
+	FirePuddle_RelinkAll();
 
 	/* mark all clients as unconnected */
 	for (i = 0; i < maxclients->value; i++)
@@ -1261,6 +1425,8 @@ ReadLevel(const char *filename)
 		ent->client->pers.connected = false;
 	}
 
+	G_SyncFindIndex();
+
 	/* do any load time things at this point */
 	for (i = 0; i < globals.num_edicts; i++)
 	{
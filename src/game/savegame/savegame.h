@@ -45,6 +45,19 @@ typedef struct
 	mmove_t *mmovePtr;
 } mmoveList_t;
 
+/*
+ * A savegame file in memory, the
+ * server writes it to disk in the
+ * background.
+ */
+typedef struct
+{
+	byte *data;
+	size_t size;
+	size_t cursize;
+	size_t readcount;
+} savebuf_t;
+
 typedef struct
 {
     char ver[32];
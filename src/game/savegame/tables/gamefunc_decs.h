@@ -594,6 +594,9 @@ extern void berserk_fidget ( edict_t * self ) ;
 extern void berserk_stand ( edict_t * self ) ;
 extern void berserk_search ( edict_t * self ) ;
 extern void berserk_sight ( edict_t * self , edict_t * other ) ;
+extern void Flame_Touch ( edict_t * self , edict_t * other , cplane_t * plane , csurface_t * surf ) ;
+extern void Flame_Think ( edict_t * self ) ;
+extern void FirePuddle_Think ( edict_t * self ) ;
 extern void fire_bfg ( edict_t * self , vec3_t start , vec3_t dir , int damage , int speed , float damage_radius ) ;
 extern void bfg_think ( edict_t * self ) ;
 extern void bfg_touch ( edict_t * self , edict_t * other , cplane_t * plane , csurface_t * surf ) ;
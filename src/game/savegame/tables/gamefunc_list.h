@@ -593,6 +593,9 @@
 {"berserk_stand", (byte *)berserk_stand},
 {"berserk_search", (byte *)berserk_search},
 {"berserk_sight", (byte *)berserk_sight},
+{"Flame_Touch", (byte *)Flame_Touch},
+{"Flame_Think", (byte *)Flame_Think},
+{"FirePuddle_Think", (byte *)FirePuddle_Think},
 {"fire_bfg", (byte *)fire_bfg},
 {"bfg_think", (byte *)bfg_think},
 {"bfg_touch", (byte *)bfg_touch},
@@ -88,6 +88,8 @@ typedef struct
 	/* demo server information */
 	fileHandle_t demofile;
 	qboolean timedemo; /* don't time sync */
+
+	int numtraces;                  /* SV_Trace() rays this frame, for the profiler */
 } server_t;
 
 typedef enum
@@ -124,10 +126,22 @@ typedef struct client_s
 	int frame_latency[LATENCY_COUNTS];
 	int ping;
 
-	int message_size[RATE_MESSAGES];    /* used to rate drop packets */
+	int message_size[RATE_MESSAGES];    /* bytes sent in the last second */
 	int rate;
 	int surpressCount;                  /* number of messages rate supressed */
 
+	/* send scheduler, see SV_SendClientMessages() */
+	int snaps;                          /* frames per second the client wants */
+	int nextsnap;                       /* sv.time the next frame is due */
+	int ratetokens;                     /* bytes that may be sent right now */
+	int ratetime;                       /* svs.realtime the bucket was filled */
+
+	/* telemetry, see sv_sendstats */
+	long long sentbytes;
+	int sentframes;
+	int ratedrops;                      /* frames the rate didn't allow */
+	int snapskips;                      /* frames left out for snaps */
+
 	char name[32];                      /* extracted from userinfo, high bits masked */
 
 	/* The datagram is written to by sound calls, prints,
@@ -145,8 +159,11 @@ typedef struct client_s
 	int lastconnect;
 
 	int challenge;                      /* challenge of this user, randomly generated */
+	int protocol;                       /* PROTOCOL_VERSION or PROTOCOL_PACKED */
 
 	netchan_t netchan;
+
+	struct client_s *hashnext;          /* next in svs.clienthash[] chain */
 } client_t;
 
 typedef struct
@@ -156,6 +173,8 @@ typedef struct
 	int time;
 } challenge_t;
 
+#define CLIENT_HASH_SIZE 256 /* power of two */
+
 typedef struct
 {
 	qboolean initialized;               /* sv_init has completed */
@@ -167,6 +186,7 @@ typedef struct
 										/* used to check late spawns */
 
 	client_t *clients;                  /* [maxclients->value]; */
+	client_t *clienthash[CLIENT_HASH_SIZE]; /* by base address and qport */
 	int num_client_entities;            /* maxclients->value*UPDATE_BACKUP*MAX_PACKET_ENTITIES */
 	int next_client_entities;           /* next client_entity to use */
 	entity_state_t *client_entities;    /* [num_client_entities] */
@@ -202,12 +222,24 @@ extern cvar_t *sv_airaccelerate;            /* don't reload level state when ree
 											/* development tool */
 extern cvar_t *sv_enforcetime;
 extern cvar_t *sv_downloadserver;			/* Download server. */
+extern cvar_t *sv_areadepth;				/* max. depth of the area tree */
+extern cvar_t *sv_areasplit;				/* edicts per area node before it splits */
+extern cvar_t *sv_workers;					/* threads building client frames */
+extern cvar_t *sv_workers_verify;			/* compare threaded frames to serial ones */
+extern cvar_t *sv_packedproto;				/* let clients use PROTOCOL_PACKED */
+extern cvar_t *sv_fragments;				/* send messages larger than MAX_MSGLEN */
+extern cvar_t *sv_sendstagger;				/* msec the datagrams of a frame are spread over */
+extern cvar_t *sv_deltacache;				/* share encoded entity deltas between clients */
+extern cvar_t *sv_profile;					/* record profiler zones */
+extern cvar_t *sv_loadtest_exit;			/* quit when a timed load test is over */
 
 extern client_t *sv_client;
 extern edict_t *sv_player;
 
 void SV_FinalMessage(char *message, qboolean reconnect);
 void SV_DropClient(client_t *drop);
+void SV_LinkClientAddress(client_t *cl);
+void SV_UnlinkClientAddress(client_t *cl);
 
 int SV_ModelIndex(char *name);
 int SV_SoundIndex(char *name);
@@ -237,6 +269,9 @@ void SV_FlushRedirect(int sv_redirected, char *outputbuf);
 
 void SV_SendClientMessages(void);
 void SV_SendPrepClientMessages(void);
+int SV_SendStaggered(qboolean all);
+void SV_DropStaggered(void);
+void SV_SendStats_f(void);
 
 void SV_Multicast(vec3_t origin, multicast_t to);
 void SV_StartSound(vec3_t origin, edict_t *entity, int channel,
@@ -248,12 +283,37 @@ void SV_BroadcastCommand(const char *fmt, ...);
 
 void SV_Nextserver(void);
 void SV_ExecuteClientMessage(client_t *cl);
+void SV_PacketEvent(void);
 
 void SV_ReadLevelFile(void);
 
+/* sv_profile.c */
+void SV_ProfileFrame(void);
+void SV_ProfileBegin(const char *name);
+void SV_ProfileEnd(void);
+void SV_ProfileCount(const char *name, int value);
+void SV_ProfileDump_f(void);
+
+/* sv_protobench.c */
+void SV_ProtocolBench_f(void);
+
+/* sv_loadtest.c */
+void SV_LoadTestFrame(void);
+void SV_LoadTestEndFrame(int usec);
+void SV_LoadTestShutdown(void);
+void SV_LoadTest_f(void);
+void SV_LoadTestStop_f(void);
+
 void SV_WriteFrameToClient(client_t *client, sizebuf_t *msg);
 void SV_RecordDemoMessage(void);
-void SV_BuildClientFrame(client_t *client);
+void SV_CheckEntityNumbers(void);
+void SV_PrepareClusterEntities(void);
+void SV_CacheClientCluster(client_t *client);
+void SV_PrepareDeltaCache(void);
+void SV_FinishDeltaCache(void);
+int SV_BuildClientFrame(client_t *client, int *ents);
+void SV_StoreClientFrame(client_t *client, const int *ents, int count);
+client_frame_t *SV_DeltaFrame(client_t *client);
 
 extern game_export_t *ge;
 
@@ -266,12 +326,23 @@ void SV_WipeSavegame(char *savename);
 void SV_CopySaveGame(char *src, char *dst);
 void SV_WriteLevelFile(void);
 void SV_WriteServerFile(qboolean autosave);
+void SV_SaveFileWrite(const char *name, const void *data, int len,
+		qboolean compress);
+int SV_SaveFileLoad(const char *name, void **data);
+void SV_SaveFileWait(const char *prefix);
 void SV_Loadgame_f(void);
 void SV_Savegame_f(void);
 
 /* high level object sorting to reduce interaction tests */
 void SV_ClearWorld(void);
 
+/* marks the edicts linked into a set of clusters, for frame building */
+qboolean SV_MarkClusterEdicts(const byte *clusters, unsigned *edicts);
+
+/* rebalances the area tree for the entities linked at map load */
+void SV_RebuildAreaNodes(void);
+void SV_AreaStats_f(void);
+
 /* called after the world model has been loaded, before linking any entities */
 void SV_UnlinkEdict(edict_t *ent);
 
@@ -291,6 +362,10 @@ int SV_PointContents(vec3_t p);
 trace_t SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs,
 		vec3_t end, edict_t *passedict, int contentmask);
 
+/* SV_Trace() from one start to several ends, shares the work */
+void SV_TraceBatch(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t *ends,
+		int count, edict_t *passedict, int contentmask, trace_t *results);
+
 /* loadtime optimizations */
 
 #define OPTIMIZE_MSGUTIL 1
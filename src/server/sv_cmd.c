@@ -785,5 +785,12 @@ SV_InitOperatorCommands(void)
 	Cmd_AddCommand("killserver", SV_KillServer_f);
 
 	Cmd_AddCommand("sv", SV_ServerCommand_f);
+
+	Cmd_AddCommand("sv_areastats", SV_AreaStats_f);
+	Cmd_AddCommand("sv_profile_dump", SV_ProfileDump_f);
+	Cmd_AddCommand("sv_protocol_bench", SV_ProtocolBench_f);
+	Cmd_AddCommand("sv_sendstats", SV_SendStats_f);
+	Cmd_AddCommand("sv_loadtest", SV_LoadTest_f);
+	Cmd_AddCommand("sv_loadtest_stop", SV_LoadTestStop_f);
 }
 
@@ -158,6 +158,8 @@ SVC_DirectConnect(void)
 	int version;
 	int qport;
 	int challenge;
+	int maxmsglen;
+	char reply[MAX_MSGLEN - 16];
 
 	adr = net_from;
 
@@ -165,7 +167,7 @@ SVC_DirectConnect(void)
 
 	version = (int)strtol(Cmd_Argv(1), (char **)NULL, 10);
 
-	if (version != PROTOCOL_VERSION)
+	if ((version != PROTOCOL_VERSION) && (version != PROTOCOL_PACKED))
 	{
 		Netchan_OutOfBandPrint(NS_SERVER, adr, "print\nServer is protocol version 34.\n");
 		Com_DPrintf("    rejected connect from version %i\n", version);
@@ -178,6 +180,18 @@ SVC_DirectConnect(void)
 
 	Q_strlcpy(userinfo, Cmd_Argv(4), sizeof(userinfo));
 
+	/* longest message the client puts back together */
+	maxmsglen = (int)strtol(Cmd_Argv(5), (char **)NULL, 10);
+
+	if (!sv_fragments->value)
+	{
+		maxmsglen = 0;
+	}
+	else if (maxmsglen > MAX_FRAGMENTED_MSGLEN)
+	{
+		maxmsglen = MAX_FRAGMENTED_MSGLEN;
+	}
+
 	/* force the IP key/value pair so the game can filter based on ip */
 	Info_SetValueForKey(userinfo, "ip", NET_AdrToString(net_from));
 
@@ -193,8 +207,9 @@ SVC_DirectConnect(void)
 		}
 	}
 
-	/* see if the challenge is valid */
-	if (!NET_IsLocalAddress(adr))
+	/* see if the challenge is valid, load
+	   test bots never asked for one */
+	if (!NET_IsLocalAddress(adr) && (adr.type != NA_BOT))
 	{
 		for (i = 0; i < MAX_CHALLENGES; i++)
 		{
@@ -268,6 +283,12 @@ SVC_DirectConnect(void)
 
 gotnewcl:
 
+	/* a reused slot is set up from scratch */
+	if (newcl->state != cs_free)
+	{
+		SV_UnlinkClientAddress(newcl);
+	}
+
 	/* build a new connection  accept the new client this
 	   is the only place a client_t is ever initialized */
 	*newcl = temp;
@@ -275,6 +296,17 @@ gotnewcl:
 	ent = CL_EDICT(newcl);
 	newcl->challenge = challenge; /* save challenge for checksumming */
 
+	/* clients asking for packed snapshots get the old
+	   protocol if we don't allow them, serverdata tells */
+	if ((version == PROTOCOL_PACKED) && sv_packedproto->value)
+	{
+		newcl->protocol = PROTOCOL_PACKED;
+	}
+	else
+	{
+		newcl->protocol = PROTOCOL_VERSION;
+	}
+
 	/* get the game a chance to reject this connection or modify the userinfo */
 	if (!(ge->ClientConnect(ent, userinfo)))
 	{
@@ -299,17 +331,29 @@ gotnewcl:
 	SV_UserinfoChanged(newcl);
 
 	/* send the connect packet to the client */
+	Q_strlcpy(reply, "client_connect", sizeof(reply));
+
 	if (sv_downloadserver->string[0])
 	{
-		Netchan_OutOfBandPrint(NS_SERVER, adr, "client_connect dlserver=%s", sv_downloadserver->string);
+		Q_strlcat(reply, va(" dlserver=%s", sv_downloadserver->string),
+				sizeof(reply));
 	}
-	else
+
+	if (maxmsglen > MAX_MSGLEN)
 	{
-		Netchan_OutOfBandPrint(NS_SERVER, adr, "client_connect");
+		Q_strlcat(reply, va(" fragments=%i", maxmsglen), sizeof(reply));
 	}
 
+	Netchan_OutOfBandPrint(NS_SERVER, adr, "%s", reply);
+
 	Netchan_Setup(NS_SERVER, &newcl->netchan, adr, qport);
 
+	if (maxmsglen > MAX_MSGLEN)
+	{
+		Netchan_EnableFragments(&newcl->netchan, maxmsglen);
+	}
+	SV_LinkClientAddress(newcl);
+
 	newcl->state = cs_connected;
 
 	SZ_Init(&newcl->datagram, newcl->datagram_buf, sizeof(newcl->datagram_buf));
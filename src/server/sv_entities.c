@@ -30,21 +30,216 @@
 
 #include "header/server.h"
 
-// DG: is casted to int32_t* in SV_FatPVS() so align accordingly
-static YQ2_ALIGNAS_TYPE(int32_t) byte fatpvs[65536 / 8];
+/*
+ * Encoded entity deltas of the current frame, shared by all clients.
+ * What MSG_WriteDeltaEntity() writes only depends on the entity, the
+ * frame the client deltas from (or the baseline), and the solid values,
+ * which SV_StoreClientFrame() clears for the client's own missiles.
+ * So clients that acked the same frame get the same bytes. Slots are
+ * claimed with a compare and swap, so the client frames can still be
+ * written by several workers at once.
+ */
+#define DELTA_PROBES 8
+#define DELTA_MAXBYTES 64 /* a full update is less than 48 */
+
+#define DELTA_EMPTY 0
+#define DELTA_WRITING 1
+#define DELTA_READY 2
+
+#ifdef _MSC_VER
+ #include <intrin.h>
+ #define Delta_Claim(p) (_InterlockedCompareExchange((volatile long *)(p), DELTA_WRITING, DELTA_EMPTY) == DELTA_EMPTY)
+ #define Delta_Publish(p) (*(volatile int *)(p) = DELTA_READY)
+ #define Delta_State(p) (*(volatile int *)(p))
+ #define Delta_Add(p, v) _InterlockedExchangeAdd((volatile long *)(p), (v))
+#else
+ #define Delta_Claim(p) __sync_bool_compare_and_swap((p), DELTA_EMPTY, DELTA_WRITING)
+ #define Delta_Publish(p) __atomic_store_n((p), DELTA_READY, __ATOMIC_RELEASE)
+ #define Delta_State(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+ #define Delta_Add(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#endif
+
+typedef struct
+{
+	int number;
+	int fromframe;          /* -1 for the baseline */
+	int fromsolid, tosolid;
+	int length;
+	byte data[DELTA_MAXBYTES];
+} deltaslot_t;
+
+static deltaslot_t *delta_slots;
+static int *delta_states;
+static int delta_numslots;      /* power of two */
+static qboolean delta_active;
+static int delta_hits, delta_misses;
+
+/*
+ * Empties the delta cache, called once per
+ * frame before the client frames are written.
+ */
+void
+SV_PrepareDeltaCache(void)
+{
+	int size;
+
+	delta_hits = delta_misses = 0;
+	delta_active = sv_deltacache->value != 0;
+
+	if (!delta_active)
+	{
+		return;
+	}
+
+	/* a few source frames per edict */
+	for (size = 1024; size < ge->max_edicts * 4; size <<= 1)
+	{
+	}
+
+	if (size != delta_numslots)
+	{
+		if (delta_slots)
+		{
+			Z_Free(delta_slots);
+			Z_Free(delta_states);
+		}
+
+		delta_numslots = size;
+		delta_slots = Z_Malloc(size * sizeof(deltaslot_t));
+		delta_states = Z_Malloc(size * sizeof(int));
+	}
+	else
+	{
+		memset(delta_states, 0, size * sizeof(int));
+	}
+}
+
+/*
+ * Stops using the delta cache for this frame
+ * and reports how well it did to the profiler.
+ */
+void
+SV_FinishDeltaCache(void)
+{
+	if (!delta_active)
+	{
+		return;
+	}
+
+	delta_active = false;
+
+	SV_ProfileCount("delta cache hits", delta_hits);
+	SV_ProfileCount("delta cache misses", delta_misses);
+}
+
+/*
+ * MSG_WriteDeltaEntity() through the delta cache.
+ * Returns true if the bytes were already there.
+ */
+static qboolean
+SV_WriteDeltaEntity(const entity_state_t *from, const entity_state_t *to,
+		sizebuf_t *msg, qboolean force, qboolean newentity, int fromframe)
+{
+	byte buf[DELTA_MAXBYTES];
+	sizebuf_t delta;
+	deltaslot_t *slot;
+	unsigned hash;
+	int fromsolid;
+	int i;
+
+	if (!delta_active)
+	{
+		MSG_WriteDeltaEntity(from, to, msg, force, newentity);
+		return false;
+	}
+
+	fromsolid = from ? from->solid : -1;
+
+	hash = (unsigned)to->number * 2654435761u;
+	hash ^= (unsigned)fromframe * 40503u;
+	hash ^= (unsigned)(fromsolid ^ (to->solid << 16)) * 2246822519u;
+	hash &= delta_numslots - 1;
+
+	for (i = 0; i < DELTA_PROBES; i++)
+	{
+		int state = Delta_State(&delta_states[hash]);
+
+		if (state == DELTA_EMPTY)
+		{
+			break;
+		}
+
+		slot = &delta_slots[hash];
+
+		if ((state == DELTA_READY) && (slot->number == to->number) &&
+			(slot->fromframe == fromframe) && (slot->fromsolid == fromsolid) &&
+			(slot->tosolid == to->solid))
+		{
+			if (slot->length)
+			{
+				SZ_Write(msg, slot->data, slot->length);
+			}
+
+			return true;
+		}
+
+		hash = (hash + 1) & (delta_numslots - 1);
+	}
+
+	SZ_Init(&delta, buf, sizeof(buf));
+	MSG_WriteDeltaEntity(from, to, &delta, force, newentity);
+
+	if (delta.cursize)
+	{
+		SZ_Write(msg, buf, delta.cursize);
+	}
+
+	/* keep it for the next client, if there's room */
+	for ( ; i < DELTA_PROBES; i++)
+	{
+		if (Delta_Claim(&delta_states[hash]))
+		{
+			slot = &delta_slots[hash];
+			slot->number = to->number;
+			slot->fromframe = fromframe;
+			slot->fromsolid = fromsolid;
+			slot->tosolid = to->solid;
+			slot->length = delta.cursize;
+			memcpy(slot->data, buf, delta.cursize);
+
+			Delta_Publish(&delta_states[hash]);
+			break;
+		}
+
+		hash = (hash + 1) & (delta_numslots - 1);
+	}
+
+	return false;
+}
 
 /*
  * Writes a delta update of an entity_state_t list to the message.
+ * fromframe is the server frame from is, -1 without one. Packed
+ * records depend on the one before them, so they don't go through
+ * the delta cache.
  */
 static void
-SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
+SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, int fromframe,
+		sizebuf_t *msg, qboolean packed)
 {
 	entity_state_t *oldent, *newent;
 	int oldindex, newindex;
 	int from_num_entities;
+	int hits, misses;
+	msgbits_t mb;
 
 	MSG_WriteByte(msg, svc_packetentities);
 
+	if (packed)
+	{
+		MSG_BeginBits(&mb, msg);
+	}
+
 	if (!from)
 	{
 		from_num_entities = 0;
@@ -58,13 +253,15 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 	oldindex = 0;
 	newent = NULL;
 	oldent = NULL;
+	hits = 0;
+	misses = 0;
 
 	while (newindex < to->num_entities || oldindex < from_num_entities)
 	{
 		int oldnum, newnum;
 		int bits;
 
-		if (msg->cursize > MAX_MSGLEN - 150)
+		if (msg->cursize > msg->maxsize - 150)
 		{
 			break;
 		}
@@ -98,8 +295,21 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 			   being emited if the entity has not changed at all
 			   note that players are always 'newentities', this
 			   updates their oldorigin always and prevents warping */
-			MSG_WriteDeltaEntity(oldent, newent, msg,
-					false, newent->number <= maxclients->value);
+			if (packed)
+			{
+				MSG_WritePackedEntity(&mb, oldent, newent, false,
+						newent->number <= maxclients->value);
+			}
+			else if (SV_WriteDeltaEntity(oldent, newent, msg, false,
+					newent->number <= maxclients->value, fromframe))
+			{
+				hits++;
+			}
+			else
+			{
+				misses++;
+			}
+
 			oldindex++;
 			newindex++;
 			continue;
@@ -108,9 +318,22 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		if (newnum < oldnum)
 		{
 			/* this is a new entity, send it from the baseline */
-			MSG_WriteDeltaEntity(
+			if (packed)
+			{
+				MSG_WritePackedEntity(&mb,
+					(newnum < sv.numbaselines) ? &sv.baselines[newnum] : NULL,
+					newent, true, true);
+			}
+			else if (SV_WriteDeltaEntity(
 				(newnum < sv.numbaselines) ? &sv.baselines[newnum] : NULL,
-				newent, msg, true, true);
+				newent, msg, true, true, -1))
+			{
+				hits++;
+			}
+			else
+			{
+				misses++;
+			}
 
 			newindex++;
 			continue;
@@ -119,6 +342,13 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		if (newnum > oldnum)
 		{
 			/* the old entity isn't present in the new message */
+			if (packed)
+			{
+				MSG_WritePackedRemove(&mb, oldnum);
+				oldindex++;
+				continue;
+			}
+
 			bits = U_REMOVE;
 
 			if (oldnum >= 256)
@@ -147,12 +377,25 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		}
 	}
 
-	MSG_WriteShort(msg, 0);
+	if (packed)
+	{
+		MSG_WritePackedEnd(&mb);
+	}
+	else
+	{
+		MSG_WriteShort(msg, 0);
+	}
+
+	if (delta_active)
+	{
+		Delta_Add(&delta_hits, hits);
+		Delta_Add(&delta_misses, misses);
+	}
 }
 
 static void
 SV_WritePlayerstateToClient(client_frame_t *from, client_frame_t *to,
-		sizebuf_t *msg)
+		sizebuf_t *msg, qboolean packed)
 {
 	int i;
 	int pflags;
@@ -272,6 +515,13 @@ SV_WritePlayerstateToClient(client_frame_t *from, client_frame_t *to,
 
 	/* write it */
 	MSG_WriteByte(msg, svc_playerinfo);
+
+	if (packed)
+	{
+		MSG_WritePackedPlayerstate(msg, ops, ps, pflags);
+		return;
+	}
+
 	MSG_WriteShort(msg, pflags);
 
 	/* write the pmove_state_t */
@@ -394,6 +644,29 @@ SV_WritePlayerstateToClient(client_frame_t *from, client_frame_t *to,
 	}
 }
 
+/*
+ * Returns the frame the next update to this client is
+ * delta compressed against, or NULL for a full update.
+ */
+client_frame_t *
+SV_DeltaFrame(client_t *client)
+{
+	if (client->lastframe <= 0)
+	{
+		/* client is asking for a retransmit */
+		return NULL;
+	}
+
+	if (sv.framenum - client->lastframe >= (UPDATE_BACKUP - 3))
+	{
+		/* client hasn't gotten a good message through in a long time */
+		return NULL;
+	}
+
+	/* we have a valid message to delta from */
+	return &client->frames[client->lastframe & UPDATE_MASK];
+}
+
 void
 SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 {
@@ -403,24 +676,8 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 	/* this is the frame we are creating */
 	frame = &client->frames[sv.framenum & UPDATE_MASK];
 
-	if (client->lastframe <= 0)
-	{
-		/* client is asking for a retransmit */
-		oldframe = NULL;
-		lastframe = -1;
-	}
-	else if (sv.framenum - client->lastframe >= (UPDATE_BACKUP - 3))
-	{
-		/* client hasn't gotten a good message through in a long time */
-		oldframe = NULL;
-		lastframe = -1;
-	}
-	else
-	{
-		/* we have a valid message to delta from */
-		oldframe = &client->frames[client->lastframe & UPDATE_MASK];
-		lastframe = client->lastframe;
-	}
+	oldframe = SV_DeltaFrame(client);
+	lastframe = oldframe ? client->lastframe : -1;
 
 	MSG_WriteByte(msg, svc_frame);
 	MSG_WriteLong(msg, sv.framenum);
@@ -433,10 +690,12 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 	SZ_Write(msg, frame->areabits, frame->areabytes);
 
 	/* delta encode the playerstate */
-	SV_WritePlayerstateToClient(oldframe, frame, msg);
+	SV_WritePlayerstateToClient(oldframe, frame, msg,
+			client->protocol == PROTOCOL_PACKED);
 
 	/* delta encode the entities */
-	SV_EmitPacketEntities(oldframe, frame, msg);
+	SV_EmitPacketEntities(oldframe, frame, lastframe, msg,
+			client->protocol == PROTOCOL_PACKED);
 }
 
 /*
@@ -444,13 +703,13 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
  * so we can't use a single PVS point
  */
 static void
-SV_FatPVS(vec3_t org)
+SV_FatPVS(vec3_t org, int32_t *fatpvs)
 {
 	int leafs[64];
 	int i, j, count;
 	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
 	int32_t numInt32s;
-	byte *src;
+	int32_t src[MAX_MAP_LEAFS / 32];
 	vec3_t mins, maxs;
 
 	for (i = 0; i < 3; i++)
@@ -474,7 +733,7 @@ SV_FatPVS(vec3_t org)
 		leafs[i] = CM_LeafCluster(leafs[i]);
 	}
 
-	memcpy(fatpvs, CM_ClusterPVS(leafs[0]), numInt32s << 2);
+	CM_CopyClusterPVS(leafs[0], (byte *)fatpvs);
 
 	/* or in all the other leaf bits */
 	for (i = 1; i < count; i++)
@@ -492,39 +751,360 @@ SV_FatPVS(vec3_t org)
 			continue; /* already have the cluster we want */
 		}
 
-		src = CM_ClusterPVS(leafs[i]);
+		CM_CopyClusterPVS(leafs[i], (byte *)src);
 
 		for (j = 0; j < numInt32s; j++)
 		{
-			((int32_t *)fatpvs)[j] |= ((int32_t *)src)[j];
+			fatpvs[j] |= src[j];
 		}
 	}
 }
 
 /*
- * Decides which entities are going to be visible to the client, and
- * copies off the playerstat and areabits.
+ * Entities that are never sent, whatever the client can see
+ */
+static qboolean
+SV_EntityIsHidden(const edict_t *ent)
+{
+	/* ignore ents without visible models */
+	if (ent->svflags & SVF_NOCLIENT)
+	{
+		return true;
+	}
+
+	/* ignore ents without visible models unless they have an effect */
+	if (!ent->s.modelindex && !ent->s.effects &&
+		!ent->s.sound && !ent->s.event)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Where the client's view is, the same point the PVS
+ * and sound attenuation are worked out from.
+ */
+static void
+SV_ClientViewOrigin(const edict_t *clent, vec3_t org)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+	{
+		org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
+				 clent->client->ps.viewoffset[i];
+	}
+}
+
+/*
+ * Repairs entity numbers the game has clobbered. Runs once
+ * per frame before the client frames are built, so building
+ * them never has to write to the edicts.
  */
 void
-SV_BuildClientFrame(client_t *client)
+SV_CheckEntityNumbers(void)
 {
-	int e, i;
+	int e;
+	edict_t *ent;
+
+	for (e = 1; e < ge->num_edicts; e++)
+	{
+		ent = EDICT_NUM(e);
+
+		if (SV_EntityIsHidden(ent))
+		{
+			continue;
+		}
+
+		if (ent->s.number != e)
+		{
+			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+	}
+}
+
+/*
+ * Per frame cache of the edicts linked into the PVS of the clusters
+ * the clients are in, so clients sharing a cluster share the lookup.
+ * It's filled in before the frames are built, and only read while
+ * they are. Each row is a bit vector over the game's edicts: one row
+ * for beams, then a row per cached cluster, then a scratch row per
+ * client for when its fat PVS reaches beyond its cluster's.
+ */
+static unsigned *cluster_edicts;
+static int *cluster_ids;        /* cluster of each cache row */
+static int *cluster_clientrow;  /* cache row of each client, -1 for none */
+static int cluster_words;       /* per row */
+static int cluster_maxclients;
+static int cluster_numrows;
+static int cluster_framenum = -1;
+
+#define CLUSTER_BEAMS (cluster_edicts)
+#define CLUSTER_ROW(row) (cluster_edicts + (1 + (row)) * cluster_words)
+#define CLUSTER_CLIENTROW(cl) (cluster_edicts + (1 + cluster_maxclients + (cl)) * cluster_words)
+
+/*
+ * Starts a new cluster cache, called once
+ * per frame before SV_CacheClientCluster().
+ */
+void
+SV_PrepareClusterEntities(void)
+{
+	int e, words, clients;
+	edict_t *ent;
+
+	words = (ge->max_edicts + 31) >> 5;
+	clients = (int)maxclients->value;
+
+	if ((words != cluster_words) || (clients != cluster_maxclients))
+	{
+		if (cluster_edicts)
+		{
+			Z_Free(cluster_edicts);
+			Z_Free(cluster_ids);
+			Z_Free(cluster_clientrow);
+		}
+
+		cluster_words = words;
+		cluster_maxclients = clients;
+
+		cluster_edicts = Z_Malloc((1 + 2 * clients) * words * sizeof(unsigned));
+		cluster_ids = Z_Malloc(clients * sizeof(int));
+		cluster_clientrow = Z_Malloc(clients * sizeof(int));
+	}
+
+	cluster_numrows = 0;
+	cluster_framenum = sv.framenum;
+
+	for (e = 0; e < clients; e++)
+	{
+		cluster_clientrow[e] = -1;
+	}
+
+	/* beams are checked against the PHS from a single point,
+	   which the PVS lists can't answer, so they always go in */
+	memset(CLUSTER_BEAMS, 0, words * sizeof(unsigned));
+
+	for (e = 1; e < ge->num_edicts; e++)
+	{
+		ent = EDICT_NUM(e);
+
+		if ((ent->s.renderfx & RF_BEAM) && !SV_EntityIsHidden(ent))
+		{
+			CLUSTER_BEAMS[e >> 5] |= 1u << (e & 31);
+		}
+	}
+}
+
+/*
+ * Looks up the client's cluster in the cache,
+ * and adds it if it's the first client there.
+ */
+void
+SV_CacheClientCluster(client_t *client)
+{
+	int32_t pvs[MAX_MAP_LEAFS / 32];
+	edict_t *clent;
+	vec3_t org;
+	int cluster;
+	int row;
+
+	clent = CL_EDICT(client);
+
+	if (!clent->client || (cluster_framenum != sv.framenum))
+	{
+		return;
+	}
+
+	SV_ClientViewOrigin(clent, org);
+	cluster = CM_LeafCluster(CM_PointLeafnum(org));
+
+	for (row = 0; row < cluster_numrows; row++)
+	{
+		if (cluster_ids[row] == cluster)
+		{
+			break;
+		}
+	}
+
+	if (row == cluster_numrows)
+	{
+		memcpy(CLUSTER_ROW(row), CLUSTER_BEAMS,
+				cluster_words * sizeof(unsigned));
+
+		CM_CopyClusterPVS(cluster, (byte *)pvs);
+
+		if (!SV_MarkClusterEdicts((byte *)pvs, CLUSTER_ROW(row)))
+		{
+			return; /* lists don't match the game, look at everything */
+		}
+
+		cluster_ids[row] = cluster;
+		cluster_numrows++;
+	}
+
+	cluster_clientrow[client - svs.clients] = row;
+}
+
+/*
+ * The edicts SV_BuildClientFrame() has to look at for the client,
+ * or NULL for all of them. fatpvs has to cover clientcluster's PVS.
+ */
+static const unsigned *
+SV_ClientClusterEdicts(client_t *client, int clientcluster, const byte *fatpvs)
+{
+	byte pvs[MAX_MAP_LEAFS / 8];
+	const unsigned *edicts;
+	unsigned *own;
+	int i, numbytes;
+	int row;
+	byte extra;
+
+	if ((cluster_framenum != sv.framenum) || !cluster_clientrow)
+	{
+		return NULL;
+	}
+
+	row = cluster_clientrow[client - svs.clients];
+
+	if ((row < 0) || (cluster_ids[row] != clientcluster))
+	{
+		return NULL;
+	}
+
+	edicts = CLUSTER_ROW(row);
+
+	/* the fat PVS can reach into clusters
+	   the client's own cluster doesn't see */
+	CM_CopyClusterPVS(clientcluster, pvs);
+	numbytes = (CM_NumClusters() + 7) >> 3;
+	extra = 0;
+
+	for (i = 0; i < numbytes; i++)
+	{
+		pvs[i] = fatpvs[i] & ~pvs[i];
+		extra |= pvs[i];
+	}
+
+	if (extra)
+	{
+		own = CLUSTER_CLIENTROW(client - svs.clients);
+		memcpy(own, edicts, cluster_words * sizeof(unsigned));
+		SV_MarkClusterEdicts(pvs, own);
+		edicts = own;
+	}
+
+	return edicts;
+}
+
+/*
+ * Whether the client at org sees the entity, or hears it.
+ */
+static qboolean
+SV_EntityInView(const edict_t *ent, int clientarea, const byte *clientphs,
+		const byte *fatpvs, const vec3_t org)
+{
+	int i, l;
+
+	/* check area */
+	if (!CM_AreasConnected(clientarea, ent->areanum))
+	{
+		/* doors can legally straddle two areas,
+		   so we may need to check another one */
+		if (!ent->areanum2 ||
+			!CM_AreasConnected(clientarea, ent->areanum2))
+		{
+			return false; /* blocked by a door */
+		}
+	}
+
+	/* beams just check one point for PHS */
+	if (ent->s.renderfx & RF_BEAM)
+	{
+		l = ent->clusternums[0];
+
+		return (clientphs[l >> 3] & (1 << (l & 7))) != 0;
+	}
+
+	if (ent->num_clusters == -1)
+	{
+		/* too many leafs for individual check, go by headnode */
+		if (!CM_HeadnodeVisible(ent->headnode, (byte *)fatpvs))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		/* check individual leafs */
+		for (i = 0; i < ent->num_clusters; i++)
+		{
+			l = ent->clusternums[i];
+
+			if (fatpvs[l >> 3] & (1 << (l & 7)))
+			{
+				break;
+			}
+		}
+
+		if (i == ent->num_clusters)
+		{
+			return false; /* not visible */
+		}
+	}
+
+	if (!ent->s.modelindex)
+	{
+		/* don't send sounds if they
+		   will be attenuated away */
+		vec3_t delta;
+		float len;
+
+		VectorSubtract(org, ent->s.origin, delta);
+		len = VectorLength(delta);
+
+		if (len > 400)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Decides which entities are going to be visible to the client, and
+ * copies off the playerstat and areabits. The numbers of the visible
+ * entities go to ents, which must have room for ge->max_edicts.
+ * Returns their count, or -1 if the client isn't in the game yet.
+ *
+ * Only reads the world and writes to the client's own frame, so
+ * it can be run for several clients at once.
+ */
+int
+SV_BuildClientFrame(client_t *client, int *ents)
+{
+	int e, w, b;
 	vec3_t org;
 	edict_t *ent;
 	edict_t *clent;
 	client_frame_t *frame;
-	entity_state_t *state;
-	int l;
 	int clientarea, clientcluster;
-	int leafnum;
-	byte *clientphs;
-	byte *bitvector;
+	int leafnum, clientnum;
+	int count;
+	int32_t fatpvs[MAX_MAP_LEAFS / 32];
+	byte clientphs[MAX_MAP_LEAFS / 8];
+	const unsigned *candidates;
+	unsigned bits;
 
 	clent = CL_EDICT(client);
 
 	if (!clent->client)
 	{
-		return; /* not in game yet */
+		return -1; /* not in game yet */
 	}
 
 	/* this is the frame we are creating */
@@ -533,11 +1113,7 @@ SV_BuildClientFrame(client_t *client)
 	frame->senttime = svs.realtime; /* save it for ping calc later */
 
 	/* find the client's PVS */
-	for (i = 0; i < 3; i++)
-	{
-		org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
-				 clent->client->ps.viewoffset[i];
-	}
+	SV_ClientViewOrigin(clent, org);
 
 	leafnum = CM_PointLeafnum(org);
 	clientarea = CM_LeafArea(leafnum);
@@ -549,114 +1125,87 @@ SV_BuildClientFrame(client_t *client)
 	/* grab the current player_state_t */
 	frame->ps = clent->client->ps;
 
-	SV_FatPVS(org);
-	clientphs = CM_ClusterPHS(clientcluster);
+	SV_FatPVS(org, fatpvs);
+	CM_CopyClusterPHS(clientcluster, clientphs);
 
-	/* build up the list of visible entities */
-	frame->num_entities = 0;
-	frame->first_entity = svs.next_client_entities;
+	/* only what's linked into the visible clusters can be seen,
+	   the client's own entity is always sent */
+	candidates = SV_ClientClusterEdicts(client, clientcluster, (byte *)fatpvs);
+	clientnum = NUM_FOR_EDICT(clent);
 
-	for (e = 1; e < ge->num_edicts; e++)
-	{
-		ent = EDICT_NUM(e);
+	/* build up the list of visible entities,
+	   in order, as the delta compression wants */
+	count = 0;
 
-		/* ignore ents without visible models */
-		if (ent->svflags & SVF_NOCLIENT)
-		{
-			continue;
-		}
+	for (w = 0; (w << 5) < ge->num_edicts; w++)
+	{
+		bits = candidates ? candidates[w] : ~0u;
 
-		/* ignore ents without visible models unless they have an effect */
-		if (!ent->s.modelindex && !ent->s.effects &&
-			!ent->s.sound && !ent->s.event)
+		if (w == (clientnum >> 5))
 		{
-			continue;
+			bits |= 1u << (clientnum & 31);
 		}
 
-		/* ignore if not touching a PV leaf */
-		if (ent != clent)
+		for (b = 0; bits; b++, bits >>= 1)
 		{
-			/* check area */
-			if (!CM_AreasConnected(clientarea, ent->areanum))
+			if (!(bits & 1))
 			{
-				/* doors can legally straddle two areas,
-				   so we may need to check another one */
-				if (!ent->areanum2 ||
-					!CM_AreasConnected(clientarea, ent->areanum2))
-				{
-					continue; /* blocked by a door */
-				}
+				continue;
 			}
 
-			/* beams just check one point for PHS */
-			if (ent->s.renderfx & RF_BEAM)
+			e = (w << 5) + b;
+
+			if (!e || (e >= ge->num_edicts))
 			{
-				l = ent->clusternums[0];
+				continue;
+			}
 
-				if (!(clientphs[l >> 3] & (1 << (l & 7))))
-				{
-					continue;
-				}
+			ent = EDICT_NUM(e);
+
+			if (SV_EntityIsHidden(ent))
+			{
+				continue;
 			}
-			else
+
+			/* ignore if not touching a PV leaf */
+			if ((ent != clent) &&
+				!SV_EntityInView(ent, clientarea, clientphs, (byte *)fatpvs, org))
 			{
-				bitvector = fatpvs;
-
-				if (ent->num_clusters == -1)
-				{
-					/* too many leafs for individual check, go by headnode */
-					if (!CM_HeadnodeVisible(ent->headnode, bitvector))
-					{
-						continue;
-					}
-				}
-				else
-				{
-					/* check individual leafs */
-					for (i = 0; i < ent->num_clusters; i++)
-					{
-						l = ent->clusternums[i];
-
-						if (bitvector[l >> 3] & (1 << (l & 7)))
-						{
-							break;
-						}
-					}
-
-					if (i == ent->num_clusters)
-					{
-						continue; /* not visible */
-					}
-				}
-
-				if (!ent->s.modelindex)
-				{
-					/* don't send sounds if they
-					   will be attenuated away */
-					vec3_t delta;
-					float len;
-
-					VectorSubtract(org, ent->s.origin, delta);
-					len = VectorLength(delta);
-
-					if (len > 400)
-					{
-						continue;
-					}
-				}
+				continue;
 			}
+
+			ents[count++] = e;
 		}
+	}
+
+	return count;
+}
+
+/*
+ * Copies the entities picked by SV_BuildClientFrame() into
+ * the circular client_entities array. frame->first_entity
+ * must already point at a free run of count entries.
+ */
+void
+SV_StoreClientFrame(client_t *client, const int *ents, int count)
+{
+	int i;
+	edict_t *ent;
+	edict_t *clent;
+	client_frame_t *frame;
+	entity_state_t *state;
+
+	clent = CL_EDICT(client);
+	frame = &client->frames[sv.framenum & UPDATE_MASK];
+
+	for (i = 0; i < count; i++)
+	{
+		ent = EDICT_NUM(ents[i]);
 
 		/* add it to the circular client_entities array */
-		state = &svs.client_entities[svs.next_client_entities %
+		state = &svs.client_entities[(frame->first_entity + i) %
 				svs.num_client_entities];
 
-		if (ent->s.number != e)
-		{
-			Com_DPrintf("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
-
 		*state = ent->s;
 
 		/* don't mark players missiles as solid */
@@ -664,10 +1213,9 @@ SV_BuildClientFrame(client_t *client)
 		{
 			state->solid = 0;
 		}
-
-		svs.next_client_entities++;
-		frame->num_entities++;
 	}
+
+	frame->num_entities = count;
 }
 
 /*
@@ -358,6 +358,12 @@ PF_StartSound(edict_t *entity, int channel, int sound_num,
 			volume, attenuation, timeofs);
 }
 
+static void
+PF_SaveFileWrite(const char *name, const void *data, int len)
+{
+	SV_SaveFileWrite(name, data, len, true);
+}
+
 /*
  * Called when either the entire server is being killed, or
  * it is changing to a different game directory.
@@ -404,6 +410,12 @@ SV_InitGameProgs(void)
 	import.unlinkentity = SV_UnlinkEdict;
 	import.BoxEdicts = SV_AreaEdicts;
 	import.trace = SV_Trace;
+	import.trace_batch = SV_TraceBatch;
+	import.profile_begin = SV_ProfileBegin;
+	import.profile_end = SV_ProfileEnd;
+	import.savefile_write = PF_SaveFileWrite;
+	import.savefile_load = SV_SaveFileLoad;
+	import.savefile_free = Z_Free;
 	import.pointcontents = SV_PointContents;
 	import.setmodel = PF_setmodel;
 	import.inPVS = PF_inPVS;
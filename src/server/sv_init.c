@@ -362,6 +362,9 @@ SV_SpawnServer(char *server, char *spawnpoint, server_state_t serverstate,
 	/* check for a savegame */
 	SV_CheckForSavegame(isautosave);
 
+	/* now that everything is in place, fit the area tree to it */
+	SV_RebuildAreaNodes();
+
 	/* set serverinfo variable */
 	Cvar_FullSet("mapname", sv.name, CVAR_SERVERINFO | CVAR_NOSET);
 
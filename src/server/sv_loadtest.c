@@ -0,0 +1,584 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Load test. sv_loadtest fills the server with bots that behave like
+ * clients on a perfect network: they connect with a connect packet,
+ * send new and begin, and then one move per frame, all as netchan
+ * packets handed to SV_PacketEvent(). The server sends them their
+ * datagrams like to anybody else, their NA_BOT address just drops
+ * them at the socket. Meanwhile the frame times, the bytes sent to
+ * the bots and the traces are recorded and reported at the end.
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+#define LOADTEST_FRAMES 36000   /* an hour of frame times */
+#define LOADTEST_JOINS 2        /* bots connecting per frame */
+
+typedef struct
+{
+	int slot;                   /* in svs.clients, -1 once it's gone */
+	int qport;
+	int sequence;               /* of the packets it sends */
+	int spawnframe;             /* sv.framenum it began in */
+	qboolean sentnew;
+	usercmd_t cmds[3];          /* oldest to newest */
+	float yaw, turn;
+	int strafe;                 /* frames left strafing one way */
+	int side;
+	int firing;                 /* frames left of the burst */
+	int nextweapon;             /* svs.realtime of the next switch */
+	long long sentbytes;        /* client->sentbytes counted so far */
+} loadbot_t;
+
+static struct
+{
+	qboolean pending;           /* waiting for a map to add the bots */
+	qboolean running;
+	qboolean measuring;         /* all bots have joined */
+	int numbots;
+	int joined;
+	int lagms;
+	int duration;               /* msec, 0 to run until stopped */
+	int starttime;              /* svs.realtime */
+	int endtime;
+	int *frametimes;            /* usec, ring of LOADTEST_FRAMES */
+	int numframes;
+	long long traces;
+	int maxtraces;
+	long long sentbytes;
+} loadtest;
+
+static loadbot_t loadbots[MAX_CLIENTS];
+
+static netadr_t
+SV_LoadTestAddress(const loadbot_t *bot)
+{
+	netadr_t adr;
+
+	memset(&adr, 0, sizeof(adr));
+	adr.type = NA_BOT;
+	adr.port = BigShort((short)(bot - loadbots + 1));
+
+	return adr;
+}
+
+/*
+ * The bot's client_t, or NULL if it was
+ * dropped and the slot may be someone else's.
+ */
+static client_t *
+SV_LoadTestClient(loadbot_t *bot)
+{
+	client_t *cl;
+
+	if (bot->slot < 0)
+	{
+		return NULL;
+	}
+
+	cl = &svs.clients[bot->slot];
+
+	if ((cl->state < cs_connected) ||
+		(cl->netchan.remote_address.type != NA_BOT) ||
+		(cl->netchan.qport != bot->qport))
+	{
+		bot->slot = -1;
+		return NULL;
+	}
+
+	return cl;
+}
+
+static qboolean
+SV_LoadTestConnect(loadbot_t *bot)
+{
+	char userinfo[MAX_INFO_STRING];
+	int i;
+
+	memset(bot, 0, sizeof(*bot));
+	bot->slot = -1;
+	bot->qport = (int)(bot - loadbots) + 1;
+	bot->sequence = 1;
+	bot->yaw = frandk() * 360;
+	bot->nextweapon = svs.realtime;
+
+	Com_sprintf(userinfo, sizeof(userinfo),
+			"\\name\\bot%i\\skin\\male/grunt\\rate\\25000\\msg\\1"
+			"\\hand\\2\\fov\\90", bot->qport);
+
+	SZ_Clear(&net_message);
+	MSG_WriteLong(&net_message, -1);
+	/* what a client with the default settings asks for */
+	SZ_Print(&net_message, va("connect %i %i 0 \"%s\" %i\n",
+				PROTOCOL_VERSION, bot->qport, userinfo,
+				MAX_FRAGMENTED_MSGLEN));
+
+	net_from = SV_LoadTestAddress(bot);
+	SV_PacketEvent();
+
+	for (i = 0; i < maxclients->value; i++)
+	{
+		bot->slot = i;
+
+		if (SV_LoadTestClient(bot))
+		{
+			return true;
+		}
+	}
+
+	bot->slot = -1;
+
+	return false;
+}
+
+static void
+SV_LoadTestMove(loadbot_t *bot, const client_t *cl)
+{
+	usercmd_t nullcmd, *cmd;
+	int checksumindex, lastframe, age;
+
+	/* scripted wandering: turn, run, strafe, jump now and then */
+	if (!(randk() % 20))
+	{
+		bot->turn = crandk() * 20;
+	}
+
+	if (bot->strafe-- <= 0)
+	{
+		bot->strafe = 5 + randk() % 20;
+		bot->side = (randk() % 3) - 1;
+	}
+
+	if (!bot->firing && !(randk() % 10))
+	{
+		bot->firing = 5 + randk() % 15;
+	}
+
+	bot->yaw = anglemod(bot->yaw + bot->turn);
+
+	bot->cmds[0] = bot->cmds[1];
+	bot->cmds[1] = bot->cmds[2];
+
+	cmd = &bot->cmds[2];
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->msec = 100;
+	cmd->angles[YAW] = ANGLE2SHORT(bot->yaw);
+	cmd->angles[PITCH] = ANGLE2SHORT(crandk() * 10);
+	cmd->forwardmove = 400;
+	cmd->sidemove = bot->side * 350;
+	cmd->upmove = (randk() % 20) ? 0 : 200;
+
+	if (bot->firing)
+	{
+		cmd->buttons |= BUTTON_ATTACK;
+		bot->firing--;
+	}
+
+	/* the newest frame that was sent at least the ping ago,
+	   the server takes the ping from the frames acked. Frames
+	   that were skipped still have the time of an older one */
+	for (lastframe = sv.framenum; lastframe > bot->spawnframe; lastframe--)
+	{
+		age = svs.realtime - cl->frames[lastframe & UPDATE_MASK].senttime;
+
+		if ((sv.framenum - lastframe >= UPDATE_BACKUP - 1) ||
+			((age >= loadtest.lagms) &&
+			 (age <= (sv.framenum - lastframe + 2) * 100)))
+		{
+			break;
+		}
+	}
+
+	if (lastframe <= bot->spawnframe)
+	{
+		lastframe = -1;
+	}
+
+	MSG_WriteByte(&net_message, clc_move);
+	checksumindex = net_message.cursize;
+	MSG_WriteByte(&net_message, 0);
+	MSG_WriteLong(&net_message, lastframe);
+
+	memset(&nullcmd, 0, sizeof(nullcmd));
+	MSG_WriteDeltaUsercmd(&net_message, &nullcmd, &bot->cmds[0]);
+	MSG_WriteDeltaUsercmd(&net_message, &bot->cmds[0], &bot->cmds[1]);
+	MSG_WriteDeltaUsercmd(&net_message, &bot->cmds[1], &bot->cmds[2]);
+
+	net_message.data[checksumindex] = COM_BlockSequenceCRCByte(
+			net_message.data + checksumindex + 1,
+			net_message.cursize - checksumindex - 1, bot->sequence);
+
+	/* a different weapon every few seconds, all of them with cheats */
+	if (svs.realtime >= bot->nextweapon)
+	{
+		bot->nextweapon = svs.realtime + 3000 + randk() % 3000;
+
+		if (Cvar_VariableValue("cheats"))
+		{
+			MSG_WriteByte(&net_message, clc_stringcmd);
+			MSG_WriteString(&net_message, "give all");
+		}
+
+		MSG_WriteByte(&net_message, clc_stringcmd);
+		MSG_WriteString(&net_message, "weapnext");
+	}
+}
+
+static void
+SV_LoadTestBotFrame(loadbot_t *bot)
+{
+	client_t *cl;
+
+	if ((cl = SV_LoadTestClient(bot)) == NULL)
+	{
+		return;
+	}
+
+	/* netchan header, with everything the server sent acked */
+	SZ_Clear(&net_message);
+	MSG_WriteLong(&net_message, bot->sequence & ~(1U << 31));
+	MSG_WriteLong(&net_message, ((cl->netchan.outgoing_sequence - 1) & ~(1U << 31)) |
+			(cl->netchan.reliable_sequence << 31));
+	MSG_WriteShort(&net_message, bot->qport);
+
+	if (cl->state == cs_spawned)
+	{
+		if (bot->sentnew)
+		{
+			bot->sentnew = false;
+			bot->spawnframe = sv.framenum;
+		}
+
+		SV_LoadTestMove(bot, cl);
+	}
+	else if (!bot->sentnew)
+	{
+		/* after connecting and after every map change */
+		MSG_WriteByte(&net_message, clc_stringcmd);
+		MSG_WriteString(&net_message, "new");
+		bot->sentnew = true;
+	}
+	else
+	{
+		MSG_WriteByte(&net_message, clc_stringcmd);
+		MSG_WriteString(&net_message, va("begin %i", svs.spawncount));
+	}
+
+	bot->sequence++;
+
+	net_from = SV_LoadTestAddress(bot);
+	SV_PacketEvent();
+}
+
+static void
+SV_LoadTestStart(void)
+{
+	int i;
+
+	if (!loadtest.frametimes)
+	{
+		loadtest.frametimes = Z_Malloc(LOADTEST_FRAMES * sizeof(int));
+	}
+
+	for (i = 0; i < MAX_CLIENTS; i++)
+	{
+		loadbots[i].slot = -1;
+	}
+
+	loadtest.pending = false;
+	loadtest.running = true;
+	loadtest.measuring = false;
+	loadtest.joined = 0;
+}
+
+/*
+ * A few bots join per frame, all at once would overflow
+ * everybody's reliable message with their configstrings.
+ * The clock starts when the last one is in.
+ */
+static void
+SV_LoadTestJoin(void)
+{
+	client_t *cl;
+	int i;
+
+	for (i = 0; (i < LOADTEST_JOINS) && (loadtest.joined < loadtest.numbots); i++)
+	{
+		if (!SV_LoadTestConnect(&loadbots[loadtest.joined]))
+		{
+			Com_Printf("Only %i of %i bots got a slot.\n", loadtest.joined,
+					loadtest.numbots);
+			loadtest.numbots = loadtest.joined;
+			break;
+		}
+
+		loadtest.joined++;
+	}
+
+	if (loadtest.joined < loadtest.numbots)
+	{
+		return;
+	}
+
+	for (i = 0; i < loadtest.numbots; i++)
+	{
+		if ((cl = SV_LoadTestClient(&loadbots[i])) != NULL)
+		{
+			loadbots[i].sentbytes = cl->sentbytes;
+		}
+	}
+
+	loadtest.measuring = true;
+	loadtest.numframes = 0;
+	loadtest.traces = 0;
+	loadtest.maxtraces = 0;
+	loadtest.sentbytes = 0;
+	loadtest.starttime = svs.realtime;
+	loadtest.endtime = loadtest.duration ?
+		svs.realtime + loadtest.duration : 0;
+}
+
+static int
+SV_LoadTestCompare(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+static void
+SV_LoadTestReport(void)
+{
+	int *sorted;
+	int i, frames, bots, seconds;
+
+	if (!loadtest.measuring)
+	{
+		Com_Printf("%i of %i bots have joined so far.\n", loadtest.joined,
+				loadtest.numbots);
+		return;
+	}
+
+	frames = Q_min(loadtest.numframes, LOADTEST_FRAMES);
+
+	for (i = 0, bots = 0; i < loadtest.numbots; i++)
+	{
+		if (SV_LoadTestClient(&loadbots[i]))
+		{
+			bots++;
+		}
+	}
+
+	seconds = (svs.realtime - loadtest.starttime) / 1000;
+
+	Com_Printf("%i of %i bots left, %i frames in %i s\n", bots,
+			loadtest.numbots, loadtest.numframes, seconds);
+
+	if (!frames)
+	{
+		return;
+	}
+
+	sorted = Z_Malloc(frames * sizeof(int));
+	memcpy(sorted, loadtest.frametimes, frames * sizeof(int));
+	qsort(sorted, frames, sizeof(int), SV_LoadTestCompare);
+
+	Com_Printf("frame time: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			sorted[frames * 50 / 100] / 1000.0f,
+			sorted[frames * 90 / 100] / 1000.0f,
+			sorted[frames * 99 / 100] / 1000.0f,
+			sorted[frames - 1] / 1000.0f);
+
+	Z_Free(sorted);
+
+	Com_Printf("sent: %lld bytes, %lld bytes/s per bot\n", loadtest.sentbytes,
+			loadtest.sentbytes / Q_max(1, seconds) / Q_max(1, loadtest.numbots));
+	Com_Printf("traces: %lld per frame, %i max\n",
+			loadtest.traces / loadtest.numframes, loadtest.maxtraces);
+}
+
+static void
+SV_LoadTestStop(void)
+{
+	client_t *cl;
+	int i;
+
+	SV_LoadTestReport();
+
+	for (i = 0; i < loadtest.numbots; i++)
+	{
+		if ((cl = SV_LoadTestClient(&loadbots[i])) != NULL)
+		{
+			SV_DropClient(cl);
+		}
+
+		loadbots[i].slot = -1;
+	}
+
+	loadtest.running = false;
+	loadtest.measuring = false;
+	loadtest.pending = false;
+
+	if (sv_loadtest_exit->value)
+	{
+		Cbuf_AddText("quit\n");
+	}
+}
+
+/*
+ * Called at the start of every server frame,
+ * before anything moves.
+ */
+void
+SV_LoadTestFrame(void)
+{
+	int i;
+
+	if (sv.state != ss_game)
+	{
+		return;
+	}
+
+	if (loadtest.pending)
+	{
+		SV_LoadTestStart();
+	}
+
+	if (!loadtest.running)
+	{
+		return;
+	}
+
+	if (!loadtest.measuring)
+	{
+		SV_LoadTestJoin();
+	}
+	else if (loadtest.endtime && (svs.realtime >= loadtest.endtime))
+	{
+		SV_LoadTestStop();
+		return;
+	}
+
+	for (i = 0; i < loadtest.numbots; i++)
+	{
+		SV_LoadTestBotFrame(&loadbots[i]);
+	}
+}
+
+/*
+ * Called at the end of every server frame with its duration.
+ */
+void
+SV_LoadTestEndFrame(int usec)
+{
+	client_t *cl;
+	int i;
+
+	if (!loadtest.measuring)
+	{
+		return;
+	}
+
+	loadtest.frametimes[loadtest.numframes % LOADTEST_FRAMES] = usec;
+	loadtest.numframes++;
+	loadtest.traces += sv.numtraces;
+	loadtest.maxtraces = Q_max(loadtest.maxtraces, sv.numtraces);
+
+	for (i = 0; i < loadtest.numbots; i++)
+	{
+		if ((cl = SV_LoadTestClient(&loadbots[i])) != NULL)
+		{
+			loadtest.sentbytes += cl->sentbytes - loadbots[i].sentbytes;
+			loadbots[i].sentbytes = cl->sentbytes;
+		}
+	}
+}
+
+/*
+ * The clients are going away with the server.
+ */
+void
+SV_LoadTestShutdown(void)
+{
+	if (loadtest.running)
+	{
+		SV_LoadTestReport();
+	}
+
+	loadtest.running = false;
+	loadtest.measuring = false;
+	loadtest.pending = false;
+
+	if (loadtest.frametimes)
+	{
+		Z_Free(loadtest.frametimes);
+		loadtest.frametimes = NULL;
+	}
+}
+
+/*
+ * sv_loadtest <bots> [seconds] [ping]
+ *
+ * Without a map running the bots join the next one,
+ * so it can go before the map on the command line.
+ */
+void
+SV_LoadTest_f(void)
+{
+	if (Cmd_Argc() < 2)
+	{
+		Com_Printf("Usage: sv_loadtest <bots> [seconds] [ping]\n");
+
+		if (loadtest.running)
+		{
+			SV_LoadTestReport();
+		}
+
+		return;
+	}
+
+	if (loadtest.running || loadtest.pending)
+	{
+		Com_Printf("A load test is already running, sv_loadtest_stop ends it.\n");
+		return;
+	}
+
+	loadtest.numbots = Q_clamp((int)strtol(Cmd_Argv(1), (char **)NULL, 10),
+			1, MAX_CLIENTS);
+	loadtest.duration = (Cmd_Argc() > 2) ?
+		(int)strtol(Cmd_Argv(2), (char **)NULL, 10) * 1000 : 0;
+	loadtest.lagms = (Cmd_Argc() > 3) ?
+		Q_clamp((int)strtol(Cmd_Argv(3), (char **)NULL, 10), 0, 1000) : 0;
+	/* started from the next frame, this
+	   may be running in the middle of rcon */
+	loadtest.pending = true;
+}
+
+void
+SV_LoadTestStop_f(void)
+{
+	if (!loadtest.running && !loadtest.pending)
+	{
+		Com_Printf("No load test running.\n");
+		return;
+	}
+
+	SV_LoadTestStop();
+}
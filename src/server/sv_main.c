@@ -54,6 +54,16 @@ cvar_t *hostname;
 cvar_t *public_server; /* should heartbeats be sent */
 cvar_t *sv_entfile; /* External entity files. */
 cvar_t *sv_downloadserver; /* Download server. */
+cvar_t *sv_areadepth; /* max. depth of the area tree */
+cvar_t *sv_areasplit; /* edicts per area node before it splits */
+cvar_t *sv_workers; /* threads building client frames */
+cvar_t *sv_workers_verify; /* compare threaded frames to serial ones */
+cvar_t *sv_packedproto; /* let clients use PROTOCOL_PACKED */
+cvar_t *sv_fragments; /* send messages larger than MAX_MSGLEN */
+cvar_t *sv_sendstagger; /* msec the datagrams of a frame are spread over */
+cvar_t *sv_deltacache; /* share encoded entity deltas between clients */
+cvar_t *sv_loadtest_exit; /* quit when a timed load test is over */
+cvar_t *sv_profile; /* record profiler zones */
 
 void SV_ConnectionlessPacket(void);
 
@@ -191,77 +201,176 @@ SV_GiveMsec(void)
 	}
 }
 
-static void
-SV_ReadPackets(void)
+/*
+ * Clients are hashed by what SV_ReadPackets() matches them
+ * on: the address without the port, which NAT routers may
+ * rewrite, and the qport. The port is left out of the key,
+ * so fixing up a translated port needs no rehash.
+ */
+static unsigned
+SV_HashClientAddress(netadr_t adr, int qport)
 {
-	int i;
-	client_t *cl;
-	int qport;
+	unsigned hash = 2166136261u;
+	const byte *data;
+	int i, len;
 
-	while (NET_GetPacket(NS_SERVER, &net_from, &net_message))
+	switch (adr.type)
+	{
+		case NA_IP:
+			data = adr.ip;
+			len = 4;
+			break;
+		case NA_IP6:
+			data = adr.ip;
+			len = 16;
+			break;
+		case NA_IPX:
+			data = adr.ipx;
+			len = 10;
+			break;
+		default:
+			data = NULL;
+			len = 0;
+			break;
+	}
+
+	hash = (hash ^ adr.type) * 16777619u;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+
+	hash = (hash ^ (qport & 0xff)) * 16777619u;
+	hash = (hash ^ ((qport >> 8) & 0xff)) * 16777619u;
+
+	return hash & (CLIENT_HASH_SIZE - 1);
+}
+
+/*
+ * Called once a client has its netchan set up. Chains
+ * are kept in client order, so the lowest slot wins if
+ * a zombie still has the same address, as it always did.
+ */
+void
+SV_LinkClientAddress(client_t *cl)
+{
+	client_t **link;
+
+	link = &svs.clienthash[SV_HashClientAddress(cl->netchan.remote_address,
+			cl->netchan.qport)];
+
+	while (*link && (*link < cl))
 	{
-		/* check for connectionless packet (0xffffffff) first */
-		if (*(int *)net_message.data == -1)
+		link = &(*link)->hashnext;
+	}
+
+	cl->hashnext = *link;
+	*link = cl;
+}
+
+/*
+ * Called before a client slot is freed
+ * or set up again for a new connection.
+ */
+void
+SV_UnlinkClientAddress(client_t *cl)
+{
+	client_t **link;
+
+	link = &svs.clienthash[SV_HashClientAddress(cl->netchan.remote_address,
+			cl->netchan.qport)];
+
+	for ( ; *link; link = &(*link)->hashnext)
+	{
+		if (*link == cl)
 		{
-			SV_ConnectionlessPacket();
-			continue;
+			*link = cl->hashnext;
+			cl->hashnext = NULL;
+			return;
 		}
+	}
+}
 
-		/* read the qport out of the message so we can fix up
-		   stupid address translating routers */
-		MSG_BeginReading(&net_message);
-		MSG_ReadLong(&net_message); /* sequence number */
-		MSG_ReadLong(&net_message); /* sequence number */
-		qport = MSG_ReadShort(&net_message) & 0xffff;
+static client_t *
+SV_FindClientByAddress(netadr_t adr, int qport)
+{
+	client_t *cl;
 
-		/* check for packets from connected clients */
-		for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	for (cl = svs.clienthash[SV_HashClientAddress(adr, qport)]; cl; cl = cl->hashnext)
+	{
+		if ((cl->state != cs_free) && (cl->netchan.qport == qport) &&
+			NET_CompareBaseAdr(adr, cl->netchan.remote_address))
 		{
-			if (cl->state == cs_free)
-			{
-				continue;
-			}
+			return cl;
+		}
+	}
 
-			if (!NET_CompareBaseAdr(net_from, cl->netchan.remote_address))
-			{
-				continue;
-			}
+	return NULL;
+}
 
-			if (cl->netchan.qport != qport)
-			{
-				continue;
-			}
+/*
+ * Handles net_message as coming from net_from. Load test
+ * bots put their packets through here as well.
+ */
+void
+SV_PacketEvent(void)
+{
+	client_t *cl;
+	int qport;
 
-			if (cl->netchan.remote_address.port != net_from.port)
-			{
-				Com_Printf("%s: fixing up a translated port\n", __func__);
-				cl->netchan.remote_address.port = net_from.port;
-			}
+	/* check for connectionless packet (0xffffffff) first */
+	if (*(int *)net_message.data == -1)
+	{
+		SV_ConnectionlessPacket();
+		return;
+	}
 
-			if (Netchan_Process(&cl->netchan, &net_message))
-			{
-				/* this is a valid, sequenced packet, so process it */
-				if (cl->state != cs_zombie)
-				{
-					cl->lastmessage = svs.realtime; /* don't timeout */
-
-					if (!(sv.demofile && (sv.state == ss_demo)))
-					{
-						SV_ExecuteClientMessage(cl);
-					}
-				}
-			}
+	/* read the qport out of the message so we can fix up
+	   stupid address translating routers */
+	MSG_BeginReading(&net_message);
+	MSG_ReadLong(&net_message); /* sequence number */
+	MSG_ReadLong(&net_message); /* sequence number */
+	qport = MSG_ReadShort(&net_message) & 0xffff;
 
-			break;
-		}
+	/* check for packets from connected clients */
+	cl = SV_FindClientByAddress(net_from, qport);
+
+	if (!cl)
+	{
+		return;
+	}
 
-		if (i != maxclients->value)
+	if (cl->netchan.remote_address.port != net_from.port)
+	{
+		Com_Printf("%s: fixing up a translated port\n", __func__);
+		cl->netchan.remote_address.port = net_from.port;
+	}
+
+	if (Netchan_Process(&cl->netchan, &net_message))
+	{
+		/* this is a valid, sequenced packet, so process it */
+		if (cl->state != cs_zombie)
 		{
-			continue;
+			cl->lastmessage = svs.realtime; /* don't timeout */
+
+			if (!(sv.demofile && (sv.state == ss_demo)))
+			{
+				SV_ExecuteClientMessage(cl);
+			}
 		}
 	}
 }
 
+static void
+SV_ReadPackets(void)
+{
+	while (NET_GetPacket(NS_SERVER, &net_from, &net_message))
+	{
+		SV_PacketEvent();
+	}
+}
+
 /*
  * If a packet has not been received from a client for timeout->value
  * seconds, drop the conneciton.  Server frames are used instead of
@@ -293,6 +402,7 @@ SV_CheckTimeouts(void)
 		if ((cl->state == cs_zombie) &&
 			(cl->lastmessage < zombiepoint))
 		{
+			SV_UnlinkClientAddress(cl);
 			cl->state = cs_free; /* can now be reused */
 			continue;
 		}
@@ -302,6 +412,7 @@ SV_CheckTimeouts(void)
 		{
 			SV_BroadcastPrintf(PRINT_HIGH, "%s timed out\n", cl->name);
 			SV_DropClient(cl);
+			SV_UnlinkClientAddress(cl);
 			cl->state = cs_free; /* don't bother with zombie state */
 		}
 	}
@@ -388,6 +499,8 @@ void
 SV_Frame(int usec)
 {
 	int opt_sendrate;
+	int wait;
+	long long framestart;
 
 #ifndef DEDICATED_ONLY
 	time_before_game = time_after_game = 0;
@@ -401,6 +514,8 @@ SV_Frame(int usec)
 
 	svs.realtime += usec / 1000;
 
+	SV_ProfileFrame();
+
 	/* keep the random time dependent */
 	randk();
 
@@ -408,7 +523,9 @@ SV_Frame(int usec)
 	SV_CheckTimeouts();
 
 	/* get packets from clients */
+	SV_ProfileBegin("SV_ReadPackets");
 	SV_ReadPackets();
+	SV_ProfileEnd();
 
 	/* send messages more often to new clients getting ready for spawning in
 	   speeds up the process of sending configstrings, entty deltas, etc.
@@ -434,10 +551,24 @@ SV_Frame(int usec)
 			svs.realtime = sv.time - 100;
 		}
 
-		NET_Sleep(sv.time - svs.realtime);
+		/* wake up for the next staggered datagram */
+		wait = SV_SendStaggered(false);
+
+		if ((wait < 0) || (wait > sv.time - svs.realtime))
+		{
+			wait = sv.time - svs.realtime;
+		}
+
+		NET_Sleep(wait);
 		return;
 	}
 
+	SV_ProfileBegin("SV_Frame");
+	framestart = Sys_Microseconds();
+
+	/* load test bots send their moves */
+	SV_LoadTestFrame();
+
 	/* update ping based on the last known frame from all clients */
 	SV_CalcPings();
 
@@ -445,10 +576,14 @@ SV_Frame(int usec)
 	SV_GiveMsec();
 
 	/* let everything in the world think and move */
+	SV_ProfileBegin("SV_RunGameFrame");
 	SV_RunGameFrame();
+	SV_ProfileEnd();
 
 	/* send messages back to the clients that had packets read this frame */
+	SV_ProfileBegin("SV_SendClientMessages");
 	SV_SendClientMessages();
+	SV_ProfileEnd();
 
 	/* if not optimizing, send all messages here */
 	if (!opt_sendrate)
@@ -464,6 +599,13 @@ SV_Frame(int usec)
 
 	/* clear teleport flags, etc for next frame */
 	SV_PrepWorldFrame();
+
+	/* traces since the last frame, client moves included */
+	SV_ProfileCount("SV_Trace", sv.numtraces);
+	SV_LoadTestEndFrame(Sys_Microseconds() - framestart);
+	sv.numtraces = 0;
+
+	SV_ProfileEnd();
 }
 
 /*
@@ -593,6 +735,24 @@ SV_UserinfoChanged(client_t *cl)
 	{
 		cl->rate = 5000;
 	}
+
+	/* snapshots per second, at most one per server frame */
+	val = Info_ValueForKey(cl->userinfo, "snaps");
+	cl->snaps = 10;
+
+	if (strlen(val))
+	{
+		cl->snaps = (int)strtol(val, (char **)NULL, 10);
+
+		if (cl->snaps < 1)
+		{
+			cl->snaps = 1;
+		}
+		else if (cl->snaps > 10)
+		{
+			cl->snaps = 10;
+		}
+	}
 }
 
 /*
@@ -631,6 +791,17 @@ SV_Init(void)
 	allow_download_maps = Cvar_Get("allow_download_maps", "1", CVAR_ARCHIVE);
 	sv_downloadserver = Cvar_Get ("sv_downloadserver", "", 0);
 
+	sv_areadepth = Cvar_Get("sv_areadepth", "8", 0);
+	sv_areasplit = Cvar_Get("sv_areasplit", "8", 0);
+	sv_workers = Cvar_Get("sv_workers", "0", CVAR_ARCHIVE);
+	sv_workers_verify = Cvar_Get("sv_workers_verify", "0", 0);
+	sv_deltacache = Cvar_Get("sv_deltacache", "1", 0);
+	sv_packedproto = Cvar_Get("sv_packedproto", "1", 0);
+	sv_fragments = Cvar_Get("sv_fragments", "1", 0);
+	sv_sendstagger = Cvar_Get("sv_sendstagger", "0", 0);
+	sv_loadtest_exit = Cvar_Get("sv_loadtest_exit", "0", 0);
+	sv_profile = Cvar_Get("sv_profile", "0", 0);
+
 	sv_noreload = Cvar_Get("sv_noreload", "0", 0);
 
 	sv_airaccelerate = Cvar_Get("sv_airaccelerate", "0", CVAR_LATCH);
@@ -738,6 +909,12 @@ SV_Shutdown(char *finalmsg, qboolean reconnect)
 	Com_SetServerState(sv.state);
 
 	/* free server static data */
+	SV_DropStaggered();
+	SV_LoadTestShutdown();
+
+	/* don't quit before the savegames are on disk */
+	SV_SaveFileWait(NULL);
+
 	if (svs.clients)
 	{
 		Z_Free(svs.clients);
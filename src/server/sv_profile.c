@@ -0,0 +1,263 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Server frame profiler. Nested zones are marked with SV_ProfileBegin()
+ * and SV_ProfileEnd(), the game does the same through gi.profile_begin
+ * and gi.profile_end. While sv_profile is set the events go into a ring
+ * buffer that every thread appends to without taking a lock, and
+ * sv_profile_dump writes what's in it as Chrome trace event JSON
+ * (open it in chrome://tracing or ui.perfetto.dev).
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+#define PROFILE_EVENTS (1 << 17) /* power of two */
+#define PROFILE_NAMELEN 32
+#define PROFILE_THREADS 32
+
+#ifdef _MSC_VER
+ #include <intrin.h>
+ #define PROFILE_THREAD_LOCAL __declspec(thread)
+ #define Profile_FetchAdd(p) ((unsigned)_InterlockedIncrement((volatile long *)(p)) - 1)
+ #define Profile_Publish(p, v) (*(volatile unsigned *)(p) = (v))
+ #define Profile_Published(p) (*(volatile unsigned *)(p))
+#else
+ #define PROFILE_THREAD_LOCAL __thread
+ #define Profile_FetchAdd(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+ #define Profile_Publish(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+ #define Profile_Published(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#endif
+
+typedef struct
+{
+	char name[PROFILE_NAMELEN];
+	long long time;         /* Sys_Microseconds() */
+	int value;              /* counters only */
+	int thread;
+	char phase;             /* 'B'egin, 'E'nd or 'C'ounter */
+	unsigned sequence;      /* event number + 1, once it's complete */
+} profevent_t;
+
+static profevent_t *profile_events;
+static unsigned profile_head;
+static unsigned profile_threads;
+static qboolean profile_active;
+
+static PROFILE_THREAD_LOCAL int profile_thread;
+
+static void
+SV_ProfileEvent(char phase, const char *name, int value)
+{
+	profevent_t *ev;
+	unsigned n;
+
+	if (!profile_thread)
+	{
+		profile_thread = (int)Profile_FetchAdd(&profile_threads) + 1;
+	}
+
+	n = Profile_FetchAdd(&profile_head);
+	ev = &profile_events[n & (PROFILE_EVENTS - 1)];
+
+	/* a reader must not take a half written slot for the old event */
+	Profile_Publish(&ev->sequence, 0);
+
+	if (name)
+	{
+		Q_strlcpy(ev->name, name, sizeof(ev->name));
+	}
+	else
+	{
+		ev->name[0] = '\0';
+	}
+
+	ev->time = Sys_Microseconds();
+	ev->value = value;
+	ev->thread = profile_thread - 1;
+	ev->phase = phase;
+
+	Profile_Publish(&ev->sequence, n + 1);
+}
+
+void
+SV_ProfileBegin(const char *name)
+{
+	if (profile_active)
+	{
+		SV_ProfileEvent('B', name, 0);
+	}
+}
+
+void
+SV_ProfileEnd(void)
+{
+	if (profile_active)
+	{
+		SV_ProfileEvent('E', NULL, 0);
+	}
+}
+
+void
+SV_ProfileCount(const char *name, int value)
+{
+	if (profile_active)
+	{
+		SV_ProfileEvent('C', name, value);
+	}
+}
+
+/*
+ * Picks up changes to sv_profile. Called at the start of
+ * each server frame, while no zone can be open.
+ */
+void
+SV_ProfileFrame(void)
+{
+	if (!sv_profile->modified)
+	{
+		return;
+	}
+
+	sv_profile->modified = false;
+
+	if (sv_profile->value && !profile_events)
+	{
+		profile_events = Z_Malloc(PROFILE_EVENTS * sizeof(profevent_t));
+	}
+
+	profile_active = sv_profile->value && profile_events;
+}
+
+static void
+SV_ProfileWriteName(FILE *f, const char *name)
+{
+	fputc('"', f);
+
+	for ( ; *name; name++)
+	{
+		if ((*name == '"') || (*name == '\\'))
+		{
+			fputc('\\', f);
+			fputc(*name, f);
+		}
+		else if ((unsigned char)*name >= ' ')
+		{
+			fputc(*name, f);
+		}
+	}
+
+	fputc('"', f);
+}
+
+/*
+ * sv_profile_dump [filename]
+ */
+void
+SV_ProfileDump_f(void)
+{
+	char path[MAX_OSPATH];
+	int depth[PROFILE_THREADS];
+	const profevent_t *ev;
+	unsigned first, head, n;
+	int written, thread, i;
+	FILE *f;
+
+	if (!profile_events)
+	{
+		Com_Printf("Nothing recorded, set sv_profile 1 first.\n");
+		return;
+	}
+
+	Com_sprintf(path, sizeof(path), "%s/%s", FS_Gamedir(),
+			(Cmd_Argc() > 1) ? Cmd_Argv(1) : "profile.json");
+
+	if ((f = Q_fopen(path, "wb")) == NULL)
+	{
+		Com_Printf("Couldn't open %s for writing.\n", path);
+		return;
+	}
+
+	head = Profile_Published(&profile_head);
+	first = (head > PROFILE_EVENTS) ? head - PROFILE_EVENTS : 0;
+
+	memset(depth, 0, sizeof(depth));
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+			"\"args\":{\"name\":\"main\"}}");
+
+	for (i = 1; i < (int)profile_threads; i++)
+	{
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+				"\"tid\":%i,\"args\":{\"name\":\"worker %i\"}}", i, i);
+	}
+
+	written = 0;
+
+	for (n = first; n != head; n++)
+	{
+		ev = &profile_events[n & (PROFILE_EVENTS - 1)];
+
+		if (Profile_Published(&ev->sequence) != n + 1)
+		{
+			continue; /* still being written or already overwritten */
+		}
+
+		thread = ev->thread % PROFILE_THREADS;
+
+		/* the ring may start in the middle of a zone */
+		if (ev->phase == 'B')
+		{
+			depth[thread]++;
+		}
+		else if (ev->phase == 'E')
+		{
+			if (!depth[thread])
+			{
+				continue;
+			}
+
+			depth[thread]--;
+		}
+
+		fprintf(f, ",\n{\"ph\":\"%c\",\"ts\":%lld,\"pid\":0,\"tid\":%i",
+				ev->phase, ev->time, ev->thread);
+
+		if (ev->phase != 'E')
+		{
+			fprintf(f, ",\"name\":");
+			SV_ProfileWriteName(f, ev->name);
+		}
+
+		if (ev->phase == 'C')
+		{
+			fprintf(f, ",\"args\":{\"value\":%i}", ev->value);
+		}
+
+		fputc('}', f);
+		written++;
+	}
+
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+
+	Com_Printf("Wrote %i events to %s.\n", written, path);
+}
@@ -0,0 +1,455 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * Snapshot encoding benchmark. sv_protocol_bench replays the entity
+ * lists of a server demo (see serverrecord) as frame to frame deltas
+ * through the PROTOCOL_VERSION and the PROTOCOL_PACKED encoders,
+ * checks that a client would decode the same states from both and
+ * reports the bandwidth each of them needs.
+ *
+ * =======================================================================
+ */
+
+#include "header/server.h"
+
+typedef struct
+{
+	entity_state_t ents[MAX_EDICTS];
+	int count;
+} benchlist_t;
+
+typedef struct
+{
+	int bytes;
+	long long time;
+	int mismatches;
+} benchresult_t;
+
+/*
+ * Reads the packetentities of a server demo frame,
+ * they are all sent without a delta.
+ */
+static qboolean
+SV_BenchReadFrame(sizebuf_t *msg, benchlist_t *list)
+{
+	unsigned bits;
+	int number;
+
+	if (MSG_ReadByte(msg) != svc_packetentities)
+	{
+		return false;
+	}
+
+	list->count = 0;
+
+	while (1)
+	{
+		number = MSG_ReadEntityBits(msg, &bits);
+
+		if ((msg->readcount > msg->cursize) || (number < 0) ||
+			(number >= MAX_EDICTS) || (list->count == MAX_EDICTS))
+		{
+			return false;
+		}
+
+		if (!number)
+		{
+			return true;
+		}
+
+		MSG_ReadDeltaEntity(msg, NULL, &list->ents[list->count++],
+				number, bits);
+	}
+}
+
+/*
+ * What SV_EmitPacketEntities() writes for a client
+ * that got from and has no baselines.
+ */
+static void
+SV_BenchEncode(const benchlist_t *from, const benchlist_t *to,
+		sizebuf_t *msg, qboolean packed, int numclients)
+{
+	const entity_state_t *oldent, *newent;
+	int oldindex, newindex;
+	int oldnum, newnum;
+	msgbits_t mb;
+
+	MSG_WriteByte(msg, svc_packetentities);
+	MSG_BeginBits(&mb, msg);
+
+	oldindex = newindex = 0;
+
+	while ((newindex < to->count) || (oldindex < from->count))
+	{
+		newent = (newindex < to->count) ? &to->ents[newindex] : NULL;
+		oldent = (oldindex < from->count) ? &from->ents[oldindex] : NULL;
+		newnum = newent ? newent->number : 99999;
+		oldnum = oldent ? oldent->number : 99999;
+
+		if (newnum == oldnum)
+		{
+			if (packed)
+			{
+				MSG_WritePackedEntity(&mb, oldent, newent, false,
+						newnum <= numclients);
+			}
+			else
+			{
+				MSG_WriteDeltaEntity(oldent, newent, msg, false,
+						newnum <= numclients);
+			}
+
+			oldindex++;
+			newindex++;
+		}
+		else if (newnum < oldnum)
+		{
+			if (packed)
+			{
+				MSG_WritePackedEntity(&mb, NULL, newent, true, true);
+			}
+			else
+			{
+				MSG_WriteDeltaEntity(NULL, newent, msg, true, true);
+			}
+
+			newindex++;
+		}
+		else
+		{
+			if (packed)
+			{
+				MSG_WritePackedRemove(&mb, oldnum);
+			}
+			else if (oldnum >= 256)
+			{
+				MSG_WriteByte(msg, U_REMOVE | U_MOREBITS1);
+				MSG_WriteByte(msg, U_NUMBER16 >> 8);
+				MSG_WriteShort(msg, oldnum);
+			}
+			else
+			{
+				MSG_WriteByte(msg, U_REMOVE);
+				MSG_WriteByte(msg, oldnum);
+			}
+
+			oldindex++;
+		}
+	}
+
+	if (packed)
+	{
+		MSG_WritePackedEnd(&mb);
+	}
+	else
+	{
+		MSG_WriteShort(msg, 0);
+	}
+}
+
+/*
+ * Parses the message like CL_ParsePacketEntities() does.
+ */
+static qboolean
+SV_BenchDecode(sizebuf_t *msg, const benchlist_t *from, benchlist_t *to,
+		qboolean packed)
+{
+	const entity_state_t *oldent;
+	int oldindex, number;
+	qboolean remove;
+	unsigned bits;
+	msgbits_t mb;
+
+	MSG_BeginReading(msg);
+
+	if (MSG_ReadByte(msg) != svc_packetentities)
+	{
+		return false;
+	}
+
+	MSG_BeginBits(&mb, msg);
+
+	oldindex = 0;
+	to->count = 0;
+
+	while (1)
+	{
+		if (packed)
+		{
+			number = MSG_ReadPackedNumber(&mb, &remove);
+			bits = 0;
+		}
+		else
+		{
+			number = MSG_ReadEntityBits(msg, &bits);
+			remove = (bits & U_REMOVE) != 0;
+		}
+
+		if ((msg->readcount > msg->cursize) || (number < 0) ||
+			(number >= MAX_EDICTS))
+		{
+			return false;
+		}
+
+		/* the ones the message skips are unchanged */
+		while ((oldindex < from->count) &&
+			   (!number || (from->ents[oldindex].number < number)))
+		{
+			oldent = &from->ents[oldindex++];
+			MSG_ReadDeltaEntity(msg, oldent, &to->ents[to->count++],
+					oldent->number, 0);
+		}
+
+		if (!number)
+		{
+			return true;
+		}
+
+		oldent = NULL;
+
+		if ((oldindex < from->count) &&
+			(from->ents[oldindex].number == number))
+		{
+			oldent = &from->ents[oldindex++];
+		}
+
+		if (remove)
+		{
+			continue;
+		}
+
+		if (to->count == MAX_EDICTS)
+		{
+			return false;
+		}
+
+		if (packed)
+		{
+			MSG_ReadPackedEntity(&mb, oldent, &to->ents[to->count++], number);
+		}
+		else
+		{
+			MSG_ReadDeltaEntity(msg, oldent, &to->ents[to->count++],
+					number, bits);
+		}
+	}
+}
+
+static qboolean
+SV_BenchSameStates(const benchlist_t *a, const benchlist_t *b)
+{
+	return (a->count == b->count) &&
+		!memcmp(a->ents, b->ents, a->count * sizeof(entity_state_t));
+}
+
+static void
+SV_BenchPrint(const char *name, const benchresult_t *r, int frames)
+{
+	Com_Printf("%s: %i bytes/frame, %i bytes/s per client, %.1f us/frame\n",
+			name, r->bytes / frames, r->bytes * 10 / frames,
+			(double)r->time / frames);
+}
+
+/*
+ * sv_protocol_bench <demo>
+ *
+ * Server demos hold every entity the server sent to anyone, so this
+ * is the worst case for a single client. They have neither baselines
+ * nor a player_state_t, so new entities go from an empty state and
+ * the playerinfo isn't counted.
+ */
+void
+SV_ProtocolBench_f(void)
+{
+	char name[MAX_OSPATH];
+	static byte msgbuf[0x10000]; /* a full update of MAX_EDICTS */
+	benchlist_t *lists, *prev, *cur, *client[2], *decoded, *swap;
+	benchresult_t results[2];
+	byte *data;
+	sizebuf_t block, msg;
+	int len, pos, blocklen;
+	int frames, entities, numclients;
+	long long start;
+	int i;
+
+	if (Cmd_Argc() != 2)
+	{
+		Com_Printf("Usage: sv_protocol_bench <demo>\n");
+		return;
+	}
+
+	if (strstr(Cmd_Argv(1), ".dm2"))
+	{
+		Com_sprintf(name, sizeof(name), "demos/%s", Cmd_Argv(1));
+	}
+	else
+	{
+		Com_sprintf(name, sizeof(name), "demos/%s.dm2", Cmd_Argv(1));
+	}
+
+	len = FS_LoadFile(name, (void **)&data);
+
+	if (!data)
+	{
+		Com_Printf("Couldn't load %s.\n", name);
+		return;
+	}
+
+	/* previous and current frame as the server has them,
+	   and what a client of each protocol decoded */
+	lists = Z_Malloc(5 * sizeof(benchlist_t));
+	prev = &lists[0];
+	cur = &lists[1];
+	client[0] = &lists[2];
+	client[1] = &lists[3];
+	decoded = &lists[4];
+
+	memset(results, 0, sizeof(results));
+	frames = entities = 0;
+	numclients = 1;
+
+	for (pos = 0; pos + 4 <= len; pos += blocklen)
+	{
+		blocklen = LittleLong(*(int *)(data + pos));
+		pos += 4;
+
+		if (blocklen == -1)
+		{
+			break;
+		}
+
+		if ((blocklen < 0) || (blocklen > len - pos))
+		{
+			Com_Printf("%s is truncated.\n", name);
+			break;
+		}
+
+		SZ_Init(&block, data + pos, blocklen);
+		block.cursize = blocklen;
+
+		i = MSG_ReadByte(&block);
+
+		if (i == svc_serverdata)
+		{
+			if (MSG_ReadLong(&block) != PROTOCOL_VERSION)
+			{
+				Com_Printf("%s isn't a protocol %i demo.\n", name,
+						PROTOCOL_VERSION);
+				break;
+			}
+
+			MSG_ReadLong(&block);
+			MSG_ReadByte(&block);
+			MSG_ReadString(&block);
+			MSG_ReadShort(&block);
+			MSG_ReadString(&block);
+
+			/* players always get their old origin,
+			   so the encoders need to know who they are */
+			while (MSG_ReadByte(&block) == svc_configstring)
+			{
+				i = MSG_ReadShort(&block);
+
+				if (i == CS_MAXCLIENTS)
+				{
+					numclients = (int)strtol(MSG_ReadString(&block),
+							(char **)NULL, 10);
+				}
+				else
+				{
+					MSG_ReadString(&block);
+				}
+			}
+
+			continue;
+		}
+
+		if (i != svc_frame)
+		{
+			continue;
+		}
+
+		MSG_ReadLong(&block);
+
+		/* the multicasts after it stay as they are */
+		if (!SV_BenchReadFrame(&block, cur))
+		{
+			Com_Printf("Bad packetentities in frame %i of %s.\n",
+					frames, name);
+			break;
+		}
+
+		for (i = 0; i < 2; i++)
+		{
+			SZ_Init(&msg, msgbuf, sizeof(msgbuf));
+
+			start = Sys_Microseconds();
+			SV_BenchEncode(prev, cur, &msg, i, numclients);
+			results[i].time += Sys_Microseconds() - start;
+			results[i].bytes += msg.cursize;
+
+			if (!SV_BenchDecode(&msg, client[i], decoded, i))
+			{
+				results[i].mismatches++;
+				decoded->count = 0;
+			}
+
+			memcpy(client[i], decoded, sizeof(benchlist_t));
+		}
+
+		if (!SV_BenchSameStates(client[0], client[1]))
+		{
+			results[1].mismatches++;
+		}
+
+		swap = prev;
+		prev = cur;
+		cur = swap;
+
+		entities += prev->count;
+		frames++;
+	}
+
+	FS_FreeFile(data);
+	Z_Free(lists);
+
+	if (!frames)
+	{
+		Com_Printf("No frames in %s.\n", name);
+		return;
+	}
+
+	Com_Printf("%s: %i frames, %i entities per frame\n", name, frames,
+			entities / frames);
+	SV_BenchPrint("protocol 34", &results[0], frames);
+	SV_BenchPrint("protocol 1034", &results[1], frames);
+
+	if (results[0].bytes)
+	{
+		Com_Printf("packed snapshots are %i%% of the old size\n",
+				(int)((long long)results[1].bytes * 100 / results[0].bytes));
+	}
+
+	if (results[0].mismatches || results[1].mismatches)
+	{
+		Com_Printf("WARNING: %i frames didn't decode to the same states.\n",
+				results[0].mismatches + results[1].mismatches);
+	}
+}
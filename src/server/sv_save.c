@@ -24,7 +24,45 @@
  * =======================================================================
  */
 
+#include "../common/header/threads.h"
 #include "header/server.h"
+#include "../common/unzip/miniz/miniz.h"
+
+/*
+ * Savegames are written by a background thread. The main thread
+ * only copies the data it's given into the queue, the thread
+ * compresses it (if asked to) and writes it out. Copies between
+ * savegame directories go through the same queue, so they see
+ * the files queued before them, and everything that reads or
+ * wipes a savegame directory waits for the jobs touching it.
+ */
+
+#define SAVEFILE_MAGIC (('Z' << 24) + ('2' << 16) + ('Q' << 8) + 'Y') /* "YQ2Z" */
+#define SAVEFILE_LEVEL 1 /* compression level, 1 to 9 */
+
+typedef struct savejob_s
+{
+	struct savejob_s *next;
+	char path[MAX_OSPATH];
+	char src[MAX_OSPATH];   /* copied from here, if set */
+	byte *data;
+	int len;
+	qboolean compress;
+} savejob_t;
+
+static qmutex_t save_lock;
+static qcond_t save_wake;   /* new job */
+static qcond_t save_done;   /* a job finished */
+static qthread_t save_thread;
+static qboolean save_initialized;
+static qboolean save_threaded;
+
+static savejob_t *save_head, *save_tail;
+static savejob_t *save_running;
+static char save_failed[MAX_OSPATH];
+
+/* where relative names given by the game go */
+static char save_workdir[MAX_OSPATH];
 
 void CM_ReadPortalState(fileHandle_t f);
 
@@ -39,6 +77,9 @@ SV_WipeSavegame(char *savename)
 
 	Com_DPrintf("SV_WipeSaveGame(%s)\n", savename);
 
+	Com_sprintf(name, sizeof(name), "%s/save/%s/", FS_Gamedir(), savename);
+	SV_SaveFileWait(name);
+
 	Com_sprintf(name, sizeof(name), "%s/save/%s/server.ssv",
 				FS_Gamedir(), savename);
 
@@ -71,20 +112,24 @@ SV_WipeSavegame(char *savename)
 	Sys_FindClose();
 }
 
-static void
-CopyFile(char *src, char *dst)
+/*
+ * Runs on the writer thread. A missing
+ * source isn't an error, there's nothing
+ * to copy then.
+ */
+static qboolean
+SV_CopyFile(const char *src, const char *dst)
 {
 	FILE *f1, *f2;
 	size_t l;
 	byte buffer[65536];
-
-	Com_DPrintf("CopyFile (%s, %s)\n", src, dst);
+	qboolean ok;
 
 	f1 = Q_fopen(src, "rb");
 
 	if (!f1)
 	{
-		return;
+		return true;
 	}
 
 	f2 = Q_fopen(dst, "wb");
@@ -92,9 +137,11 @@ CopyFile(char *src, char *dst)
 	if (!f2)
 	{
 		fclose(f1);
-		return;
+		return false;
 	}
 
+	ok = true;
+
 	while (1)
 	{
 		l = fread(buffer, 1, sizeof(buffer), f1);
@@ -104,58 +151,575 @@ CopyFile(char *src, char *dst)
 			break;
 		}
 
-		fwrite(buffer, 1, l, f2);
+		if (fwrite(buffer, 1, l, f2) != l)
+		{
+			ok = false;
+			break;
+		}
 	}
 
 	fclose(f1);
-	fclose(f2);
+
+	if (fclose(f2) != 0)
+	{
+		ok = false;
+	}
+
+	return ok;
+}
+
+/*
+ * Runs on the writer thread.
+ */
+static qboolean
+SV_SaveFileStore(const savejob_t *job)
+{
+	FILE *f;
+	void *packed;
+	size_t packedlen;
+	int header[2];
+	qboolean ok;
+
+	f = Q_fopen(job->path, "wb");
+
+	if (!f)
+	{
+		return false;
+	}
+
+	packed = NULL;
+
+	if (job->compress && job->len)
+	{
+		packed = tdefl_compress_mem_to_heap(job->data, job->len, &packedlen,
+				tdefl_create_comp_flags_from_zip_params(SAVEFILE_LEVEL, 15, 0));
+	}
+
+	if (packed)
+	{
+		header[0] = LittleLong(SAVEFILE_MAGIC);
+		header[1] = LittleLong(job->len);
+
+		ok = (fwrite(header, sizeof(header), 1, f) == 1) &&
+			(fwrite(packed, packedlen, 1, f) == 1);
+
+		free(packed);
+	}
+	else
+	{
+		ok = !job->len || (fwrite(job->data, job->len, 1, f) == 1);
+	}
+
+	if (fclose(f) != 0)
+	{
+		ok = false;
+	}
+
+	return ok;
+}
+
+static qboolean
+SV_SaveFileRun(const savejob_t *job)
+{
+	if (job->src[0])
+	{
+		return SV_CopyFile(job->src, job->path);
+	}
+
+	return SV_SaveFileStore(job);
+}
+
+THREAD_FUNC(SV_SaveFileThread)
+{
+	savejob_t *job;
+	qboolean ok;
+
+	Mutex_Lock(&save_lock);
+
+	while (1)
+	{
+		while (!save_head)
+		{
+			Cond_Wait(&save_wake, &save_lock);
+		}
+
+		job = save_head;
+		save_head = job->next;
+
+		if (!save_head)
+		{
+			save_tail = NULL;
+		}
+
+		save_running = job;
+		Mutex_Unlock(&save_lock);
+
+		ok = SV_SaveFileRun(job);
+
+		Mutex_Lock(&save_lock);
+
+		if (!ok)
+		{
+			Q_strlcpy(save_failed, job->path, sizeof(save_failed));
+		}
+
+		save_running = NULL;
+		Cond_Broadcast(&save_done);
+
+		free(job->data);
+		free(job);
+	}
+
+	THREAD_RETURN;
+}
+
+/*
+ * Tells about a job that failed on the writer
+ * thread. Called with save_lock held.
+ */
+static void
+SV_SaveFileReport(void)
+{
+	if (save_failed[0])
+	{
+		Com_Printf("Couldn't write %s\n", save_failed);
+		save_failed[0] = '\0';
+	}
+}
+
+static void
+SV_SaveFileQueue(savejob_t *job)
+{
+	if (!save_initialized)
+	{
+		Mutex_Init(&save_lock);
+		Cond_Init(&save_wake);
+		Cond_Init(&save_done);
+		save_threaded = Thread_Spawn(&save_thread, SV_SaveFileThread);
+		save_initialized = true;
+
+		if (!save_threaded)
+		{
+			Com_Printf("Couldn't start the savegame thread, saving in the foreground.\n");
+		}
+	}
+
+	if (!save_threaded)
+	{
+		if (!SV_SaveFileRun(job))
+		{
+			Com_Printf("Couldn't write %s\n", job->path);
+		}
+
+		free(job->data);
+		free(job);
+		return;
+	}
+
+	job->next = NULL;
+
+	Mutex_Lock(&save_lock);
+
+	if (save_tail)
+	{
+		save_tail->next = job;
+	}
+	else
+	{
+		save_head = job;
+	}
+
+	save_tail = job;
+
+	SV_SaveFileReport();
+	Cond_Signal(&save_wake);
+	Mutex_Unlock(&save_lock);
+}
+
+static savejob_t *
+SV_SaveFileJob(const char *path)
+{
+	savejob_t *job;
+
+	job = calloc(1, sizeof(savejob_t));
+
+	if (!job)
+	{
+		Com_Error(ERR_FATAL, "%s: out of memory", __func__);
+	}
+
+	Q_strlcpy(job->path, path, sizeof(job->path));
+
+	return job;
+}
+
+/*
+ * The game gives names relative to the
+ * savegame directory it was called in.
+ */
+static void
+SV_SaveFilePath(const char *name, char *path, size_t size)
+{
+	char workdir[MAX_OSPATH];
+
+	if ((name[0] == '/') || (name[0] == '\\') || (name[0] && (name[1] == ':')))
+	{
+		Q_strlcpy(path, name, size);
+	}
+	else if (save_workdir[0])
+	{
+		Com_sprintf(path, size, "%s/%s", save_workdir, name);
+	}
+	else
+	{
+		Sys_GetWorkDir(workdir, sizeof(workdir));
+		Com_sprintf(path, size, "%s/%s", workdir, name);
+	}
+}
+
+/*
+ * Queues a savegame file. The data is copied,
+ * the caller can reuse its buffer right away.
+ */
+void
+SV_SaveFileWrite(const char *name, const void *data, int len,
+		qboolean compress)
+{
+	savejob_t *job;
+	char path[MAX_OSPATH];
+
+	SV_SaveFilePath(name, path, sizeof(path));
+
+	job = SV_SaveFileJob(path);
+	job->len = len;
+	job->compress = compress;
+
+	if (len > 0)
+	{
+		job->data = malloc(len);
+
+		if (!job->data)
+		{
+			Com_Error(ERR_FATAL, "%s: out of memory", __func__);
+		}
+
+		memcpy(job->data, data, len);
+	}
+
+	SV_SaveFileQueue(job);
+}
+
+static qboolean
+SV_SaveFileTouches(const savejob_t *job, const char *prefix, size_t len)
+{
+	return !strncmp(job->path, prefix, len) ||
+		(job->src[0] && !strncmp(job->src, prefix, len));
+}
+
+/*
+ * Waits for the jobs that write or copy files
+ * whose path starts with prefix, NULL waits
+ * for all of them.
+ */
+void
+SV_SaveFileWait(const char *prefix)
+{
+	const savejob_t *job;
+	qboolean pending;
+	size_t len;
+
+	if (!save_threaded)
+	{
+		return;
+	}
+
+	if (!prefix)
+	{
+		prefix = "";
+	}
+
+	len = strlen(prefix);
+
+	Mutex_Lock(&save_lock);
+
+	do
+	{
+		pending = save_running &&
+			SV_SaveFileTouches(save_running, prefix, len);
+
+		for (job = save_head; job && !pending; job = job->next)
+		{
+			pending = SV_SaveFileTouches(job, prefix, len);
+		}
+
+		if (pending)
+		{
+			Cond_Wait(&save_done, &save_lock);
+		}
+	}
+	while (pending);
+
+	SV_SaveFileReport();
+	Mutex_Unlock(&save_lock);
+}
+
+/*
+ * Reads a savegame file, written by
+ * SV_SaveFileWrite() or an older build.
+ * Free the data with Z_Free().
+ */
+int
+SV_SaveFileLoad(const char *name, void **data)
+{
+	char path[MAX_OSPATH];
+	int header[2];
+	byte *raw, *buf;
+	size_t outlen;
+	long len;
+	FILE *f;
+
+	*data = NULL;
+
+	SV_SaveFilePath(name, path, sizeof(path));
+	SV_SaveFileWait(path);
+
+	f = Q_fopen(path, "rb");
+
+	if (!f)
+	{
+		return -1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (len < 0)
+	{
+		fclose(f);
+		return -1;
+	}
+
+	raw = Z_Malloc(len + 1);
+
+	if (len && (fread(raw, len, 1, f) != 1))
+	{
+		fclose(f);
+		Z_Free(raw);
+		return -1;
+	}
+
+	fclose(f);
+
+	if (len >= sizeof(header))
+	{
+		memcpy(header, raw, sizeof(header));
+
+		if (LittleLong(header[0]) == SAVEFILE_MAGIC)
+		{
+			header[1] = LittleLong(header[1]);
+			buf = Z_Malloc(header[1] + 1);
+
+			outlen = tinfl_decompress_mem_to_mem(buf, header[1],
+					raw + sizeof(header), len - sizeof(header),
+					TINFL_FLAG_PARSE_ZLIB_HEADER);
+			Z_Free(raw);
+
+			if (outlen != (size_t)header[1])
+			{
+				Com_Printf("%s is corrupt\n", path);
+				Z_Free(buf);
+				return -1;
+			}
+
+			*data = buf;
+			return header[1];
+		}
+	}
+
+	*data = raw;
+	return (int)len;
+}
+
+/*
+ * Switches the working directory to save/current,
+ * the game writes and reads its files there.
+ */
+static qboolean
+SV_EnterSaveDir(char *workdir, size_t size)
+{
+	char name[MAX_OSPATH];
+
+	Com_sprintf(name, sizeof(name), "%s/save/current", FS_Gamedir());
+	Sys_GetWorkDir(workdir, size);
+	Sys_Mkdir(name);
+
+	if (!Sys_SetWorkDir(name))
+	{
+		Com_Printf("Couldn't change to %s\n", name);
+		Sys_SetWorkDir(workdir);
+		return false;
+	}
+
+	Q_strlcpy(save_workdir, name, sizeof(save_workdir));
+
+	return true;
+}
+
+static void
+SV_LeaveSaveDir(char *workdir)
+{
+	save_workdir[0] = '\0';
+	Sys_SetWorkDir(workdir);
+}
+
+static void
+SV_QueueCopy(const char *src, const char *dst)
+{
+	savejob_t *job;
+
+	Com_DPrintf("CopyFile (%s, %s)\n", src, dst);
+
+	job = SV_SaveFileJob(dst);
+	Q_strlcpy(job->src, src, sizeof(job->src));
+
+	SV_SaveFileQueue(job);
+}
+
+/*
+ * Copies the .sav and .sv2 file of a level.
+ */
+static void
+SV_QueueLevelCopy(const char *src, const char *dst, const char *level)
+{
+	char name[MAX_OSPATH], name2[MAX_OSPATH];
+	size_t l;
+
+	Com_sprintf(name, sizeof(name), "%s%s", src, level);
+	Com_sprintf(name2, sizeof(name2), "%s%s", dst, level);
+	SV_QueueCopy(name, name2);
+
+	/* change sav to sv2 */
+	l = strlen(name);
+	strcpy(name + l - 3, "sv2");
+	l = strlen(name2);
+	strcpy(name2 + l - 3, "sv2");
+	SV_QueueCopy(name, name2);
+}
+
+/*
+ * Remembers the level a write job in srcdir is for,
+ * once per level.
+ */
+static void
+SV_AddPendingLevel(savejob_t **pending, const savejob_t *job,
+		const char *srcdir, size_t len)
+{
+	savejob_t *level;
+	size_t l;
+
+	l = strlen(job->path);
+
+	if (job->src[0] || strncmp(job->path, srcdir, len) ||
+		(l < len + 4) || strcmp(job->path + l - 4, ".sav"))
+	{
+		return;
+	}
+
+	for (level = *pending; level; level = level->next)
+	{
+		if (!strcmp(level->path, job->path + len))
+		{
+			return;
+		}
+	}
+
+	level = SV_SaveFileJob(job->path + len);
+	level->next = *pending;
+	*pending = level;
 }
 
 void
 SV_CopySaveGame(char *src, char *dst)
 {
+	char srcdir[MAX_OSPATH], dstdir[MAX_OSPATH];
 	char name[MAX_OSPATH], name2[MAX_OSPATH];
-	size_t l, len;
+	savejob_t *pending, *job, *next;
+	size_t len;
 	char *found;
 
 	Com_DPrintf("SV_CopySaveGame(%s, %s)\n", src, dst);
 
 	SV_WipeSavegame(dst);
 
+	Com_sprintf(srcdir, sizeof(srcdir), "%s/save/%s/", FS_Gamedir(), src);
+	Com_sprintf(dstdir, sizeof(dstdir), "%s/save/%s/", FS_Gamedir(), dst);
+	len = strlen(srcdir);
+
+	/* the levels that are queued or being written may
+	   not be on disk yet, so they may not be found below */
+	pending = NULL;
+
+	if (save_threaded)
+	{
+		Mutex_Lock(&save_lock);
+
+		if (save_running)
+		{
+			SV_AddPendingLevel(&pending, save_running, srcdir, len);
+		}
+
+		for (job = save_head; job; job = job->next)
+		{
+			SV_AddPendingLevel(&pending, job, srcdir, len);
+		}
+
+		Mutex_Unlock(&save_lock);
+	}
+
 	/* copy the savegame over */
-	Com_sprintf(name, sizeof(name), "%s/save/%s/server.ssv", FS_Gamedir(), src);
-	Com_sprintf(name2, sizeof(name2), "%s/save/%s/server.ssv", FS_Gamedir(), dst);
-	FS_CreatePath(name2);
-	CopyFile(name, name2);
-
-	Com_sprintf(name, sizeof(name), "%s/save/%s/game.ssv", FS_Gamedir(), src);
-	Com_sprintf(name2, sizeof(name2), "%s/save/%s/game.ssv", FS_Gamedir(), dst);
-	CopyFile(name, name2);
-
-	Com_sprintf(name, sizeof(name), "%s/save/%s/", FS_Gamedir(), src);
-	len = strlen(name);
-	Com_sprintf(name, sizeof(name), "%s/save/%s/*.sav", FS_Gamedir(), src);
+	FS_CreatePath(dstdir);
+
+	Com_sprintf(name, sizeof(name), "%sserver.ssv", srcdir);
+	Com_sprintf(name2, sizeof(name2), "%sserver.ssv", dstdir);
+	SV_QueueCopy(name, name2);
+
+	Com_sprintf(name, sizeof(name), "%sgame.ssv", srcdir);
+	Com_sprintf(name2, sizeof(name2), "%sgame.ssv", dstdir);
+	SV_QueueCopy(name, name2);
+
+	Com_sprintf(name, sizeof(name), "%s*.sav", srcdir);
 	found = Sys_FindFirst(name, 0, 0);
 
 	while (found)
 	{
-		strcpy(name + len, found + len);
+		SV_QueueLevelCopy(srcdir, dstdir, found + len);
 
-		Com_sprintf(name2, sizeof(name2), "%s/save/%s/%s",
-					FS_Gamedir(), dst, found + len);
-		CopyFile(name, name2);
-
-		/* change sav to sv2 */
-		l = strlen(name);
-		strcpy(name + l - 3, "sv2");
-		l = strlen(name2);
-		strcpy(name2 + l - 3, "sv2");
-		CopyFile(name, name2);
+		/* already copied, it's only rewritten */
+		for (job = pending; job; job = job->next)
+		{
+			if (!strcmp(job->path, found + len))
+			{
+				job->path[0] = '\0';
+			}
+		}
 
 		found = Sys_FindNext(0, 0);
 	}
 
 	Sys_FindClose();
+
+	for (job = pending; job; job = next)
+	{
+		next = job->next;
+
+		if (job->path[0])
+		{
+			SV_QueueLevelCopy(srcdir, dstdir, job->path);
+		}
+
+		free(job);
+	}
 }
 
 void
@@ -163,39 +727,32 @@ SV_WriteLevelFile(void)
 {
 	char name[MAX_OSPATH];
 	char workdir[MAX_OSPATH];
-	FILE *f;
+	sizebuf_t buf;
+	int size;
 
 	Com_DPrintf("SV_WriteLevelFile()\n");
 
-	Com_sprintf(name, sizeof(name), "%s/save/current/%s.sv2",
-				FS_Gamedir(), sv.name);
-	f = Q_fopen(name, "wb");
+	/* the configstrings and the portal state */
+	size = sizeof(sv.configstrings) + MAX_MAP_AREAPORTALS * sizeof(qboolean);
+	SZ_Init(&buf, Z_Malloc(size), size);
 
-	if (!f)
-	{
-		Com_Printf("Failed to open %s\n", name);
-		return;
-	}
+	SZ_Write(&buf, sv.configstrings, sizeof(sv.configstrings));
+	CM_WritePortalState(&buf);
 
-	fwrite(sv.configstrings, sizeof(sv.configstrings), 1, f);
-	CM_WritePortalState(f);
-	fclose(f);
-
-	Com_sprintf(name, sizeof(name), "%s/save/current", FS_Gamedir());
-	Sys_GetWorkDir(workdir, sizeof(workdir));
-	Sys_Mkdir(name);
+	Com_sprintf(name, sizeof(name), "%s/save/current/%s.sv2",
+				FS_Gamedir(), sv.name);
+	SV_SaveFileWrite(name, buf.data, buf.cursize, false);
+	Z_Free(buf.data);
 
-	if (!Sys_SetWorkDir(name))
+	if (!SV_EnterSaveDir(workdir, sizeof(workdir)))
 	{
-		Com_Printf("Couldn't change to %s\n", name);
-		Sys_SetWorkDir(workdir);
 		return;
 	}
 
 	Com_sprintf(name, sizeof(name), "%s.sav", sv.name);
 	ge->WriteLevel(name);
 
-	Sys_SetWorkDir(workdir);
+	SV_LeaveSaveDir(workdir);
 }
 
 void
@@ -207,6 +764,9 @@ SV_ReadLevelFile(void)
 
 	Com_DPrintf("SV_ReadLevelFile()\n");
 
+	Com_sprintf(name, sizeof(name), "%s/save/current/", FS_Gamedir());
+	SV_SaveFileWait(name);
+
 	Com_sprintf(name, sizeof(name), "save/current/%s.sv2", sv.name);
 	FS_FOpenFile(name, &f, true);
 
@@ -220,44 +780,43 @@ SV_ReadLevelFile(void)
 	CM_ReadPortalState(f);
 	FS_FCloseFile(f);
 
-	Com_sprintf(name, sizeof(name), "%s/save/current", FS_Gamedir());
-	Sys_GetWorkDir(workdir, sizeof(workdir));
-
-	if (!Sys_SetWorkDir(name))
+	if (!SV_EnterSaveDir(workdir, sizeof(workdir)))
 	{
-		Com_Printf("Couldn't change to %s\n", name);
-		Sys_SetWorkDir(workdir);
 		return;
 	}
 
 	Com_sprintf(name, sizeof(name), "%s.sav", sv.name);
 	ge->ReadLevel(name);
 
-	Sys_SetWorkDir(workdir);
+	SV_LeaveSaveDir(workdir);
 }
 
 void
 SV_WriteServerFile(qboolean autosave)
 {
-	FILE *f;
+	sizebuf_t buf;
 	cvar_t *var;
 	char name[MAX_OSPATH], string[128];
 	char workdir[MAX_OSPATH];
 	char comment[32];
 	time_t aclock;
 	struct tm *newtime;
+	int size;
 
 	Com_DPrintf("SV_WriteServerFile(%s)\n", autosave ? "true" : "false");
 
-	Com_sprintf(name, sizeof(name), "%s/save/current/server.ssv", FS_Gamedir());
-	f = Q_fopen(name, "wb");
+	size = sizeof(comment) + sizeof(svs.mapcmd);
 
-	if (!f)
+	for (var = cvar_vars; var; var = var->next)
 	{
-		Com_Printf("Couldn't write %s\n", name);
-		return;
+		if (var->flags & CVAR_LATCH)
+		{
+			size += LATCH_CVAR_SAVELENGTH + sizeof(string);
+		}
 	}
 
+	SZ_Init(&buf, Z_Malloc(size), size);
+
 	/* write the comment field */
 	memset(comment, 0, sizeof(comment));
 
@@ -278,10 +837,10 @@ SV_WriteServerFile(qboolean autosave)
 				sv.configstrings[CS_NAME]);
 	}
 
-	fwrite(comment, 1, sizeof(comment), f);
+	SZ_Write(&buf, comment, sizeof(comment));
 
 	/* write the mapcmd */
-	fwrite(svs.mapcmd, 1, sizeof(svs.mapcmd), f);
+	SZ_Write(&buf, svs.mapcmd, sizeof(svs.mapcmd));
 
 	/* write all CVAR_LATCH cvars
 	   these will be things like coop,
@@ -304,27 +863,23 @@ SV_WriteServerFile(qboolean autosave)
 		memset(string, 0, sizeof(string));
 		strcpy(cvarname, var->name);
 		strcpy(string, var->string);
-		fwrite(cvarname, 1, sizeof(cvarname), f);
-		fwrite(string, 1, sizeof(string), f);
+		SZ_Write(&buf, cvarname, sizeof(cvarname));
+		SZ_Write(&buf, string, sizeof(string));
 	}
 
-	fclose(f);
+	Com_sprintf(name, sizeof(name), "%s/save/current/server.ssv", FS_Gamedir());
+	SV_SaveFileWrite(name, buf.data, buf.cursize, false);
+	Z_Free(buf.data);
 
 	/* write game state */
-	Com_sprintf(name, sizeof(name), "%s/save/current", FS_Gamedir());
-	Sys_GetWorkDir(workdir, sizeof(workdir));
-	Sys_Mkdir(name);
-
-	if (!Sys_SetWorkDir(name))
+	if (!SV_EnterSaveDir(workdir, sizeof(workdir)))
 	{
-		Com_Printf("Couldn't change to %s\n", name);
-		Sys_SetWorkDir(workdir);
 		return;
 	}
 
 	ge->WriteGame("game.ssv", autosave);
 
-	Sys_SetWorkDir(workdir);
+	SV_LeaveSaveDir(workdir);
 }
 
 static void
@@ -338,6 +893,9 @@ SV_ReadServerFile(void)
 
 	Com_DPrintf("SV_ReadServerFile()\n");
 
+	Com_sprintf(name, sizeof(name), "%s/save/current/", FS_Gamedir());
+	SV_SaveFileWait(name);
+
 	Com_sprintf(name, sizeof(name), "save/current/server.ssv");
 	FS_FOpenFile(name, &f, true);
 
@@ -377,19 +935,14 @@ SV_ReadServerFile(void)
 	strcpy(svs.mapcmd, mapcmd);
 
 	/* read game state */
-	Com_sprintf(name, sizeof(name), "%s/save/current", FS_Gamedir());
-	Sys_GetWorkDir(workdir, sizeof(workdir));
-
-	if (!Sys_SetWorkDir(name))
+	if (!SV_EnterSaveDir(workdir, sizeof(workdir)))
 	{
-		Com_Printf("Couldn't change to %s\n", name);
-		Sys_SetWorkDir(workdir);
 		return;
 	}
 
 	ge->ReadGame("game.ssv");
 
-	Sys_SetWorkDir(workdir);
+	SV_LeaveSaveDir(workdir);
 }
 
 void
@@ -415,6 +968,10 @@ SV_Loadgame_f(void)
 		Com_Printf("Bad savedir.\n");
 	}
 
+	/* it may have just been saved */
+	Com_sprintf(name, sizeof(name), "%s/save/%s/", FS_Gamedir(), Cmd_Argv(1));
+	SV_SaveFileWait(name);
+
 	/* make sure the server.ssv file exists */
 	Com_sprintf(name, sizeof(name), "%s/save/%s/server.ssv",
 				FS_Gamedir(), Cmd_Argv(1));
@@ -445,20 +445,179 @@ SV_StartSound(vec3_t origin, edict_t *entity, int channel, int soundindex,
 	}
 }
 
-static qboolean
-SV_SendClientDatagram(client_t *client)
+/* one spawned client's datagram for this frame */
+typedef struct
 {
-	byte msg_buf[MAX_MSGLEN];
+	client_t *client;
+	int *ents;          /* visible entities, see SV_BuildClientFrame() */
+	int numents;
+	int surpress;       /* surpressCount the frame was written with */
+	int slot;           /* place among the spawned clients */
+	int framenum;       /* sv.framenum it was built in */
+	int sendtime;       /* svs.realtime it's due, -1 once sent */
 	sizebuf_t msg;
+	byte msg_buf[MAX_FRAGMENTED_MSGLEN];
+} sendjob_t;
+
+static sendjob_t *sendjobs;
+static int sendjob_pending;     /* jobs SV_SendStaggered() looks at */
+static int *sendjob_ents;
+static int sendjob_clients;
+static int sendjob_edicts;
+
+static void
+SV_AllocSendJobs(void)
+{
+	int i;
+
+	if ((sendjob_clients == (int)maxclients->value) &&
+		(sendjob_edicts == ge->max_edicts))
+	{
+		return;
+	}
+
+	if (sendjobs)
+	{
+		Z_Free(sendjobs);
+		Z_Free(sendjob_ents);
+	}
+
+	sendjob_clients = (int)maxclients->value;
+	sendjob_edicts = ge->max_edicts;
 
-	SV_BuildClientFrame(client);
+	sendjobs = Z_Malloc(sendjob_clients * sizeof(sendjob_t));
+	sendjob_ents = Z_Malloc(sendjob_clients * sendjob_edicts * sizeof(int));
+
+	for (i = 0; i < sendjob_clients; i++)
+	{
+		sendjobs[i].ents = sendjob_ents + i * sendjob_edicts;
+	}
+}
+
+static void
+SV_BuildFrameJob(void *data, int index)
+{
+	sendjob_t *job = (sendjob_t *)data + index;
+
+	SV_ProfileBegin("SV_BuildClientFrame");
+	job->numents = SV_BuildClientFrame(job->client, job->ents);
+	SV_ProfileEnd();
+}
+
+static void
+SV_WriteFrameJob(void *data, int index)
+{
+	sendjob_t *job = (sendjob_t *)data + index;
+
+	SV_ProfileBegin("SV_WriteFrameToClient");
+
+	if (job->numents >= 0)
+	{
+		SV_StoreClientFrame(job->client, job->ents, job->numents);
+	}
 
-	SZ_Init(&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = true;
+	/* big frames go out in fragments if the client takes them */
+	SZ_Init(&job->msg, job->msg_buf, job->client->netchan.maxmsglen);
+	job->msg.allowoverflow = true;
+	job->msg.silent = true; /* may be a worker, the console isn't thread safe */
 
 	/* send over all the relevant entity_state_t
 	   and the player_state_t */
-	SV_WriteFrameToClient(client, &msg);
+	job->framenum = sv.framenum;
+	job->surpress = job->client->surpressCount;
+	SV_WriteFrameToClient(job->client, &job->msg);
+
+	SV_ProfileEnd();
+}
+
+/*
+ * Hands out the runs of client_entities in client order, so the
+ * layout is the same however the frames were built. Returns false
+ * if a run overwrites entities some client still deltas from, in
+ * which case the frames have to be written one after another.
+ */
+static qboolean
+SV_AllocFrameEntities(sendjob_t *jobs, int numjobs)
+{
+	client_frame_t *frame;
+	int i;
+
+	for (i = 0; i < numjobs; i++)
+	{
+		if (jobs[i].numents < 0)
+		{
+			continue;
+		}
+
+		frame = &jobs[i].client->frames[sv.framenum & UPDATE_MASK];
+		frame->first_entity = svs.next_client_entities;
+		svs.next_client_entities += jobs[i].numents;
+	}
+
+	for (i = 0; i < numjobs; i++)
+	{
+		frame = SV_DeltaFrame(jobs[i].client);
+
+		if (frame && (svs.next_client_entities - frame->first_entity >
+					svs.num_client_entities))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Builds and writes every frame a second time on this thread
+ * and complains about any that doesn't match the threaded one.
+ */
+static void
+SV_VerifyFrameJobs(sendjob_t *jobs, int numjobs)
+{
+	byte msg_buf[MAX_FRAGMENTED_MSGLEN];
+	sizebuf_t msg;
+	sendjob_t *job;
+	int *ents;
+	int count;
+	int i;
+
+	ents = Z_Malloc(ge->max_edicts * sizeof(int));
+
+	for (i = 0, job = jobs; i < numjobs; i++, job++)
+	{
+		count = SV_BuildClientFrame(job->client, ents);
+
+		if ((count != job->numents) ||
+			((count > 0) && memcmp(ents, job->ents, count * sizeof(int))))
+		{
+			Com_Printf("sv_workers_verify: frame %i: entities for %s differ\n",
+					sv.framenum, job->client->name);
+			continue;
+		}
+
+		SZ_Init(&msg, msg_buf, job->client->netchan.maxmsglen);
+		msg.allowoverflow = true;
+
+		job->client->surpressCount = job->surpress;
+		SV_WriteFrameToClient(job->client, &msg);
+
+		if ((msg.cursize != job->msg.cursize) ||
+			memcmp(msg.data, job->msg.data, msg.cursize))
+		{
+			Com_Printf("sv_workers_verify: frame %i: packet for %s differs\n",
+					sv.framenum, job->client->name);
+		}
+	}
+
+	Z_Free(ents);
+}
+
+static void
+SV_FinishClientDatagram(sendjob_t *job)
+{
+	client_t *client = job->client;
+	sizebuf_t *msg = &job->msg;
 
 	/* copy the accumulated multicast datagram
 	   for this client out to the message
@@ -470,25 +629,204 @@ SV_SendClientDatagram(client_t *client)
 	}
 	else
 	{
-		SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
+		SZ_Write(msg, client->datagram.data, client->datagram.cursize);
 	}
 
 	SZ_Clear(&client->datagram);
 
-	if (msg.overflowed)
+	if (msg->overflowed)
 	{
 		/* must have room left for the packet header */
 		Com_Printf("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear(&msg);
+		SZ_Clear(msg);
+	}
+}
+
+static void
+SV_TransmitClientDatagram(sendjob_t *job)
+{
+	client_t *client = job->client;
+	sizebuf_t *msg = &job->msg;
+
+	job->sendtime = -1;
+
+	/* gone since the frame was built */
+	if (client->state != cs_spawned)
+	{
+		return;
 	}
 
 	/* send the datagram */
-	Netchan_Transmit(&client->netchan, msg.cursize, msg.data);
+	Netchan_Transmit(&client->netchan, msg->cursize, msg->data);
 
-	/* record the size for rate estimation */
-	client->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
+	/* pings count from here, not from building the frame,
+	   sv.framenum is already the next one if it's sent late */
+	client->frames[job->framenum & UPDATE_MASK].senttime = svs.realtime;
 
-	return true;
+	/* pay for it and record the size for sv_sendstats */
+	client->ratetokens -= msg->cursize;
+	client->message_size[job->framenum % RATE_MESSAGES] = msg->cursize;
+	client->sentbytes += msg->cursize;
+	client->sentframes++;
+}
+
+/*
+ * With sv_sendstagger set the datagrams of a frame go out over that
+ * many msec instead of all at once, so the egress is an even stream
+ * rather than a burst every frame. Every spawned client keeps its slot
+ * from frame to frame so the interval between its frames, which the
+ * client interpolates over, stays the same. Sends the datagrams that
+ * are due, or all with all set, and returns the msec until the next
+ * one or -1 if none are left.
+ */
+int
+SV_SendStaggered(qboolean all)
+{
+	sendjob_t *job;
+	int wait, bytes;
+	int i;
+
+	if (!sendjob_pending)
+	{
+		return -1;
+	}
+
+	wait = -1;
+	bytes = 0;
+
+	SV_ProfileBegin("SV_SendClientDatagram");
+	NET_QueuePackets();
+
+	for (i = 0, job = sendjobs; i < sendjob_pending; i++, job++)
+	{
+		if (job->sendtime < 0)
+		{
+			continue;
+		}
+
+		if (all || (job->sendtime <= svs.realtime))
+		{
+			SV_TransmitClientDatagram(job);
+			bytes += job->msg.cursize;
+		}
+		else if ((wait < 0) || (job->sendtime - svs.realtime < wait))
+		{
+			wait = job->sendtime - svs.realtime;
+		}
+	}
+
+	NET_FlushPackets();
+	SV_ProfileEnd();
+
+	if (wait < 0)
+	{
+		sendjob_pending = 0;
+	}
+
+	if (bytes)
+	{
+		SV_ProfileCount("SV_SentBytes", bytes);
+	}
+
+	return wait;
+}
+
+/*
+ * Forgets the datagrams that haven't been sent,
+ * before the clients they're for are freed.
+ */
+void
+SV_DropStaggered(void)
+{
+	sendjob_pending = 0;
+}
+
+/*
+ * Gives every datagram its time, loopback clients and
+ * everyone while sv_sendstagger is 0 get them now.
+ */
+static void
+SV_ScheduleClientDatagrams(sendjob_t *jobs, int numjobs, int numslots)
+{
+	int window;
+	int i;
+
+	window = (int)sv_sendstagger->value;
+
+	/* all of them have to be out before the next frame */
+	if (window > 90)
+	{
+		window = 90;
+	}
+
+	for (i = 0; i < numjobs; i++)
+	{
+		jobs[i].sendtime = svs.realtime;
+
+		if ((window > 0) && (numslots > 1) &&
+			(jobs[i].client->netchan.remote_address.type != NA_LOOPBACK))
+		{
+			jobs[i].sendtime += jobs[i].slot * window / numslots;
+		}
+	}
+
+	sendjob_pending = numjobs;
+}
+
+/*
+ * Building and delta compressing the frames only reads the
+ * world, so with sv_workers set it's spread over the worker
+ * threads. Everything else stays on the main thread, in
+ * client order.
+ */
+static void
+SV_SendClientDatagrams(sendjob_t *jobs, int numjobs)
+{
+	int i;
+
+	SV_CheckEntityNumbers();
+	SV_PrepareClusterEntities();
+
+	for (i = 0; i < numjobs; i++)
+	{
+		SV_CacheClientCluster(jobs[i].client);
+	}
+
+	Workers_Run(SV_BuildFrameJob, jobs, numjobs);
+
+	SV_PrepareDeltaCache();
+
+	if (SV_AllocFrameEntities(jobs, numjobs))
+	{
+		Workers_Run(SV_WriteFrameJob, jobs, numjobs);
+	}
+	else
+	{
+		for (i = 0; i < numjobs; i++)
+		{
+			SV_WriteFrameJob(jobs, i);
+		}
+	}
+
+	/* verifying writes without the cache, so it's checked too */
+	SV_FinishDeltaCache();
+
+	if (sv_workers_verify->value && (Workers_Count() || sv_deltacache->value))
+	{
+		SV_VerifyFrameJobs(jobs, numjobs);
+	}
+
+	for (i = 0; i < numjobs; i++)
+	{
+		/* the workers only flagged it */
+		if (jobs[i].msg.overflowed)
+		{
+			Com_Printf("SZ_GetSpace: overflow\n");
+		}
+
+		jobs[i].msg.silent = false;
+		SV_FinishClientDatagram(&jobs[i]);
+	}
 }
 
 static void
@@ -510,8 +848,7 @@ SV_DemoCompleted(void)
 static qboolean
 SV_RateDrop(client_t *c)
 {
-	int total;
-	int i;
+	int elapsed;
 
 	/* never drop over the loopback */
 	if (c->netchan.remote_address.type == NA_LOOPBACK)
@@ -519,16 +856,52 @@ SV_RateDrop(client_t *c)
 		return false;
 	}
 
-	total = 0;
+	/* the bucket fills with rate bytes per second
+	   and holds a quarter of a second worth */
+	elapsed = svs.realtime - c->ratetime;
+	c->ratetime = svs.realtime;
 
-	for (i = 0; i < RATE_MESSAGES; i++)
+	if ((elapsed < 0) || (elapsed > 1000))
 	{
-		total += c->message_size[i];
+		elapsed = 1000;
 	}
 
-	if (total > c->rate)
+	c->ratetokens += c->rate * elapsed / 1000;
+
+	if (c->ratetokens > c->rate / 4)
+	{
+		c->ratetokens = c->rate / 4;
+	}
+
+	/* a big frame takes it below zero, the next
+	   one waits until that has been paid back */
+	if (c->ratetokens < 0)
 	{
 		c->surpressCount++;
+		c->ratedrops++;
+		c->message_size[sv.framenum % RATE_MESSAGES] = 0;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if the client asked for fewer frames
+ * than the server runs and this one isn't due.
+ */
+static qboolean
+SV_SnapSkip(client_t *c)
+{
+	/* sv.time starts over with every map */
+	if (c->nextsnap > sv.time + 1000)
+	{
+		c->nextsnap = sv.time;
+	}
+
+	if (sv.time < c->nextsnap)
+	{
+		c->snapskips++;
 		c->message_size[sv.framenum % RATE_MESSAGES] = 0;
 		return true;
 	}
@@ -561,10 +934,11 @@ SV_NextDemoChunk(byte *msgbuf)
 		return -1;
 	}
 
-	if (n > MAX_MSGLEN)
+	/* clients record fragmented messages in one block */
+	if (n > MAX_FRAGMENTED_MSGLEN)
 	{
 		Com_Error(ERR_DROP,
-				"SV_SendClientMessages: msglen > MAX_MSGLEN");
+				"SV_SendClientMessages: msglen > MAX_FRAGMENTED_MSGLEN");
 	}
 
 	r = FS_FRead(msgbuf, n, 1, sv.demofile);
@@ -593,7 +967,14 @@ SV_SendClientMessages(void)
 	int i;
 	client_t *c;
 	int msglen;
-	byte msgbuf[MAX_MSGLEN];
+	int numjobs, numslots;
+	static byte msgbuf[MAX_FRAGMENTED_MSGLEN];
+
+	if (sv_workers->modified)
+	{
+		sv_workers->modified = false;
+		Workers_Init((int)sv_workers->value);
+	}
 
 	/* read the next demo message if needed */
 	if (sv.demofile && (sv.state == ss_demo))
@@ -611,6 +992,16 @@ SV_SendClientMessages(void)
 		msglen = 0;
 	}
 
+	numjobs = 0;
+	numslots = 0;
+
+	/* whatever is left of the last frame goes first,
+	   sendjobs may be reallocated below */
+	SV_SendStaggered(true);
+
+	/* everything sent below goes out in one batch at the end */
+	NET_QueuePackets();
+
 	/* send a message to each spawned client */
 	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
 	{
@@ -633,17 +1024,85 @@ SV_SendClientMessages(void)
 		}
 		else if (c->state == cs_spawned)
 		{
+			numslots++;
+
 			/* don't overrun bandwidth */
-			if (SV_RateDrop(c))
+			if (SV_SnapSkip(c) || SV_RateDrop(c))
 			{
 				continue;
 			}
 
-			SV_SendClientDatagram(c);
+			/* keeps the average, but never bursts to catch up */
+			c->nextsnap += 1000 / c->snaps;
+
+			if (c->nextsnap < sv.time)
+			{
+				c->nextsnap = sv.time;
+			}
+
+			if (!numjobs)
+			{
+				SV_AllocSendJobs();
+			}
+
+			/* sent below, after the last client
+			   that overflowed has been dropped */
+			sendjobs[numjobs].slot = numslots - 1;
+			sendjobs[numjobs++].client = c;
 		}
 
 		/* messages to non-spawned clients are sent by SendPrepClientMessages */
 	}
+
+	if (numjobs)
+	{
+		SV_ScheduleClientDatagrams(sendjobs, numjobs, numslots);
+		SV_SendClientDatagrams(sendjobs, numjobs);
+	}
+
+	NET_FlushPackets();
+
+	/* the ones that aren't staggered */
+	SV_SendStaggered(false);
+}
+
+/*
+ * sv_sendstats
+ */
+void
+SV_SendStats_f(void)
+{
+	client_t *c;
+	int i, j, recent;
+
+	if (!svs.initialized)
+	{
+		Com_Printf("No server running.\n");
+		return;
+	}
+
+	Com_Printf("num name            rate snaps bytes/s frames    bytes drops skips\n");
+	Com_Printf("--- --------------- ----- ----- ------- ------ -------- ----- -----\n");
+
+	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
+	{
+		if (c->state != cs_spawned)
+		{
+			continue;
+		}
+
+		/* one message per server frame, so that's a second */
+		recent = 0;
+
+		for (j = 0; j < RATE_MESSAGES; j++)
+		{
+			recent += c->message_size[j];
+		}
+
+		Com_Printf("%3i %-15.15s %5i %5i %7i %6i %8lld %5i %5i\n", i,
+				c->name, c->rate, c->snaps, recent, c->sentframes,
+				c->sentbytes, c->ratedrops, c->snapskips);
+	}
 }
 
 void
@@ -78,7 +78,7 @@ SV_New_f(void)
 
 	/* send the serverdata */
 	MSG_WriteByte(&sv_client->netchan.message, svc_serverdata);
-	MSG_WriteLong(&sv_client->netchan.message, PROTOCOL_VERSION);
+	MSG_WriteLong(&sv_client->netchan.message, sv_client->protocol);
 	MSG_WriteLong(&sv_client->netchan.message, svs.spawncount);
 	MSG_WriteByte(&sv_client->netchan.message, sv.attractloop);
 	MSG_WriteString(&sv_client->netchan.message, gamedir);
@@ -174,7 +174,7 @@ SV_Configstrings_f(void)
 		if (*cs != '\0')
 		{
 			if ((sv_client->netchan.message.cursize + MSG_ConfigString_Size(cs))
-				> (MAX_MSGLEN - (CMD_MARGIN + max_msgutil)))
+				> (sv_client->netchan.maxmsglen - (CMD_MARGIN + max_msgutil)))
 			{
 				break;
 			}
@@ -245,7 +245,7 @@ SV_Baselines_f(void)
 		if (base->modelindex || base->sound || base->effects)
 		{
 			if ((sv_client->netchan.message.cursize + MSG_DeltaEntity_Size(NULL, base, true, true))
-				> (MAX_MSGLEN - (CMD_MARGIN + max_msgutil)))
+				> (sv_client->netchan.maxmsglen - (CMD_MARGIN + max_msgutil)))
 			{
 				break;
 			}
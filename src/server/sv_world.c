@@ -26,8 +26,9 @@
 
 #include "header/server.h"
 
-#define AREA_DEPTH 4
-#define AREA_NODES 32
+#define AREA_DEPTH 4 /* every map is split at least this deep */
+#define AREA_MAX_DEPTH 10 /* upper limit for sv_areadepth */
+#define AREA_NODES ((1 << (AREA_MAX_DEPTH + 1)) - 1)
 #define MAX_TOTAL_ENT_LEAFS 128
 
 #define STRUCT_FROM_LINK(l, t, m) ((t *)((byte *)l - (byte *)&(((t *)NULL)->m)))
@@ -36,6 +37,7 @@
 typedef struct areanode_s
 {
 	int axis; /* -1 = leaf node */
+	int depth;
 	float dist;
 	struct areanode_s *children[2];
 	link_t trigger_edicts;
@@ -50,7 +52,28 @@ edict_t **area_list;
 int area_count, area_maxcount;
 int area_type;
 
+/* sv_areastats counters */
+static int area_traces;
+static int area_candidates;
+
+/* Every edict is kept in the lists of the clusters it was last
+   linked into, so building a client frame only has to look at
+   the clusters in its PVS. Edicts without a cluster, or with too
+   many to list, go in one more list that's always looked at. */
+typedef struct
+{
+	int cluster;
+	int prev, next; /* link numbers, -1 ends the list */
+} clusterlink_t;
+
+static clusterlink_t *cluster_links;  /* MAX_ENT_CLUSTERS per edict */
+static byte *cluster_numlinks;        /* links in use per edict */
+static int *cluster_heads;            /* [cluster_numclusters + 1] */
+static int cluster_numclusters;
+static int cluster_maxedicts;
+
 static int SV_HullForEntity(edict_t *ent);
+static void SV_LinkToAreaNode(edict_t *ent);
 
 /* ClearLink is used for new headnodes */
 static void
@@ -75,23 +98,53 @@ InsertLinkBefore(link_t *l, link_t *before)
 	l->next->prev = l;
 }
 
+static int
+SV_AreaEdictCompare(const void *a, const void *b)
+{
+	const edict_t *ea = *(edict_t * const *)a;
+	const edict_t *eb = *(edict_t * const *)b;
+
+	return (ea > eb) - (ea < eb);
+}
+
+static int
+SV_AreaFloatCompare(const void *a, const void *b)
+{
+	float fa = *(const float *)a;
+	float fb = *(const float *)b;
+
+	return (fa > fb) - (fa < fb);
+}
+
 /*
- * Builds a uniformly subdivided tree for the given world size
+ * Builds the area tree for the given world size. The top
+ * AREA_DEPTH levels are split uniformly, like the original
+ * tree. Below that nodes holding more than sv_areasplit of
+ * the given edicts keep splitting at their median, down to
+ * sv_areadepth, so crowded parts of the map get small nodes
+ * and empty ones don't waste any.
  */
 static areanode_t *
-SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
+SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs,
+		edict_t **ents, int numents, float *centers)
 {
 	areanode_t *anode;
 	vec3_t size;
 	vec3_t mins1, maxs1, mins2, maxs2;
+	int maxdepth, front, back, i;
+	edict_t *check;
 
 	anode = &sv_areanodes[sv_numareanodes];
 	sv_numareanodes++;
 
 	ClearLink(&anode->trigger_edicts);
 	ClearLink(&anode->solid_edicts);
+	anode->depth = depth;
 
-	if (depth == AREA_DEPTH)
+	maxdepth = Q_clamp((int)sv_areadepth->value, AREA_DEPTH, AREA_MAX_DEPTH);
+
+	if ((depth >= maxdepth) ||
+		((depth >= AREA_DEPTH) && (numents <= (int)sv_areasplit->value)))
 	{
 		anode->axis = -1;
 		anode->children[0] = anode->children[1] = NULL;
@@ -110,6 +163,49 @@ SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
 	}
 
 	anode->dist = 0.5f * (maxs[anode->axis] + mins[anode->axis]);
+
+	if ((depth >= AREA_DEPTH) && (numents > 0))
+	{
+		/* split at the median, but don't create slivers */
+		for (i = 0; i < numents; i++)
+		{
+			centers[i] = 0.5f * (ents[i]->absmin[anode->axis] +
+					ents[i]->absmax[anode->axis]);
+		}
+
+		qsort(centers, numents, sizeof(centers[0]), SV_AreaFloatCompare);
+
+		anode->dist = Q_clamp(centers[numents / 2],
+				mins[anode->axis] + 0.25f * size[anode->axis],
+				maxs[anode->axis] - 0.25f * size[anode->axis]);
+	}
+
+	/* edicts that cross the plane stay here, sort the
+	   others to the front (child 0) and the back (child 1) */
+	front = 0;
+
+	for (i = 0; i < numents; i++)
+	{
+		if (ents[i]->absmin[anode->axis] > anode->dist)
+		{
+			check = ents[front];
+			ents[front++] = ents[i];
+			ents[i] = check;
+		}
+	}
+
+	back = front;
+
+	for (i = front; i < numents; i++)
+	{
+		if (ents[i]->absmax[anode->axis] < anode->dist)
+		{
+			check = ents[back];
+			ents[back++] = ents[i];
+			ents[i] = check;
+		}
+	}
+
 	VectorCopy(mins, mins1);
 	VectorCopy(mins, mins2);
 	VectorCopy(maxs, maxs1);
@@ -117,18 +213,338 @@ SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
 
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 
-	anode->children[0] = SV_CreateAreaNode(depth + 1, mins2, maxs2);
-	anode->children[1] = SV_CreateAreaNode(depth + 1, mins1, maxs1);
+	anode->children[0] = SV_CreateAreaNode(depth + 1, mins2, maxs2,
+			ents, front, centers);
+	anode->children[1] = SV_CreateAreaNode(depth + 1, mins1, maxs1,
+			ents + front, back - front, centers);
 
 	return anode;
 }
 
+/*
+ * Puts an edict into the first area node its box crosses
+ */
+static void
+SV_LinkToAreaNode(edict_t *ent)
+{
+	areanode_t *node;
+
+	/* find the first node that the ent's box crosses */
+	node = sv_areanodes;
+
+	while (1)
+	{
+		if (node->axis == -1)
+		{
+			break;
+		}
+
+		if (ent->absmin[node->axis] > node->dist)
+		{
+			node = node->children[0];
+		}
+		else if (ent->absmax[node->axis] < node->dist)
+		{
+			node = node->children[1];
+		}
+		else
+		{
+			break; /* crosses the node */
+		}
+	}
+
+	/* link it in */
+	if (ent->solid == SOLID_TRIGGER)
+	{
+		InsertLinkBefore(&ent->area, &node->trigger_edicts);
+	}
+	else
+	{
+		InsertLinkBefore(&ent->area, &node->solid_edicts);
+	}
+}
+
+static void
+SV_ClearClusterLinks(void)
+{
+	int i;
+
+	if ((cluster_maxedicts != ge->max_edicts) ||
+		(cluster_numclusters != CM_NumClusters()))
+	{
+		if (cluster_links)
+		{
+			Z_Free(cluster_links);
+			Z_Free(cluster_numlinks);
+			Z_Free(cluster_heads);
+		}
+
+		cluster_maxedicts = ge->max_edicts;
+		cluster_numclusters = CM_NumClusters();
+
+		cluster_links = Z_Malloc(cluster_maxedicts * MAX_ENT_CLUSTERS *
+				sizeof(clusterlink_t));
+		cluster_numlinks = Z_Malloc(cluster_maxedicts);
+		cluster_heads = Z_Malloc((cluster_numclusters + 1) * sizeof(int));
+	}
+	else
+	{
+		memset(cluster_numlinks, 0, cluster_maxedicts);
+	}
+
+	for (i = 0; i <= cluster_numclusters; i++)
+	{
+		cluster_heads[i] = -1;
+	}
+}
+
 void
 SV_ClearWorld(void)
 {
 	memset(sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
-	SV_CreateAreaNode(0, sv.models[1]->mins, sv.models[1]->maxs);
+	SV_CreateAreaNode(0, sv.models[1]->mins, sv.models[1]->maxs, NULL, 0, NULL);
+
+	area_traces = 0;
+	area_candidates = 0;
+
+	SV_ClearClusterLinks();
+}
+
+/*
+ * Moves the edict to the lists of the clusters
+ * SV_LinkEdict() has just worked out for it.
+ */
+static void
+SV_LinkClusters(edict_t *ent)
+{
+	clusterlink_t *link;
+	int e, i, n, count;
+
+	e = NUM_FOR_EDICT(ent);
+
+	if (e >= cluster_maxedicts)
+	{
+		return;
+	}
+
+	/* unlink from the old clusters */
+	for (i = 0; i < cluster_numlinks[e]; i++)
+	{
+		link = &cluster_links[e * MAX_ENT_CLUSTERS + i];
+
+		if (link->prev != -1)
+		{
+			cluster_links[link->prev].next = link->next;
+		}
+		else
+		{
+			cluster_heads[link->cluster] = link->next;
+		}
+
+		if (link->next != -1)
+		{
+			cluster_links[link->next].prev = link->prev;
+		}
+	}
+
+	count = (ent->num_clusters > 0) ? ent->num_clusters : 1;
+
+	for (i = 0; i < count; i++)
+	{
+		n = e * MAX_ENT_CLUSTERS + i;
+		link = &cluster_links[n];
+
+		link->cluster = (ent->num_clusters > 0) ? ent->clusternums[i] :
+			cluster_numclusters;
+		link->prev = -1;
+		link->next = cluster_heads[link->cluster];
+
+		if (link->next != -1)
+		{
+			cluster_links[link->next].prev = n;
+		}
+
+		cluster_heads[link->cluster] = n;
+	}
+
+	cluster_numlinks[e] = count;
+}
+
+/*
+ * Sets the bit of every edict linked into one of the
+ * clusters in the given cluster bit vector, and of the
+ * ones that aren't in any listed cluster. Returns false
+ * if the lists don't cover all of the game's edicts.
+ */
+qboolean
+SV_MarkClusterEdicts(const byte *clusters, unsigned *edicts)
+{
+	int c, n, e;
+
+	if ((cluster_maxedicts != ge->max_edicts) || !cluster_heads)
+	{
+		return false;
+	}
+
+	for (c = 0; c < cluster_numclusters; c++)
+	{
+		if (!(clusters[c >> 3] & (1 << (c & 7))))
+		{
+			if (!clusters[c >> 3])
+			{
+				c |= 7; /* skip the rest of the byte */
+			}
+
+			continue;
+		}
+
+		for (n = cluster_heads[c]; n != -1; n = cluster_links[n].next)
+		{
+			e = n / MAX_ENT_CLUSTERS;
+			edicts[e >> 5] |= 1u << (e & 31);
+		}
+	}
+
+	for (n = cluster_heads[cluster_numclusters]; n != -1; n = cluster_links[n].next)
+	{
+		e = n / MAX_ENT_CLUSTERS;
+		edicts[e >> 5] |= 1u << (e & 31);
+	}
+
+	return true;
+}
+
+/*
+ * Rebuilds the area tree around the edicts that are
+ * linked right now. Called once the map is spawned,
+ * when the monsters, items and triggers are in place.
+ */
+void
+SV_RebuildAreaNodes(void)
+{
+	edict_t **ents;
+	float *centers;
+	edict_t *ent;
+	int i, numents;
+
+	if (!sv.models[1])
+	{
+		return;
+	}
+
+	ents = Z_Malloc(ge->num_edicts * sizeof(*ents));
+	centers = Z_Malloc(ge->num_edicts * sizeof(*centers));
+	numents = 0;
+
+	for (i = 1; i < ge->num_edicts; i++)
+	{
+		ent = EDICT_NUM(i);
+
+		if (ent->area.prev)
+		{
+			SV_UnlinkEdict(ent);
+			ents[numents++] = ent;
+		}
+	}
+
+	memset(sv_areanodes, 0, sizeof(sv_areanodes));
+	sv_numareanodes = 0;
+	SV_CreateAreaNode(0, sv.models[1]->mins, sv.models[1]->maxs,
+			ents, numents, centers);
+
+	/* SV_CreateAreaNode() shuffled the list, relink in edict order.
+	   Only the area links change, so don't go through SV_LinkEdict(),
+	   that would bump the linkcount and drop the game's groundentities */
+	qsort(ents, numents, sizeof(ents[0]), SV_AreaEdictCompare);
+
+	for (i = 0; i < numents; i++)
+	{
+		SV_LinkToAreaNode(ents[i]);
+	}
+
+	Z_Free(centers);
+	Z_Free(ents);
+
+	area_traces = 0;
+	area_candidates = 0;
+}
+
+static void
+SV_AreaStats_r(areanode_t *node, int *nodes, int *leafs,
+		int *solid, int *trigger)
+{
+	link_t *l;
+
+	nodes[node->depth]++;
+
+	for (l = node->solid_edicts.next; l != &node->solid_edicts; l = l->next)
+	{
+		solid[node->depth]++;
+	}
+
+	for (l = node->trigger_edicts.next; l != &node->trigger_edicts; l = l->next)
+	{
+		trigger[node->depth]++;
+	}
+
+	if (node->axis == -1)
+	{
+		leafs[node->depth]++;
+		return;
+	}
+
+	SV_AreaStats_r(node->children[0], nodes, leafs, solid, trigger);
+	SV_AreaStats_r(node->children[1], nodes, leafs, solid, trigger);
+}
+
+/*
+ * sv_areastats [reset]
+ */
+void
+SV_AreaStats_f(void)
+{
+	int nodes[AREA_MAX_DEPTH + 1], leafs[AREA_MAX_DEPTH + 1];
+	int solid[AREA_MAX_DEPTH + 1], trigger[AREA_MAX_DEPTH + 1];
+	int i;
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("No map loaded.\n");
+		return;
+	}
+
+	if ((Cmd_Argc() > 1) && !strcmp(Cmd_Argv(1), "reset"))
+	{
+		area_traces = 0;
+		area_candidates = 0;
+		return;
+	}
+
+	memset(nodes, 0, sizeof(nodes));
+	memset(leafs, 0, sizeof(leafs));
+	memset(solid, 0, sizeof(solid));
+	memset(trigger, 0, sizeof(trigger));
+
+	SV_AreaStats_r(sv_areanodes, nodes, leafs, solid, trigger);
+
+	Com_Printf("depth nodes leafs  solid trigger\n");
+	Com_Printf("----- ----- ----- ------ -------\n");
+
+	for (i = 0; i <= AREA_MAX_DEPTH; i++)
+	{
+		if (!nodes[i])
+		{
+			continue;
+		}
+
+		Com_Printf("%5i %5i %5i %6i %7i\n", i, nodes[i], leafs[i],
+				solid[i], trigger[i]);
+	}
+
+	Com_Printf("%i nodes, %i traces, %.2f candidates per trace\n",
+			sv_numareanodes, area_traces,
+			area_traces ? (float)area_candidates / area_traces : 0.0f);
 }
 
 void
@@ -146,7 +562,6 @@ SV_UnlinkEdict(edict_t *ent)
 void
 SV_LinkEdict(edict_t *ent)
 {
-	areanode_t *node;
 	int leafs[MAX_TOTAL_ENT_LEAFS];
 	int clusters[MAX_TOTAL_ENT_LEAFS];
 	int num_leafs;
@@ -352,6 +767,8 @@ SV_LinkEdict(edict_t *ent)
 		}
 	}
 
+	SV_LinkClusters(ent);
+
 	/* if first time, make sure old_origin is valid */
 	if (!ent->linkcount)
 	{
@@ -365,39 +782,7 @@ SV_LinkEdict(edict_t *ent)
 		return;
 	}
 
-	/* find the first node that the ent's box crosses */
-	node = sv_areanodes;
-
-	while (1)
-	{
-		if (node->axis == -1)
-		{
-			break;
-		}
-
-		if (ent->absmin[node->axis] > node->dist)
-		{
-			node = node->children[0];
-		}
-		else if (ent->absmax[node->axis] < node->dist)
-		{
-			node = node->children[1];
-		}
-		else
-		{
-			break; /* crosses the node */
-		}
-	}
-
-	/* link it in */
-	if (ent->solid == SOLID_TRIGGER)
-	{
-		InsertLinkBefore(&ent->area, &node->trigger_edicts);
-	}
-	else
-	{
-		InsertLinkBefore(&ent->area, &node->solid_edicts);
-	}
+	SV_LinkToAreaNode(ent);
 }
 
 static void
@@ -555,17 +940,14 @@ SV_HullForEntity(edict_t *ent)
 }
 
 static void
-SV_ClipMoveToEntities(moveclip_t *clip)
+SV_ClipMoveToEntityList(moveclip_t *clip, edict_t **touchlist, int num)
 {
-	int i, num;
-	edict_t *touchlist[MAX_EDICTS], *touch;
+	int i;
+	edict_t *touch;
 	trace_t trace;
 	int headnode;
 	float *angles;
 
-	num = SV_AreaEdicts(clip->boxmins, clip->boxmaxs, touchlist,
-			MAX_EDICTS, AREA_SOLID);
-
 	/* be careful, it is possible to have an entity in this
 	   list removed before we get to it (killtriggered) */
 	for (i = 0; i < num; i++)
@@ -646,6 +1028,21 @@ SV_ClipMoveToEntities(moveclip_t *clip)
 	}
 }
 
+static void
+SV_ClipMoveToEntities(moveclip_t *clip)
+{
+	int num;
+	edict_t *touchlist[MAX_EDICTS];
+
+	num = SV_AreaEdicts(clip->boxmins, clip->boxmaxs, touchlist,
+			MAX_EDICTS, AREA_SOLID);
+
+	area_traces++;
+	area_candidates += num;
+
+	SV_ClipMoveToEntityList(clip, touchlist, num);
+}
+
 static void
 SV_TraceBounds(const vec3_t start, const vec3_t mins, const vec3_t maxs,
 		const vec3_t end, vec3_t boxmins, vec3_t boxmaxs)
@@ -687,6 +1084,8 @@ SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
 		maxs = vec3_origin;
 	}
 
+	sv.numtraces++;
+
 	memset(&clip, 0, sizeof(moveclip_t));
 
 	/* clip to world */
@@ -718,3 +1117,117 @@ SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
 	return clip.trace;
 }
 
+
+/*
+ * Moves the given mins/maxs volume from start to each of
+ * the ends, like calling SV_Trace() count times. The world
+ * is clipped with one shared BSP walk and the area tree is
+ * only asked once for the edicts touching the whole batch.
+ */
+void
+SV_TraceBatch(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t *ends,
+		int count, edict_t *passedict, int contentmask, trace_t *results)
+{
+	edict_t *touchlist[MAX_EDICTS], *touch;
+	edict_t *raylist[MAX_EDICTS];
+	vec3_t boxmins, boxmaxs;
+	moveclip_t clip;
+	int i, j, num, numray;
+
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	sv.numtraces += count;
+
+	/* clip to world */
+	CM_BoxTraceBatch(start, (const vec3_t *)ends, count, mins, maxs, 0,
+			contentmask, results);
+
+	/* one area query covering every ray */
+	for (i = 0; i < count; i++)
+	{
+		results[i].ent = ge->edicts;
+
+		SV_TraceBounds(start, mins, maxs, ends[i], clip.boxmins, clip.boxmaxs);
+
+		if (i == 0)
+		{
+			VectorCopy(clip.boxmins, boxmins);
+			VectorCopy(clip.boxmaxs, boxmaxs);
+		}
+		else
+		{
+			for (j = 0; j < 3; j++)
+			{
+				boxmins[j] = Q_min(boxmins[j], clip.boxmins[j]);
+				boxmaxs[j] = Q_max(boxmaxs[j], clip.boxmaxs[j]);
+			}
+		}
+	}
+
+	num = SV_AreaEdicts(boxmins, boxmaxs, touchlist, MAX_EDICTS, AREA_SOLID);
+
+	for (i = 0; i < count; i++)
+	{
+		if (results[i].fraction == 0)
+		{
+			continue; /* blocked by the world */
+		}
+
+		memset(&clip, 0, sizeof(moveclip_t));
+
+		clip.trace = results[i];
+		clip.contentmask = contentmask;
+		clip.start = start;
+		clip.end = ends[i];
+		clip.mins = mins;
+		clip.maxs = maxs;
+		clip.passedict = passedict;
+
+		VectorCopy(mins, clip.mins2);
+		VectorCopy(maxs, clip.maxs2);
+
+		SV_TraceBounds(start, clip.mins2, clip.maxs2,
+				ends[i], clip.boxmins, clip.boxmaxs);
+
+		/* narrow the shared list down to this ray, in the
+		   same order SV_AreaEdicts() would have returned it */
+		numray = 0;
+
+		for (j = 0; j < num; j++)
+		{
+			touch = touchlist[j];
+
+			if ((touch->absmin[0] > clip.boxmaxs[0]) ||
+				(touch->absmin[1] > clip.boxmaxs[1]) ||
+				(touch->absmin[2] > clip.boxmaxs[2]) ||
+				(touch->absmax[0] < clip.boxmins[0]) ||
+				(touch->absmax[1] < clip.boxmins[1]) ||
+				(touch->absmax[2] < clip.boxmins[2]))
+			{
+				continue;
+			}
+
+			raylist[numray++] = touch;
+		}
+
+		area_traces++;
+		area_candidates += numray;
+
+		SV_ClipMoveToEntityList(&clip, raylist, numray);
+
+		results[i] = clip.trace;
+	}
+}